@@ -0,0 +1,632 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The Hypha IP Micro-Benchmarks.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "hypha_ip/hypha_internal.h"
+#include "hypha_ip/hypha_ip.h"
+
+/// The number of iterations of each benchmark loop
+#ifndef HYPHA_IP_BENCHMARK_ITERATIONS
+#define HYPHA_IP_BENCHMARK_ITERATIONS (10'000'000U)
+#endif
+
+/// The most producer threads of the transmit ring benchmark, which doubles them from one up to this
+#ifndef HYPHA_IP_BENCHMARK_PRODUCERS
+#define HYPHA_IP_BENCHMARK_PRODUCERS (8U)
+#endif
+
+/// Keeps the compiler from removing the work being measured
+static volatile uint8_t benchmark_sink;
+
+/// @return The monotonic time in nanoseconds
+static uint64_t BenchmarkNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1'000'000'000U) + (uint64_t)now.tv_nsec;
+}
+
+/// @brief Prints a single result line
+static void BenchmarkReport(char const *name, uint64_t nanoseconds, size_t iterations) {
+    printf("%-40s %10.3f ns/op\r\n", name, (double)nanoseconds / (double)iterations);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// FLIPS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// A header to benchmark, the interpreter table and the specialized flip
+typedef struct BenchmarkFlip {
+    char const *name;                    ///< The name of the header
+    size_t num_units;                    ///< The number of units in the table
+    HyphaIpFlipUnit_t const *units;      ///< The interpreter table
+    void (*flip)(void *, void const *);  ///< The specialized flip
+} BenchmarkFlip_t;
+
+static void BenchmarkFlips(void) {
+    BenchmarkFlip_t const flips[] = {
+        {"ethernet", HYPHA_IP_DIMOF(hypha_ip_flip_ethernet_header), hypha_ip_flip_ethernet_header,
+         HyphaIpFlipEthernetHeader},
+        {"ipv4", HYPHA_IP_DIMOF(hypha_ip_flip_ip_header), hypha_ip_flip_ip_header, HyphaIpFlipIPv4Header},
+        {"udp", HYPHA_IP_DIMOF(hypha_ip_flip_udp_header), hypha_ip_flip_udp_header, HyphaIpFlipUdpHeader},
+        {"arp", HYPHA_IP_DIMOF(hypha_ip_flip_arp_packet), hypha_ip_flip_arp_packet, HyphaIpFlipArpPacket},
+        {"igmp", HYPHA_IP_DIMOF(hypha_ip_flip_igmp_packet), hypha_ip_flip_igmp_packet, HyphaIpFlipIgmpPacket},
+    };
+    _Alignas(8) uint8_t source[64];
+    _Alignas(8) uint8_t destination[64];
+    for (size_t i = 0U; i < sizeof(source); i++) {
+        source[i] = (uint8_t)i;
+    }
+    char name[64];
+    for (size_t f = 0U; f < HYPHA_IP_DIMOF(flips); f++) {
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < HYPHA_IP_BENCHMARK_ITERATIONS; i++) {
+            source[0] = (uint8_t)i;
+            HyphaIpFlipCopy(flips[f].num_units, flips[f].units, destination, source);
+            benchmark_sink = destination[0];
+        }
+        uint64_t interpreted = BenchmarkNow() - start;
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < HYPHA_IP_BENCHMARK_ITERATIONS; i++) {
+            source[0] = (uint8_t)i;
+            flips[f].flip(destination, source);
+            benchmark_sink = destination[0];
+        }
+        uint64_t specialized = BenchmarkNow() - start;
+        snprintf(name, sizeof(name), "flip %s (table)", flips[f].name);
+        BenchmarkReport(name, interpreted, HYPHA_IP_BENCHMARK_ITERATIONS);
+        snprintf(name, sizeof(name), "flip %s (specialized)", flips[f].name);
+        BenchmarkReport(name, specialized, HYPHA_IP_BENCHMARK_ITERATIONS);
+    }
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// CHECKSUMS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+static void BenchmarkChecksums(void) {
+    struct {
+        char const *name;
+        HyphaIpChecksumKernel_e kernel;
+    } const kernels[] = {
+        {"scalar", HyphaIpChecksumKernelScalar},
+        {"sse2", HyphaIpChecksumKernelSSE2},
+        {"avx2", HyphaIpChecksumKernelAVX2},
+        {"neon", HyphaIpChecksumKernelNEON},
+    };
+    static uint8_t payload[HYPHA_IP_MAX_UDP_PAYLOAD_SIZE + 1U];
+    for (size_t i = 0U; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 131U);
+    }
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 100U;
+    char name[64];
+    for (size_t k = 0U; k < HYPHA_IP_DIMOF(kernels); k++) {
+        if (!HyphaIpChecksumKernelIsAvailable(kernels[k].kernel)) {
+            continue;
+        }
+        // 1472 bytes starting on an odd address
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            payload[1] = (uint8_t)i;
+            benchmark_sink =
+                (uint8_t)HyphaIpChecksumBytes(kernels[k].kernel, &payload[1], HYPHA_IP_MAX_UDP_PAYLOAD_SIZE);
+        }
+        snprintf(name, sizeof(name), "checksum 1472 bytes (%s)", kernels[k].name);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+    }
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// UDP TRANSMIT
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// The benchmark is the client of the stack
+struct HyphaIpExternalContext {
+    HyphaIpTimestamp_t timestamp;     ///< The fake monotonic clock
+    /// A fragmented transmit holds the first frame while filling the others, the transmit ring holds one per slot
+    HyphaIpEthernetFrame_t frames[2U + HYPHA_IP_TRANSMIT_RING_SIZE];
+    bool taken[2U + HYPHA_IP_TRANSMIT_RING_SIZE];  ///< The frames which are acquired
+    HyphaIpEthernetFrame_t *captured;  ///< When set, the transmitted frames are copied here
+    size_t captures;                   ///< The number of frames copied to captured
+};
+
+static HyphaIpEthernetFrame_t *BenchmarkAcquire(HyphaIpExternalContext_t mine) {
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(mine->frames); i++) {
+        if (!mine->taken[i]) {
+            mine->taken[i] = true;
+            mine->frames[i].info.capacity = HYPHA_IP_FRAME_CAPACITY;
+            return &mine->frames[i];
+        }
+    }
+    return nullptr;
+}
+
+static HyphaIpStatus_e BenchmarkRelease(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *frame) {
+    mine->taken[frame - mine->frames] = false;
+    return HyphaIpStatusOk;
+}
+
+static HyphaIpStatus_e BenchmarkReceive(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *frame) {
+    (void)mine;
+    (void)frame;
+    return HyphaIpStatusFailure;  // nothing is ever received
+}
+
+static HyphaIpStatus_e BenchmarkTransmit(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *frame) {
+    if (mine->captured != nullptr) {
+        memcpy(&mine->captured[mine->captures++], frame, HYPHA_IP_FRAME_ALLOCATION(frame->info.length));
+    }
+    benchmark_sink = frame->payload[HyphaIpUdpOffsetChecksum];
+    return HyphaIpStatusOk;
+}
+
+static HyphaIpStatus_e BenchmarkReceiveUdp(HyphaIpExternalContext_t mine, HyphaIpMetaData_t *metadata,
+                                           HyphaIpSpan_t span) {
+    (void)mine;
+    (void)metadata;
+    benchmark_sink = (uint8_t)span.count;
+    return HyphaIpStatusOk;
+}
+
+static int BenchmarkPrint(HyphaIpExternalContext_t mine, char const *const format, ...) {
+    (void)mine;
+    (void)format;
+    return 0;
+}
+
+static HyphaIpTimestamp_t BenchmarkTimestamp(HyphaIpExternalContext_t mine) { return ++mine->timestamp; }
+
+static void BenchmarkReportStatus(HyphaIpExternalContext_t mine, HyphaIpStatus_e status, char const *const func,
+                                  char const *const file, unsigned int line) {
+    (void)mine;
+    if (status != HyphaIpStatusOk) {
+        printf("Error %d in %s @ %s:%u\r\n", (int)status, func, file, line);
+    }
+}
+
+/// The client context of the benchmark stack
+static struct HyphaIpExternalContext benchmark_client;
+
+/// The storage of the benchmark stack, each benchmark runs its own one in turn
+static _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) uint8_t benchmark_storage[sizeof(struct HyphaIpContext)];
+
+/// @brief Initializes a stack on top of the benchmark driver
+static HyphaIpContext_t BenchmarkInitialize(void) {
+    HyphaIpNetworkInterface_t interface = {
+        .mac = {{0x02, 0x00, 0x00}, {0x00, 0x00, 0x01}},
+        .address = {172, 16, 0, 7},
+        .netmask = {255, 255, 0, 0},
+        .gateway = {172, 16, 0, 1},
+    };
+    HyphaIpExternalInterface_t externals = {
+        .acquire = BenchmarkAcquire,
+        .release = BenchmarkRelease,
+        .receive = BenchmarkReceive,
+        .transmit = BenchmarkTransmit,
+        .receive_udp = BenchmarkReceiveUdp,
+        .print = BenchmarkPrint,
+        .get_monotonic_timestamp = BenchmarkTimestamp,
+        .report = BenchmarkReportStatus,
+    };
+    HyphaIpContext_t context = nullptr;
+    if (HyphaIpIsFailure(HyphaIpInitialize(&context, benchmark_storage, sizeof(benchmark_storage), &interface,
+                                           &benchmark_client, &externals))) {
+        printf("Could not initialize the stack\r\n");
+    }
+    return context;
+}
+
+static void BenchmarkUdpTransmit(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpUdpFlow_t flow;
+    (void)HyphaIpPrepareUdpTransmit(context, &metadata, &flow);
+    static uint8_t payload[HYPHA_IP_MAX_UDP_PAYLOAD_SIZE];
+    size_t const sizes[] = {64U, HYPHA_IP_MAX_UDP_PAYLOAD_SIZE};
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        HyphaIpSpan_t datagram = {.pointer = payload, .count = (uint32_t)sizes[s], .type = HyphaIpSpanTypeUint8_t};
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            payload[0] = (uint8_t)i;
+            (void)HyphaIpTransmitUdpDatagram(context, &metadata, datagram);
+        }
+        snprintf(name, sizeof(name), "udp transmit %zu bytes (datagram)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            payload[0] = (uint8_t)i;
+            (void)HyphaIpTransmitUdpFlow(context, &flow, datagram);
+        }
+        snprintf(name, sizeof(name), "udp transmit %zu bytes (flow)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+    }
+    (void)HyphaIpDeinitialize(&context);
+}
+
+static void BenchmarkUdpFragmented(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    static uint8_t payload[HYPHA_IP_MAX_UDP_DATAGRAM_SIZE];
+    size_t const sizes[] = {8192U, HYPHA_IP_MAX_UDP_DATAGRAM_SIZE};
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 1000U;
+    char name[64];
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        HyphaIpSpan_t datagram = {.pointer = payload, .count = (uint32_t)sizes[s], .type = HyphaIpSpanTypeUint8_t};
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            payload[0] = (uint8_t)i;
+            (void)HyphaIpTransmitUdpDatagram(context, &metadata, datagram);
+        }
+        uint64_t elapsed = BenchmarkNow() - start;
+        snprintf(name, sizeof(name), "udp transmit %zu bytes (fragmented)", sizes[s]);
+        BenchmarkReport(name, elapsed, iterations);
+        printf("%-40s %10.3f MB/s\r\n", name, ((double)sizes[s] * (double)iterations * 1e3) / (double)elapsed);
+    }
+    (void)HyphaIpDeinitialize(&context);
+}
+
+/// The orders the fragments of a datagram are received in
+typedef enum BenchmarkOrder {
+    BenchmarkOrderInOrder,     ///< As they were sent, the first fragment last
+    BenchmarkOrderReversed,    ///< The last fragment first
+    BenchmarkOrderInterleaved  ///< The odd fragments then the even ones
+} BenchmarkOrder_e;
+
+static void BenchmarkReassembly(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    static HyphaIpReassemblySlot_t slots[2];
+    (void)HyphaIpProvideReassemblySlots(context, HYPHA_IP_DIMOF(slots), slots);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    static uint8_t payload[HYPHA_IP_MAX_UDP_DATAGRAM_SIZE];
+    static HyphaIpEthernetFrame_t fragments[(HYPHA_IP_MAX_UDP_DATAGRAM_SIZE / 1024U) + 1U];
+    size_t order[HYPHA_IP_DIMOF(fragments)];
+    char const *const names[] = {"in order", "reversed", "interleaved"};
+    size_t const sizes[] = {8192U, HYPHA_IP_MAX_UDP_DATAGRAM_SIZE};
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 1000U;
+    char name[64];
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        // the stack fragments the datagram for us
+        HyphaIpSpan_t datagram = {.pointer = payload, .count = (uint32_t)sizes[s], .type = HyphaIpSpanTypeUint8_t};
+        benchmark_client.captured = fragments;
+        benchmark_client.captures = 0U;
+        (void)HyphaIpTransmitUdpDatagram(context, &metadata, datagram);
+        benchmark_client.captured = nullptr;
+        size_t const count = benchmark_client.captures;
+        for (BenchmarkOrder_e o = BenchmarkOrderInOrder; o <= BenchmarkOrderInterleaved; o++) {
+            for (size_t i = 0U; i < count; i++) {
+                if (o == BenchmarkOrderInOrder) {
+                    order[i] = i;
+                } else if (o == BenchmarkOrderReversed) {
+                    order[i] = count - 1U - i;
+                } else {
+                    size_t const odds = count / 2U;
+                    order[i] = (i < odds) ? ((2U * i) + 1U) : (2U * (i - odds));
+                }
+            }
+            uint64_t start = BenchmarkNow();
+            for (size_t i = 0U; i < iterations; i++) {
+                for (size_t f = 0U; f < count; f++) {
+                    (void)HyphaIpIPv4ReceivePacket(context, &fragments[order[f]], (HyphaIpTimestamp_t)i);
+                }
+            }
+            snprintf(name, sizeof(name), "reassemble %zu bytes (%s)", sizes[s], names[o]);
+            BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        }
+    }
+    if (HyphaIpGetStatistics(context)->reassembly.hits != (HYPHA_IP_DIMOF(sizes) * 3U * iterations)) {
+        printf("Not every datagram was reassembled\r\n");
+    }
+    (void)HyphaIpDeinitialize(&context);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// IPv4 Filter
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// The IPv4 filter as it was before the prefixes, a scan over every address, kept to compare against
+static bool BenchmarkIPv4FilterScan(size_t count, HyphaIpIPv4Prefix_t const hosts[count],
+                                    HyphaIpIPv4Address_t address) {
+    for (size_t i = 0U; i < count; i++) {
+        if (HyphaIpIsSameIPv4Address(hosts[i].address, address)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void BenchmarkIPv4Filter(void) {
+    size_t const sizes[] = {32U, 256U, 4096U};
+    // every other address, so the hosts do not merge into ranges
+    static HyphaIpIPv4Prefix_t hosts[4096U];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(hosts); i++) {
+        hosts[i] = (HyphaIpIPv4Prefix_t){{172, 16, (uint8_t)(i >> 7U), (uint8_t)(2U * i)}, 32U};
+    }
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        if (sizes[s] > HYPHA_IP_IPv4_FILTER_TABLE_SIZE) {
+            printf("ipv4 filter %zu hosts skipped, HYPHA_IP_IPv4_FILTER_TABLE_SIZE is %u\r\n", sizes[s],
+                   (unsigned int)HYPHA_IP_IPv4_FILTER_TABLE_SIZE);
+            continue;
+        }
+        HyphaIpContext_t context = BenchmarkInitialize();
+        if (context == nullptr) {
+            return;
+        }
+        (void)HyphaIpPopulateIPv4Prefixes(context, sizes[s], hosts);
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            benchmark_sink = BenchmarkIPv4FilterScan(sizes[s], hosts, hosts[i % sizes[s]].address);
+        }
+        snprintf(name, sizeof(name), "ipv4 filter %zu hosts (scan)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            benchmark_sink = HyphaIpIsPermittedIPv4Address(context, hosts[i % sizes[s]].address);
+        }
+        snprintf(name, sizeof(name), "ipv4 filter %zu hosts (hit)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            HyphaIpIPv4Address_t missing = hosts[i % sizes[s]].address;
+            missing.d |= 1U;
+            benchmark_sink = HyphaIpIsPermittedIPv4Address(context, missing);
+        }
+        snprintf(name, sizeof(name), "ipv4 filter %zu hosts (miss)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        (void)HyphaIpDeinitialize(&context);
+    }
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Ethernet
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+static void BenchmarkMulticastFilter(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    context->features.allow_any_multicast = false;
+    static HyphaIpEthernetAddress_t groups[HYPHA_IP_MULTICAST_FILTER_SIZE];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(groups); i++) {
+        HyphaIpIPv4Address_t group = {239, 1, (uint8_t)(i >> 8U), (uint8_t)i};
+        (void)HyphaIpConvertMulticast(&groups[i], group);
+    }
+    (void)HyphaIpPopulateEthernetFilter(context, HYPHA_IP_DIMOF(groups), groups);
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    uint64_t start = BenchmarkNow();
+    for (size_t i = 0U; i < iterations; i++) {
+        benchmark_sink = HyphaIpIsPermittedEthernetAddress(context, groups[i % HYPHA_IP_DIMOF(groups)]);
+    }
+    snprintf(name, sizeof(name), "multicast filter %zu groups (hit)", HYPHA_IP_DIMOF(groups));
+    BenchmarkReport(name, BenchmarkNow() - start, iterations);
+    HyphaIpEthernetAddress_t missing = {{0x01, 0x00, 0x5E}, {0x02, 0x00, 0x00}};
+    start = BenchmarkNow();
+    for (size_t i = 0U; i < iterations; i++) {
+        missing.uid[1] = (uint8_t)(i >> 8U);
+        missing.uid[2] = (uint8_t)i;
+        benchmark_sink = HyphaIpIsPermittedEthernetAddress(context, missing);
+    }
+    snprintf(name, sizeof(name), "multicast filter %zu groups (miss)", HYPHA_IP_DIMOF(groups));
+    BenchmarkReport(name, BenchmarkNow() - start, iterations);
+    (void)HyphaIpDeinitialize(&context);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// ARP
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+static void BenchmarkArpLookup(void) {
+    size_t const sizes[] = {32U, 256U, 4096U};
+    static HyphaIpAddressMatch_t matches[4096U];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(matches); i++) {
+        matches[i] = (HyphaIpAddressMatch_t){{{0x02, 0x00, 0x00}, {0x00, (uint8_t)(i >> 8U), (uint8_t)i}},
+                                             {172, 16, (uint8_t)(i >> 8U), (uint8_t)i}};
+    }
+    HyphaIpIPv4Address_t missing = {172, 17, 0, 1};
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        if (sizes[s] > HYPHA_IP_ARP_TABLE_SIZE) {
+            printf("arp lookup %zu entries skipped, HYPHA_IP_ARP_TABLE_SIZE is %u\r\n", sizes[s],
+                   (unsigned int)HYPHA_IP_ARP_TABLE_SIZE);
+            continue;
+        }
+        HyphaIpContext_t context = BenchmarkInitialize();
+        if (context == nullptr) {
+            return;
+        }
+        (void)HyphaIpPopulateArpTable(context, sizes[s], matches);
+        uint64_t start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            HyphaIpEthernetAddress_t mac = HyphaIpFindEthernetAddress(context, &matches[i % sizes[s]].ipv4);
+            benchmark_sink = mac.uid[2];
+        }
+        snprintf(name, sizeof(name), "arp lookup %zu entries (by ipv4)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            HyphaIpIPv4Address_t ipv4 = HyphaIpFindIPv4Address(context, &matches[i % sizes[s]].mac);
+            benchmark_sink = ipv4.d;
+        }
+        snprintf(name, sizeof(name), "arp lookup %zu entries (by mac)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        start = BenchmarkNow();
+        for (size_t i = 0U; i < iterations; i++) {
+            missing.d = (uint8_t)i;
+            HyphaIpEthernetAddress_t mac = HyphaIpFindEthernetAddress(context, &missing);
+            benchmark_sink = mac.uid[2];
+        }
+        snprintf(name, sizeof(name), "arp lookup %zu entries (miss)", sizes[s]);
+        BenchmarkReport(name, BenchmarkNow() - start, iterations);
+        (void)HyphaIpDeinitialize(&context);
+    }
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Timers
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// Ages the ARP cache the way a periodic sweep would, a look at every entry, kept to compare against
+static size_t BenchmarkArpSweep(HyphaIpContext_t context, HyphaIpTimestamp_t now) {
+    size_t expired = 0U;
+    HyphaIpArpCache_t const *cache = &HyphaIpTablesReadBegin(context)->arp_cache;
+    for (size_t i = 0U; i < cache->count; i++) {
+        expired += (cache->entries[i].expiration <= now) ? 1U : 0U;
+    }
+    HyphaIpTablesReadEnd(context);
+    return expired;
+}
+
+static void BenchmarkTimers(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    // a full cache whose entries expire one millisecond apart over the next minute
+    HyphaIpTimestamp_t now = benchmark_client.timestamp;
+    HyphaIpTablesLock(context);
+    for (size_t i = 0U; i < HYPHA_IP_ARP_TABLE_SIZE; i++) {
+        HyphaIpAddressMatch_t match = {{{0x02, 0x00, 0x00}, {0x00, (uint8_t)(i >> 8U), (uint8_t)i}},
+                                       {172, 16, (uint8_t)(i >> 8U), (uint8_t)i}};
+        (void)HyphaIpArpCacheInsert(context, &match, now + 60'000 + (HyphaIpTimestamp_t)i);
+    }
+    HyphaIpTablesDraft(context, HyphaIpTableNone)->populated++;  // the owner starts the timers on its next tick
+    HyphaIpTablesUnlock(context);
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    uint64_t start = BenchmarkNow();
+    for (size_t i = 0U; i < iterations; i++) {
+        benchmark_sink = (uint8_t)BenchmarkArpSweep(context, now + (HyphaIpTimestamp_t)(i % 60'000U));
+    }
+    snprintf(name, sizeof(name), "timers %u arp entries (sweep)", (unsigned int)HYPHA_IP_ARP_TABLE_SIZE);
+    BenchmarkReport(name, BenchmarkNow() - start, iterations);
+    // every millisecond up to the first expiration, which is mostly nothing due
+    start = BenchmarkNow();
+    size_t const ticks = 60'000U;
+    for (size_t i = 0U; i < ticks; i++) {
+        benchmark_sink = (uint8_t)HyphaIpTick(context, now + (HyphaIpTimestamp_t)i);
+    }
+    snprintf(name, sizeof(name), "timers %u arp entries (tick)", (unsigned int)HYPHA_IP_ARP_TABLE_SIZE);
+    BenchmarkReport(name, BenchmarkNow() - start, ticks);
+    // then once for each entry as it expires
+    start = BenchmarkNow();
+    for (size_t i = 0U; i < HYPHA_IP_ARP_TABLE_SIZE; i++) {
+        benchmark_sink = (uint8_t)HyphaIpTick(context, now + 60'000 + (HyphaIpTimestamp_t)i);
+    }
+    snprintf(name, sizeof(name), "timers %u arp entries (expire)", (unsigned int)HYPHA_IP_ARP_TABLE_SIZE);
+    BenchmarkReport(name, BenchmarkNow() - start, HYPHA_IP_ARP_TABLE_SIZE);
+    (void)HyphaIpDeinitialize(&context);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Transmit Ring
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// The work of a producer thread
+typedef struct BenchmarkProducer {
+    HyphaIpContext_t context;      ///< The stack to queue on
+    HyphaIpUdpFlow_t const *flow;  ///< The flow every producer sends on
+    size_t count;                  ///< The datagrams to queue
+    atomic_bool const *go;         ///< Holds the producers back until they are all running
+} BenchmarkProducer_t;
+
+static void *BenchmarkProduce(void *argument) {
+    BenchmarkProducer_t const *producer = (BenchmarkProducer_t const *)argument;
+    uint8_t payload[64] = {0};
+    HyphaIpSpan_t datagram = {.pointer = payload, .count = sizeof(payload), .type = HyphaIpSpanTypeUint8_t};
+    while (!atomic_load_explicit(producer->go, memory_order_acquire)) {
+        sched_yield();
+    }
+    for (size_t i = 0U; i < producer->count; i++) {
+        payload[0] = (uint8_t)i;
+        // a full ring waits for the owner to drain
+        while (HyphaIpEnqueueUdpFlow(producer->context, producer->flow, datagram) == HyphaIpStatusTransmitRingFull) {
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+static void BenchmarkTransmitRing(void) {
+    HyphaIpContext_t context = BenchmarkInitialize();
+    if (context == nullptr) {
+        return;
+    }
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpUdpFlow_t flow;
+    (void)HyphaIpPrepareUdpTransmit(context, &metadata, &flow);
+    if (HyphaIpIsFailure(HyphaIpStartTransmitRing(context))) {
+        printf("Could not start the transmit ring\r\n");
+        (void)HyphaIpDeinitialize(&context);
+        return;
+    }
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    size_t const iterations = HYPHA_IP_BENCHMARK_ITERATIONS / 10U;
+    char name[64];
+    for (size_t producers = 1U; producers <= HYPHA_IP_BENCHMARK_PRODUCERS; producers *= 2U) {
+        atomic_bool go = false;
+        pthread_t threads[HYPHA_IP_BENCHMARK_PRODUCERS];
+        BenchmarkProducer_t work[HYPHA_IP_BENCHMARK_PRODUCERS];
+        size_t const each = iterations / producers;
+        for (size_t p = 0U; p < producers; p++) {
+            work[p] = (BenchmarkProducer_t){.context = context, .flow = &flow, .count = each, .go = &go};
+            (void)pthread_create(&threads[p], nullptr, BenchmarkProduce, &work[p]);
+        }
+        size_t const goal = statistics->ring.drained + (each * producers);
+        size_t const overflows = statistics->ring.overflows;
+        uint64_t start = BenchmarkNow();
+        atomic_store_explicit(&go, true, memory_order_release);
+        // this thread owns the stack and drains while the others produce
+        while (statistics->ring.drained < goal) {
+            size_t drained = 0U;
+            (void)HyphaIpDrainTransmitRing(context, &drained);
+            if (drained == 0U) {
+                sched_yield();  // let the producers fill the ring
+            }
+        }
+        uint64_t elapsed = BenchmarkNow() - start;
+        for (size_t p = 0U; p < producers; p++) {
+            (void)pthread_join(threads[p], nullptr);
+        }
+        snprintf(name, sizeof(name), "udp ring 64 bytes (%zu producers)", producers);
+        BenchmarkReport(name, elapsed, each * producers);
+        printf("%-40s %10zu full\r\n", name, statistics->ring.overflows - overflows);
+    }
+    (void)HyphaIpDeinitialize(&context);
+}
+
+int main(void) {
+    BenchmarkFlips();
+    BenchmarkChecksums();
+    BenchmarkUdpTransmit();
+    BenchmarkUdpFragmented();
+    BenchmarkReassembly();
+    BenchmarkIPv4Filter();
+    BenchmarkMulticastFilter();
+    BenchmarkArpLookup();
+    BenchmarkTimers();
+    BenchmarkTransmitRing();
+    return 0;
+}
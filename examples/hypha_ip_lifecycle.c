@@ -91,13 +91,20 @@ int main(int argc, char *argv[argc]) {
     (void)argv;  // Suppress unused parameter warning
 
     /// ![Hypha IP Lifecycle Example]
+    // The context lives in storage from whatever allocator you need, one for each stack you run
+    size_t size = HyphaIpContextSize();
+    void *storage = aligned_alloc(HYPHA_IP_CONTEXT_ALIGNMENT, size);
+    if (storage == nullptr) {
+        return -1;
+    }
     // Initialize the Hypha IP context
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &interface, &mine, &externals);
+    HyphaIpStatus_e status = HyphaIpInitialize(&context, storage, size, &interface, &mine, &externals);
     // check if the initialization was successful
     if (HyphaIpIsSuccess(status)) {
         // Initialization was successful, proceed with the lifecycle
     } else {
         // Handle initialization failure
+        free(storage);
         return -1;
     }
 
@@ -156,6 +163,9 @@ int main(int argc, char *argv[argc]) {
     status = HyphaIpDeinitialize(&context);
     // check if the deinitialization was successful
 
+    // The storage is no longer used by the stack
+    free(storage);
+
     // Any context cleanup for the client context can be done here
 
     /// ![Hypha IP Lifecycle Example]
@@ -93,6 +93,17 @@ typedef enum HyphaIpEtherType : uint16_t {
 #define HYPHA_IP_TTL 64
 #endif
 
+#ifndef HYPHA_IP_CONTEXT_ALIGNMENT
+/// The alignment of a context in bytes, see @ref HyphaIpContextSize. A whole cache line keeps contexts which are
+/// next to each other (one per core or NIC queue) from sharing a line.
+#define HYPHA_IP_CONTEXT_ALIGNMENT 64
+#endif
+
+#ifndef HYPHA_IP_INTERFACE_COUNT
+/// The number of network interfaces a context can own, see @ref HyphaIpAddInterface
+#define HYPHA_IP_INTERFACE_COUNT 2
+#endif
+
 #ifndef HYPHA_INTERNAL
 /// Define this as blank to expose internal functions to debuggers
 #define HYPHA_INTERNAL static
@@ -131,9 +142,9 @@ typedef struct HyphaIpEthernetHeader {
     HyphaIpEthernetAddress_t source;       ///< The source MAC address
 #if (HYPHA_IP_USE_VLAN == 1)
     uint16_t tpid;               ///<  See @ref HyphaIpEtherType
-    uint16_t priority : 3;       ///<  The priority of the frame, 0-7
+    uint16_t vlan : 12;          ///<  The VLAN ID, if any (the low bits of the tag control information)
     uint16_t drop_eligible : 1;  ///<  Used to indicate that the frame can be dropped if necessary
-    uint16_t vlan : 12;          ///<  The VLAN ID, if any
+    uint16_t priority : 3;       ///<  The priority of the frame, 0-7 (the high bits)
 #endif
     uint16_t type;  ///<  See @ref HyphaIpEtherType
 } HyphaIpEthernetHeader_t;
@@ -146,17 +157,46 @@ static_assert(sizeof(HyphaIpEthernetHeader_t) == 14U, "Must be exactly this size
 /// The maximum size of an Ethernet frame payload
 #define HYPHA_IP_MAX_ETHERNET_FRAME_SIZE (HYPHA_IP_MTU)
 
+/// The flags exchanged with the driver for each frame
+typedef enum HyphaIpFrameFlag : uint32_t {
+    HyphaIpFrameFlagNone = 0U,                          ///< Nothing has been done to the frame
+    HyphaIpFrameFlagIPv4ChecksumVerified = (1U << 0U),  ///< RX: the driver verified the IPv4 header checksum
+    HyphaIpFrameFlagUdpChecksumVerified = (1U << 1U),   ///< RX: the driver verified the UDP checksum
+    HyphaIpFrameFlagIPv4ChecksumInsert = (1U << 2U),    ///< TX: the driver must insert the IPv4 header checksum
+    HyphaIpFrameFlagUdpChecksumInsert = (1U << 3U),     ///< TX: the driver must insert the UDP checksum
+} HyphaIpFrameFlag_e;
+
+/// The information about a frame which is exchanged with the driver. It is not part of the frame on the wire.
+typedef struct HyphaIpFrameInfo {
+    uint32_t flags;     ///< The bitwise OR of @ref HyphaIpFrameFlag_e, cleared by the stack when a frame is acquired
+    uint16_t length;    ///< The valid bytes from the header on, set by the driver on receive and the stack on transmit
+    uint16_t capacity;  ///< The bytes from the header on which the buffer holds, set by the driver
+    uint8_t interface;  ///< The index of the interface, set by the driver on receive and the stack on transmit
+} HyphaIpFrameInfo_t;
+
 /// The 802.3 header and payload
 /// @note CRC32 is assumed to be handled by the Peripheral/Hardware
+/// @note A frame may be allocated shorter than this structure, see @ref HYPHA_IP_FRAME_ALLOCATION. The stack never
+/// touches the bytes at or past `info.capacity`.
 typedef struct HyphaIpEthernetFrame {
+    /// The information exchanged with the driver, ahead of the on-the-wire bytes so a short buffer can carry it
+    HyphaIpFrameInfo_t info;
     /// The Ethernet Header
     HyphaIpEthernetHeader_t header;
     /// The payload of the Ethernet Frame. Contains the IP header, the UDP header and so forth.
     uint8_t payload[HYPHA_IP_MAX_ETHERNET_FRAME_SIZE];
 } HyphaIpEthernetFrame_t;
-static_assert(sizeof(HyphaIpEthernetFrame_t) == HYPHA_IP_MTU + sizeof(HyphaIpEthernetHeader_t),
+static_assert(sizeof(HyphaIpEthernetFrame_t) - offsetof(HyphaIpEthernetFrame_t, header) >=
+                  HYPHA_IP_MTU + sizeof(HyphaIpEthernetHeader_t),
               "Must fit a whole single MTU");
 
+/// The capacity of a frame which can hold a whole MTU, the most any frame needs
+#define HYPHA_IP_FRAME_CAPACITY (sizeof(HyphaIpEthernetHeader_t) + HYPHA_IP_MTU)
+static_assert(HYPHA_IP_FRAME_CAPACITY <= UINT16_MAX, "The capacity must fit in the frame information");
+
+/// The number of bytes to allocate for a frame with the given capacity, for drivers which keep pools of smaller frames
+#define HYPHA_IP_FRAME_ALLOCATION(capacity) (offsetof(HyphaIpEthernetFrame_t, header) + (capacity))
+
 /// The IPv4 Address in Network Order
 typedef struct HyphaIpIPv4Address {
     uint8_t a;  ///< Previously, the Class A subnet
@@ -174,19 +214,28 @@ typedef struct HyphaIpNetworkInterface {
     HyphaIpEthernetAddress_t mac;  ///<  The MAC Address of the Network Interface
     HyphaIpIPv4Address_t address;  ///<  The IPv4 Address of the Network Interface
     HyphaIpIPv4Address_t netmask;  ///<  The IPv4 Netmask of the Network Interface
-    HyphaIpIPv4Address_t gateway;  ///<  The IPv4 Address of the Gateway on this Network
+    HyphaIpIPv4Address_t gateway;  ///<  The IPv4 Address of the Gateway on this Network, 0.0.0.0 for none
 } HyphaIpNetworkInterface_t;
 
 /// A signed timestamp. The time basis (what scale of seconds) is stipulated by the @ref HyphaIpGetMonotonicTimestamp_f
 /// type.
 typedef int64_t HyphaIpTimestamp_t;
 
+/// The deadline @ref HyphaIpNextDeadline gives when no timer is running
+#define HYPHA_IP_NO_DEADLINE (HyphaIpTimestamp_t)INT64_MAX
+
 /// A structure to correlate the MAC address and the IPv4 Address
 typedef struct HyphaIpAddressMatch {
     HyphaIpEthernetAddress_t mac;  ///< The Media Access Controller Address
     HyphaIpIPv4Address_t ipv4;     ///< The IPv4 Protocol Address
 } HyphaIpAddressMatch_t;
 
+/// An IPv4 network in CIDR notation, e.g. 172.16.0.0/12. A single host is a prefix of length 32.
+typedef struct HyphaIpIPv4Prefix {
+    HyphaIpIPv4Address_t address;  ///< The address of the network, the bits past the prefix are ignored
+    uint8_t length;                ///< The number of leading bits which name the network, 0 to 32
+} HyphaIpIPv4Prefix_t;
+
 /// @brief The types of pointers in a Span.
 /// These are limited due to the space in the field. Complex structures should use
 /// either Undefined or Uint8_t
@@ -242,8 +291,67 @@ typedef struct HyphaIpMetaData {
     /// The timestamp of the message (either received or transmitted),
     /// used for ordering and deduplication
     HyphaIpTimestamp_t timestamp;
+    /// The index of the interface to transmit on. Multicasts and broadcasts leave on this interface, a unicast leaves
+    /// on the interface of its route, which is written back here.
+    uint8_t interface;
 } HyphaIpMetaData_t;
 
+/// The largest UDP payload which can be transmitted, anything over a single frame is sent as IPv4 fragments
+#define HYPHA_IP_MAX_UDP_DATAGRAM_SIZE (65535U - 20U - 8U)
+
+/// The size of the Ethernet, IPv4 (20 bytes, no options) and UDP (8 bytes) headers of a datagram on the wire
+#define HYPHA_IP_UDP_FLOW_HEADER_SIZE (sizeof(HyphaIpEthernetHeader_t) + 20U + 8U)
+
+/// A prepared UDP transmit flow to a single destination address and port.
+/// The headers are serialized once by @ref HyphaIpPrepareUdpTransmit so each @ref HyphaIpTransmitUdpFlow only copies
+/// the template, patches the lengths and checksums and copies the payload.
+/// @note The contents are owned by the stack, the caller only provides the storage.
+typedef struct HyphaIpUdpFlow {
+    HyphaIpMetaData_t metadata;                     ///< The addresses and ports, the timestamp of the last transmit
+    uint8_t header[HYPHA_IP_UDP_FLOW_HEADER_SIZE];  ///< The headers in network order, lengths and checksums are zero
+    uint16_t ipv4_sum;                              ///< The one's complement sum of the IPv4 header template
+    uint16_t udp_sum;  ///< The one's complement sum of the pseudo header and UDP header templates
+} HyphaIpUdpFlow_t;
+
+/// A frame of the transmit ring which a producer thread is building, from @ref HyphaIpReserveTransmit.
+/// @note The position is owned by the stack, the caller only provides the storage.
+typedef struct HyphaIpTransmitReservation {
+    HyphaIpEthernetFrame_t *frame;  ///< The frame to build, from the header on, with `info.length` set
+    size_t position;                ///< The place of the frame in the ring
+} HyphaIpTransmitReservation_t;
+
+#ifndef HYPHA_IP_REASSEMBLY_SIZE
+/// The largest IPv4 payload (the UDP header and data) which a reassembly slot can put back together from fragments.
+/// Lower this to shrink each @ref HyphaIpReassemblySlot_t when the peers never send datagrams this large.
+#define HYPHA_IP_REASSEMBLY_SIZE (HYPHA_IP_MAX_UDP_DATAGRAM_SIZE + 8U)
+#endif
+
+#ifndef HYPHA_IP_REASSEMBLY_SLOTS
+/// The most reassembly slots which can be given to @ref HyphaIpProvideReassemblySlots, each has a timer of its own
+#define HYPHA_IP_REASSEMBLY_SLOTS 8U
+#endif
+
+/// The number of 8 byte blocks, the unit of IPv4 fragment offsets, in a reassembly slot
+#define HYPHA_IP_REASSEMBLY_BLOCKS ((HYPHA_IP_REASSEMBLY_SIZE + 7U) / 8U)
+
+/// A datagram being put back together from its IPv4 fragments.
+/// @note The contents are owned by the stack, the caller only provides the storage to
+/// @ref HyphaIpProvideReassemblySlots.
+typedef struct HyphaIpReassemblySlot {
+    HyphaIpIPv4Address_t source;       ///< The sender of the fragments
+    HyphaIpIPv4Address_t destination;  ///< The receiver of the fragments
+    uint16_t identification;           ///< The identification shared by the fragments
+    uint8_t protocol;                  ///< The IP protocol of the datagram
+    bool in_use;                       ///< The slot holds a datagram
+    uint16_t length;                   ///< The length of the datagram, zero until the last fragment arrives
+    uint16_t blocks;                   ///< The number of distinct blocks received so far
+    uint16_t timer;                    ///< The timer which drops the datagram if it is still incomplete at expiry
+    HyphaIpTimestamp_t expiry;         ///< When the datagram is dropped if it is still incomplete
+    /// A set bit for each block received, the clear bits below the length are the holes
+    uint32_t received[(HYPHA_IP_REASSEMBLY_BLOCKS + 31U) / 32U];
+    uint8_t data[HYPHA_IP_REASSEMBLY_BLOCKS * 8U];  ///< The payload of the datagram
+} HyphaIpReassemblySlot_t;
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // CONSTANTS
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -368,6 +476,17 @@ typedef enum HyphaIpStatus {
     HyphaIpStaticVLANFiltered = -26,             ///<  The VLAN ID was filtered out
     HyphaIpStatusIPv4PacketTooLarge = -27,       ///<  The IPv4 packet was too large to be processed
     HyphaIpStatusUdpDatagramTooLarge = -28,      ///<  The UDP datagram was too large to be processed
+    HyphaIpStatusInvalidFrameLength = -29,       ///<  The frame length does not fit the frame or what it carries
+    HyphaIpStatusUdpListenerTableFull = -30,     ///<  The UDP listener table is full and cannot accept more entries
+    HyphaIpStatusUdpPortUnreachable = -31,       ///<  No listener is registered for the datagram's address and port
+    HyphaIpStatusIgmpGroupTableFull = -32,       ///<  The IGMP group table is full and cannot join more groups
+    HyphaIpStatusIgmpChecksumRejected = -33,     ///<  The IGMP checksum was rejected, indicating a malformed message
+    HyphaIpStatusArpPacketRejected = -34,        ///<  The ARP packet was not an Ethernet and IPv4 one
+    HyphaIpStatusArpQueueFull = -35,             ///<  No more frames can wait for ARP replies, the frame was dropped
+    HyphaIpStatusNoRoute = -36,                  ///<  No route reaches the destination address
+    HyphaIpStatusRouteTableFull = -37,           ///<  The routing table is full and cannot accept more routes
+    HyphaIpStatusInterfaceTableFull = -38,       ///<  The context already owns @ref HYPHA_IP_INTERFACE_COUNT interfaces
+    HyphaIpStatusTransmitRingFull = -39,         ///<  Every frame of the transmit ring is waiting to be drained
 } HyphaIpStatus_e;
 
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -482,6 +601,15 @@ typedef struct HyphaIpArpCounter {
     size_t announces;  ///<  The number of ARP announcements
     size_t additions;  ///<  The number of ARP additions
     size_t removals;   ///<  The number of ARP removals
+    size_t requests;   ///<  The number of ARP requests received for our address
+    size_t replies;    ///<  The number of ARP replies sent
+    size_t learned;    ///<  The number of times a sender's addresses were added or refreshed in the cache
+    size_t rejected;   ///<  The number of ARP packets which were not for Ethernet and IPv4
+    size_t resolves;   ///<  The number of ARP requests sent to resolve a destination
+    size_t queued;     ///<  The number of frames which waited for an ARP reply
+    size_t flushed;    ///<  The number of waiting frames which were sent once the reply came
+    size_t overflows;  ///<  The number of frames dropped because no more could wait
+    size_t timeouts;   ///<  The number of waiting frames dropped because the reply did not come in time
 } HyphaIpArpCounter_t;
 
 /// Counts the number of allocator statistics
@@ -491,18 +619,98 @@ typedef struct HyphaIpAllocationCounter {
     size_t failures;  ///<  The number of failed acquires or releases
 } HyphaIpFrameCounter_t;
 
+/// Counts where the checksums of a protocol were handled
+typedef struct HyphaIpChecksumCounter {
+    size_t rx_offloaded;  ///<  Received checksums the driver verified
+    size_t rx_software;   ///<  Received checksums the stack verified
+    size_t tx_offloaded;  ///<  Transmitted checksums the driver inserted
+    size_t tx_software;   ///<  Transmitted checksums the stack computed
+} HyphaIpChecksumCounter_t;
+
+/// Counts the checksum handling for each protocol
+typedef struct HyphaIpChecksumStatistics {
+    HyphaIpChecksumCounter_t ipv4;  ///<  The IPv4 header checksums
+    HyphaIpChecksumCounter_t udp;   ///<  The UDP checksums
+} HyphaIpChecksumStatistics_t;
+
+/// Counts the work of putting fragmented IPv4 datagrams back together
+typedef struct HyphaIpReassemblyCounter {
+    size_t fragments;  ///<  The number of fragments taken in
+    size_t hits;       ///<  The number of datagrams completed and delivered
+    size_t timeouts;   ///<  The number of datagrams dropped because they were not completed in time
+    size_t evictions;  ///<  The number of datagrams dropped to make room for a newer one
+    size_t rejected;   ///<  The number of fragments which could not be used
+} HyphaIpReassemblyCounter_t;
+
+/// Counts the checks of IPv4 multicast Ethernet Addresses against the joined groups
+typedef struct HyphaIpMulticastFilterCounter {
+    size_t matches;     ///<  The number of addresses which were found in the groups
+    size_t collisions;  ///<  The number of addresses which passed the bitmap but were not in the groups
+    size_t rejected;    ///<  The number of addresses which the bitmap alone turned away
+} HyphaIpMulticastFilterCounter_t;
+
+/// Counts how received UDP datagrams were handed to the registered listeners
+typedef struct HyphaIpUdpListenerCounter {
+    size_t delivered;     ///<  The number of datagrams given to a registered listener
+    size_t unregistered;  ///<  The number of datagrams dropped because nothing listens on their address and port
+} HyphaIpUdpListenerCounter_t;
+
+/// Counts the IGMP membership work of the joined groups
+typedef struct HyphaIpIgmpMembershipCounter {
+    size_t queries;     ///<  The number of queries which asked about any of our groups
+    size_t reports;     ///<  The number of delayed reports sent in answer to queries
+    size_t suppressed;  ///<  The number of delayed reports cancelled because another host reported first
+} HyphaIpIgmpMembershipCounter_t;
+
+/// Counts the entries removed by their timers
+typedef struct HyphaIpExpirationCounter {
+    size_t arp;       ///<  The number of ARP entries which expired
+    size_t ethernet;  ///<  The number of Ethernet filter entries which expired
+    size_t ipv4;      ///<  The number of IPv4 filter ranges which expired
+} HyphaIpExpirationCounter_t;
+
+/// Counts the traffic of a single network interface
+typedef struct HyphaIpInterfaceCounter {
+    HyphaIpThroughput_t frames;  ///<  The frames (and their bytes) taken by the driver and received on the interface
+    size_t rejected;             ///<  The received packets whose source does not route back out of the interface
+} HyphaIpInterfaceCounter_t;
+
+/// Counts the next hop lookups, of unicast transmits and of the sources of received packets
+typedef struct HyphaIpRouteCounter {
+    size_t hits;         ///<  The lookups answered by the route cache
+    size_t misses;       ///<  The lookups which searched the routing table
+    size_t unreachable;  ///<  The lookups which found no route at all
+} HyphaIpRouteCounter_t;
+
+/// Counts the frames other threads queued on the transmit ring
+typedef struct HyphaIpTransmitRingCounter {
+    size_t drained;    ///<  The frames of the ring which the driver took
+    size_t cancelled;  ///<  The reservations committed with no length, which were skipped
+    size_t overflows;  ///<  The reservations refused because the ring was full, as of the last drain
+} HyphaIpTransmitRingCounter_t;
+
 /// The Statistics structure for Hypha IP stack
 typedef struct HyphaIpStatistics {
-    HyphaIpLayerResult_t mac;        ///< MAC Layer statistics
-    HyphaIpLayerResult_t ethertype;  ///< Ethernet Type statistics
-    HyphaIpLayerResult_t ip;         ///< IPv4 Layer statistics
-    HyphaIpLayerResult_t udp;        ///< UDP Layer statistics
-    HyphaIpLayerResult_t icmp;       ///< ICMP Layer statistics
-    HyphaIpLayerResult_t igmp;       ///< IGMP Layer statistics
-    HyphaIpLayerResult_t unknown;    ///< Unknown protocols, not supported
-    HyphaIpArpCounter_t arp;         ///< ARP Layer statistics
-    HyphaIpCounter_t counter;        ///< The throughput statistics for each layer
-    HyphaIpFrameCounter_t frames;    ///< The number of allocations and deallocations
+    HyphaIpLayerResult_t mac;                   ///< MAC Layer statistics
+    HyphaIpLayerResult_t ethertype;             ///< Ethernet Type statistics
+    HyphaIpLayerResult_t ip;                    ///< IPv4 Layer statistics
+    HyphaIpLayerResult_t udp;                   ///< UDP Layer statistics
+    HyphaIpLayerResult_t icmp;                  ///< ICMP Layer statistics
+    HyphaIpLayerResult_t igmp;                  ///< IGMP Layer statistics
+    HyphaIpLayerResult_t unknown;               ///< Unknown protocols, not supported
+    HyphaIpArpCounter_t arp;                    ///< ARP Layer statistics
+    HyphaIpCounter_t counter;                   ///< The throughput statistics for each layer
+    HyphaIpFrameCounter_t frames;               ///< The number of allocations and deallocations
+    HyphaIpChecksumStatistics_t checksums;      ///< Where checksums were verified or computed
+    HyphaIpReassemblyCounter_t reassembly;      ///< The IPv4 fragment reassembly statistics
+    HyphaIpMulticastFilterCounter_t multicast;  ///< The multicast Ethernet Address filter statistics
+    HyphaIpUdpListenerCounter_t listeners;      ///< The UDP listener statistics
+    HyphaIpIgmpMembershipCounter_t membership;  ///< The IGMP group membership statistics
+    HyphaIpExpirationCounter_t expirations;     ///< The aged entries
+    HyphaIpRouteCounter_t routes;               ///< The next hop lookups
+    HyphaIpTransmitRingCounter_t ring;          ///< The transmits queued by other threads
+    /// The traffic of each interface, by its index
+    HyphaIpInterfaceCounter_t interfaces[HYPHA_IP_INTERFACE_COUNT];
 } HyphaIpStatistics_t;
 
 /// The internal Debugging Levels
@@ -557,19 +765,27 @@ typedef struct HyphaIpExternalContext *HyphaIpExternalContext_t;
 
 /// Acquire a Frame from the Frame provider.The frame could be used to receive or transmit data.
 /// @param context The handle to the external context
-/// @return A pointer to a Frame, or nullptr if none are available
+/// @return A pointer to a Frame with `info.capacity` of @ref HYPHA_IP_FRAME_CAPACITY, or nullptr if none are available
 /// @post HyphaIpEthernetReceiveFrame_f
 /// @post HyphaIpEthernetTransmitFrame_f
 typedef HyphaIpEthernetFrame_t *(*HyphaIpAcquireEthernetFrame_f)(HyphaIpExternalContext_t context);
 
+/// Acquires a Frame which can hold at least `capacity` bytes from the header on, so the frame provider can hand out
+/// small frames for small packets from a separate pool.
+/// @param context The handle to the external context
+/// @param capacity The bytes from the header on which the frame must hold
+/// @return A pointer to a Frame with `info.capacity` set, or nullptr if none are available
+typedef HyphaIpEthernetFrame_t *(*HyphaIpAcquireSizedEthernetFrame_f)(HyphaIpExternalContext_t context,
+                                                                      size_t capacity);
+
 /// Receives an ethernet frame into the given frame pointer.
 /// @param context The handle to the external context
-/// @param frame The pointer to the frame to receive the data into
+/// @param frame The pointer to the frame to receive the data into, the driver sets `info.length`
 typedef HyphaIpStatus_e (*HyphaIpEthernetReceiveFrame_f)(HyphaIpExternalContext_t context,
                                                          HyphaIpEthernetFrame_t *frame);
 /// Transmits an ethernet frame.
 /// @param context The handle to the external context
-/// @param frame The pointer to the frame to transmit
+/// @param frame The pointer to the frame to transmit, `info.length` bytes from the header on
 typedef HyphaIpStatus_e (*HyphaIpEthernetTransmitFrame_f)(HyphaIpExternalContext_t context,
                                                           HyphaIpEthernetFrame_t *frame);
 
@@ -579,6 +795,53 @@ typedef HyphaIpStatus_e (*HyphaIpEthernetTransmitFrame_f)(HyphaIpExternalContext
 typedef HyphaIpStatus_e (*HyphaIpReleaseEthernetFrame_f)(HyphaIpExternalContext_t context,
                                                          HyphaIpEthernetFrame_t *frame);
 
+/// Acquires up to `count` frames from the Frame provider in a single call.
+/// @param context The handle to the external context
+/// @param count The number of frames requested
+/// @param frames The array to fill with the acquired frame pointers
+/// @return The number of frames acquired, which are the first entries in `frames`.
+typedef size_t (*HyphaIpAcquireEthernetFrames_f)(HyphaIpExternalContext_t context, size_t count,
+                                                 HyphaIpEthernetFrame_t *frames[count]);
+
+/// Receives up to `count` ethernet frames into the given (acquired) frames in a single call.
+/// @param context The handle to the external context
+/// @param count The number of frames offered to the driver
+/// @param frames The frames to receive into, filled in order
+/// @return The number of frames which were filled, which are the first entries in `frames`.
+typedef size_t (*HyphaIpEthernetReceiveFrames_f)(HyphaIpExternalContext_t context, size_t count,
+                                                 HyphaIpEthernetFrame_t *frames[count]);
+
+/// Transmits `count` ethernet frames in a single call. While a datagram is sent the stack holds up to
+/// @ref HYPHA_IP_BATCH_SIZE frames for this call, and gives them to it early whenever an acquire finds no frame.
+/// @param context The handle to the external context
+/// @param count The number of frames to transmit
+/// @param frames The frames to transmit, in order
+/// @return The number of frames which were transmitted, which are the first entries in `frames`.
+typedef size_t (*HyphaIpEthernetTransmitFrames_f)(HyphaIpExternalContext_t context, size_t count,
+                                                  HyphaIpEthernetFrame_t *frames[count]);
+
+/// Releases `count` ethernet frames back to the frame provider in a single call.
+/// @param context The handle to the external context
+/// @param count The number of frames to release
+/// @param frames The frames to release
+typedef HyphaIpStatus_e (*HyphaIpReleaseEthernetFrames_f)(HyphaIpExternalContext_t context, size_t count,
+                                                          HyphaIpEthernetFrame_t *frames[count]);
+
+/// The checksum offloads a driver can perform
+typedef struct HyphaIpCapabilities {
+    bool rx_ipv4_checksum;  ///< Verifies IPv4 header checksums, see @ref HyphaIpFrameFlagIPv4ChecksumVerified
+    bool rx_udp_checksum;   ///< Verifies UDP checksums, see @ref HyphaIpFrameFlagUdpChecksumVerified
+    bool tx_ipv4_checksum;  ///< Inserts IPv4 header checksums, see @ref HyphaIpFrameFlagIPv4ChecksumInsert
+    bool tx_udp_checksum;   ///< Inserts UDP checksums, see @ref HyphaIpFrameFlagUdpChecksumInsert
+} HyphaIpCapabilities_t;
+
+/// Reports the offloads the driver can perform, called once from @ref HyphaIpInitialize
+/// @param context The handle to the external context
+/// @param[out] capabilities The capabilities to fill in, all false on entry
+/// @return HyphaIpStatusOk if the capabilities were filled in
+typedef HyphaIpStatus_e (*HyphaIpGetCapabilities_f)(HyphaIpExternalContext_t context,
+                                                    HyphaIpCapabilities_t *capabilities);
+
 /// A printf-like function which is used to print debug information.
 /// @param context The handle to the context of the stack
 /// @param format The format string
@@ -604,6 +867,14 @@ typedef HyphaIpTimestamp_t (*HyphaIpGetMonotonicTimestamp_f)(HyphaIpExternalCont
 typedef HyphaIpStatus_e (*HyphaIpUdpDatagramListener_f)(HyphaIpExternalContext_t context, HyphaIpMetaData_t *metadata,
                                                         HyphaIpSpan_t datagram);
 
+/// The callback of a listener registered with @ref HyphaIpRegisterUdpListener.
+/// @param user The user context given when the listener was registered
+/// @param metadata The metadata of the incoming datagram
+/// @param datagram The UDP Datagram
+/// @retval HyphaIpStatusOk Datagram was received and is acceptable.
+/// @retval HyphaIpStatusFailure The Datagram was not acceptable, or the function failed.
+typedef HyphaIpStatus_e (*HyphaIpUdpListener_f)(void *user, HyphaIpMetaData_t *metadata, HyphaIpSpan_t datagram);
+
 /// Used to report internal issues all the way out of the API to an observer.
 typedef void (*HyphaIpReport_f)(HyphaIpExternalContext_t context, HyphaIpStatus_e status, char const *const func,
                                 char const *const file, unsigned int line);
@@ -625,6 +896,12 @@ typedef struct HyphaIpExternalInterface {
     HyphaIpEthernetReceiveFrame_f receive;                   ///< The interface to receive incoming frames
     HyphaIpEthernetTransmitFrame_f transmit;                 ///< The interface to transmit frames
     HyphaIpReleaseEthernetFrame_f release;                   ///< The interface to release frames
+    HyphaIpAcquireSizedEthernetFrame_f acquire_sized;        ///< Optional, acquires frames smaller than the MTU
+    HyphaIpAcquireEthernetFrames_f acquire_batch;            ///< Optional, acquires many frames in one call
+    HyphaIpEthernetReceiveFrames_f receive_batch;            ///< Optional, receives many frames in one call
+    HyphaIpEthernetTransmitFrames_f transmit_batch;          ///< Optional, transmits many frames in one call
+    HyphaIpReleaseEthernetFrames_f release_batch;            ///< Optional, releases many frames in one call
+    HyphaIpGetCapabilities_f capabilities;                   ///< Optional, reports the checksum offloads
     HyphaIpPrinter_f print;                                  ///<  Optional, if not given no prints will occur.
     HyphaIpGetMonotonicTimestamp_f get_monotonic_timestamp;  ///< The interface to get the monotonic timestamp
     HyphaIpReport_f report;                                  ///< The interface to report errors deep within functions
@@ -638,16 +915,50 @@ typedef struct HyphaIpExternalInterface {
 // API
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
-/// Initializes the HyphaIp Context
+/// The size of the storage for a context. Each context is a separate stack with nothing shared between them, so any
+/// number of them can run side by side (one per thread, core or NIC queue).
+/// @return The bytes a context needs, a multiple of @ref HYPHA_IP_CONTEXT_ALIGNMENT
+size_t HyphaIpContextSize(void);
+
+/// Initializes the HyphaIp Context in storage provided by the caller
 /// @param[out] context The location to store the opaque context
-/// @param[in] interface The network interface to the HyphaIp
+/// @param[in] storage The storage for the context, aligned to @ref HYPHA_IP_CONTEXT_ALIGNMENT. It must stay valid
+/// until the context is de-initialized.
+/// @param[in] size The bytes of storage, at least @ref HyphaIpContextSize
+/// @param[in] interface The first network interface to the HyphaIp, its index is zero
 /// @param[in] theirs The external context defined by the client
 /// @param[in] externals The external interfaces to the HyphaIp
+/// @retval HyphaIpStatusInvalidContext The context location is nullptr or the storage is too small or misaligned
 /// @return The status of the operation
-HyphaIpStatus_e HyphaIpInitialize(HyphaIpContext_t *context, HyphaIpNetworkInterface_t *interface,
-                                  HyphaIpExternalContext_t theirs, HyphaIpExternalInterface_t *externals);
-
-/// De-initializes the Hypha IP Context.
+HyphaIpStatus_e HyphaIpInitialize(HyphaIpContext_t *context, void *storage, size_t size,
+                                  HyphaIpNetworkInterface_t *interface, HyphaIpExternalContext_t theirs,
+                                  HyphaIpExternalInterface_t *externals);
+
+/// Adds another network interface to the context, along with the route to its network. The interfaces are numbered in
+/// the order they are added, the one given to @ref HyphaIpInitialize is zero.
+/// @note Only the first interface gets a default route, through its gateway. The gateway of this one is not used until
+/// it is given to @ref HyphaIpAddRoute.
+/// @param[in] context The opaque context
+/// @param[in] interface The network interface, checked like the one given to @ref HyphaIpInitialize
+/// @param[out] index The index of the interface, as given in @ref HyphaIpFrameInfo_t and @ref HyphaIpMetaData_t
+/// @retval HyphaIpStatusInterfaceTableFull There are already @ref HYPHA_IP_INTERFACE_COUNT interfaces
+/// @retval HyphaIpStatusInvalidNetwork The network overlaps the network of another interface
+HyphaIpStatus_e HyphaIpAddInterface(HyphaIpContext_t context, HyphaIpNetworkInterface_t const *interface,
+                                    uint8_t *index);
+
+/// Adds a route to a network. Unicast transmits go by the route with the longest prefix which holds the destination,
+/// to the gateway of the route or, when the gateway is @ref hypha_ip_default_route, straight to the destination.
+/// @param[in] context The opaque context
+/// @param[in] prefix The network of the route, a prefix length of zero is the default route
+/// @param[in] gateway The next hop, which must be within the network of the interface
+/// @param[in] interface The index of the interface the route leaves on
+/// @retval HyphaIpStatusRouteTableFull There are already @ref HYPHA_IP_ROUTE_TABLE_SIZE routes
+/// @retval HyphaIpStatusInvalidNetwork The gateway is not within the network of the interface
+/// @note May be called from any thread, the owner picks up the new routes without waiting on the caller.
+HyphaIpStatus_e HyphaIpAddRoute(HyphaIpContext_t context, HyphaIpIPv4Prefix_t prefix, HyphaIpIPv4Address_t gateway,
+                                uint8_t interface);
+
+/// De-initializes the Hypha IP Context. Its storage is cleared and can then be reused or freed by the caller.
 /// @param[inout] context The location where the opaque context in stored. Will be set to nullptr.
 /// @return The status of the operation
 HyphaIpStatus_e HyphaIpDeinitialize(HyphaIpContext_t *context);
@@ -672,9 +983,12 @@ HyphaIpEthernetAddress_t HyphaIpFindEthernetAddress(HyphaIpContext_t context, Hy
 /// @param[in] matches The array of matches
 /// @return The status of the operation
 /// @retval HyphaIpStatusArpTableFull The matches won't fit in the table
+/// @note Like the other populates this may be called from any thread. The owner ages the entries and sends what was
+/// waiting for them from its next tick.
 HyphaIpStatus_e HyphaIpPopulateArpTable(HyphaIpContext_t context, size_t len, HyphaIpAddressMatch_t matches[len]);
 
-/// @brief Populates entries in the software Ethernet Filter.
+/// @brief Populates entries in the software Ethernet Filter. IPv4 multicast addresses (01:00:5E) are kept in the
+/// multicast filter with the joined groups, the rest in the table.
 /// @warning By calling this, the MAC Filter will be enabled, and all MAC addresses will be filtered, regardless of
 /// @ref HYPHA_IP_USE_MAC_FILTER.
 /// @param context The opaque context
@@ -686,20 +1000,67 @@ HyphaIpStatus_e HyphaIpPopulateEthernetFilter(HyphaIpContext_t context, size_t l
 
 /// @brief Populates entries in the software IPv4 Allow Filter. A
 /// @warning By calling this, the IPv4 Filter will be enabled, and all IPv4 packets will be filtered, regardless of
-/// @ref HYPHA_IP_USE_IP_FILTER. Anything not in the filter will be dropped.
+/// @ref HYPHA_IP_USE_IP_FILTER. Anything not in the filter will be dropped. The entries expire after
+/// @ref HYPHA_IP_EXPIRATION_TIME, once the last one has the filter is disabled again.
 /// @param context The opaque context
 /// @param len The number of entries in the provided filter.
 /// @param filters The array of IPv4 addresses to filter on.
 /// @return HyphaIpStatus_e
 HyphaIpStatus_e HyphaIpPopulateIPv4Filter(HyphaIpContext_t context, size_t len, HyphaIpIPv4Address_t filters[len]);
 
+/// @brief Populates networks and hosts in the software IPv4 Allow Filter. A source address is allowed when it is
+/// within any of the prefixes. Overlapping and adjacent prefixes are merged, so each prefix takes at most one of the
+/// @ref HYPHA_IP_IPv4_FILTER_TABLE_SIZE entries. The lookup is a binary search over the entries.
+/// @warning By calling this, the IPv4 Filter will be enabled, just as with @ref HyphaIpPopulateIPv4Filter.
+/// @param context The opaque context
+/// @param len The number of prefixes provided.
+/// @param prefixes The array of IPv4 prefixes to filter on, any prefix length over 32 is an invalid argument.
+/// @return HyphaIpStatus_e
+HyphaIpStatus_e HyphaIpPopulateIPv4Prefixes(HyphaIpContext_t context, size_t len, HyphaIpIPv4Prefix_t prefixes[len]);
+
+/// @brief Gives the stack the memory to put fragmented IPv4 datagrams back together in.
+/// Without slots every fragment is rejected. Each slot holds one incomplete datagram until all of its fragments have
+/// arrived, then the datagram is delivered like any other. When every slot is busy the oldest datagram is evicted.
+/// @param context The opaque context
+/// @param len The number of slots, zero to stop reassembling, at most @ref HYPHA_IP_REASSEMBLY_SLOTS
+/// @param slots The array of slots, the caller owns the storage which must outlive its use by the stack
+/// @return HyphaIpStatus_e
+HyphaIpStatus_e HyphaIpProvideReassemblySlots(HyphaIpContext_t context, size_t len, HyphaIpReassemblySlot_t slots[len]);
+
 /// Runs the Hypha IP Stack once, Receiving and then Transmitting.
 /// @note This will not block and will try to receive a single frame then return.
 /// @param[in] context The opaque context
 /// @return The status of the operation
 HyphaIpStatus_e HyphaIpRunOnce(HyphaIpContext_t context);
 
+/// Runs the Hypha IP Stack over a batch of up to `max_frames` received frames.
+/// The monotonic timestamp is sampled once for the whole batch and the headers of the next frame are prefetched while
+/// the current one is parsed, so the fixed per-frame cost of @ref HyphaIpRunOnce is amortized over the batch.
+/// @note This will not block. The batch ends early once the driver has no more frames (receive returns a failure).
+/// @param[in] context The opaque context
+/// @param[in] max_frames The maximum number of frames to process in this call
+/// @param[out] handled The number of frames which were processed
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpRunBatch(HyphaIpContext_t context, size_t max_frames, size_t *handled);
+
+/// Fires the timers whose deadlines have passed. ARP entries and filter entries are removed once they expire and the
+/// delayed IGMP reports are sent. @ref HyphaIpRunOnce and @ref HyphaIpRunBatch tick with their own timestamp, an
+/// event loop which sleeps between frames calls this when it wakes at @ref HyphaIpNextDeadline.
+/// @param[in] context The opaque context
+/// @param[in] timestamp The current time
+/// @return The status of the last timer which failed, or Ok
+HyphaIpStatus_e HyphaIpTick(HyphaIpContext_t context, HyphaIpTimestamp_t timestamp);
+
+/// Gives the earliest deadline of the running timers, so an event loop can sleep until exactly then (or until a frame
+/// arrives) instead of polling.
+/// @param[in] context The opaque context
+/// @param[out] deadline The deadline, @ref HYPHA_IP_NO_DEADLINE when no timer is running. A deadline which has
+/// already passed means @ref HyphaIpTick has work now.
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpNextDeadline(HyphaIpContext_t context, HyphaIpTimestamp_t *deadline);
+
 /// Transmits a UDP Datagram now. This will not enqueue or wait until later or do the work in the @ref HyphaIpRunOnce.
+/// Datagrams which do not fit in a single frame are sent as IPv4 fragments, up to @ref HYPHA_IP_MAX_UDP_DATAGRAM_SIZE.
 /// @param[in] context The opaque context
 /// @param[in] metadata The metadata of the datagram
 /// @param[in] datagram The UDP Datagram
@@ -707,24 +1068,152 @@ HyphaIpStatus_e HyphaIpRunOnce(HyphaIpContext_t context);
 HyphaIpStatus_e HyphaIpTransmitUdpDatagram(HyphaIpContext_t context, HyphaIpMetaData_t *metadata,
                                            HyphaIpSpan_t datagram);
 
+/// Transmits a UDP Datagram gathered from several spans now, like @ref HyphaIpTransmitUdpDatagram but without the
+/// caller first copying the pieces into a single buffer. The pieces are copied straight into the frames.
+/// @param[in] context The opaque context
+/// @param[in] metadata The metadata of the datagram
+/// @param[in] count The number of spans
+/// @param[in] spans The pieces of the UDP Datagram in order, all `HyphaIpSpanTypeUint8_t`. Empty pieces are skipped.
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpTransmitUdpDatagramV(HyphaIpContext_t context, HyphaIpMetaData_t *metadata, size_t count,
+                                            HyphaIpSpan_t const spans[count]);
+
+/// Reserves a frame so a UDP payload can be written straight into it, without the stack copying it afterwards.
+/// Each reservation must end with @ref HyphaIpCommitUdpDatagram or @ref HyphaIpAbort.
+/// @param[in] context The opaque context
+/// @param[out] frame The reserved frame, only to be passed back to the commit or abort
+/// @param[out] payload The writable bytes of the UDP payload within the frame
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpReserveUdpPayload(HyphaIpContext_t context, HyphaIpEthernetFrame_t **frame,
+                                         HyphaIpSpan_t *payload);
+
+/// Fills in the headers in front of a reserved payload and transmits it now. The frame is given back in every case
+/// except an invalid context or frame.
+/// @param[in] context The opaque context
+/// @param[in] frame The frame from @ref HyphaIpReserveUdpPayload
+/// @param[in] metadata The metadata of the datagram
+/// @param[in] length The number of payload bytes which were written
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpCommitUdpDatagram(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                         HyphaIpMetaData_t *metadata, size_t length);
+
+/// Gives back a reserved frame without transmitting it.
+/// @param[in] context The opaque context
+/// @param[in] frame The frame from @ref HyphaIpReserveUdpPayload
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpAbort(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame);
+
 /// Gets the statistics of the Hypha IP Stack
 /// @param[in] context The opaque context
 /// @return The statistics of the Hypha IP Stack
 HyphaIpStatistics_t const *HyphaIpGetStatistics(HyphaIpContext_t context);
 
-/// Prepares the Hypha IP Stack to receive UDP datagrams on some address and port
+/// Prepares the Hypha IP Stack to receive UDP datagrams on some address and port. A multicast address joins its group,
+/// which the stack then keeps reporting to IGMP queriers until it is released.
 /// @param[in] context The opaque context
 /// @param[in] address The IPv4 Address to listen on
 /// @param[in] port The port to listen on
 /// @return The status of the operation
+/// @note A join waits for another thread which is populating the filters to finish.
 HyphaIpStatus_e HyphaIpPrepareUdpReceive(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port);
 
-/// Prepares the Hypha IP Stack to transmit UDP datagrams on some address and port.
+/// Undoes one @ref HyphaIpPrepareUdpReceive. A multicast group is only left once every receiver which prepared it has
+/// released it.
 /// @param[in] context The opaque context
-/// @param[in] address The IPv4 Address to transmit to (destination, not source)
-/// @param[in] port The port to transmit to (destination, not source)
+/// @param[in] address The IPv4 Address which was listened on
+/// @param[in] port The port which was listened on
 /// @return The status of the operation
-HyphaIpStatus_e HyphaIpPrepareUdpTransmit(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port);
+/// @note A leave waits for another thread which is populating the filters to finish.
+HyphaIpStatus_e HyphaIpReleaseUdpReceive(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port);
+
+/// Registers a listener for the UDP datagrams sent to an address and port. Registering the same address and port
+/// again replaces the listener. The address may be @ref hypha_ip_default_route to listen on the port at any address.
+/// @note While no listener is registered every datagram is given to the receive_udp interface. Once any is, the
+/// datagrams to an address and port without a listener are dropped before their checksum is checked.
+/// @param[in] context The opaque context
+/// @param[in] address The destination IPv4 Address to listen on
+/// @param[in] port The destination port to listen on
+/// @param[in] listener The function to call with each datagram
+/// @param[in] user Given to the listener with each datagram
+/// @retval HyphaIpStatusUdpListenerTableFull There are already @ref HYPHA_IP_UDP_LISTENER_TABLE_SIZE listeners
+HyphaIpStatus_e HyphaIpRegisterUdpListener(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port,
+                                           HyphaIpUdpListener_f listener, void *user);
+
+/// Removes the listener of an address and port.
+/// @param[in] context The opaque context
+/// @param[in] address The destination IPv4 Address it listened on
+/// @param[in] port The destination port it listened on
+/// @retval HyphaIpStatusInvalidArgument Nothing was listening on the address and port
+HyphaIpStatus_e HyphaIpUnregisterUdpListener(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port);
+
+/// Prepares a flow which transmits UDP datagrams to some multicast address and port.
+/// @param[in] context The opaque context
+/// @param[in] metadata The destination address and port and the source port of the flow
+/// @param[out] flow The flow to fill in, the caller owns the storage
+/// @return The status of the operation. Only multicast destinations are supported.
+HyphaIpStatus_e HyphaIpPrepareUdpTransmit(HyphaIpContext_t context, HyphaIpMetaData_t const *metadata,
+                                          HyphaIpUdpFlow_t *flow);
+
+/// Transmits a UDP Datagram on a prepared flow now. The datagram must fit in a single frame.
+/// @param[in] context The opaque context
+/// @param[in,out] flow The flow from @ref HyphaIpPrepareUdpTransmit, the metadata timestamp is updated
+/// @param[in] datagram The UDP payload
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpTransmitUdpFlow(HyphaIpContext_t context, HyphaIpUdpFlow_t *flow, HyphaIpSpan_t datagram);
+
+/// Gives the transmit ring a frame from the driver for each of its slots, after which any thread may queue transmits
+/// on it. Only the functions of the ring (reserve, commit and enqueue), the populates and @ref HyphaIpAddRoute may be
+/// called from other threads, everything else belongs to the thread which owns the context.
+/// @param[in] context The opaque context
+/// @retval HyphaIpStatusBusy The ring was already started
+/// @retval HyphaIpStatusOutOfMemory The driver ran out of frames, the ones acquired were given back
+HyphaIpStatus_e HyphaIpStartTransmitRing(HyphaIpContext_t context);
+
+/// Drains what was committed and gives the frames of the ring back to the driver. The producers must have stopped,
+/// a reservation which was never committed is lost. @ref HyphaIpDeinitialize stops the ring too.
+/// @param[in] context The opaque context
+/// @return The status of the operation, Ok when the ring was not started
+HyphaIpStatus_e HyphaIpStopTransmitRing(HyphaIpContext_t context);
+
+/// Reserves the next frame of the transmit ring. May be called from any thread.
+/// @note Every reservation must be committed, even one which is not wanted (with a length of zero), as the owner
+/// drains the ring in order and waits at the first frame which is still being built.
+/// @param[in] context The opaque context
+/// @param[out] reservation The frame to build and its place in the ring
+/// @retval HyphaIpStatusBusy The ring is not started
+/// @retval HyphaIpStatusTransmitRingFull The owner has not drained enough frames yet
+HyphaIpStatus_e HyphaIpReserveTransmit(HyphaIpContext_t context, HyphaIpTransmitReservation_t *reservation);
+
+/// Hands a reserved frame over to the owner, which transmits it with its next drain. May be called from any thread.
+/// @param[in] context The opaque context
+/// @param[in] reservation The reservation from @ref HyphaIpReserveTransmit, its frame is no longer the caller's
+/// @return The status of the operation
+HyphaIpStatus_e HyphaIpCommitTransmit(HyphaIpContext_t context, HyphaIpTransmitReservation_t const *reservation);
+
+/// Copies a fully built frame onto the transmit ring. May be called from any thread.
+/// @param[in] context The opaque context
+/// @param[in] frame The frame, from the header to `info.length`, with the flags and interface to send it with
+/// @retval HyphaIpStatusInvalidFrameLength The frame is shorter than its header or longer than
+/// @ref HYPHA_IP_FRAME_CAPACITY
+/// @retval HyphaIpStatusTransmitRingFull The owner has not drained enough frames yet
+HyphaIpStatus_e HyphaIpEnqueueTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame);
+
+/// Builds a UDP Datagram of a prepared flow straight into a frame of the transmit ring. May be called from any thread,
+/// so the flow is only read and its timestamp is not updated.
+/// @param[in] context The opaque context
+/// @param[in] flow The flow from @ref HyphaIpPrepareUdpTransmit
+/// @param[in] datagram The UDP payload, which must fit in a single frame
+/// @retval HyphaIpStatusTransmitRingFull The owner has not drained enough frames yet
+HyphaIpStatus_e HyphaIpEnqueueUdpFlow(HyphaIpContext_t context, HyphaIpUdpFlow_t const *flow, HyphaIpSpan_t datagram);
+
+/// Transmits the frames which other threads committed to the ring, in the order they were reserved, as one burst of
+/// up to @ref HYPHA_IP_BATCH_SIZE frames. Only the owner thread may drain. Each transmitted frame is released to the
+/// driver like any other and its slot gets a freshly acquired one, a slot the driver has no frame for yet stays full
+/// until a later drain.
+/// @param[in] context The opaque context
+/// @param[out] drained The number of frames taken off the ring, transmitted or skipped
+/// @return The status of the last frame which failed, or Ok
+HyphaIpStatus_e HyphaIpDrainTransmitRing(HyphaIpContext_t context, size_t *drained);
 
 #if defined(HYPHA_IP_USE_ICMP) || defined(HYPHA_IP_USE_ICMPv6)
 
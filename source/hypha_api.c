@@ -5,12 +5,13 @@
 
 #include "hypha_ip/hypha_internal.h"
 
-/// The internal Global Context singleton for the Hypha IP stack.
-struct HyphaIpContext gHyphaIpContext;
+size_t HyphaIpContextSize(void) { return sizeof(struct HyphaIpContext); }
 
-HyphaIpStatus_e HyphaIpInitialize(HyphaIpContext_t *context, HyphaIpNetworkInterface_t *interface,
-                                  HyphaIpExternalContext_t theirs, HyphaIpExternalInterface_t *externals) {
-    if (context == nullptr) {
+HyphaIpStatus_e HyphaIpInitialize(HyphaIpContext_t *context, void *storage, size_t size,
+                                  HyphaIpNetworkInterface_t *interface, HyphaIpExternalContext_t theirs,
+                                  HyphaIpExternalInterface_t *externals) {
+    if (context == nullptr || storage == nullptr || size < sizeof(struct HyphaIpContext) ||
+        ((uintptr_t)storage % _Alignof(struct HyphaIpContext)) != 0U) {
         return HyphaIpStatusInvalidContext;
     }
     if (interface == nullptr || externals == nullptr) {
@@ -30,61 +31,50 @@ HyphaIpStatus_e HyphaIpInitialize(HyphaIpContext_t *context, HyphaIpNetworkInter
         externals->transmit == nullptr) {
         return HyphaIpStatusInvalidArgument;
     }
-    // check the interface mac
-    if (HyphaIpIsMulticastEthernetAddress(interface->mac)) {
-        return HyphaIpStatusInvalidMacAddress;
-    }
-    // check that we don't have a multicast address
-    if (HyphaIpIsMulticastIPv4Address(interface->address)) {
-        return HyphaIpStatusInvalidIpAddress;
-    }
-    // check that we don't have a localhost address
-    if (HyphaIpIsLocalhostIPv4Address(interface->address)) {
-        return HyphaIpStatusInvalidIpAddress;
+    HyphaIpStatus_e checked = HyphaIpRouteCheckInterface(interface);
+    if (HyphaIpIsFailure(checked)) {
+        return checked;
     }
-
-    // the address & mask should be on the same network as the gateway & mask
-    uint32_t network_mask = HyphaIpIPv4AddressToValue(interface->netmask);
-    uint32_t our_network = HyphaIpIPv4AddressToValue(interface->address) & network_mask;
-    uint32_t gateway_network = HyphaIpIPv4AddressToValue(interface->gateway) & network_mask;
-    bool same_network = (our_network == gateway_network);
-    if (!same_network) {
-        return HyphaIpStatusInvalidNetwork;
-    }
-    *context = &gHyphaIpContext;
+    // nothing is shared between contexts, each one lives entirely in the storage it was given
+    struct HyphaIpContext *stack = (struct HyphaIpContext *)storage;
+    memset(stack, 0, sizeof(struct HyphaIpContext));
+    *context = stack;
     // initialize the variables
-    gHyphaIpContext.debugging.mask.value = HYPHA_IP_DEBUG_MASK;
-    gHyphaIpContext.features.allow_any_localhost = (HYPHA_IP_ALLOW_ANY_LOCALHOST == 1);
-    gHyphaIpContext.features.allow_any_multicast = (HYPHA_IP_ALLOW_ANY_MULTICAST == 1);
-    gHyphaIpContext.features.allow_any_broadcast = (HYPHA_IP_ALLOW_ANY_BROADCAST == 1);
-    gHyphaIpContext.features.allow_mac_filtering = (HYPHA_IP_USE_MAC_FILTER == 1);
-    gHyphaIpContext.features.allow_ip_filtering = (HYPHA_IP_USE_IP_FILTER == 1);
-    gHyphaIpContext.features.allow_arp_cache = (HYPHA_IP_USE_ARP_CACHE == 1);
+    stack->debugging.mask.value = HYPHA_IP_DEBUG_MASK;
+    stack->features.allow_any_localhost = (HYPHA_IP_ALLOW_ANY_LOCALHOST == 1);
+    stack->features.allow_any_multicast = (HYPHA_IP_ALLOW_ANY_MULTICAST == 1);
+    stack->features.allow_any_broadcast = (HYPHA_IP_ALLOW_ANY_BROADCAST == 1);
+    stack->features.allow_mac_filtering = (HYPHA_IP_USE_MAC_FILTER == 1);
+    stack->features.allow_ip_filtering = (HYPHA_IP_USE_IP_FILTER == 1);
+    stack->features.allow_arp_cache = (HYPHA_IP_USE_ARP_CACHE == 1);
 #if (HYPHA_IP_USE_VLAN == 1)
-    gHyphaIpContext.features.allow_vlan_filtering = true;  // can be disabled by the user
+    stack->features.allow_vlan_filtering = true;  // can be disabled by the user
 #else
-    gHyphaIpContext.features.allow_vlan_filtering = false;  // VLAN is not supported
-#endif
-    memcpy(&gHyphaIpContext.interface, interface, sizeof(HyphaIpNetworkInterface_t));
-    gHyphaIpContext.theirs = theirs;
-    memcpy(&gHyphaIpContext.external, externals, sizeof(HyphaIpExternalInterface_t));
-#if (HYPHA_IP_USE_MAC_FILTER == 1)
-    memset(gHyphaIpContext.allowed_ethernet_addresses, 0, sizeof(gHyphaIpContext.allowed_ethernet_addresses));
+    stack->features.allow_vlan_filtering = false;  // VLAN is not supported
 #endif
-#if (HYPHA_IP_USE_IP_FILTER == 1)
-    memset(gHyphaIpContext.allowed_ipv4_addresses, 0, sizeof(gHyphaIpContext.allowed_ipv4_addresses));
-#endif
-#if (HYPHA_IP_USE_ARP_CACHE == 1)
-    memset(gHyphaIpContext.arp_cache, 0, sizeof(gHyphaIpContext.arp_cache));
-#endif
-    memset(&gHyphaIpContext.statistics, 0, sizeof(gHyphaIpContext.statistics));
+    HyphaIpTablesInitialize(stack);
+    // the routing table is empty, so there is always room for the first interface and the default route
+    (void)HyphaIpRouteFirstInterface(stack, interface);
+    stack->theirs = theirs;
+    memcpy(&stack->external, externals, sizeof(HyphaIpExternalInterface_t));
+    stack->timers.now = externals->get_monotonic_timestamp(theirs) / HYPHA_IP_TIMER_RESOLUTION;
+    if (externals->capabilities != nullptr) {
+        HyphaIpStatus_e status = externals->capabilities(theirs, &stack->capabilities);
+        if (HyphaIpIsFailure(status)) {
+            memset(stack, 0, sizeof(struct HyphaIpContext));
+            *context = nullptr;
+            return status;
+        }
+    }
     return HyphaIpStatusOk;
 }
 
 HyphaIpStatus_e HyphaIpDeinitialize(HyphaIpContext_t *context) {
-    if (context == nullptr) {
+    if (context == nullptr || *context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
+    // the frames of the transmit ring go back to the driver
+    (void)HyphaIpStopTransmitRing(*context);
     memset(*context, 0, sizeof(struct HyphaIpContext));
     *context = nullptr;
     return HyphaIpStatusOk;
@@ -94,29 +84,59 @@ HyphaIpStatus_e HyphaIpRunOnce(HyphaIpContext_t context) {
     if (context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
-    HyphaIpEthernetFrame_t *frame = context->external.acquire(context->theirs);
-    HyphaIpStatus_e status = HyphaIpStatusOk;
+    HyphaIpEthernetFrame_t *frame = HyphaIpDriverAcquire(context);
     if (frame == nullptr) {
-        context->statistics.frames.failures++;
-        status = HyphaIpStatusOutOfMemory;
-        HYPHA_IP_REPORT(context, status);
-        return status;
+        return HyphaIpStatusOutOfMemory;
     }
-    context->statistics.frames.acquires++;
     // receive a frame from the ethernet driver
-    status = context->external.receive(context->theirs, frame);
+    HyphaIpStatus_e status = context->external.receive(context->theirs, frame);
     HYPHA_IP_REPORT(context, status);
     // receive the frame with the stack
-    status = HyphaIpEthernetReceiveFrame(context, frame);
+    HyphaIpTimestamp_t timestamp = context->external.get_monotonic_timestamp(context->theirs);
+    status = HyphaIpEthernetReceiveFrame(context, frame, timestamp);
     HYPHA_IP_REPORT(context, status);
     // release the frame back to the client
-    status = context->external.release(context->theirs, frame);
-    HYPHA_IP_REPORT(context, status);
-    if (HyphaIpIsSuccess(status)) {
-        context->statistics.frames.releases++;
-    } else {
-        context->statistics.frames.failures++;
+    status = HyphaIpDriverRelease(context, frame);
+    // then fire any timers whose time has come
+    HyphaIpStatus_e timers = HyphaIpTick(context, timestamp);
+    HYPHA_IP_REPORT(context, timers);
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpRunBatch(HyphaIpContext_t context, size_t max_frames, size_t *handled) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (handled == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    *handled = 0U;
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    // one clock sample for the whole batch
+    HyphaIpTimestamp_t timestamp = context->external.get_monotonic_timestamp(context->theirs);
+    HyphaIpEthernetFrame_t *frames[HYPHA_IP_BATCH_SIZE];
+    while (*handled < max_frames) {
+        size_t wanted = max_frames - *handled;
+        wanted = (wanted < HYPHA_IP_BATCH_SIZE) ? wanted : HYPHA_IP_BATCH_SIZE;
+        size_t received = HyphaIpDriverReceiveBatch(context, wanted, frames);
+        for (size_t i = 0U; i < received; i++) {
+            if ((i + 1U) < received) {
+                // pull the next headers into the cache while this frame is being parsed
+                __builtin_prefetch(&frames[i + 1U]->header, 0, 3);
+                __builtin_prefetch(&frames[i + 1U]->payload[HyphaIpOffsetOfUDPHeader()], 0, 3);
+            }
+            HyphaIpStatus_e result = HyphaIpEthernetReceiveFrame(context, frames[i], timestamp);
+            HYPHA_IP_REPORT(context, result);
+        }
+        HyphaIpStatus_e released = HyphaIpDriverReleaseBatch(context, received, frames);
+        status = HyphaIpIsFailure(status) ? status : released;  // the first failure is the one returned
+        *handled += received;
+        if (received < wanted) {
+            break;  // the driver has run dry
+        }
     }
+    HyphaIpStatus_e timers = HyphaIpTick(context, timestamp);
+    HYPHA_IP_REPORT(context, timers);
     return status;
 }
 
@@ -4,49 +4,510 @@
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 #include "hypha_ip/hypha_internal.h"
 
-HyphaIpStatus_e HyphaIpArpAnnouncement(HyphaIpContext_t context) {
-    if (context == nullptr) {
-        return HyphaIpStatusInvalidContext;
+/// Writes the Ethernet header and the ARP packet into the frame and hands it to the driver on the frame's interface
+static HyphaIpStatus_e HyphaIpArpSend(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                      HyphaIpEthernetAddress_t destination, HyphaIpArpPacket_t const *arp_packet) {
+    HyphaIpEthernetHeader_t ethernet_header =
+        HyphaIpEthernetBaseHeader(context, frame->info.interface, HyphaIpEtherType_ARP);
+    ethernet_header.destination = destination;
+    HyphaIpCopyEthernetHeaderToFrame(frame, &ethernet_header);
+    HyphaIpCopyArpPacketToFrame(frame, arp_packet);
+    frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpArpPacket_t));
+    HyphaIpStatus_e status = HyphaIpDriverTransmit(context, frame);
+    HYPHA_IP_REPORT(context, status);
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.counter.arp.tx.count++;
+        context->statistics.counter.arp.tx.bytes += sizeof(HyphaIpArpPacket_t);
     }
-    HyphaIpIPv4Address_t ipv4 = context->interface.address;
+    return status;
+}
+
+/// Announces the address of one interface
+static HyphaIpStatus_e HyphaIpArpAnnounce(HyphaIpContext_t context, uint8_t interface) {
+    HyphaIpNetworkInterface_t const *ours = &context->interfaces[interface];
+    HyphaIpIPv4Address_t ipv4 = ours->address;
 
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerARP, "ARP Announcement for " PRIuIPv4Address "\r\n",
                    ipv4.a, ipv4.b, ipv4.c, ipv4.d);
 
-    HyphaIpEthernetFrame_t *frame = context->external.acquire(context->theirs);
+    HyphaIpEthernetFrame_t *frame =
+        HyphaIpDriverAcquireSized(context, sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpArpPacket_t));
     if (frame == nullptr) {
         return HyphaIpStatusOutOfMemory;
     }
+    frame->info.interface = interface;
     HyphaIpArpPacket_t arp_packet = {
         .hardware_type = HyphaIpArpHardwareTypeEthernet,
         .protocol_type = HyphaIpArpProtocolTypeIPv4,
         .hardware_length = sizeof(HyphaIpEthernetAddress_t),
         .protocol_length = sizeof(HyphaIpIPv4Address_t),
         .operation = HyphaIpArpOperationRequest,
-        .sender_hardware = context->interface.mac,
-        .sender_protocol = context->interface.address,
+        .sender_hardware = ours->mac,
+        .sender_protocol = ours->address,
         .target_hardware = hypha_ip_ethernet_broadcast,  // we don't know the target MAC yet
-        .target_protocol = context->interface.address,   // we are asking for our own address
+        .target_protocol = ours->address,                // we are asking for our own address
     };
-    HyphaIpCopyArpPacketToFrame(frame, &arp_packet);
-    HyphaIpStatus_e status = context->external.transmit(context->theirs, frame);
-    HYPHA_IP_REPORT(context, status);
+    HyphaIpStatus_e status = HyphaIpArpSend(context, frame, hypha_ip_ethernet_broadcast, &arp_packet);
     if (status == HyphaIpStatusOk) {
         context->statistics.arp.announces++;
     }
-    status = context->external.release(context->theirs, frame);
-    HYPHA_IP_REPORT(context, status);
+    return HyphaIpDriverRelease(context, frame);
+}
+
+HyphaIpStatus_e HyphaIpArpAnnouncement(HyphaIpContext_t context) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    // each interface is on its own link, so each one announces its own address
+    for (size_t i = 0U; i < context->interface_count; i++) {
+        HyphaIpStatus_e announced = HyphaIpArpAnnounce(context, (uint8_t)i);
+        if (HyphaIpIsFailure(announced)) {
+            status = announced;
+        }
+    }
     return status;
 }
 
 HyphaIpStatus_e HyphaIpArpProcessPacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
                                         HyphaIpTimestamp_t timestamp) {
-    // TODO the lengths must match 48 bit address and IPv4 address
     context->statistics.counter.arp.rx.count++;
+    if (frame->info.length < (sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpArpPacket_t))) {
+        return HyphaIpStatusInvalidFrameLength;
+    }
     context->statistics.counter.arp.rx.bytes += sizeof(HyphaIpArpPacket_t);
     HyphaIpArpPacket_t arp_packet;
     HyphaIpCopyArpPacketFromFrame(&arp_packet, frame);
-    // TODO deal with ARP, could require queueing up a send for later?
-    (void)timestamp;  // Suppress unused parameter warning
-    return HyphaIpStatusNotImplemented;
+    if (arp_packet.hardware_type != HyphaIpArpHardwareTypeEthernet ||
+        arp_packet.protocol_type != HyphaIpArpProtocolTypeIPv4 ||
+        arp_packet.hardware_length != sizeof(HyphaIpEthernetAddress_t) ||
+        arp_packet.protocol_length != sizeof(HyphaIpIPv4Address_t)) {
+        context->statistics.arp.rejected++;
+        return HyphaIpStatusArpPacketRejected;
+    }
+    HyphaIpIPv4Address_t sender = arp_packet.sender_protocol;
+    // only the address of the interface the packet came in on is answered, the others are on other links
+    HyphaIpNetworkInterface_t const *ours = &context->interfaces[frame->info.interface];
+    bool for_us = HyphaIpIsSameIPv4Address(ours->address, arp_packet.target_protocol);
+    // a probe has no sender address to learn and our own packets have nothing to teach
+    bool learnable = !HyphaIpIsSameIPv4Address(sender, hypha_ip_default_route) &&
+                     !HyphaIpIsOurEthernetAddress(context, arp_packet.sender_hardware);
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    HyphaIpAddressMatch_t match = {.mac = arp_packet.sender_hardware, .ipv4 = sender};
+    HyphaIpTimestamp_t expiration = timestamp + HYPHA_IP_EXPIRATION_TIME;
+    // RFC 826, a sender we already know is refreshed from any packet, a new one is only added when it asks us
+    HyphaIpARPEntry_t const *entry = HyphaIpArpCacheFindByIPv4(&HyphaIpTablesReadBegin(context)->arp_cache, sender);
+    bool known = (entry != nullptr);
+    bool cached = known && HyphaIpIsSameEthernetAddress(entry->match.mac, match.mac);
+    HyphaIpTablesReadEnd(context);
+    if (learnable && (known || for_us)) {
+        // a refresh only moves the owner's timer, a new (or moved) address needs a new version of the tables. The
+        // receive path never waits on a writer for it, a sender missed meanwhile is learned from its next packet.
+        if (!cached && HyphaIpTablesTryLock(context)) {
+            status = HyphaIpArpCacheInsert(context, &match, expiration);
+            cached = HyphaIpIsSuccess(status);
+            HyphaIpTablesUnlock(context);
+        }
+        if (cached) {
+            context->statistics.arp.learned++;
+            status = HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry, HyphaIpIPv4AddressToValue(sender), expiration);
+        }
+        // the address may be the one some transmits are waiting for, they go out even if the cache did not take it
+        HyphaIpArpPendingFlush(context, &match);
+    }
+#else
+    (void)timestamp;
+#endif
+    if (!for_us || arp_packet.operation != HyphaIpArpOperationRequest || !learnable) {
+        return status;  // replies and requests for other hosts need no answer
+    }
+    context->statistics.arp.requests++;
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerARP,
+                   "ARP Request from " PRIuIPv4Address "\r\n", sender.a, sender.b, sender.c, sender.d);
+    // the request becomes the reply in place, the driver gets the same frame back without a second buffer
+    arp_packet.operation = HyphaIpArpOperationReply;
+    arp_packet.target_hardware = arp_packet.sender_hardware;
+    arp_packet.target_protocol = sender;
+    arp_packet.sender_hardware = ours->mac;
+    arp_packet.sender_protocol = ours->address;
+    frame->info.flags = HyphaIpFrameFlagNone;  // what the driver did on receive means nothing to the transmit
+    HyphaIpStatus_e reply = HyphaIpArpSend(context, frame, arp_packet.target_hardware, &arp_packet);
+    if (HyphaIpIsSuccess(reply)) {
+        context->statistics.arp.replies++;
+    }
+    // a full cache does not stop the answer, but it is still worth hearing about
+    return HyphaIpIsFailure(reply) ? reply : status;
+}
+
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+/// The value of an empty slot in the ARP indexes
+#define HYPHA_IP_ARP_INDEX_EMPTY 0U
+
+/// Maps a 32 bit hash onto the index without a division
+static inline size_t HyphaIpArpReduce(uint32_t hash) {
+    return (size_t)(((uint64_t)hash * HYPHA_IP_ARP_INDEX_SIZE) >> 32U);
+}
+
+/// @return The slot where the search for the IPv4 Address starts
+static inline size_t HyphaIpArpHashIPv4(HyphaIpIPv4Address_t ipv4) {
+    // Fibonacci hashing spreads the mostly sequential hosts of a subnet over the whole index
+    return HyphaIpArpReduce(HyphaIpIPv4AddressToValue(ipv4) * 0x9E37'79B1U);
+}
+
+/// @return The slot where the search for the Ethernet Address starts
+static inline size_t HyphaIpArpHashMac(HyphaIpEthernetAddress_t mac) {
+    uint64_t value = 0U;
+    memcpy(&value, &mac, sizeof(mac));
+    return HyphaIpArpReduce((uint32_t)((value * 0x9E37'79B9'7F4A'7C15U) >> 32U));
+}
+
+/// @return The slot after the given one, wrapping around the end of the index
+static inline size_t HyphaIpArpNext(size_t slot) { return ((slot + 1U) == HYPHA_IP_ARP_INDEX_SIZE) ? 0U : (slot + 1U); }
+
+/// @return The slot where the search for the numbered entry starts in the given index
+static size_t HyphaIpArpHome(HyphaIpArpCache_t const *cache, uint16_t const *index, uint16_t number) {
+    HyphaIpAddressMatch_t const *match = &cache->entries[number - 1U].match;
+    return (index == cache->by_ipv4) ? HyphaIpArpHashIPv4(match->ipv4) : HyphaIpArpHashMac(match->mac);
+}
+
+/// @return The slot of the index which holds the numbered entry
+static size_t HyphaIpArpSlotOf(HyphaIpArpCache_t const *cache, uint16_t const *index, uint16_t number) {
+    size_t slot = HyphaIpArpHome(cache, index, number);
+    while (index[slot] != number) {
+        slot = HyphaIpArpNext(slot);
+    }
+    return slot;
+}
+
+/// Puts the numbered entry in the first empty slot from its home
+static void HyphaIpArpLink(uint16_t *index, size_t home, uint16_t number) {
+    size_t slot = home;
+    while (index[slot] != HYPHA_IP_ARP_INDEX_EMPTY) {
+        slot = HyphaIpArpNext(slot);
+    }
+    index[slot] = number;
+}
+
+/// Empties a slot of the index. The rest of the run is shifted back over the hole so no search stops early, which
+/// leaves no tombstones to clean up later.
+static void HyphaIpArpUnlink(HyphaIpArpCache_t const *cache, uint16_t *index, size_t slot) {
+    size_t hole = slot;
+    for (size_t next = HyphaIpArpNext(slot); index[next] != HYPHA_IP_ARP_INDEX_EMPTY; next = HyphaIpArpNext(next)) {
+        size_t home = HyphaIpArpHome(cache, index, index[next]);
+        // an entry whose home is (cyclically) after the hole would not be found from there, so it stays
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            index[hole] = index[next];
+            hole = next;
+        }
+    }
+    index[hole] = HYPHA_IP_ARP_INDEX_EMPTY;
+}
+
+/// @return The number of the entry of the IPv4 Address, zero when it has none
+static uint16_t HyphaIpArpNumberOf(HyphaIpArpCache_t const *cache, HyphaIpIPv4Address_t ipv4) {
+    for (size_t slot = HyphaIpArpHashIPv4(ipv4); cache->by_ipv4[slot] != HYPHA_IP_ARP_INDEX_EMPTY;
+         slot = HyphaIpArpNext(slot)) {
+        uint16_t number = cache->by_ipv4[slot];
+        if (HyphaIpIsSameIPv4Address(cache->entries[number - 1U].match.ipv4, ipv4)) {
+            return number;
+        }
+    }
+    return HYPHA_IP_ARP_INDEX_EMPTY;
+}
+
+HyphaIpARPEntry_t const *HyphaIpArpCacheFindByIPv4(HyphaIpArpCache_t const *cache, HyphaIpIPv4Address_t ipv4) {
+    uint16_t number = HyphaIpArpNumberOf(cache, ipv4);
+    return (number == HYPHA_IP_ARP_INDEX_EMPTY) ? nullptr : &cache->entries[number - 1U];
+}
+
+HyphaIpARPEntry_t const *HyphaIpArpCacheFindByMac(HyphaIpArpCache_t const *cache, HyphaIpEthernetAddress_t mac) {
+    for (size_t slot = HyphaIpArpHashMac(mac); cache->by_mac[slot] != HYPHA_IP_ARP_INDEX_EMPTY;
+         slot = HyphaIpArpNext(slot)) {
+        HyphaIpARPEntry_t const *entry = &cache->entries[cache->by_mac[slot] - 1U];
+        if (HyphaIpIsSameEthernetAddress(entry->match.mac, mac)) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+HyphaIpStatus_e HyphaIpArpCacheInsert(HyphaIpContext_t context, HyphaIpAddressMatch_t const *match,
+                                      HyphaIpTimestamp_t expiration) {
+    HyphaIpArpCache_t *cache = &HyphaIpTablesDraft(context, HyphaIpTableArpCache)->arp_cache;
+    uint16_t number = HyphaIpArpNumberOf(cache, match->ipv4);
+    HyphaIpARPEntry_t *entry = nullptr;
+    if (number != HYPHA_IP_ARP_INDEX_EMPTY) {
+        entry = &cache->entries[number - 1U];
+        if (!HyphaIpIsSameEthernetAddress(entry->match.mac, match->mac)) {
+            // the old address has to be found from its own home before it is changed
+            HyphaIpArpUnlink(cache, cache->by_mac, HyphaIpArpSlotOf(cache, cache->by_mac, number));
+            entry->match.mac = match->mac;
+            HyphaIpArpLink(cache->by_mac, HyphaIpArpHashMac(match->mac), number);
+        }
+        entry->expiration = expiration;
+        return HyphaIpStatusOk;
+    }
+    if (cache->count == HYPHA_IP_DIMOF(cache->entries)) {
+        return HyphaIpStatusArpTableFull;
+    }
+    entry = &cache->entries[cache->count++];
+    entry->valid = true;
+    entry->expiration = expiration;
+    entry->match = *match;
+    number = (uint16_t)cache->count;
+    HyphaIpArpLink(cache->by_ipv4, HyphaIpArpHashIPv4(match->ipv4), number);
+    HyphaIpArpLink(cache->by_mac, HyphaIpArpHashMac(match->mac), number);
+    context->statistics.arp.additions++;
+    return HyphaIpStatusOk;
+}
+
+/// Takes the numbered entry out of the cache and its indexes. A timer left running for it finds nothing to remove.
+static void HyphaIpArpCacheRemoveNumber(HyphaIpContext_t context, HyphaIpArpCache_t *cache, uint16_t number) {
+    HyphaIpARPEntry_t *entry = &cache->entries[number - 1U];
+    uint16_t last = (uint16_t)cache->count;
+    HyphaIpArpUnlink(cache, cache->by_ipv4, HyphaIpArpSlotOf(cache, cache->by_ipv4, number));
+    HyphaIpArpUnlink(cache, cache->by_mac, HyphaIpArpSlotOf(cache, cache->by_mac, number));
+    if (number != last) {
+        // the last entry fills the hole so the entries stay packed
+        size_t ipv4_slot = HyphaIpArpSlotOf(cache, cache->by_ipv4, last);
+        size_t mac_slot = HyphaIpArpSlotOf(cache, cache->by_mac, last);
+        *entry = cache->entries[last - 1U];
+        cache->by_ipv4[ipv4_slot] = number;
+        cache->by_mac[mac_slot] = number;
+    }
+    memset(&cache->entries[last - 1U], 0, sizeof(HyphaIpARPEntry_t));
+    cache->count--;
+    context->statistics.arp.removals++;
+}
+
+void HyphaIpArpCacheRemove(HyphaIpContext_t context, HyphaIpIPv4Address_t ipv4) {
+    HyphaIpArpCache_t *cache = &HyphaIpTablesDraft(context, HyphaIpTableArpCache)->arp_cache;
+    uint16_t number = HyphaIpArpNumberOf(cache, ipv4);
+    if (number != HYPHA_IP_ARP_INDEX_EMPTY) {
+        HyphaIpArpCacheRemoveNumber(context, cache, number);
+    }
+}
+
+void HyphaIpArpCacheExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline) {
+    HyphaIpArpCache_t const *found = &HyphaIpTablesPeek(context, HyphaIpTableArpCache)->arp_cache;
+    uint16_t number = HyphaIpArpNumberOf(found, HyphaIpValueToIPv4Address(key));
+    if (number == HYPHA_IP_ARP_INDEX_EMPTY) {
+        return;
+    }
+    HyphaIpTimestamp_t expiration = found->entries[number - 1U].expiration;
+    if (expiration > deadline) {
+        // populated again since the timers last caught up with the tables
+        (void)HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry, key, expiration);
+        return;
+    }
+    // the draft is a copy of what was found, so the entry has the same number in it
+    HyphaIpArpCacheRemoveNumber(context, &HyphaIpTablesDraft(context, HyphaIpTableArpCache)->arp_cache, number);
+    context->statistics.expirations.arp++;
+}
+
+HyphaIpStatus_e HyphaIpArpCacheAge(HyphaIpContext_t context, HyphaIpTables_t const *tables) {
+    HyphaIpArpCache_t const *cache = &tables->arp_cache;
+    HyphaIpStatus_e result = HyphaIpStatusOk;
+    for (size_t i = 0U; i < cache->count; i++) {
+        HyphaIpARPEntry_t const *entry = &cache->entries[i];
+        HyphaIpStatus_e status = HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry,
+                                                 HyphaIpIPv4AddressToValue(entry->match.ipv4), entry->expiration);
+        result = HyphaIpIsFailure(status) ? status : result;
+    }
+    return result;
+}
+
+/// Broadcasts an ARP request for the Ethernet Address of an IPv4 Address on an interface
+static HyphaIpStatus_e HyphaIpArpRequest(HyphaIpContext_t context, uint8_t interface, HyphaIpIPv4Address_t ipv4) {
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerARP, "ARP Request for " PRIuIPv4Address "\r\n",
+                   ipv4.a, ipv4.b, ipv4.c, ipv4.d);
+    HyphaIpEthernetFrame_t *frame =
+        HyphaIpDriverAcquireSized(context, sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpArpPacket_t));
+    if (frame == nullptr) {
+        return HyphaIpStatusOutOfMemory;
+    }
+    frame->info.interface = interface;
+    HyphaIpArpPacket_t arp_packet = {
+        .hardware_type = HyphaIpArpHardwareTypeEthernet,
+        .protocol_type = HyphaIpArpProtocolTypeIPv4,
+        .hardware_length = sizeof(HyphaIpEthernetAddress_t),
+        .protocol_length = sizeof(HyphaIpIPv4Address_t),
+        .operation = HyphaIpArpOperationRequest,
+        .sender_hardware = context->interfaces[interface].mac,
+        .sender_protocol = context->interfaces[interface].address,
+        .target_hardware = hypha_ip_ethernet_local,  // this is what we are asking for
+        .target_protocol = ipv4,
+    };
+    HyphaIpStatus_e status = HyphaIpArpSend(context, frame, hypha_ip_ethernet_broadcast, &arp_packet);
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.arp.resolves++;
+    }
+    (void)HyphaIpDriverRelease(context, frame);
+    return status;
+}
+
+/// @return The outstanding request for the IPv4 Address or nullptr if there is none
+static HyphaIpArpResolution_t *HyphaIpArpPendingFind(HyphaIpArpPending_t *pending, HyphaIpIPv4Address_t ipv4) {
+    for (size_t i = 0U; i < pending->destinations; i++) {
+        if (HyphaIpIsSameIPv4Address(pending->resolutions[i].destination, ipv4)) {
+            return &pending->resolutions[i];
+        }
+    }
+    return nullptr;
+}
+
+/// Takes the outstanding request and the waiting frames of a destination out of the queue. The frames behind them
+/// are moved up so the storage stays packed and in order.
+static void HyphaIpArpPendingRemove(HyphaIpArpPending_t *pending, HyphaIpArpResolution_t *resolution) {
+    size_t kept = 0U;
+    size_t used = 0U;
+    for (size_t i = 0U; i < pending->frames; i++) {
+        HyphaIpArpPendingFrame_t waiting = pending->pending[i];
+        if (HyphaIpIsSameIPv4Address(waiting.destination, resolution->destination)) {
+            continue;
+        }
+        if (waiting.offset != used) {
+            memmove(&pending->storage[used], &pending->storage[waiting.offset], waiting.length);
+            waiting.offset = used;
+        }
+        used += waiting.length;
+        pending->pending[kept++] = waiting;
+    }
+    pending->frames = kept;
+    pending->used = used;
+    // the last request fills the hole so the requests stay packed
+    *resolution = pending->resolutions[--pending->destinations];
+}
+
+HyphaIpStatus_e HyphaIpArpPendingAdd(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame,
+                                     HyphaIpIPv4Address_t destination) {
+    HyphaIpArpPending_t *pending = &context->arp_pending;
+    HyphaIpArpResolution_t *resolution = HyphaIpArpPendingFind(pending, destination);
+    size_t length = frame->info.length;
+    bool full = (resolution == nullptr) ? (pending->destinations == HYPHA_IP_DIMOF(pending->resolutions))
+                                        : (resolution->count == HYPHA_IP_ARP_PENDING_FRAMES);
+    if (full || (length > (sizeof(pending->storage) - pending->used))) {
+        context->statistics.arp.overflows++;
+        return HyphaIpStatusArpQueueFull;
+    }
+    if (resolution == nullptr) {
+        // the first frame for a destination asks for it, the rest wait for the same reply
+        HyphaIpTimestamp_t now = context->external.get_monotonic_timestamp(context->theirs);
+        resolution = &pending->resolutions[pending->destinations];
+        resolution->destination = destination;
+        resolution->interface = frame->info.interface;
+        resolution->timer = 0U;
+        resolution->count = 0U;
+        HyphaIpStatus_e status = HyphaIpTimerSchedule(context, &resolution->timer, HyphaIpTimerKindArpRequest,
+                                                      HyphaIpIPv4AddressToValue(destination),
+                                                      now + HYPHA_IP_ARP_REQUEST_TIMEOUT);
+        if (HyphaIpIsFailure(status)) {
+            return status;
+        }
+        pending->destinations++;
+        // a request which is lost is no different to one which is not answered, the timer drops the frames
+        (void)HyphaIpArpRequest(context, resolution->interface, destination);
+    }
+    HyphaIpArpPendingFrame_t *waiting = &pending->pending[pending->frames++];
+    waiting->destination = destination;
+    waiting->flags = frame->info.flags;
+    waiting->interface = frame->info.interface;
+    waiting->offset = pending->used;
+    waiting->length = length;
+    memcpy(&pending->storage[pending->used], &frame->header, length);
+    pending->used += length;
+    resolution->count++;
+    context->statistics.arp.queued++;
+    return HyphaIpStatusOk;
+}
+
+HyphaIpArpPendingMark_t HyphaIpArpPendingMark(HyphaIpContext_t context) {
+    HyphaIpArpPending_t const *pending = &context->arp_pending;
+    return (HyphaIpArpPendingMark_t){
+        .destinations = pending->destinations, .frames = pending->frames, .used = pending->used};
+}
+
+void HyphaIpArpPendingRollback(HyphaIpContext_t context, HyphaIpArpPendingMark_t mark) {
+    HyphaIpArpPending_t *pending = &context->arp_pending;
+    if (pending->frames == mark.frames) {
+        return;  // the usual case, nothing was held
+    }
+    // nothing is flushed while a datagram is being sent, so its frames are the ones after the mark
+    for (size_t i = mark.frames; i < pending->frames; i++) {
+        HyphaIpArpPendingFind(pending, pending->pending[i].destination)->count--;
+        context->statistics.arp.overflows++;
+    }
+    pending->frames = mark.frames;
+    pending->used = mark.used;
+    // the requests for destinations nothing waits on any more are given up, they were added last
+    while (pending->destinations > mark.destinations && pending->resolutions[pending->destinations - 1U].count == 0U) {
+        HyphaIpTimerCancel(context, &pending->resolutions[--pending->destinations].timer);
+    }
+}
+
+void HyphaIpArpPendingFlush(HyphaIpContext_t context, HyphaIpAddressMatch_t const *match) {
+    HyphaIpArpPending_t *pending = &context->arp_pending;
+    HyphaIpArpResolution_t *resolution = HyphaIpArpPendingFind(pending, match->ipv4);
+    if (resolution == nullptr) {
+        return;
+    }
+    HyphaIpTimerCancel(context, &resolution->timer);
+    // only these frames go out in the burst, so what the driver takes of it is what was flushed
+    size_t const accepted = context->statistics.mac.accepted;
+    HyphaIpDriverBurstBegin(context);
+    for (size_t i = 0U; i < pending->frames; i++) {
+        HyphaIpArpPendingFrame_t const *waiting = &pending->pending[i];
+        if (!HyphaIpIsSameIPv4Address(waiting->destination, match->ipv4)) {
+            continue;
+        }
+        HyphaIpEthernetFrame_t *frame = HyphaIpDriverAcquireSized(context, waiting->length);
+        if (frame == nullptr) {
+            continue;  // counted as an allocation failure
+        }
+        memcpy(&frame->header, &pending->storage[waiting->offset], waiting->length);
+        frame->header.destination = match->mac;
+        frame->info.flags = waiting->flags;
+        frame->info.interface = waiting->interface;
+        HyphaIpMetaData_t metadata = {.destination_address = match->ipv4, .interface = waiting->interface};
+        (void)HyphaIpEthernetSendFrame(context, frame, &metadata, waiting->length - sizeof(HyphaIpEthernetHeader_t));
+        (void)HyphaIpDriverRelease(context, frame);
+    }
+    HyphaIpStatus_e status = HyphaIpDriverBurstEnd(context);
+    HYPHA_IP_REPORT(context, status);
+    context->statistics.arp.flushed += context->statistics.mac.accepted - accepted;
+    HyphaIpArpPendingRemove(pending, resolution);
+}
+
+void HyphaIpArpPendingResolve(HyphaIpContext_t context) {
+    HyphaIpArpPending_t *pending = &context->arp_pending;
+    if (pending->destinations == 0U) {
+        return;  // the usual case, nothing is waiting
+    }
+    // the matches are copied out, the frames are sent once the read is over
+    HyphaIpAddressMatch_t resolved[HYPHA_IP_ARP_PENDING_DESTINATIONS];
+    size_t count = 0U;
+    HyphaIpArpCache_t const *cache = &HyphaIpTablesReadBegin(context)->arp_cache;
+    for (size_t i = 0U; i < pending->destinations; i++) {
+        HyphaIpARPEntry_t const *entry = HyphaIpArpCacheFindByIPv4(cache, pending->resolutions[i].destination);
+        if (entry != nullptr) {
+            resolved[count++] = entry->match;
+        }
+    }
+    HyphaIpTablesReadEnd(context);
+    for (size_t i = 0U; i < count; i++) {
+        HyphaIpArpPendingFlush(context, &resolved[i]);
+    }
+}
+
+void HyphaIpArpPendingExpire(HyphaIpContext_t context, uint32_t key) {
+    HyphaIpArpPending_t *pending = &context->arp_pending;
+    HyphaIpArpResolution_t *resolution = HyphaIpArpPendingFind(pending, HyphaIpValueToIPv4Address(key));
+    if (resolution != nullptr) {
+        resolution->timer = 0U;  // the timer has been given back
+        context->statistics.arp.timeouts += resolution->count;
+        HyphaIpArpPendingRemove(pending, resolution);
+    }
 }
+#endif  // HYPHA_IP_USE_ARP_CACHE
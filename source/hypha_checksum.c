@@ -4,37 +4,241 @@
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 #include "hypha_ip/hypha_internal.h"
 
+#if (HYPHA_IP_USE_SIMD_CHECKSUM == 1) && defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+/// SSE2 is part of the x86-64 baseline
+#define HYPHA_IP_CHECKSUM_SSE2 1
+#if defined(__GNUC__)
+/// AVX2 is compiled in with a target attribute and selected at runtime
+#define HYPHA_IP_CHECKSUM_AVX2 1
+#endif
+#endif
+
+#if (HYPHA_IP_USE_SIMD_CHECKSUM == 1) && defined(__ARM_NEON) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+/// NEON is part of the AArch64 baseline
+#define HYPHA_IP_CHECKSUM_NEON 1
+#endif
+
+/// Below this many bytes the scalar kernel is faster than any setup the vector kernels need
+#define HYPHA_IP_CHECKSUM_SIMD_MINIMUM (64U)
+
+/// The number of vector iterations before the 32 bit lanes are drained, each lane grows by at most 2 * 0xFFFF
+#define HYPHA_IP_CHECKSUM_SIMD_BLOCKS (16'384U)
+
+/// Folds a 64 bit accumulator into a 16 bit 1's compliment sum
+static uint16_t ChecksumFold(uint64_t sum) {
+    sum = (sum & 0xFFFF'FFFFU) + (sum >> 32U);
+    sum = (sum & 0xFFFF'FFFFU) + (sum >> 32U);
+    sum = (sum & 0xFFFFU) + (sum >> 16U);
+    sum = (sum & 0xFFFFU) + (sum >> 16U);
+    return (uint16_t)sum;
+}
+
+/// The portable kernel, adds 32 bit halves of unaligned 64 bit loads into a 64 bit accumulator
+static uint64_t ChecksumScalar(uint8_t const *bytes, size_t count) {
+    uint64_t sum0 = 0U;
+    uint64_t sum1 = 0U;
+    while (count >= 2U * sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, &bytes[0], sizeof(a));
+        memcpy(&b, &bytes[sizeof(a)], sizeof(b));
+        sum0 += (a & 0xFFFF'FFFFU) + (a >> 32U);
+        sum1 += (b & 0xFFFF'FFFFU) + (b >> 32U);
+        bytes += 2U * sizeof(uint64_t);
+        count -= 2U * sizeof(uint64_t);
+    }
+    while (count >= sizeof(uint16_t)) {
+        uint16_t word;
+        memcpy(&word, bytes, sizeof(word));
+        sum0 += word;
+        bytes += sizeof(uint16_t);
+        count -= sizeof(uint16_t);
+    }
+    if (count > 0U) {
+        // pad the odd byte with a zero in the same memory order as the data
+        uint8_t const padded[sizeof(uint16_t)] = {bytes[0], 0U};
+        uint16_t word;
+        memcpy(&word, padded, sizeof(word));
+        sum0 += word;
+    }
+    return sum0 + sum1;
+}
+
+#if defined(HYPHA_IP_CHECKSUM_SSE2)
+/// The SSE2 kernel, widens each 16 bit word into a 32 bit lane
+static uint64_t ChecksumSSE2(uint8_t const *bytes, size_t count) {
+    uint64_t sum = 0U;
+    __m128i const zero = _mm_setzero_si128();
+    while (count >= 2U * sizeof(__m128i)) {
+        size_t blocks = count / (2U * sizeof(__m128i));
+        blocks = (blocks > HYPHA_IP_CHECKSUM_SIMD_BLOCKS) ? HYPHA_IP_CHECKSUM_SIMD_BLOCKS : blocks;
+        // two independent accumulators to hide the add latency
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        for (size_t b = 0U; b < blocks; b++) {
+            __m128i v0 = _mm_loadu_si128((__m128i const *)&bytes[0]);
+            __m128i v1 = _mm_loadu_si128((__m128i const *)&bytes[sizeof(__m128i)]);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v0, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v0, zero));
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v1, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v1, zero));
+            bytes += 2U * sizeof(__m128i);
+        }
+        count -= blocks * 2U * sizeof(__m128i);
+        uint32_t lanes[2U * sizeof(__m128i) / sizeof(uint32_t)];
+        _mm_storeu_si128((__m128i *)&lanes[0], acc0);
+        _mm_storeu_si128((__m128i *)&lanes[sizeof(__m128i) / sizeof(uint32_t)], acc1);
+        for (size_t i = 0U; i < HYPHA_IP_DIMOF(lanes); i++) {
+            sum += lanes[i];
+        }
+    }
+    return sum + ChecksumScalar(bytes, count);
+}
+#endif
+
+#if defined(HYPHA_IP_CHECKSUM_AVX2)
+/// The AVX2 kernel, widens each 16 bit word into a 32 bit lane
+__attribute__((target("avx2"))) static uint64_t ChecksumAVX2(uint8_t const *bytes, size_t count) {
+    uint64_t sum = 0U;
+    __m256i const zero = _mm256_setzero_si256();
+    while (count >= 2U * sizeof(__m256i)) {
+        size_t blocks = count / (2U * sizeof(__m256i));
+        blocks = (blocks > HYPHA_IP_CHECKSUM_SIMD_BLOCKS) ? HYPHA_IP_CHECKSUM_SIMD_BLOCKS : blocks;
+        // two independent accumulators to hide the add latency
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        for (size_t b = 0U; b < blocks; b++) {
+            __m256i v0 = _mm256_loadu_si256((__m256i const *)&bytes[0]);
+            __m256i v1 = _mm256_loadu_si256((__m256i const *)&bytes[sizeof(__m256i)]);
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v0, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v0, zero));
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v1, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v1, zero));
+            bytes += 2U * sizeof(__m256i);
+        }
+        count -= blocks * 2U * sizeof(__m256i);
+        uint32_t lanes[2U * sizeof(__m256i) / sizeof(uint32_t)];
+        _mm256_storeu_si256((__m256i *)&lanes[0], acc0);
+        _mm256_storeu_si256((__m256i *)&lanes[sizeof(__m256i) / sizeof(uint32_t)], acc1);
+        for (size_t i = 0U; i < HYPHA_IP_DIMOF(lanes); i++) {
+            sum += lanes[i];
+        }
+    }
+    return sum + ChecksumScalar(bytes, count);
+}
+#endif
+
+#if defined(HYPHA_IP_CHECKSUM_NEON)
+/// The NEON kernel, pairwise adds 16 bit words into 32 bit lanes
+static uint64_t ChecksumNEON(uint8_t const *bytes, size_t count) {
+    uint64_t sum = 0U;
+    while (count >= sizeof(uint8x16_t)) {
+        size_t blocks = count / sizeof(uint8x16_t);
+        blocks = (blocks > HYPHA_IP_CHECKSUM_SIMD_BLOCKS) ? HYPHA_IP_CHECKSUM_SIMD_BLOCKS : blocks;
+        uint32x4_t acc = vdupq_n_u32(0U);
+        for (size_t b = 0U; b < blocks; b++) {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(bytes)));
+            bytes += sizeof(uint8x16_t);
+        }
+        count -= blocks * sizeof(uint8x16_t);
+        uint64x2_t wide = vpaddlq_u32(acc);
+        sum += vgetq_lane_u64(wide, 0) + vgetq_lane_u64(wide, 1);
+    }
+    return sum + ChecksumScalar(bytes, count);
+}
+#endif
+
+bool HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernel_e kernel) {
+    switch (kernel) {
+        case HyphaIpChecksumKernelScalar:
+            return true;
+#if defined(HYPHA_IP_CHECKSUM_SSE2)
+        case HyphaIpChecksumKernelSSE2:
+            return true;
+#endif
+#if defined(HYPHA_IP_CHECKSUM_AVX2)
+        case HyphaIpChecksumKernelAVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#if defined(HYPHA_IP_CHECKSUM_NEON)
+        case HyphaIpChecksumKernelNEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+HyphaIpChecksumKernel_e HyphaIpChecksumSelectKernel(void) {
+    if (HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernelAVX2)) {
+        return HyphaIpChecksumKernelAVX2;
+    }
+    if (HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernelSSE2)) {
+        return HyphaIpChecksumKernelSSE2;
+    }
+    if (HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernelNEON)) {
+        return HyphaIpChecksumKernelNEON;
+    }
+    return HyphaIpChecksumKernelScalar;
+}
+
+uint16_t HyphaIpChecksumBytes(HyphaIpChecksumKernel_e kernel, void const *bytes, size_t count) {
+    if (bytes == nullptr || count == 0U) {
+        return 0U;
+    }
+    uint8_t const *data = (uint8_t const *)bytes;
+    uint64_t sum = 0U;
+    switch (kernel) {
+#if defined(HYPHA_IP_CHECKSUM_SSE2)
+        case HyphaIpChecksumKernelSSE2:
+            sum = ChecksumSSE2(data, count);
+            break;
+#endif
+#if defined(HYPHA_IP_CHECKSUM_AVX2)
+        case HyphaIpChecksumKernelAVX2:
+            sum = ChecksumAVX2(data, count);
+            break;
+#endif
+#if defined(HYPHA_IP_CHECKSUM_NEON)
+        case HyphaIpChecksumKernelNEON:
+            sum = ChecksumNEON(data, count);
+            break;
+#endif
+        default:
+            sum = ChecksumScalar(data, count);
+            break;
+    }
+    return ChecksumFold(sum);
+}
+
 uint16_t HyphaIpComputeChecksum(HyphaIpSpan_t header_span, HyphaIpSpan_t payload_span) {
-    // TODO check types, must be uint8_t or uint16_t
-    // TODO support byte payload data (odd lengths) if so, have to be uint8_ts
-    // TODO then remove debug prints
-    // printf("Header " PRIuSpan " Payload " PRIuSpan "\r\n", header_span.pointer, header_span.count, header_span.type,
-    //        payload_span.pointer, payload_span.count, payload_span.type);
-    uint16_t *header = (uint16_t *)header_span.pointer;
-    uint16_t *payload = (uint16_t *)payload_span.pointer;
-    uint32_t sum = 0U;
-    uint16_t lss = 0U;  // least significant short
-    uint16_t mss = 0U;  // most significant short
-    for (size_t i = 0U; i < header_span.count; i++) {
-        // printf("sum=%08x += %04x\r\n", sum, header[i]);
-        sum += header[i];
-        // printf("sum=%08x\r\n", sum);
-    }
-    for (size_t i = 0U; i < payload_span.count; i++) {
-        // printf("sum=%08x += %04x\r\n", sum, payload[i]);
-        sum += payload[i];
-        // printf("sum=%08x\r\n", sum);
-    }
-    // printf("intermediate sum=%08x\r\n", sum);
-    // perform the overflow reduction
-    do {
-        lss = (sum & 0x0000FFFFU) >> 0u;
-        mss = (sum & 0xFFFF0000U) >> 16u;
-        // printf("MSS=%04x LSS=%04X\r\n", mss, lss);
-        sum = lss + mss;
-        // printf("Added Sum=%08x\r\n", sum);
-    } while (mss > 0);  // while it overflows, repeat
-    lss = (sum & 0x0000FFFFU) >> 0;
-    // printf("result = %04x\r\n", lss);
-    return lss;
+    size_t header_bytes = HyphaIpSpanSize(header_span);
+    size_t payload_bytes = HyphaIpSpanSize(payload_span);
+    HyphaIpChecksumKernel_e kernel = HyphaIpChecksumKernelScalar;
+    if ((header_bytes + payload_bytes) >= HYPHA_IP_CHECKSUM_SIMD_MINIMUM) {
+        kernel = HyphaIpChecksumSelectKernel();
+    }
+    uint16_t header_sum = HyphaIpChecksumBytes(kernel, header_span.pointer, header_bytes);
+    uint16_t payload_sum = HyphaIpChecksumBytes(kernel, payload_span.pointer, payload_bytes);
+    if ((header_bytes % sizeof(uint16_t)) != 0U) {
+        // the payload starts on an odd byte of the combined run, so its words are byte swapped (RFC 1071 2.(B))
+        payload_sum = __builtin_bswap16(payload_sum);
+    }
+    return HyphaIpChecksumAdd(header_sum, payload_sum);
+}
+
+uint16_t HyphaIpChecksumCached(HyphaIpChecksumCache_t *cache, size_t count, uint16_t const words[count]) {
+    if (!cache->valid) {
+        cache->checksum = (uint16_t)~HyphaIpChecksumBytes(HyphaIpChecksumKernelScalar, words, count * sizeof(uint16_t));
+        cache->valid = true;
+    } else {
+        for (size_t i = 0U; i < count; i++) {
+            if (words[i] != cache->words[i]) {
+                cache->checksum = HyphaIpChecksumUpdate16(cache->checksum, cache->words[i], words[i]);
+            }
+        }
+    }
+    memcpy(cache->words, words, count * sizeof(uint16_t));
+    return cache->checksum;
 }
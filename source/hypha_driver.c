@@ -0,0 +1,246 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The boundary between the Hypha IP stack and the client's Ethernet driver. All frames are acquired, transmitted
+/// and released through here so the batch interfaces can be used when the driver supplies them.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+/// Releases a single frame immediately and counts the result.
+static HyphaIpStatus_e HyphaIpDriverReleaseNow(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame) {
+    HyphaIpStatus_e status = context->external.release(context->theirs, frame);
+    HYPHA_IP_REPORT(context, status);
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.frames.releases++;
+    } else {
+        context->statistics.frames.failures++;
+    }
+    return status;
+}
+
+/// Checks that a frame from the driver can hold `capacity` bytes and gets it ready for use.
+/// @return The frame, or nullptr when there was none or it was too small, which is given straight back
+static HyphaIpEthernetFrame_t *HyphaIpDriverAccept(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                                   size_t capacity) {
+    if (frame == nullptr) {
+        context->statistics.frames.failures++;
+        HYPHA_IP_REPORT(context, HyphaIpStatusOutOfMemory);
+        return nullptr;
+    }
+    context->statistics.frames.acquires++;
+    if (frame->info.capacity < capacity) {
+        context->statistics.frames.failures++;
+        HYPHA_IP_REPORT(context, HyphaIpStatusInvalidFrameLength);
+        (void)HyphaIpDriverReleaseNow(context, frame);
+        return nullptr;
+    }
+    frame->info.flags = HyphaIpFrameFlagNone;
+    frame->info.length = 0U;
+    frame->info.interface = 0U;
+    return frame;
+}
+
+HyphaIpEthernetFrame_t *HyphaIpDriverAcquire(HyphaIpContext_t context) {
+    return HyphaIpDriverAcquireSized(context, HYPHA_IP_FRAME_CAPACITY);
+}
+
+static HyphaIpStatus_e HyphaIpDriverFlush(HyphaIpContext_t context);
+
+/// Asks the driver for a single frame, without counting it.
+static HyphaIpEthernetFrame_t *HyphaIpDriverAsk(HyphaIpContext_t context, size_t capacity) {
+    if (context->external.acquire_sized != nullptr) {
+        return context->external.acquire_sized(context->theirs, capacity);
+    }
+    return context->external.acquire(context->theirs);
+}
+
+HyphaIpEthernetFrame_t *HyphaIpDriverAcquireSized(HyphaIpContext_t context, size_t capacity) {
+    HyphaIpEthernetFrame_t *frame = HyphaIpDriverAsk(context, capacity);
+    HyphaIpFrameBurst_t *burst = &context->burst;
+    if (frame == nullptr && (burst->transmits > 0U || burst->releases > 0U)) {
+        // the frames the burst holds may be all the driver has, so they go back to it before asking again
+        HyphaIpStatus_e flushed = HyphaIpDriverFlush(context);
+        burst->status = HyphaIpIsFailure(burst->status) ? burst->status : flushed;
+        frame = HyphaIpDriverAsk(context, capacity);
+    }
+    return HyphaIpDriverAccept(context, frame, capacity);
+}
+
+size_t HyphaIpDriverAcquireBatch(HyphaIpContext_t context, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    size_t acquired = 0U;
+    if (context->external.acquire_batch != nullptr) {
+        size_t given = context->external.acquire_batch(context->theirs, count, frames);
+        given = (given < count) ? given : count;
+        for (size_t i = 0U; i < given; i++) {
+            // a frame which is too small is given back and the rest are kept in order
+            frames[acquired] = HyphaIpDriverAccept(context, frames[i], HYPHA_IP_FRAME_CAPACITY);
+            acquired += (frames[acquired] != nullptr) ? 1U : 0U;
+        }
+        // every frame the driver could not give is a failed acquire, as it would be one at a time
+        context->statistics.frames.failures += count - given;
+    } else {
+        for (; acquired < count; acquired++) {
+            frames[acquired] = HyphaIpDriverAcquire(context);
+            if (frames[acquired] == nullptr) {
+                break;
+            }
+        }
+    }
+    return acquired;
+}
+
+HyphaIpStatus_e HyphaIpDriverReleaseBatch(HyphaIpContext_t context, size_t count,
+                                          HyphaIpEthernetFrame_t *frames[count]) {
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (count == 0U) {
+        return status;
+    }
+    if (context->external.release_batch != nullptr) {
+        status = context->external.release_batch(context->theirs, count, frames);
+        HYPHA_IP_REPORT(context, status);
+        if (HyphaIpIsSuccess(status)) {
+            context->statistics.frames.releases += count;
+        } else {
+            context->statistics.frames.failures += count;
+        }
+    } else {
+        for (size_t i = 0U; i < count; i++) {
+            HyphaIpStatus_e released = HyphaIpDriverReleaseNow(context, frames[i]);
+            if (HyphaIpIsFailure(released)) {
+                status = released;
+            }
+        }
+    }
+    return status;
+}
+
+size_t HyphaIpDriverReceiveBatch(HyphaIpContext_t context, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    count = (count < HYPHA_IP_BATCH_SIZE) ? count : HYPHA_IP_BATCH_SIZE;
+    size_t received = 0U;
+    if (context->external.receive_batch != nullptr) {
+        size_t acquired = HyphaIpDriverAcquireBatch(context, count, frames);
+        if (acquired > 0U) {
+            received = context->external.receive_batch(context->theirs, acquired, frames);
+            received = (received < acquired) ? received : acquired;
+        }
+        // give back what the driver could not fill
+        (void)HyphaIpDriverReleaseBatch(context, acquired - received, &frames[received]);
+    } else {
+        for (; received < count; received++) {
+            HyphaIpEthernetFrame_t *frame = HyphaIpDriverAcquire(context);
+            if (frame == nullptr) {
+                break;
+            }
+            if (HyphaIpIsFailure(context->external.receive(context->theirs, frame))) {
+                // the driver has run dry, this is the normal end of a batch
+                (void)HyphaIpDriverReleaseNow(context, frame);
+                break;
+            }
+            frames[received] = frame;
+        }
+    }
+    return received;
+}
+
+/// Counts a frame once the driver has said whether it took it
+static void HyphaIpDriverCountTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame, bool sent) {
+    if (!sent) {
+        context->statistics.mac.rejected++;
+        return;
+    }
+    HyphaIpDirectionalThroughput_t *tx = &context->statistics.interfaces[frame->info.interface].frames.tx;
+    tx->count++;
+    tx->bytes += frame->info.length;
+    context->statistics.counter.mac.tx.count++;
+    context->statistics.counter.mac.tx.bytes += frame->info.length;
+    context->statistics.mac.accepted++;
+}
+
+/// Transmits `count` frames, with a single call if the driver allows it, and counts each one.
+/// @return The number of frames which the driver accepted.
+static size_t HyphaIpDriverTransmitBatch(HyphaIpContext_t context, size_t count,
+                                         HyphaIpEthernetFrame_t *frames[count]) {
+    size_t sent = 0U;
+    if (context->external.transmit_batch != nullptr) {
+        sent = context->external.transmit_batch(context->theirs, count, frames);
+        sent = (sent < count) ? sent : count;
+        for (size_t i = 0U; i < count; i++) {
+            HyphaIpDriverCountTransmit(context, frames[i], i < sent);
+        }
+    } else {
+        for (size_t i = 0U; i < count; i++) {
+            HyphaIpStatus_e status = context->external.transmit(context->theirs, frames[i]);
+            HYPHA_IP_REPORT(context, status);
+            HyphaIpDriverCountTransmit(context, frames[i], HyphaIpIsSuccess(status));
+            sent += HyphaIpIsSuccess(status) ? 1U : 0U;
+        }
+    }
+    return sent;
+}
+
+/// Hands everything held in the burst to the driver. Transmits go first so every held release is safe.
+static HyphaIpStatus_e HyphaIpDriverFlush(HyphaIpContext_t context) {
+    HyphaIpFrameBurst_t *burst = &context->burst;
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (burst->transmits > 0U) {
+        size_t sent = HyphaIpDriverTransmitBatch(context, burst->transmits, burst->transmit);
+        if (sent < burst->transmits) {
+            status = HyphaIpStatusFailure;
+            HYPHA_IP_REPORT(context, status);
+        }
+        burst->transmits = 0U;
+    }
+    HyphaIpStatus_e released = HyphaIpDriverReleaseBatch(context, burst->releases, burst->release);
+    burst->releases = 0U;
+    return HyphaIpIsSuccess(status) ? released : status;
+}
+
+HyphaIpStatus_e HyphaIpDriverTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame) {
+    HyphaIpFrameBurst_t *burst = &context->burst;
+    if (burst->depth == 0U) {
+        HyphaIpStatus_e status = context->external.transmit(context->theirs, frame);
+        HyphaIpDriverCountTransmit(context, frame, HyphaIpIsSuccess(status));
+        return status;
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (burst->transmits == HYPHA_IP_BATCH_SIZE) {
+        status = HyphaIpDriverFlush(context);
+    }
+    burst->transmit[burst->transmits++] = frame;
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpDriverRelease(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame) {
+    HyphaIpFrameBurst_t *burst = &context->burst;
+    if (burst->depth == 0U) {
+        return HyphaIpDriverReleaseNow(context, frame);
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (burst->releases == HYPHA_IP_BATCH_SIZE) {
+        status = HyphaIpDriverFlush(context);
+    }
+    burst->release[burst->releases++] = frame;
+    return status;
+}
+
+void HyphaIpDriverBurstBegin(HyphaIpContext_t context) {
+    // a burst only pays off when the driver can take the frames in one call
+    if (context->external.transmit_batch != nullptr || context->external.release_batch != nullptr) {
+        context->burst.depth++;
+    }
+}
+
+HyphaIpStatus_e HyphaIpDriverBurstEnd(HyphaIpContext_t context) {
+    HyphaIpFrameBurst_t *burst = &context->burst;
+    if (burst->depth == 0U) {
+        return HyphaIpStatusOk;
+    }
+    burst->depth--;
+    if (burst->depth > 0U) {
+        return HyphaIpStatusOk;  // an outer burst will flush
+    }
+    HyphaIpStatus_e status = HyphaIpDriverFlush(context);
+    status = HyphaIpIsFailure(burst->status) ? burst->status : status;
+    burst->status = HyphaIpStatusOk;
+    return status;
+}
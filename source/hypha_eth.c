@@ -25,8 +25,13 @@ bool HyphaIpIsOurEthernetAddress(HyphaIpContext_t context, HyphaIpEthernetAddres
     if (context == nullptr) {
         return false;
     }
-    // check if the mac is the same as our interface mac
-    return HyphaIpIsSameEthernetAddress(context->interface.mac, mac);
+    // check if the mac is the same as any of our interface macs
+    for (size_t i = 0U; i < context->interface_count; i++) {
+        if (HyphaIpIsSameEthernetAddress(context->interfaces[i].mac, mac)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool HyphaIpIsLocalBroadcastEthernetAddress(HyphaIpEthernetAddress_t mac) {
@@ -38,6 +43,105 @@ bool HyphaIpIsLocalEthernetAddress(HyphaIpEthernetAddress_t mac) {
 }
 
 #if (HYPHA_IP_USE_MAC_FILTER == 1)
+/// @return The low 23 bits of an IPv4 multicast MAC address, which carry the group
+static inline uint32_t HyphaIpMulticastGroup(HyphaIpEthernetAddress_t mac) {
+    return ((uint32_t)(mac.uid[0] & 0x7FU) << 16U) | ((uint32_t)mac.uid[1] << 8U) | (uint32_t)mac.uid[2];
+}
+
+/// @return The bit of the multicast filter's bitmap for the group
+static inline uint32_t HyphaIpMulticastBit(uint32_t group) {
+    // Fibonacci hashing keeps runs of groups (like consecutive subjects) on separate bits
+    return (group * 0x9E37'79B1U) >> (32U - (uint32_t)__builtin_ctz(HYPHA_IP_MULTICAST_FILTER_BITS));
+}
+
+/// @return The position of the first group which is not less than the given one
+static size_t HyphaIpMulticastFilterFind(HyphaIpMulticastFilter_t const *filter, uint32_t group) {
+    size_t low = 0U;
+    size_t high = filter->count;
+    while (low < high) {
+        size_t middle = low + ((high - low) / 2U);
+        if (filter->groups[middle] < group) {
+            low = middle + 1U;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/// Sets the bit of the group in the multicast filter's bitmap
+static inline void HyphaIpMulticastFilterSet(HyphaIpMulticastFilter_t *filter, uint32_t group) {
+    uint32_t bit = HyphaIpMulticastBit(group);
+    filter->bits[bit / 64U] |= (UINT64_C(1) << (bit % 64U));
+}
+
+/// @return True if a joined group has this IPv4 multicast MAC address
+static bool HyphaIpMulticastFilterMatch(HyphaIpContext_t context, HyphaIpMulticastFilter_t const *filter,
+                                        HyphaIpEthernetAddress_t mac) {
+    uint32_t group = HyphaIpMulticastGroup(mac);
+    uint32_t bit = HyphaIpMulticastBit(group);
+    if ((filter->bits[bit / 64U] & (UINT64_C(1) << (bit % 64U))) == 0U) {
+        context->statistics.multicast.rejected++;
+        return false;  // no joined group hashes here, the usual answer for the groups nobody wants
+    }
+    size_t index = HyphaIpMulticastFilterFind(filter, group);
+    if (index < filter->count && filter->groups[index] == group) {
+        context->statistics.multicast.matches++;
+        return true;
+    }
+    context->statistics.multicast.collisions++;
+    return false;
+}
+
+HyphaIpStatus_e HyphaIpMulticastFilterAdd(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac) {
+    if (!HyphaIpIsIPv4MulticastEthernetAddress(mac)) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpMulticastFilter_t *filter = &HyphaIpTablesDraft(context, HyphaIpTableMulticastFilter)->multicast_filter;
+    uint32_t group = HyphaIpMulticastGroup(mac);
+    size_t index = HyphaIpMulticastFilterFind(filter, group);
+    if (index < filter->count && filter->groups[index] == group) {
+        return HyphaIpStatusOk;  // already let through
+    }
+    if (filter->count == HYPHA_IP_DIMOF(filter->groups)) {
+        return HyphaIpStatusEthernetFilterTableFull;
+    }
+    memmove(&filter->groups[index + 1U], &filter->groups[index], (filter->count - index) * sizeof(uint32_t));
+    filter->groups[index] = group;
+    filter->count++;
+    HyphaIpMulticastFilterSet(filter, group);
+    return HyphaIpStatusOk;
+}
+
+bool HyphaIpMulticastFilterHas(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac) {
+    HyphaIpMulticastFilter_t const *filter = &HyphaIpTablesPeek(context, HyphaIpTableMulticastFilter)->multicast_filter;
+    uint32_t group = HyphaIpMulticastGroup(mac);
+    size_t index = HyphaIpMulticastFilterFind(filter, group);
+    return HyphaIpIsIPv4MulticastEthernetAddress(mac) && index < filter->count && filter->groups[index] == group;
+}
+
+void HyphaIpMulticastFilterRemove(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac) {
+    if (!HyphaIpIsIPv4MulticastEthernetAddress(mac)) {
+        return;
+    }
+    HyphaIpMulticastFilter_t *filter = &HyphaIpTablesDraft(context, HyphaIpTableMulticastFilter)->multicast_filter;
+    uint32_t group = HyphaIpMulticastGroup(mac);
+    size_t index = HyphaIpMulticastFilterFind(filter, group);
+    if (index == filter->count || filter->groups[index] != group) {
+        return;
+    }
+    filter->count--;
+    memmove(&filter->groups[index], &filter->groups[index + 1U], (filter->count - index) * sizeof(uint32_t));
+    // the bit stays set while another group which is left hashes to it, the rest of the bitmap is untouched
+    uint32_t bit = HyphaIpMulticastBit(group);
+    for (size_t i = 0U; i < filter->count; i++) {
+        if (HyphaIpMulticastBit(filter->groups[i]) == bit) {
+            return;
+        }
+    }
+    filter->bits[bit / 64U] &= ~(UINT64_C(1) << (bit % 64U));
+}
+
 bool HyphaIpIsPermittedEthernetAddress(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac) {
     if (context == nullptr) {
         return false;  // if there is no context, we cannot do anything
@@ -58,15 +162,20 @@ bool HyphaIpIsPermittedEthernetAddress(HyphaIpContext_t context, HyphaIpEthernet
     if (context->features.allow_mac_filtering == false) {
         return true;  // if MAC filtering is not enabled, allow any addresses
     }
-    // TODO improve the algorithm here. at first we'll just use the brute force approach to prove correctness of the
-    // stack but this should be replaced with a AVL style tree.
-    for (size_t i = 0U; i < HYPHA_IP_DIMOF(context->allowed_ethernet_addresses); i++) {
-        HyphaIpEthernetFilter_t *filter = &context->allowed_ethernet_addresses[i];
-        if (filter->valid && HyphaIpIsSameEthernetAddress(filter->mac, mac)) {
-            return true;
+    HyphaIpTables_t const *tables = HyphaIpTablesReadBegin(context);
+    bool permitted = false;
+    if (HyphaIpIsIPv4MulticastEthernetAddress(mac)) {
+        // there could be thousands of groups, so these never go through the table
+        permitted = HyphaIpMulticastFilterMatch(context, &tables->multicast_filter, mac);
+    } else {
+        // the table only holds the few unicast (and non IPv4 multicast) addresses, a scan is fine
+        for (size_t i = 0U; i < HYPHA_IP_DIMOF(tables->allowed_ethernet_addresses) && !permitted; i++) {
+            HyphaIpEthernetFilter_t const *filter = &tables->allowed_ethernet_addresses[i];
+            permitted = filter->valid && HyphaIpIsSameEthernetAddress(filter->mac, mac);
         }
     }
-    return false;
+    HyphaIpTablesReadEnd(context);
+    return permitted;
 }
 
 HyphaIpStatus_e HyphaIpPopulateEthernetFilter(HyphaIpContext_t context, size_t len,
@@ -77,32 +186,73 @@ HyphaIpStatus_e HyphaIpPopulateEthernetFilter(HyphaIpContext_t context, size_t l
     if (filters == nullptr || len == 0U) {
         return HyphaIpStatusInvalidArgument;
     }
-    // how many are free in the filter table?
+    HyphaIpTablesLock(context);
+    HyphaIpTables_t *tables =
+        HyphaIpTablesDraft(context, (HyphaIpTable_e)(HyphaIpTableEthernetFilter | HyphaIpTableMulticastFilter));
+    // how many are free in the filter table and the multicast filter?
     size_t free = 0U;
-    for (size_t i = 0U; i < HYPHA_IP_DIMOF(context->allowed_ethernet_addresses); i++) {
-        if (context->allowed_ethernet_addresses[i].valid == false) {
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(tables->allowed_ethernet_addresses); i++) {
+        if (tables->allowed_ethernet_addresses[i].valid == false) {
             free++;
         }
     }
-    if (len > free) {
+    size_t groups = 0U;
+    for (size_t index = 0U; index < len; index++) {
+        groups += HyphaIpIsIPv4MulticastEthernetAddress(filters[index]) ? 1U : 0U;
+    }
+    size_t free_groups = HYPHA_IP_DIMOF(tables->multicast_filter.groups) - tables->multicast_filter.count;
+    if ((len - groups) > free || groups > free_groups) {
+        HyphaIpTablesUnlock(context);
         return HyphaIpStatusEthernetFilterTableFull;
     }
-    context->features.allow_mac_filtering = true;  // enable the MAC filter
-    size_t index = 0U;
+    size_t i = 0U;
     HyphaIpTimestamp_t now = context->external.get_monotonic_timestamp(context->theirs);
-    for (size_t i = 0U; i < HYPHA_IP_DIMOF(context->allowed_ethernet_addresses) && index < len; i++) {
+    for (size_t index = 0U; index < len; index++) {
+        if (HyphaIpIsIPv4MulticastEthernetAddress(filters[index])) {
+            (void)HyphaIpMulticastFilterAdd(context, filters[index]);  // the room was checked above
+            continue;
+        }
         // TODO check is the filter is already in the table first
-        if (context->allowed_ethernet_addresses[i].valid == false) {
-            context->allowed_ethernet_addresses[i].valid = true;
-            context->allowed_ethernet_addresses[i].expiration =
-                now + HYPHA_IP_EXPIRATION_TIME;  // set the expiration time
-            memcpy(&context->allowed_ethernet_addresses[i].mac, &filters[index],
-                   sizeof(HyphaIpEthernetAddress_t));  // copy the filter
-            index++;
+        while (tables->allowed_ethernet_addresses[i].valid) {
+            i++;
         }
+        HyphaIpEthernetFilter_t *filter = &tables->allowed_ethernet_addresses[i];
+        filter->valid = true;
+        filter->expiration = now + HYPHA_IP_EXPIRATION_TIME;                      // set the expiration time
+        memcpy(&filter->mac, &filters[index], sizeof(HyphaIpEthernetAddress_t));  // copy the filter
     }
+    tables->populated++;  // the owner starts the timers
+    HyphaIpTablesUnlock(context);
+    // the filter is only turned on once what it lets through has been published
+    atomic_store_explicit(&context->features.allow_mac_filtering, true, memory_order_release);
     return HyphaIpStatusOk;
 }
+
+void HyphaIpEthernetFilterExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline) {
+    HyphaIpEthernetFilter_t const *filter =
+        &HyphaIpTablesPeek(context, HyphaIpTableEthernetFilter)->allowed_ethernet_addresses[key];
+    if (filter->valid && filter->expiration > deadline) {
+        // populated again since the timers last caught up with the tables
+        (void)HyphaIpTimerAge(context, HyphaIpTimerKindEthernetFilter, key, filter->expiration);
+    } else if (filter->valid) {
+        HyphaIpTablesDraft(context, HyphaIpTableEthernetFilter)->allowed_ethernet_addresses[key].valid = false;
+        context->statistics.expirations.ethernet++;
+    }
+}
+
+HyphaIpStatus_e HyphaIpEthernetFilterAge(HyphaIpContext_t context, HyphaIpTables_t const *tables) {
+    HyphaIpStatus_e result = HyphaIpStatusOk;
+    // the entries stay where they are, so the index finds the entry again
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(tables->allowed_ethernet_addresses); i++) {
+        HyphaIpEthernetFilter_t const *filter = &tables->allowed_ethernet_addresses[i];
+        if (filter->valid) {
+            HyphaIpStatus_e status =
+                HyphaIpTimerAge(context, HyphaIpTimerKindEthernetFilter, (uint32_t)i, filter->expiration);
+            result = HyphaIpIsFailure(status) ? status : result;
+        }
+    }
+    return result;
+}
 #endif  // HYPHA_IP_USE_MAC_FILTER
 
 bool HyphaIpConvertMulticast(HyphaIpEthernetAddress_t *mac, HyphaIpIPv4Address_t ip) {
@@ -126,68 +276,89 @@ HyphaIpStatus_e HyphaIpPopulateArpTable(HyphaIpContext_t context, size_t len, Hy
     if (matches == nullptr || len == 0U) {
         return HyphaIpStatusInvalidArgument;
     }
-    // how many are free in the arp_cache?
-    size_t free = 0U;
-    for (size_t i = 0U; i < HYPHA_IP_DIMOF(context->arp_cache); i++) {
-        if (context->arp_cache[i].valid == false) {
-            free++;
-        }
-    }
-    if (len > free) {
+    HyphaIpTablesLock(context);
+    HyphaIpArpCache_t const *cache = &HyphaIpTablesPeek(context, HyphaIpTableArpCache)->arp_cache;
+    // the entries are packed, so the free ones are all at the end
+    if (len > (HYPHA_IP_DIMOF(cache->entries) - cache->count)) {
+        HyphaIpTablesUnlock(context);
         return HyphaIpStatusArpTableFull;
     }
-    context->features.allow_arp_cache = true;  // enable the ARP cache
-    size_t index = 0U;
     HyphaIpTimestamp_t now = context->external.get_monotonic_timestamp(context->theirs);
-    for (size_t i = 0U; i < HYPHA_IP_DIMOF(context->arp_cache) && index < len; i++) {
-        if (context->arp_cache[i].valid == false) {
-            context->arp_cache[i].valid = true;
-            context->arp_cache[i].expiration = now + HYPHA_IP_EXPIRATION_TIME;  // set the expiration time
-            memcpy(&context->arp_cache[i].match, &matches[index], sizeof(HyphaIpAddressMatch_t));
-            index++;
-            context->statistics.arp.additions++;
-        }
+    for (size_t i = 0U; i < len; i++) {
+        // an address which is already known is updated in place
+        (void)HyphaIpArpCacheInsert(context, &matches[i], now + HYPHA_IP_EXPIRATION_TIME);
     }
+    // the owner thread starts the timers and sends any transmits waiting for these on its next tick
+    HyphaIpTablesDraft(context, HyphaIpTableNone)->populated++;
+    HyphaIpTablesUnlock(context);
+    atomic_store_explicit(&context->features.allow_arp_cache, true, memory_order_release);
     return HyphaIpStatusOk;
 }
 
 HyphaIpIPv4Address_t HyphaIpFindIPv4Address(HyphaIpContext_t context, HyphaIpEthernetAddress_t *mac) {
-    for (size_t i = 0U; context->features.allow_arp_cache && i < HYPHA_IP_DIMOF(context->arp_cache); i++) {
-        HyphaIpARPEntry_t *entry = &context->arp_cache[i];
-        if (entry->valid && HyphaIpIsSameEthernetAddress(entry->match.mac, *mac)) {
+    HyphaIpIPv4Address_t ipv4 = hypha_ip_default_route;
+    if (context->features.allow_arp_cache) {
+        HyphaIpARPEntry_t const *entry = HyphaIpArpCacheFindByMac(&HyphaIpTablesReadBegin(context)->arp_cache, *mac);
+        if (entry != nullptr) {
             context->statistics.arp.lookups++;
-            return context->arp_cache[i].match.ipv4;
+            ipv4 = entry->match.ipv4;
         }
+        HyphaIpTablesReadEnd(context);
     }
-    return hypha_ip_default_route;
+    return ipv4;
 }
 
 HyphaIpEthernetAddress_t HyphaIpFindEthernetAddress(HyphaIpContext_t context, HyphaIpIPv4Address_t *ipv4) {
-    for (size_t i = 0U; context->features.allow_arp_cache && i < HYPHA_IP_DIMOF(context->arp_cache); i++) {
-        HyphaIpARPEntry_t *entry = &context->arp_cache[i];
-
-        if (entry->valid && memcmp(&entry->match.ipv4, ipv4, sizeof(HyphaIpIPv4Address_t)) == 0) {
+    HyphaIpEthernetAddress_t mac = hypha_ip_ethernet_local;
+    if (context->features.allow_arp_cache) {
+        HyphaIpARPEntry_t const *entry = HyphaIpArpCacheFindByIPv4(&HyphaIpTablesReadBegin(context)->arp_cache, *ipv4);
+        if (entry != nullptr) {
             context->statistics.arp.lookups++;
-            return context->arp_cache[i].match.mac;
+            mac = entry->match.mac;
         }
+        HyphaIpTablesReadEnd(context);
     }
-    return hypha_ip_ethernet_local;
+    return mac;
 }
 #endif  // HYPHA_IP_USE_ARP_CACHE
 
-HyphaIpStatus_e HyphaIpEthernetTransmitFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
-                                             HyphaIpMetaData_t *metadata, HyphaIpEtherType_e ether_type,
-                                             size_t payload_length) {
-    if (context == nullptr) {
-        return HyphaIpStatusInvalidContext;
+/// Finds the Ethernet Address of an IPv4 destination (or the next hop towards it) on an interface
+/// @return False when the destination is a unicast one the ARP cache does not know (yet)
+static bool HyphaIpEthernetResolve(HyphaIpContext_t context, uint8_t interface, HyphaIpIPv4Address_t destination,
+                                   HyphaIpEthernetAddress_t *mac) {
+    if (HyphaIpConvertMulticast(mac, destination)) {
+        return true;  // this was a multicast, nothing else to do
     }
-    if (frame == nullptr || metadata == nullptr) {
-        HYPHA_IP_REPORT(context, HyphaIpStatusInvalidArgument);
-        return HyphaIpStatusInvalidArgument;
+    uint32_t host_mask = ~HyphaIpIPv4AddressToValue(context->interfaces[interface].netmask);
+    bool directed_broadcast = (host_mask != 0U) && HyphaIpIsInOurNetwork(context, interface, destination) &&
+                              ((HyphaIpIPv4AddressToValue(destination) & host_mask) == host_mask);
+    if (HyphaIpIsLimitedBroadcastIPv4Address(destination) || directed_broadcast) {
+        *mac = hypha_ip_ethernet_broadcast;
+        return true;
+    }
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    if (context->features.allow_arp_cache) {
+        // it may be a local address, so lookup in the ARP cache
+        HyphaIpARPEntry_t const *entry =
+            HyphaIpArpCacheFindByIPv4(&HyphaIpTablesReadBegin(context)->arp_cache, destination);
+        bool known = (entry != nullptr);
+        if (known) {
+            context->statistics.arp.lookups++;
+            *mac = entry->match.mac;
+        }
+        HyphaIpTablesReadEnd(context);
+        return known;
     }
+#endif
+    *mac = hypha_ip_ethernet_local;  // with no way to resolve it, there is nothing to wait for
+    return true;
+}
+
+HyphaIpEthernetHeader_t HyphaIpEthernetBaseHeader(HyphaIpContext_t context, uint8_t interface,
+                                                  HyphaIpEtherType_e ether_type) {
     HyphaIpEthernetHeader_t ethernet_header = {
         .destination = hypha_ip_ethernet_broadcast,  // default to a broadcast incase we can't resolve it
-        .source = context->interface.mac,
+        .source = context->interfaces[interface].mac,
 #if (HYPHA_IP_USE_VLAN == 1)
         .tpid = HyphaIpEtherType_VLAN,  // VLAN tag
         .priority = 0,                  // default priority
@@ -196,13 +367,29 @@ HyphaIpStatus_e HyphaIpEthernetTransmitFrame(HyphaIpContext_t context, HyphaIpEt
 #endif
         .type = ether_type,
     };
+    return ethernet_header;
+}
+
+HyphaIpEthernetHeader_t HyphaIpEthernetMakeHeader(HyphaIpContext_t context, uint8_t interface,
+                                                  HyphaIpIPv4Address_t destination, HyphaIpEtherType_e ether_type) {
+    HyphaIpEthernetHeader_t ethernet_header = HyphaIpEthernetBaseHeader(context, interface, ether_type);
     // find the ethernet mac to send to
-    if (HyphaIpConvertMulticast(&ethernet_header.destination, metadata->destination_address)) {
-        // this was a multicast, nothing else to do
-    } else {
-        // it may be a local address, so lookup in the ARP cache
-        ethernet_header.destination = HyphaIpFindEthernetAddress(context, &metadata->destination_address);
+    (void)HyphaIpEthernetResolve(context, interface, destination, &ethernet_header.destination);
+    return ethernet_header;
+}
+
+HyphaIpStatus_e HyphaIpEthernetTransmitFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                             HyphaIpMetaData_t *metadata, HyphaIpIPv4Address_t next_hop,
+                                             HyphaIpEtherType_e ether_type, size_t payload_length) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
     }
+    if (frame == nullptr || metadata == nullptr) {
+        HYPHA_IP_REPORT(context, HyphaIpStatusInvalidArgument);
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpEthernetHeader_t ethernet_header = HyphaIpEthernetBaseHeader(context, frame->info.interface, ether_type);
+    bool resolved = HyphaIpEthernetResolve(context, frame->info.interface, next_hop, &ethernet_header.destination);
 
     // if debug, print the header
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "Transmitting Ethernet Frame %p:\r\n", frame);
@@ -219,86 +406,112 @@ HyphaIpStatus_e HyphaIpEthernetTransmitFrame(HyphaIpContext_t context, HyphaIpEt
     // copy-flip each header into the right place
     HyphaIpCopyEthernetHeaderToFrame(frame, &ethernet_header);
 
-    // transmit
-    HyphaIpStatus_e status = context->external.transmit(context->theirs, frame);
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    if (!resolved) {
+        // the frame waits for the ARP reply instead of going to nobody, the timestamp is left as it was
+        frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + payload_length);
+        HyphaIpStatus_e status = HyphaIpArpPendingAdd(context, frame, next_hop);
+        HYPHA_IP_REPORT(context, status);
+        return status;
+    }
+#else
+    (void)resolved;
+#endif
+    return HyphaIpEthernetSendFrame(context, frame, metadata, payload_length);
+}
+
+HyphaIpStatus_e HyphaIpEthernetSendFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                         HyphaIpMetaData_t *metadata, size_t payload_length) {
+    frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + payload_length);
+    HyphaIpStatus_e status = HyphaIpDriverTransmit(context, frame);
     HYPHA_IP_REPORT(context, status);
     if (HyphaIpIsSuccess(status)) {
-        // this is the closest timestamp for success
+        // this is the closest timestamp for success, within a burst it is when the frame was queued
         metadata->timestamp = context->external.get_monotonic_timestamp(context->theirs);
-        // if the transmission was successful, we can update the statistics
-        context->statistics.counter.mac.tx.count++;
-        context->statistics.counter.mac.tx.bytes += sizeof(ethernet_header) + payload_length;
-        context->statistics.mac.accepted++;
-    } else {
-        // if the transmission failed, we can update the statistics
-        context->statistics.mac.rejected++;
     }
-
     return status;
 }
 
-HyphaIpStatus_e HyphaIpEthernetReceiveFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame) {
+HyphaIpStatus_e HyphaIpEthernetReceiveFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                            HyphaIpTimestamp_t timestamp) {
     if (context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
     if (frame == nullptr) {
         return HyphaIpStatusInvalidArgument;
     }
-    HyphaIpTimestamp_t timestamp = context->external.get_monotonic_timestamp(context->theirs);
-    HyphaIpEthernetHeader_t ethernet_header;
     context->statistics.counter.mac.rx.count++;
+    // nothing past the length the driver received is parsed
+    size_t capacity = (frame->info.capacity < HYPHA_IP_FRAME_CAPACITY) ? frame->info.capacity : HYPHA_IP_FRAME_CAPACITY;
+    if (frame->info.length < sizeof(HyphaIpEthernetHeader_t) || frame->info.length > capacity) {
+        context->statistics.mac.rejected++;
+        HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerMAC,
+                       "Frame %p Length %u outside of Capacity %u\r\n", frame, frame->info.length,
+                       frame->info.capacity);
+        return HyphaIpStatusInvalidFrameLength;
+    }
+    if (frame->info.interface >= context->interface_count) {
+        context->statistics.mac.rejected++;
+        HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerMAC, "Frame %p on unknown Interface %u\r\n",
+                       frame, frame->info.interface);
+        return HyphaIpStatusInvalidArgument;
+    }
+    context->statistics.interfaces[frame->info.interface].frames.rx.count++;
+    context->statistics.interfaces[frame->info.interface].frames.rx.bytes += frame->info.length;
     context->statistics.counter.mac.rx.bytes += sizeof(HyphaIpEthernetHeader_t);
-    HyphaIpCopyEthernetHeaderFromFrame(&ethernet_header, frame);
+    // the header is read in place, nothing is copied out of the frame
+    HyphaIpEthernetAddress_t destination = HyphaIpPeekEthernetDestination(frame);
+    HyphaIpEthernetAddress_t source = HyphaIpPeekEthernetSource(frame);
+    uint16_t type = HyphaIpPeekEtherType(frame);
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "Receiving Ethernet Frame %p:\r\n", frame);
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "  Destination: " PRIuEthernetAddress "\r\n",
-                   ethernet_header.destination.oui[0], ethernet_header.destination.oui[1],
-                   ethernet_header.destination.oui[2], ethernet_header.destination.uid[0],
-                   ethernet_header.destination.uid[1], ethernet_header.destination.uid[2]);
+                   destination.oui[0], destination.oui[1], destination.oui[2], destination.uid[0], destination.uid[1],
+                   destination.uid[2]);
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "  Source: " PRIuEthernetAddress "\r\n",
-                   ethernet_header.source.oui[0], ethernet_header.source.oui[1], ethernet_header.source.oui[2],
-                   ethernet_header.source.uid[0], ethernet_header.source.uid[1], ethernet_header.source.uid[2]);
-    HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "  Type: %04X\r\n",
-                   (unsigned int)ethernet_header.type);
+                   source.oui[0], source.oui[1], source.oui[2], source.uid[0], source.uid[1], source.uid[2]);
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerMAC, "  Type: %04X\r\n", (unsigned int)type);
 
     // Ethernet Acceptance Rules
     // 1.) Is it destined for us, explicitly?
-    bool our_mac_address = HyphaIpIsOurEthernetAddress(context, ethernet_header.destination);
+    bool our_mac_address = HyphaIpIsOurEthernetAddress(context, destination);
     // 2.) Is it destined for a multicast address?
-    bool to_multicast_mac = HyphaIpIsMulticastEthernetAddress(ethernet_header.destination);
+    bool to_multicast_mac = HyphaIpIsMulticastEthernetAddress(destination);
     // 3.) Is it a broadcast?
-    bool to_broadcast_mac = HyphaIpIsLocalBroadcastEthernetAddress(ethernet_header.destination);
-    bool allowed_broadcast = context->features.allow_any_broadcast && to_broadcast_mac;
+    bool to_broadcast_mac = HyphaIpIsLocalBroadcastEthernetAddress(destination);
+    // ARP requests are always broadcast, so they get through whenever ARP is in use
+    bool arp_broadcast = to_broadcast_mac && context->features.allow_arp_cache && (type == HyphaIpEtherType_ARP);
+    bool allowed_broadcast = (context->features.allow_any_broadcast && to_broadcast_mac) || arp_broadcast;
     bool allowed_multicast_mac = context->features.allow_any_multicast && to_multicast_mac;
     // 4.) Is it a MAC address we allow?
-    bool allowed_mac = HyphaIpIsPermittedEthernetAddress(context, ethernet_header.destination);
+    bool allowed_mac = HyphaIpIsPermittedEthernetAddress(context, destination);
     if (!our_mac_address && !allowed_multicast_mac && !allowed_broadcast && !allowed_mac) {
         context->statistics.mac.rejected++;
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerMAC,
-                       "MAC Rejected " PRIuEthernetAddress " -> " PRIuEthernetAddress "\r\n",
-                       ethernet_header.source.oui[0], ethernet_header.source.oui[1], ethernet_header.source.oui[2],
-                       ethernet_header.source.uid[0], ethernet_header.source.uid[1], ethernet_header.source.uid[2],
-                       ethernet_header.destination.oui[0], ethernet_header.destination.oui[1],
-                       ethernet_header.destination.oui[2], ethernet_header.destination.uid[0],
-                       ethernet_header.destination.uid[1], ethernet_header.destination.uid[2]);
+                       "MAC Rejected " PRIuEthernetAddress " -> " PRIuEthernetAddress "\r\n", source.oui[0],
+                       source.oui[1], source.oui[2], source.uid[0], source.uid[1], source.uid[2], destination.oui[0],
+                       destination.oui[1], destination.oui[2], destination.uid[0], destination.uid[1],
+                       destination.uid[2]);
         return HyphaIpStatusMacRejected;
     }
     context->statistics.mac.accepted++;
 
     // 5.) Is it a type we accept?
-    bool arp_type = (ethernet_header.type == HyphaIpEtherType_ARP);
-    bool ipv4_type = (ethernet_header.type == HyphaIpEtherType_IPv4);
-    bool vlan_type = (ethernet_header.type == HyphaIpEtherType_VLAN);
-    if (!arp_type && !ipv4_type && !vlan_type) {
+    bool arp_type = (type == HyphaIpEtherType_ARP);
+    bool ipv4_type = (type == HyphaIpEtherType_IPv4);
+    if (!arp_type && !ipv4_type) {
         context->statistics.ethertype.rejected++;
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerMAC, "EtherType %04X Rejected\r\n",
-                       ethernet_header.type);
+                       (unsigned int)type);
         return HyphaIpStatusEthernetTypeRejected;
     }
 #if (HYPHA_IP_USE_VLAN == 1)
-    if (context->features.allow_vlan_filtering && vlan_type && ethernet_header.vlan != HYPHA_IP_VLAN_ID) {
+    // 6.) Is it tagged for a VLAN we accept?
+    bool vlan_tagged = (HyphaIpPeekVlanTpid(frame) == HyphaIpEtherType_VLAN);
+    uint16_t vlan = HyphaIpPeekVlanId(frame);
+    if (context->features.allow_vlan_filtering && (!vlan_tagged || vlan != HYPHA_IP_VLAN_ID)) {
         context->statistics.ethertype.rejected++;
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerMAC, "VLAN ID %u Rejected\r\n",
-                       ethernet_header.vlan);
+                       (unsigned int)vlan);
         return HyphaIpStaticVLANFiltered;
     }
 #endif
@@ -58,22 +58,22 @@ size_t HyphaIpFlipCopy(size_t num_flip_units, HyphaIpFlipUnit_t const flip_units
 }
 
 /// Outlines the flipping units for ethernet headers
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_ethernet_header[] = {{sizeof(uint8_t), 12},
-                                                                 {sizeof(uint16_t), 1 + (2 * HYPHA_IP_USE_VLAN)}};
+HyphaIpFlipUnit_t const hypha_ip_flip_ethernet_header[] = {{sizeof(uint8_t), 12},
+                                                           {sizeof(uint16_t), 1 + (2 * HYPHA_IP_USE_VLAN)}};
 
 /// Outlines the flipping units for IPv4 headers
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_ip_header[] = {
+HyphaIpFlipUnit_t const hypha_ip_flip_ip_header[] = {
     {sizeof(uint8_t), 2}, {sizeof(uint16_t), 3}, {sizeof(uint8_t), 2}, {sizeof(uint16_t), 1}, {sizeof(uint8_t), 8},
 };
 
 /// Outlines the flipping units for ICMP headers
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_icmp_header[] = {{sizeof(uint16_t), 2}};
+HyphaIpFlipUnit_t const hypha_ip_flip_icmp_header[] = {{sizeof(uint16_t), 2}};
 
 /// Outlines the flipping units for UDP headers
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_udp_header[] = {{sizeof(uint16_t), 4}};
+HyphaIpFlipUnit_t const hypha_ip_flip_udp_header[] = {{sizeof(uint16_t), 4}};
 
 /// Outlines the flipping units for ARP packets
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_arp_packet[] = {
+HyphaIpFlipUnit_t const hypha_ip_flip_arp_packet[] = {
     {sizeof(uint16_t), 4},  // enums and sizes
     {sizeof(uint8_t), 6},   // mac
     {sizeof(uint8_t), 4},   // ipv4
@@ -82,8 +82,9 @@ HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_arp_packet[] = {
 };
 
 /// Outlines the flipping units for IGMP packets
-HYPHA_INTERNAL const HyphaIpFlipUnit_t flip_igmp_packet[] = {
-    {sizeof(uint16_t), 2},  // type, max_response_time, checksum (treat them as two 16-bit units)
+HyphaIpFlipUnit_t const hypha_ip_flip_igmp_packet[] = {
+    {sizeof(uint8_t), 2},   // type, max_response_time (don't flip)
+    {sizeof(uint16_t), 1},  // checksum
     {sizeof(uint8_t), 4}    // group address (don't flip)
 };
 
@@ -100,19 +101,19 @@ size_t HyphaIpOffsetOfUDPPayload(void) {
 }
 
 void HyphaIpCopyEthernetHeaderFromFrame(HyphaIpEthernetHeader_t *dst, HyphaIpEthernetFrame_t *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_ethernet_header), flip_ethernet_header, dst, (void *)&src->header);
+    HyphaIpFlipFromFrame(dst, &src->header);
 }
 
 void HyphaIpCopyEthernetHeaderToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpEthernetHeader_t const *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_ethernet_header), flip_ethernet_header, dst, src);
+    HyphaIpFlipToFrame(&dst->header, src);
 }
 
 void HyphaIpCopyIPHeaderFromFrame(HyphaIpIPv4Header_t *dst, HyphaIpEthernetFrame_t *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_ip_header), flip_ip_header, dst, src->payload);
+    HyphaIpFlipFromFrame(dst, src->payload);
 }
 
 void HyphaIpCopyIPHeaderToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpIPv4Header_t const *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_ip_header), flip_ip_header, dst->payload, src);
+    HyphaIpFlipToFrame(dst->payload, src);
 }
 
 void HyphaIpUpdateIpChecksumInFrame(HyphaIpEthernetFrame_t *dst, uint16_t checksum) {
@@ -125,12 +126,12 @@ void HyphaIpUpdateIpChecksumInFrame(HyphaIpEthernetFrame_t *dst, uint16_t checks
 
 void HyphaIpCopyUdpHeaderFromFrame(HyphaIpUDPHeader_t *dst, HyphaIpEthernetFrame_t *src) {
     size_t offset = HyphaIpOffsetOfUDPHeader();
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_udp_header), flip_udp_header, dst, &src->payload[offset]);
+    HyphaIpFlipFromFrame(dst, &src->payload[offset]);
 }
 
 void HyphaIpCopyUdpHeaderToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpUDPHeader_t const *src) {
     size_t offset = HyphaIpOffsetOfUDPHeader();
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_udp_header), flip_udp_header, &dst->payload[offset], src);
+    HyphaIpFlipToFrame(&dst->payload[offset], src);
 }
 
 void HyphaIpCopyUdpPayloadFromFrame(HyphaIpSpan_t span, HyphaIpEthernetFrame_t *src) {
@@ -145,36 +146,36 @@ void HyphaIpCopyUdpPayloadToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpSpan_t spa
 
 void HyphaIpCopyIcmpHeaderFromFrame(HyphaIpICMPHeader_t *dst, HyphaIpEthernetFrame_t *src) {
     size_t offset = sizeof(HyphaIpIPv4Header_t);
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_icmp_header), flip_icmp_header, dst, &src->payload[offset]);
+    HyphaIpFlipFromFrame(dst, &src->payload[offset]);
 }
 
 void HyphaIpCopyIcmpHeaderToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpICMPHeader_t const *src) {
     size_t offset = sizeof(HyphaIpIPv4Header_t);
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_icmp_header), flip_icmp_header, &dst->payload[offset], src);
+    HyphaIpFlipToFrame(&dst->payload[offset], src);
 }
 
 void HyphaIpCopyIcmpDatagramFromFrame(uint8_t *dst, HyphaIpEthernetFrame_t *src) {
     size_t offset = sizeof(HyphaIpIPv4Header_t) + sizeof(HyphaIpICMPHeader_t);
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_udp_header), flip_udp_header, dst, &src->payload[offset]);
+    HyphaIpFlipUdpHeader(dst, &src->payload[offset]);
 }
 
 void HyphaIpCopyIcmpDatagramToFrame(HyphaIpEthernetFrame_t *dst, uint8_t const *src) {
     size_t offset = sizeof(HyphaIpIPv4Header_t) + sizeof(HyphaIpICMPHeader_t);
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_udp_header), flip_udp_header, &dst->payload[offset], src);
+    HyphaIpFlipUdpHeader(&dst->payload[offset], src);
 }
 
 void HyphaIpCopyArpPacketFromFrame(HyphaIpArpPacket_t *dst, HyphaIpEthernetFrame_t *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_arp_packet), flip_arp_packet, dst, src->payload);
+    HyphaIpFlipFromFrame(dst, src->payload);
 }
 
 void HyphaIpCopyArpPacketToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpArpPacket_t const *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_arp_packet), flip_arp_packet, dst->payload, src);
+    HyphaIpFlipToFrame(dst->payload, src);
 }
 
 void HyphaIpCopyIgmpPacketFromFrame(HyphaIpIgmpPacket_t *dst, HyphaIpEthernetFrame_t *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_igmp_packet), flip_igmp_packet, dst, src->payload);
+    HyphaIpFlipFromFrame(dst, &src->payload[sizeof(HyphaIpIPv4Header_t)]);
 }
 
 void HyphaIpCopyIgmpPacketToFrame(HyphaIpEthernetFrame_t *dst, HyphaIpIgmpPacket_t const *src) {
-    HyphaIpFlipCopy(HYPHA_IP_DIMOF(flip_igmp_packet), flip_igmp_packet, dst->payload, src);
+    HyphaIpFlipToFrame(&dst->payload[sizeof(HyphaIpIPv4Header_t)], src);  // the IGMP message follows the IP header
 }
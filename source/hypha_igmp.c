@@ -5,13 +5,14 @@
 
 #include "hypha_ip/hypha_internal.h"
 
-/// @brief Sends an IGMP packet to the given multicast address with the specified type.
+/// @brief Sends an IGMP packet about a multicast group with the specified type.
 /// @param context The Hypha IP context
-/// @param multicast The multicast address to send the IGMP packet to
+/// @param destination The address to send the IGMP packet to, the group itself for a report
+/// @param multicast The multicast group the IGMP packet is about
 /// @param type The type of the IGMP packet (Membership Report or Leave Group)
 /// @return HyphaIpStatus_e The status of the operation.
-HYPHA_INTERNAL HyphaIpStatus_e HyphaIpIgmpPacket(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast,
-                                                 HyphaIpIgmpType_e type) {
+HYPHA_INTERNAL HyphaIpStatus_e HyphaIpIgmpPacket(HyphaIpContext_t context, HyphaIpIPv4Address_t destination,
+                                                 HyphaIpIPv4Address_t multicast, HyphaIpIgmpType_e type) {
     if (context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
@@ -21,14 +22,11 @@ HYPHA_INTERNAL HyphaIpStatus_e HyphaIpIgmpPacket(HyphaIpContext_t context, Hypha
 
     HyphaIpStatus_e status = HyphaIpStatusOk;
     // acquire a frame for the IGMP packet
-    HyphaIpEthernetFrame_t *frame = context->external.acquire(context->theirs);
+    HyphaIpEthernetFrame_t *frame = HyphaIpDriverAcquireSized(
+        context, sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpIPv4Header_t) + sizeof(HyphaIpIgmpPacket_t));
     if (frame == nullptr) {
-        context->statistics.frames.failures++;
-        status = HyphaIpStatusOutOfMemory;
-        HYPHA_IP_REPORT(context, status);
-        return status;
+        return HyphaIpStatusOutOfMemory;
     }
-    context->statistics.frames.acquires++;
     // fill in an IGMP packet
     HyphaIpIgmpPacket_t igmp_packet = {
         .type = type,            // IGMPv2 Membership Report or Leave Group
@@ -48,16 +46,17 @@ HYPHA_INTERNAL HyphaIpStatus_e HyphaIpIgmpPacket(HyphaIpContext_t context, Hypha
         .count = 0,
         .type = HyphaIpSpanTypeUndefined,
     };
-    // compute the checksum for the IGMP packet
-    igmp_packet.checksum = HyphaIpComputeChecksum(igmp_span, payload_span);
+    // compute the checksum for the IGMP packet, which is sent 1's complimented
+    igmp_packet.checksum = (uint16_t)~HyphaIpComputeChecksum(igmp_span, payload_span);
     // copy the IGMP packet into the frame
     HyphaIpCopyIgmpPacketToFrame(frame, &igmp_packet);
     // make a metadata structure
     HyphaIpMetaData_t metadata = {
-        .source_address = context->interface.address,  // ours
-        .destination_address = multicast,              // send to the multicast group
-        .source_port = 0,                              // IGMP does not use ports
-        .destination_port = 0,                         // IGMP does not use ports
+        .source_address = context->interfaces[0].address,  // ours
+        .destination_address = destination,                // the group, or all routers for a leave
+        .source_port = 0,                                  // IGMP does not use ports
+        .destination_port = 0,                             // IGMP does not use ports
+        .interface = 0,                                    // the groups are joined on the first interface
     };
     // let the lower layer no figure out the ethernet stuff
     status = HyphaIpIPv4TransmitPacket(context, frame, &metadata, HyphaIpProtocol_IGMP, igmp_span);
@@ -66,23 +65,274 @@ HYPHA_INTERNAL HyphaIpStatus_e HyphaIpIgmpPacket(HyphaIpContext_t context, Hypha
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerIGMP,
                        "IGMP Membership Report failed to send %u\r\n", status);
         context->statistics.igmp.rejected++;
+    } else {
+        context->statistics.counter.igmp.tx.count++;
+        context->statistics.counter.igmp.tx.bytes += sizeof(HyphaIpIgmpPacket_t);
     }
     // now free the frame
-    status = context->external.release(context->theirs, frame);
-    HYPHA_IP_REPORT(context, status);
-    if (HyphaIpIsSuccess(status)) {
-        context->statistics.frames.releases++;
-    } else {
-        context->statistics.frames.failures++;
+    return HyphaIpDriverRelease(context, frame);
+}
+
+HyphaIpStatus_e HyphaIpMembershipReport(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast) {
+    return HyphaIpIgmpPacket(context, multicast, multicast, HyphaIpIgmpTypeReport_v2);
+}
+
+/// @return The joined group, or nullptr
+static HyphaIpIgmpGroup_t *HyphaIpIgmpFind(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast) {
+    for (size_t i = 0U; i < context->igmp.count; i++) {
+        if (HyphaIpIsSameIPv4Address(context->igmp.entries[i].group, multicast)) {
+            return &context->igmp.entries[i];
+        }
+    }
+    return nullptr;
+}
+
+/// @return The next value of a xorshift generator, seeded from our addresses so neighbours spread out differently
+static uint32_t HyphaIpIgmpRandom(HyphaIpContext_t context) {
+    uint32_t x = context->igmp.random;
+    if (x == 0U) {
+        HyphaIpNetworkInterface_t const *ours = &context->interfaces[0];
+        uint32_t mac = ((uint32_t)ours->mac.uid[0] << 16U) | ((uint32_t)ours->mac.uid[1] << 8U) | ours->mac.uid[2];
+        x = (HyphaIpIPv4AddressToValue(ours->address) ^ (mac * 0x9E37'79B1U)) | 1U;
     }
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    context->igmp.random = x;
+    return x;
+}
+
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+/// @return A joined group which is sent to the Ethernet Address, or nullptr
+static HyphaIpIgmpGroup_t *HyphaIpIgmpSharing(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac) {
+    for (size_t i = 0U; i < context->igmp.count; i++) {
+        HyphaIpEthernetAddress_t joined;
+        // 32 groups share each Ethernet Address, like 224.1.1.1 and 239.1.1.1
+        if (HyphaIpConvertMulticast(&joined, context->igmp.entries[i].group) &&
+            HyphaIpIsSameEthernetAddress(joined, mac)) {
+            return &context->igmp.entries[i];
+        }
+    }
+    return nullptr;
+}
 
+/// Lets the frames of a group which is about to be joined through the Ethernet filter, along with the queries for
+/// all hosts when it is the first group. Only the addresses which were not let through already are added, and the
+/// group remembers whether its own was.
+static HyphaIpStatus_e HyphaIpIgmpFilterAdd(HyphaIpContext_t context, HyphaIpIgmpGroup_t *group) {
+    HyphaIpEthernetAddress_t all_hosts;
+    HyphaIpEthernetAddress_t mac;
+    if (!HyphaIpConvertMulticast(&all_hosts, hypha_ip_igmpv1) || !HyphaIpConvertMulticast(&mac, group->group)) {
+        return HyphaIpStatusInvalidIpAddress;
+    }
+    bool first = (context->igmp.count == 0U) && !HyphaIpMulticastFilterHas(context, all_hosts);
+    if (first) {
+        HyphaIpStatus_e status = HyphaIpMulticastFilterAdd(context, all_hosts);
+        if (HyphaIpIsFailure(status)) {
+            return status;
+        }
+    }
+    group->filtered = !HyphaIpMulticastFilterHas(context, mac);
+    HyphaIpStatus_e status = group->filtered ? HyphaIpMulticastFilterAdd(context, mac) : HyphaIpStatusOk;
+    if (HyphaIpIsFailure(status) && first) {
+        HyphaIpMulticastFilterRemove(context, all_hosts);
+    } else if (first) {
+        context->igmp.all_hosts = true;
+    }
     return status;
 }
 
-HyphaIpStatus_e HyphaIpMembershipReport(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast) {
-    return HyphaIpIgmpPacket(context, multicast, HyphaIpIgmpTypeReport_v2);
+/// Takes what the join of a group which has been left let through back out of the Ethernet filter, unless a joined
+/// group is still sent to it
+static void HyphaIpIgmpFilterRemove(HyphaIpContext_t context, HyphaIpIgmpGroup_t const *group) {
+    HyphaIpEthernetAddress_t all_hosts;
+    HyphaIpEthernetAddress_t mac;
+    if (group->filtered && HyphaIpConvertMulticast(&mac, group->group)) {
+        HyphaIpIgmpGroup_t *sharing = HyphaIpIgmpSharing(context, mac);
+        if (sharing == nullptr) {
+            HyphaIpMulticastFilterRemove(context, mac);
+        } else {
+            sharing->filtered = true;  // the address is taken out when the last group sent to it is left
+        }
+    }
+    if (context->igmp.count == 0U && context->igmp.all_hosts && HyphaIpConvertMulticast(&all_hosts, hypha_ip_igmpv1)) {
+        HyphaIpMulticastFilterRemove(context, all_hosts);
+        context->igmp.all_hosts = false;
+    }
+}
+#endif
+
+HyphaIpStatus_e HyphaIpJoinGroup(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (!HyphaIpIsMulticastIPv4Address(multicast)) {
+        return HyphaIpStatusInvalidIpAddress;
+    }
+    HyphaIpIgmpGroup_t *group = HyphaIpIgmpFind(context, multicast);
+    if (group != nullptr) {
+        if (group->references == UINT16_MAX) {
+            return HyphaIpStatusInvalidArgument;
+        }
+        group->references++;
+        return HyphaIpStatusOk;  // already a member, nothing to tell anyone
+    }
+    if (context->igmp.count == HYPHA_IP_IGMP_GROUP_TABLE_SIZE) {
+        return HyphaIpStatusIgmpGroupTableFull;
+    }
+    HyphaIpIgmpGroup_t joining = {.group = multicast, .references = 1U, .state = HyphaIpIgmpStateIdle, .deadline = 0};
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+    // the group's frames (and the queries for it) have to get through the Ethernet filter before anyone is told
+    HyphaIpTablesLock(context);
+    HyphaIpStatus_e status = HyphaIpIgmpFilterAdd(context, &joining);
+    HyphaIpTablesUnlock(context);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+#endif
+    context->igmp.entries[context->igmp.count++] = joining;
+    // the unsolicited report, should it be lost (which the statistics count) the next query asks again
+    (void)HyphaIpMembershipReport(context, multicast);
+    return HyphaIpStatusOk;
 }
 
 HyphaIpStatus_e HyphaIpLeaveGroup(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast) {
-    return HyphaIpIgmpPacket(context, multicast, HyphaIpIgmpTypeLeave);
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpIgmpGroup_t *group = HyphaIpIgmpFind(context, multicast);
+    if (group == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (group->references > 1U) {
+        group->references--;
+        return HyphaIpStatusOk;  // someone is still listening
+    }
+    if (group->state == HyphaIpIgmpStateDelaying) {
+        HyphaIpTimerCancel(context, &group->timer);
+        context->igmp.delaying--;
+    }
+    HyphaIpIgmpGroup_t const left = *group;
+    // the last group moves into the hole
+    *group = context->igmp.entries[--context->igmp.count];
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+    HyphaIpTablesLock(context);
+    HyphaIpIgmpFilterRemove(context, &left);
+    HyphaIpTablesUnlock(context);
+#else
+    (void)left;
+#endif
+    // RFC 2236 section 3, the Leave goes to the routers rather than to the group
+    return HyphaIpIgmpPacket(context, hypha_ip_igmpv2, multicast, HyphaIpIgmpTypeLeave);
+}
+
+/// Starts (or brings forward) the delayed report of a group, at a random time within the response time
+static HyphaIpStatus_e HyphaIpIgmpSchedule(HyphaIpContext_t context, HyphaIpIgmpGroup_t *group,
+                                           HyphaIpTimestamp_t timestamp, HyphaIpTimestamp_t response_time) {
+    uint64_t delay = HyphaIpIgmpRandom(context) % (uint64_t)response_time;
+    HyphaIpTimestamp_t deadline = timestamp + (HyphaIpTimestamp_t)delay;
+    if (group->state == HyphaIpIgmpStateDelaying && group->deadline <= deadline) {
+        return HyphaIpStatusOk;  // RFC 2236, a running timer is only reset when the new one is sooner
+    }
+    HyphaIpStatus_e status = HyphaIpTimerSchedule(context, &group->timer, HyphaIpTimerKindIgmpReport,
+                                                  HyphaIpIPv4AddressToValue(group->group), deadline);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    if (group->state == HyphaIpIgmpStateIdle) {
+        group->state = HyphaIpIgmpStateDelaying;
+        context->igmp.delaying++;
+    }
+    group->deadline = deadline;
+    return HyphaIpStatusOk;
+}
+
+/// @return The Max Response Time of a query in deciseconds
+static uint32_t HyphaIpIgmpResponseTime(uint8_t code, size_t length) {
+    if (code == 0U) {
+        return 100U;  // an IGMPv1 query, RFC 2236 section 4 says to use 10 seconds
+    }
+    if (length > sizeof(HyphaIpIgmpPacket_t) && code >= 128U) {
+        // an IGMPv3 query codes large times as a floating point value (RFC 3376 section 4.1.1)
+        return (uint32_t)((code & 0x0FU) | 0x10U) << (((code >> 4U) & 0x07U) + 3U);
+    }
+    return code;
+}
+
+HyphaIpStatus_e HyphaIpIgmpReceivePacket(HyphaIpContext_t context, HyphaIpTimestamp_t timestamp,
+                                         HyphaIpSpan_t message) {
+    context->statistics.counter.igmp.rx.count++;
+    size_t const length = HyphaIpSpanSize(message);
+    if (length < sizeof(HyphaIpIgmpPacket_t)) {
+        context->statistics.igmp.rejected++;
+        return HyphaIpStatusInvalidSpan;
+    }
+    // the checksum covers the whole message, which is longer for IGMPv3
+    HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+    if (HyphaIpComputeChecksum(message, empty) != HyphaIpChecksumValid) {
+        context->statistics.igmp.rejected++;
+        return HyphaIpStatusIgmpChecksumRejected;
+    }
+    context->statistics.igmp.accepted++;
+    context->statistics.counter.igmp.rx.bytes += length;
+    // type, max response code, checksum then the group, read in place
+    uint8_t const *bytes = (uint8_t const *)message.pointer;
+    uint8_t type = bytes[0];
+    uint8_t code = bytes[1];
+    HyphaIpIPv4Address_t address;
+    memcpy(&address, &bytes[offsetof(HyphaIpIgmpPacket_t, group)], sizeof(address));
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIGMP,
+                   "Received IGMP Type %02X code %u for group " PRIuIPv4Address "\r\n", type, code, address.a,
+                   address.b, address.c, address.d);
+
+    if (type == HyphaIpIgmpTypeQuery) {
+        HyphaIpTimestamp_t response_time =
+            (HyphaIpTimestamp_t)HyphaIpIgmpResponseTime(code, length) * HYPHA_IP_IGMP_DECISECOND;
+        bool general = HyphaIpIsSameIPv4Address(address, hypha_ip_default_route);
+        bool asked = false;
+        HyphaIpStatus_e result = HyphaIpStatusOk;
+        for (size_t i = 0U; i < context->igmp.count; i++) {
+            HyphaIpIgmpGroup_t *group = &context->igmp.entries[i];
+            if (general || HyphaIpIsSameIPv4Address(group->group, address)) {
+                HyphaIpStatus_e status = HyphaIpIgmpSchedule(context, group, timestamp, response_time);
+                result = HyphaIpIsFailure(status) ? status : result;
+                asked = true;
+            }
+        }
+        if (asked) {
+            context->statistics.membership.queries++;
+        }
+        return result;
+    } else if (type == HyphaIpIgmpTypeReport_v1 || type == HyphaIpIgmpTypeReport_v2) {
+        // another member has answered for the group, the router only needs to hear from one of us
+        HyphaIpIgmpGroup_t *group = HyphaIpIgmpFind(context, address);
+        if (group != nullptr && group->state == HyphaIpIgmpStateDelaying) {
+            HyphaIpTimerCancel(context, &group->timer);
+            group->state = HyphaIpIgmpStateIdle;
+            context->igmp.delaying--;
+            context->statistics.membership.suppressed++;
+        }
+    }
+    // Leaves and IGMPv3 reports are for the routers
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpIgmpReportDue(HyphaIpContext_t context, uint32_t key) {
+    HyphaIpIgmpGroup_t *group = HyphaIpIgmpFind(context, HyphaIpValueToIPv4Address(key));
+    if (group == nullptr) {
+        return HyphaIpStatusOk;  // left since, the timer went with it
+    }
+    group->timer = 0U;  // the timer has been given back
+    if (context->igmp.budget == 0U) {
+        // enough reports for this tick, the deadline has passed so the next tick sends it
+        return HyphaIpTimerSchedule(context, &group->timer, HyphaIpTimerKindIgmpReport, key, group->deadline);
+    }
+    context->igmp.budget--;
+    group->state = HyphaIpIgmpStateIdle;
+    context->igmp.delaying--;
+    HyphaIpStatus_e status = HyphaIpMembershipReport(context, group->group);
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.membership.reports++;
+    }
+    return status;
 }
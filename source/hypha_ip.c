@@ -48,9 +48,9 @@ bool HyphaIpIsInNetwork(HyphaIpIPv4Address_t ipv4, uint32_t network, uint32_t ne
     return ((ipv4_value & netmask) == (network & netmask));
 }
 
-bool HyphaIpIsInOurNetwork(HyphaIpContext_t context, HyphaIpIPv4Address_t ipv4) {
-    uint32_t netmask = HyphaIpIPv4AddressToValue(context->interface.netmask);
-    uint32_t address = HyphaIpIPv4AddressToValue(context->interface.address);
+bool HyphaIpIsInOurNetwork(HyphaIpContext_t context, uint8_t interface, HyphaIpIPv4Address_t ipv4) {
+    uint32_t netmask = HyphaIpIPv4AddressToValue(context->interfaces[interface].netmask);
+    uint32_t address = HyphaIpIPv4AddressToValue(context->interfaces[interface].address);
     uint32_t network = address & netmask;
     return HyphaIpIsInNetwork(ipv4, network, netmask);
 }
@@ -66,7 +66,12 @@ bool HyphaIpIsSameIPv4Address(HyphaIpIPv4Address_t a, HyphaIpIPv4Address_t b) {
 }
 
 bool HyphaIpIsOurIPv4Address(HyphaIpContext_t context, HyphaIpIPv4Address_t address) {
-    return HyphaIpIsSameIPv4Address(context->interface.address, address);
+    for (size_t i = 0U; i < context->interface_count; i++) {
+        if (HyphaIpIsSameIPv4Address(context->interfaces[i].address, address)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool HyphaIpIsLimitedBroadcastIPv4Address(HyphaIpIPv4Address_t address) {
@@ -74,42 +79,133 @@ bool HyphaIpIsLimitedBroadcastIPv4Address(HyphaIpIPv4Address_t address) {
 }
 
 #if (HYPHA_IP_USE_IP_FILTER == 1)
-HyphaIpStatus_e HyphaIpPopulateIPv4Filter(HyphaIpContext_t context, size_t len, HyphaIpIPv4Address_t addresses[len]) {
+/// Finds the first range which ends at or after the value
+static size_t HyphaIpIPv4FilterFind(HyphaIpIPv4Filter_t const *filter, uint32_t value) {
+    size_t low = 0U;
+    size_t high = filter->count;
+    while (low < high) {
+        size_t middle = low + ((high - low) / 2U);
+        if (filter->ranges[middle].last < value) {
+            low = middle + 1U;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/// Adds a range to the filter, merging it with any ranges it overlaps or touches so they stay disjoint and sorted.
+/// The merged range lasts as long as the longest lived of its parts. The caller has made sure there is room for one
+/// more range.
+static void HyphaIpIPv4FilterInsert(HyphaIpContext_t context, HyphaIpIPv4Range_t range) {
+    HyphaIpIPv4Filter_t *filter = &HyphaIpTablesDraft(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses;
+    // a range which ends right before this one starts is merged too
+    size_t first = HyphaIpIPv4FilterFind(filter, (range.first == 0U) ? 0U : (range.first - 1U));
+    size_t last = first;
+    while (last < filter->count && (range.last == UINT32_MAX || filter->ranges[last].first <= (range.last + 1U))) {
+        HyphaIpIPv4Range_t *merged = &filter->ranges[last];
+        range.first = (merged->first < range.first) ? merged->first : range.first;
+        range.last = (merged->last > range.last) ? merged->last : range.last;
+        range.expiration = (merged->expiration > range.expiration) ? merged->expiration : range.expiration;
+        last++;
+    }
+    // [first, last) are replaced by the one merged range, the owner gives back the timers of the ones which are gone
+    size_t tail = filter->count - last;
+    memmove(&filter->ranges[first + 1U], &filter->ranges[last], tail * sizeof(HyphaIpIPv4Range_t));
+    filter->ranges[first] = range;
+    filter->count = first + 1U + tail;
+}
+
+void HyphaIpIPv4FilterExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline) {
+    HyphaIpIPv4Filter_t const *found = &HyphaIpTablesPeek(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses;
+    size_t index = HyphaIpIPv4FilterFind(found, key);
+    if (index < found->count && found->ranges[index].first == key) {
+        HyphaIpTimestamp_t expiration = found->ranges[index].expiration;
+        if (expiration > deadline) {
+            // populated again since the timers last caught up with the tables
+            (void)HyphaIpTimerAge(context, HyphaIpTimerKindIPv4Filter, key, expiration);
+            return;
+        }
+        HyphaIpIPv4Filter_t *filter = &HyphaIpTablesDraft(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses;
+        size_t tail = filter->count - index - 1U;
+        memmove(&filter->ranges[index], &filter->ranges[index + 1U], tail * sizeof(HyphaIpIPv4Range_t));
+        filter->count--;
+        context->statistics.expirations.ipv4++;
+    }
+    if (HyphaIpTablesPeek(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses.count == 0U) {
+        // an empty filter would turn every source away, until it is populated again nothing is filtered
+        atomic_store_explicit(&context->features.allow_ip_filtering, false, memory_order_release);
+    }
+}
+
+HyphaIpStatus_e HyphaIpIPv4FilterAge(HyphaIpContext_t context, HyphaIpTables_t const *tables) {
+    HyphaIpIPv4Filter_t const *filter = &tables->allowed_ipv4_addresses;
+    HyphaIpStatus_e result = HyphaIpStatusOk;
+    for (size_t i = 0U; i < filter->count; i++) {
+        HyphaIpIPv4Range_t const *range = &filter->ranges[i];
+        HyphaIpStatus_e status = HyphaIpTimerAge(context, HyphaIpTimerKindIPv4Filter, range->first, range->expiration);
+        result = HyphaIpIsFailure(status) ? status : result;
+    }
+    return result;
+}
+
+HyphaIpStatus_e HyphaIpPopulateIPv4Prefixes(HyphaIpContext_t context, size_t len, HyphaIpIPv4Prefix_t prefixes[len]) {
     if (context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
-    if (len > HYPHA_IP_IPv4_FILTER_TABLE_SIZE || len == 0 || addresses == nullptr) {
+    if (len > HYPHA_IP_IPv4_FILTER_TABLE_SIZE || len == 0 || prefixes == nullptr) {
         return HyphaIpStatusInvalidArgument;
     }
-    // count the number of free entries in the table
-    size_t free_count = 0;
-    for (size_t i = 0; i < HYPHA_IP_IPv4_FILTER_TABLE_SIZE; i++) {
-        HyphaIpIPv4Filter_t *filter = &context->allowed_ipv4_addresses[i];
-        if (filter->valid == false) {
-            free_count++;
+    for (size_t i = 0; i < len; i++) {
+        if (prefixes[i].length > 32U) {
+            return HyphaIpStatusInvalidArgument;
         }
     }
-    if (free_count < len) {
+    // each prefix adds at most one range, merging may need less
+    HyphaIpTablesLock(context);
+    HyphaIpIPv4Filter_t const *filter = &HyphaIpTablesDraft(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses;
+    if ((HYPHA_IP_IPv4_FILTER_TABLE_SIZE - filter->count) < len) {
+        HyphaIpTablesUnlock(context);
         return HyphaIpStatusIPv4FilterTableFull;
     }
-    context->features.allow_ip_filtering = true;
-    size_t index = 0U;
     HyphaIpTimestamp_t now = context->external.get_monotonic_timestamp(context->theirs);
-    for (size_t i = 0; i < HYPHA_IP_IPv4_FILTER_TABLE_SIZE; i++) {
-        HyphaIpIPv4Filter_t *filter = &context->allowed_ipv4_addresses[i];
-        if (filter->valid == false) {
-            if (index < len) {
-                // copy the filter
-                filter->ipv4 = addresses[index];
-                filter->expiration = now + HYPHA_IP_EXPIRATION_TIME;  // set the expiration time
-                filter->valid = true;
-                index++;
-            } else {
-                // we are done, no more filters to add
-                break;
-            }
-        }
+    HyphaIpTimestamp_t expiration = now + HYPHA_IP_EXPIRATION_TIME;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t netmask = (prefixes[i].length == 0U) ? 0U : (UINT32_MAX << (32U - prefixes[i].length));
+        uint32_t network = HyphaIpIPv4AddressToValue(prefixes[i].address) & netmask;
+        HyphaIpIPv4FilterInsert(
+            context, (HyphaIpIPv4Range_t){.first = network, .last = network | ~netmask, .expiration = expiration});
+    }
+    HyphaIpTablesDraft(context, HyphaIpTableNone)->populated++;  // the owner starts the timers of the ranges
+    HyphaIpTablesUnlock(context);
+    // turned on after the ranges are published, so no source they allow is turned away in between
+    atomic_store_explicit(&context->features.allow_ip_filtering, true, memory_order_release);
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpPopulateIPv4Filter(HyphaIpContext_t context, size_t len, HyphaIpIPv4Address_t addresses[len]) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (len > HYPHA_IP_IPv4_FILTER_TABLE_SIZE || len == 0 || addresses == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpTablesLock(context);
+    HyphaIpIPv4Filter_t const *filter = &HyphaIpTablesDraft(context, HyphaIpTableIPv4Filter)->allowed_ipv4_addresses;
+    if ((HYPHA_IP_IPv4_FILTER_TABLE_SIZE - filter->count) < len) {
+        HyphaIpTablesUnlock(context);
+        return HyphaIpStatusIPv4FilterTableFull;
     }
+    HyphaIpTimestamp_t now = context->external.get_monotonic_timestamp(context->theirs);
+    HyphaIpTimestamp_t expiration = now + HYPHA_IP_EXPIRATION_TIME;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t host = HyphaIpIPv4AddressToValue(addresses[i]);
+        HyphaIpIPv4FilterInsert(context,
+                                (HyphaIpIPv4Range_t){.first = host, .last = host, .expiration = expiration});
+    }
+    HyphaIpTablesDraft(context, HyphaIpTableNone)->populated++;
+    HyphaIpTablesUnlock(context);
+    atomic_store_explicit(&context->features.allow_ip_filtering, true, memory_order_release);
     return HyphaIpStatusOk;
 }
 
@@ -129,21 +225,13 @@ bool HyphaIpIsPermittedIPv4Address(HyphaIpContext_t context, HyphaIpIPv4Address_
     if (context->features.allow_ip_filtering == false) {
         return true;  // filtering is not enabled, so all addresses are allowed
     }
-    HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
-                   "Checking if " PRIuIPv4Address " is in the filter table\r\n", address.a, address.b, address.c,
-                   address.d);
-    // TODO improve the performance of this function by using an AVL or something similar
-    // we assume there will be a small CPU penalty, these platforms can not tolerate a large memory penalty
-    for (size_t i = 0; i < HYPHA_IP_IPv4_FILTER_TABLE_SIZE; i++) {
-        HyphaIpIPv4Filter_t *filter = &context->allowed_ipv4_addresses[i];
-        if (filter->valid && HyphaIpIsSameIPv4Address(filter->ipv4, address)) {
-            return true;  // found a match
-        }
-    }
-    HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerIPv4,
-                   "Address " PRIuIPv4Address " is not in the filter table\r\n", address.a, address.b, address.c,
-                   address.d);
-    return false;  // not found in the filter table
+    // the ranges are disjoint, so only the first one which ends at or after the address can hold it
+    HyphaIpIPv4Filter_t const *filter = &HyphaIpTablesReadBegin(context)->allowed_ipv4_addresses;
+    uint32_t value = HyphaIpIPv4AddressToValue(address);
+    size_t index = HyphaIpIPv4FilterFind(filter, value);
+    bool permitted = (index < filter->count) && (filter->ranges[index].first <= value);
+    HyphaIpTablesReadEnd(context);
+    return permitted;
 }
 #endif  // HYPHA_IP_USE_IP_FILTER
 
@@ -174,32 +262,53 @@ bool HyphaIpIsPrivateIPv4Address(HyphaIpIPv4Address_t address) {
 HyphaIpStatus_e HyphaIpIPv4ReceivePacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
                                          HyphaIpTimestamp_t timestamp) {
     context->statistics.counter.ipv4.rx.count++;
-    HyphaIpIPv4Header_t ip_header;
-    HyphaIpCopyIPHeaderFromFrame(&ip_header, frame);
+    // the header has to have been received before any of it is read
+    if (frame->info.length < (sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpIPv4Header_t))) {
+        context->statistics.ip.rejected++;
+        return HyphaIpStatusInvalidFrameLength;
+    }
+    // the header is read in place, nothing is copied out of the frame
+    uint8_t version = HyphaIpPeekIPv4Version(frame);
+    uint8_t ihl = HyphaIpPeekIPv4IHL(frame);
+    uint16_t length = HyphaIpPeekIPv4Length(frame);
+    uint16_t fragment = HyphaIpPeekIPv4Fragment(frame);
+    uint8_t protocol = HyphaIpPeekIPv4Protocol(frame);
+    // IGMP is sent with the one word Router Alert option (RFC 2236), the only option which is let in (and skipped)
+    bool router_alert = (protocol == HyphaIpProtocol_IGMP) && (ihl == HYPHA_IP_IPv4_IHL_ROUTER_ALERT);
+    size_t header_length = router_alert ? (HYPHA_IP_IPv4_IHL_ROUTER_ALERT * 4U) : sizeof(HyphaIpIPv4Header_t);
+    if (frame->info.length < (sizeof(HyphaIpEthernetHeader_t) + header_length)) {
+        context->statistics.ip.rejected++;
+        return HyphaIpStatusInvalidFrameLength;
+    }
+    // any other option in the word makes the header one we do not understand
+    router_alert = router_alert && (HyphaIpPeek16(&frame->payload[sizeof(HyphaIpIPv4Header_t)]) ==
+                                    HYPHA_IP_IPv4_OPTION_ROUTER_ALERT);
+    HyphaIpIPv4Address_t source = HyphaIpPeekIPv4Source(frame);
+    HyphaIpIPv4Address_t destination = HyphaIpPeekIPv4Destination(frame);
 
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
-                   "RX: IP Header: Version=%u, IHL=%u, DSCP=%u, ECN=%u, Length=%u, ID=%u, DF=%u, MF=%u, "
-                   "Offset=%u, TTL=%u, Protocol=%u, Checksum=%04X\r\n",
-                   ip_header.version, ip_header.IHL, ip_header.DSCP, ip_header.ECN, ip_header.length,
-                   ip_header.identification, ip_header.DF, ip_header.MF, ip_header.fragment_offset, ip_header.TTL,
-                   ip_header.protocol, ip_header.checksum);
+                   "RX: IP Header: Version=%u, IHL=%u, Length=%u, ID=%u, DF=%u, MF=%u, Offset=%u, Protocol=%u\r\n",
+                   version, ihl, length, HyphaIpPeekIPv4Identification(frame), (fragment & HYPHA_IP_IPv4_FLAG_DF) != 0U,
+                   (fragment & HYPHA_IP_IPv4_FLAG_MF) != 0U, fragment & HYPHA_IP_IPv4_FRAGMENT_MASK, protocol);
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
-                   "RX: Source: " PRIuIPv4Address " => Destination: " PRIuIPv4Address "\r\n", ip_header.source.a,
-                   ip_header.source.b, ip_header.source.c, ip_header.source.d, ip_header.destination.a,
-                   ip_header.destination.b, ip_header.destination.c, ip_header.destination.d);
-    HYPHA_IP_DO(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
-                HyphaIpPrintArray16(context, sizeof(ip_header) / sizeof(uint16_t), (uint16_t *)&ip_header););
+                   "RX: Source: " PRIuIPv4Address " => Destination: " PRIuIPv4Address "\r\n", source.a, source.b,
+                   source.c, source.d, destination.a, destination.b, destination.c, destination.d);
 
     // IP Header acceptance rules
-    if (HYPHA_IP_USE_IP_CHECKSUM) {
+    bool ipv4_verified = context->capabilities.rx_ipv4_checksum &&
+                         ((frame->info.flags & HyphaIpFrameFlagIPv4ChecksumVerified) != 0U);
+    if (HYPHA_IP_USE_IP_CHECKSUM && ipv4_verified) {
+        // the driver has already checked the header, it would have dropped a bad one
+        context->statistics.checksums.ipv4.rx_offloaded++;
+    } else if (HYPHA_IP_USE_IP_CHECKSUM) {
+        context->statistics.checksums.ipv4.rx_software++;
         HyphaIpSpan_t ip_header_span = HyphaIpSpanIpHeader(frame);
+        ip_header_span.count = (uint32_t)(header_length / sizeof(uint16_t));  // the options are summed too
         HyphaIpSpan_t ip_payload_span = HYPHA_IP_DEFAULT_SPAN;
         // 0.) Is the HEADER Checksum valid?
         uint16_t checksum = HyphaIpComputeChecksum(ip_header_span, ip_payload_span);
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
                        "Computed Checksum: %04X (should be %04X)\r\n", checksum, HyphaIpChecksumValid);
-        HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4, "Provided Checksum: %04X\r\n",
-                       ip_header.checksum);
         bool valid_checksum = (checksum == HyphaIpChecksumValid);
         if (!valid_checksum) {
             context->statistics.ip.rejected++;
@@ -208,25 +317,28 @@ HyphaIpStatus_e HyphaIpIPv4ReceivePacket(HyphaIpContext_t context, HyphaIpEthern
         }
     }
     // 1.) Is the IP version 4?
-    bool ipv4_version = (ip_header.version == 4);
+    bool ipv4_version = (version == 4);
     // 2.) check to make sure the header length is valid
-    bool header_length_valid = (ip_header.IHL == 5);
-    // no fragmentation is allowed, offset must be zero.
-    bool no_fragmentation = (ip_header.MF == 0) && (ip_header.fragment_offset == 0);
-    if (!ipv4_version || !header_length_valid || (ip_header.length > HYPHA_IP_MAX_IP_LENGTH) || !no_fragmentation) {
+    bool header_length_valid = (ihl == 5) || router_alert;
+    // 2a.) the total length has to cover at least the header and fit in the frame
+    bool length_valid = (length >= header_length) && (length <= HYPHA_IP_MAX_IP_LENGTH) &&
+                        (length <= (frame->info.length - sizeof(HyphaIpEthernetHeader_t)));
+    // 2b.) fragments are only allowed when there are slots to reassemble them in (and never with options)
+    bool fragmented = (fragment & (HYPHA_IP_IPv4_FLAG_MF | HYPHA_IP_IPv4_FRAGMENT_MASK)) != 0U;
+    bool fragment_valid = !fragmented || (context->reassembly.count > 0U && !router_alert);
+    if (!ipv4_version || !header_length_valid || !length_valid || !fragment_valid) {
         context->statistics.ip.rejected++;
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelError, HyphaIpPrintLayerIPv4,
-                       "Invalid IPv4 Header: Version=%u, IHL=%u, Length=%u, DF=%u, MF=%u, Offset=%u\r\n",
-                       ip_header.version, ip_header.IHL, ip_header.length, ip_header.DF, ip_header.MF,
-                       ip_header.fragment_offset);
+                       "Invalid IPv4 Header: Version=%u, IHL=%u, Length=%u, Fragment=%04X\r\n", version, ihl, length,
+                       fragment);
         return HyphaIpStatusIPv4HeaderRejected;
     }
     // 3.) check to make sure the destination address is valid (localhost from some localhost, our interface but then
     // from our network) or is a multicast or is a limited broadcast.
-    bool to_our_address = HyphaIpIsOurIPv4Address(context, ip_header.destination);
-    bool to_localhost = HyphaIpIsLocalhostIPv4Address(ip_header.destination);
-    bool to_multicast = HyphaIpIsMulticastIPv4Address(ip_header.destination);
-    bool to_limited_broadcast = HyphaIpIsLimitedBroadcastIPv4Address(ip_header.destination);
+    bool to_our_address = HyphaIpIsOurIPv4Address(context, destination);
+    bool to_localhost = HyphaIpIsLocalhostIPv4Address(destination);
+    bool to_multicast = HyphaIpIsMulticastIPv4Address(destination);
+    bool to_limited_broadcast = HyphaIpIsLimitedBroadcastIPv4Address(destination);
     bool valid_destination = to_our_address || (context->features.allow_any_multicast && to_multicast) ||
                              (context->features.allow_any_broadcast && to_limited_broadcast) ||
                              (context->features.allow_any_localhost && to_localhost);
@@ -234,23 +346,26 @@ HyphaIpStatus_e HyphaIpIPv4ReceivePacket(HyphaIpContext_t context, HyphaIpEthern
         context->statistics.ip.rejected++;
         return HyphaIpStatusIPv4DestinationRejected;
     }
-    // 4.) Check to make sure the source address is within our network mask
-    bool is_same_network = HyphaIpIsInOurNetwork(context, ip_header.source);
-    bool from_localhost = HyphaIpIsLocalhostIPv4Address(ip_header.source);
+    // 4.) Check to make sure the source address routes back out of the interface it came in on
+    HyphaIpNextHop_t reverse = {.valid = false};
+    bool reverse_path = HyphaIpIsSuccess(HyphaIpRouteLookup(context, source, &reverse)) &&
+                        (reverse.interface == frame->info.interface);
+    bool from_localhost = HyphaIpIsLocalhostIPv4Address(source);
     bool valid_localhost = context->features.allow_any_localhost && to_localhost && from_localhost;
-    bool valid_network = valid_localhost || is_same_network;
+    bool valid_network = valid_localhost || reverse_path;
     if (!valid_network) {
         context->statistics.ip.rejected++;
+        context->statistics.interfaces[frame->info.interface].rejected++;
         return HyphaIpStatusIPv4SourceRejected;
     }
     // 5.) Check to make the source address is not filtered out
-    bool from_our_address = HyphaIpIsOurIPv4Address(context, ip_header.source);
+    bool from_our_address = HyphaIpIsOurIPv4Address(context, source);
     if (context->features.allow_ip_filtering == true && !from_our_address) {
-        bool found = HyphaIpIsPermittedIPv4Address(context, ip_header.source);
+        bool found = HyphaIpIsPermittedIPv4Address(context, source);
         if (!found) {
             HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerIPv4,
-                           "Source Address " PRIuIPv4Address " not in filter table\r\n", ip_header.source.a,
-                           ip_header.source.b, ip_header.source.c, ip_header.source.d);
+                           "Source Address " PRIuIPv4Address " not in filter table\r\n", source.a, source.b, source.c,
+                           source.d);
 
             context->statistics.ip.rejected++;
             return HyphaIpStatusIPv4SourceFiltered;
@@ -258,79 +373,133 @@ HyphaIpStatus_e HyphaIpIPv4ReceivePacket(HyphaIpContext_t context, HyphaIpEthern
     }
 
     context->statistics.ip.accepted++;
-    context->statistics.counter.ipv4.rx.bytes += sizeof(ip_header) + ip_header.length;
+    context->statistics.counter.ipv4.rx.bytes += length;
+
+    if (fragmented) {
+        // the protocol only sees the datagram once every fragment has arrived
+        return HyphaIpIPv4Reassemble(context, frame, timestamp);
+    }
+    // the payload is bounded by the IPv4 length, not the frame
+    HyphaIpSpan_t payload = {.pointer = &frame->payload[header_length],
+                             .count = (uint32_t)(length - header_length),
+                             .type = HyphaIpSpanTypeUint8_t};
+    bool udp_verified =
+        context->capabilities.rx_udp_checksum && ((frame->info.flags & HyphaIpFrameFlagUdpChecksumVerified) != 0U);
+    return HyphaIpIPv4DeliverPayload(context, source, destination, protocol, timestamp, payload, udp_verified);
+}
 
+HyphaIpStatus_e HyphaIpIPv4DeliverPayload(HyphaIpContext_t context, HyphaIpIPv4Address_t source,
+                                          HyphaIpIPv4Address_t destination, uint8_t protocol,
+                                          HyphaIpTimestamp_t timestamp, HyphaIpSpan_t payload, bool udp_verified) {
     /// now handle each protocol
-    if (ip_header.protocol == HyphaIpProtocol_UDP) {
-        return HyphaIpUdpReceiveDatagram(context, &ip_header, timestamp, frame);
-    } else if (ip_header.protocol == HyphaIpProtocol_ICMP) {
+    if (protocol == HyphaIpProtocol_UDP) {
+        return HyphaIpUdpReceiveDatagram(context, source, destination, timestamp, payload, udp_verified);
+    } else if (protocol == HyphaIpProtocol_ICMP) {
         // TODO support?
         context->statistics.counter.icmp.rx.count++;
         HYPHA_IP_REPORT(context, HyphaIpStatusNotImplemented);
         return HyphaIpStatusNotImplemented;
-    } else if (ip_header.protocol == HyphaIpProtocol_IGMP) {
-        // TODO support receiving?
-        context->statistics.counter.igmp.rx.count++;
-        HYPHA_IP_REPORT(context, HyphaIpStatusNotImplemented);
-        return HyphaIpStatusNotImplemented;
+    } else if (protocol == HyphaIpProtocol_IGMP) {
+        return HyphaIpIgmpReceivePacket(context, timestamp, payload);
     }
     context->statistics.unknown.rejected++;
     return HyphaIpStatusUnsupportedProtocol;
 }
 
-HyphaIpStatus_e HyphaIpIPv4TransmitPacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
-                                          HyphaIpMetaData_t *metadata, HyphaIpProtocol_e ip_protocol,
-                                          HyphaIpSpan_t packet) {
-    if (context == nullptr) {
-        return HyphaIpStatusInvalidContext;
-    }
-    if (frame == nullptr || metadata == nullptr) {
-        return HyphaIpStatusInvalidArgument;
-    }
-    if (HyphaIpSpanIsEmpty(packet)) {
-        return HyphaIpStatusInvalidSpan;
+HyphaIpStatus_e HyphaIpIPv4SelectInterface(HyphaIpContext_t context, HyphaIpMetaData_t *metadata,
+                                           HyphaIpIPv4Address_t *next_hop) {
+    HyphaIpIPv4Address_t destination = metadata->destination_address;
+    *next_hop = destination;
+    if (HyphaIpIsMulticastIPv4Address(destination) || HyphaIpIsLimitedBroadcastIPv4Address(destination) ||
+        HyphaIpIsLocalhostIPv4Address(destination)) {
+        // these never leave by a route, the caller picks the interface
+        return (metadata->interface < context->interface_count) ? HyphaIpStatusOk : HyphaIpStatusInvalidArgument;
     }
-    if (HyphaIpSpanSize(packet) > HYPHA_IP_MAX_IP_PAYLOAD_SIZE) {
-        return HyphaIpStatusIPv4PacketTooLarge;
-    }
-    // check to make sure the destination is valid
-    bool to_multicast = HyphaIpIsMulticastIPv4Address(metadata->destination_address);
-    bool to_broadcast = HyphaIpIsLimitedBroadcastIPv4Address(metadata->destination_address);
-    bool to_localhost = HyphaIpIsLocalhostIPv4Address(metadata->destination_address);
-    bool to_our_address = HyphaIpIsOurIPv4Address(context, metadata->destination_address);
-
-    HyphaIpIPv4Address_t source_ip = context->interface.address;
-    if (to_localhost) {
-        bool from_localhost = HyphaIpIsLocalhostIPv4Address(metadata->source_address);
-        if (!from_localhost) {
-            source_ip = hypha_ip_localhost;
-        } else {
-            // this allows you to use 127.x.x.x for testing
-            source_ip = metadata->source_address;
+    for (size_t i = 0U; i < context->interface_count; i++) {
+        if (HyphaIpIsSameIPv4Address(context->interfaces[i].address, destination)) {
+            metadata->interface = (uint8_t)i;  // looped back as if it came in on that interface
+            return HyphaIpStatusOk;
         }
     }
+    HyphaIpNextHop_t hop;
+    HyphaIpStatus_e status = HyphaIpRouteLookup(context, destination, &hop);
+    if (HyphaIpIsSuccess(status)) {
+        metadata->interface = hop.interface;
+        *next_hop = hop.next_hop;
+    }
+    return status;
+}
 
-    if (!to_multicast && !to_broadcast && !to_localhost && !to_our_address) {
-        return HyphaIpStatusIPv4DestinationRejected;
+HyphaIpIPv4Address_t HyphaIpIPv4SelectSource(HyphaIpContext_t context, uint8_t interface,
+                                             HyphaIpIPv4Address_t destination, HyphaIpIPv4Address_t requested) {
+    if (HyphaIpIsLocalhostIPv4Address(destination)) {
+        // this allows you to use 127.x.x.x for testing
+        return HyphaIpIsLocalhostIPv4Address(requested) ? requested : hypha_ip_localhost;
     }
+    return context->interfaces[interface].address;
+}
 
+HyphaIpIPv4Header_t HyphaIpIPv4MakeHeader(HyphaIpContext_t context, uint8_t interface,
+                                          HyphaIpIPv4Address_t destination, HyphaIpIPv4Address_t requested,
+                                          HyphaIpProtocol_e protocol, size_t payload_length) {
     HyphaIpIPv4Header_t ip_header = {
         .version = 4,
         .IHL = 5,  // no options are supported, so the header length is 5 * sizeof(uint32_t) = 20 bytes
         .DSCP = 0,
         .ECN = 0,
-        .length = (uint16_t)(sizeof(HyphaIpIPv4Header_t) + (uint16_t)HyphaIpSpanSize(packet)),
-        .identification = 0,  // no fragmentation, so ID is 0
+        .length = (uint16_t)(sizeof(HyphaIpIPv4Header_t) + payload_length),
+        .identification = 0,  // only fragments need an ID
         .zero = 0,
         .DF = 0,
         .MF = 0,
         .fragment_offset = 0,
         .TTL = HYPHA_IP_TTL,
-        .protocol = ip_protocol,
+        .protocol = protocol,
         .checksum = 0,  // must start as zero
-        .source = source_ip,
-        .destination = metadata->destination_address,
+        .source = HyphaIpIPv4SelectSource(context, interface, destination, requested),
+        .destination = destination,
     };
+    return ip_header;
+}
+
+HyphaIpStatus_e HyphaIpIPv4TransmitPacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                          HyphaIpMetaData_t *metadata, HyphaIpProtocol_e ip_protocol,
+                                          HyphaIpSpan_t packet) {
+    HyphaIpIPv4Fragment_t const whole = {.identification = 0U, .offset = 0U, .more = false};
+    return HyphaIpIPv4TransmitFragment(context, frame, metadata, ip_protocol, packet, whole);
+}
+
+HyphaIpStatus_e HyphaIpIPv4TransmitFragment(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                            HyphaIpMetaData_t *metadata, HyphaIpProtocol_e ip_protocol,
+                                            HyphaIpSpan_t packet, HyphaIpIPv4Fragment_t fragment) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (frame == nullptr || metadata == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (HyphaIpSpanIsEmpty(packet)) {
+        return HyphaIpStatusInvalidSpan;
+    }
+    if (HyphaIpSpanSize(packet) > HYPHA_IP_MAX_IP_PAYLOAD_SIZE) {
+        return HyphaIpStatusIPv4PacketTooLarge;
+    }
+    // other hosts are resolved over ARP, either directly on the link or through the gateway of their route
+    HyphaIpIPv4Address_t next_hop;
+    HyphaIpStatus_e selected = HyphaIpIPv4SelectInterface(context, metadata, &next_hop);
+    if (HyphaIpIsFailure(selected)) {
+        return selected;
+    }
+    bool to_localhost = HyphaIpIsLocalhostIPv4Address(metadata->destination_address);
+    bool to_our_address = HyphaIpIsOurIPv4Address(context, metadata->destination_address);
+    frame->info.interface = metadata->interface;
+
+    HyphaIpIPv4Header_t ip_header =
+        HyphaIpIPv4MakeHeader(context, metadata->interface, metadata->destination_address, metadata->source_address,
+                              ip_protocol, HyphaIpSpanSize(packet));
+    ip_header.identification = fragment.identification;
+    ip_header.MF = fragment.more ? 1U : 0U;
+    ip_header.fragment_offset = (uint16_t)(fragment.offset / 8U) & HYPHA_IP_IPv4_FRAGMENT_MASK;
 
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
                    "TX: IP Header: Version=%u, IHL=%u, DSCP=%u, ECN=%u, Length=%u, ID=%u, DF=%u, MF=%u, "
@@ -349,19 +518,27 @@ HyphaIpStatus_e HyphaIpIPv4TransmitPacket(HyphaIpContext_t context, HyphaIpEther
     // copy-flip the header into the right place, payload is already there
     HyphaIpCopyIPHeaderToFrame(frame, &ip_header);
 
-    if (HYPHA_IP_USE_IP_CHECKSUM) {
-        HyphaIpSpan_t ip_header_span = HyphaIpSpanIpHeader(frame);
-        HyphaIpSpan_t ip_payload_span = HYPHA_IP_DEFAULT_SPAN;
-        // compute the IP checksum (and save the 1's compliment)
-        ip_header.checksum = ~HyphaIpComputeChecksum(ip_header_span, ip_payload_span);
+    // frames which are looped back never reach the driver, so they can not be offloaded
+    bool loopback = to_localhost || to_our_address;
+    if (HYPHA_IP_USE_IP_CHECKSUM && context->capabilities.tx_ipv4_checksum && !loopback) {
+        // the checksum is left as zero for the driver to fill in
+        frame->info.flags |= HyphaIpFrameFlagIPv4ChecksumInsert;
+        context->statistics.checksums.ipv4.tx_offloaded++;
+    } else if (HYPHA_IP_USE_IP_CHECKSUM) {
+        context->statistics.checksums.ipv4.tx_software++;
+        // only the words which changed since the last header are summed (RFC 1624)
+        uint16_t words[HYPHA_IP_CHECKSUM_CACHE_WORDS];
+        memcpy(words, &frame->payload[HyphaIpOffsetOfIPHeader()], sizeof(HyphaIpIPv4Header_t));
+        ip_header.checksum = HyphaIpChecksumCached(&context->tx_checksums.ipv4, HYPHA_IP_DIMOF(words), words);
         HyphaIpUpdateIpChecksumInFrame(frame, ip_header.checksum);
     } else {
         // maybe hardware will do this for us? leave it as 0
     }
 
-    if (to_localhost || to_our_address) {
+    if (loopback) {
         // capture the timestamp now since it's going to the ethernet driver
         metadata->timestamp = context->external.get_monotonic_timestamp(context->theirs);
+        frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + sizeof(ip_header) + HyphaIpSpanSize(packet));
         // call the receive function directly since it's localhost
         return HyphaIpIPv4ReceivePacket(context, frame, metadata->timestamp);
     }  // otherwise continue to the ethernet layer
@@ -369,7 +546,7 @@ HyphaIpStatus_e HyphaIpIPv4TransmitPacket(HyphaIpContext_t context, HyphaIpEther
     size_t const full_packet_length = sizeof(ip_header) + HyphaIpSpanSize(packet);
     // fill in the ethernet header and transmit in this function
     HyphaIpStatus_e status =
-        HyphaIpEthernetTransmitFrame(context, frame, metadata, HyphaIpEtherType_IPv4, full_packet_length);
+        HyphaIpEthernetTransmitFrame(context, frame, metadata, next_hop, HyphaIpEtherType_IPv4, full_packet_length);
     if (HyphaIpIsSuccess(status)) {
         // if the transmission was successful, we can update the statistics
         context->statistics.counter.ipv4.tx.count++;
@@ -0,0 +1,187 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The Hypha IP IPv4 fragment reassembly implementation.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+/// The number of bits in each word of the received block map
+#define HYPHA_IP_REASSEMBLY_WORD_BITS (sizeof(uint32_t) * 8U)
+
+HyphaIpStatus_e HyphaIpProvideReassemblySlots(HyphaIpContext_t context, size_t len,
+                                              HyphaIpReassemblySlot_t slots[len]) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if ((len > 0U && slots == nullptr) || len > HYPHA_IP_REASSEMBLY_SLOTS) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    // the datagrams in the slots which are given up are dropped with their timers
+    for (size_t i = 0U; i < context->reassembly.count; i++) {
+        HyphaIpTimerCancel(context, &context->reassembly.slots[i].timer);
+    }
+    for (size_t i = 0U; i < len; i++) {
+        slots[i].in_use = false;
+        slots[i].timer = 0U;
+    }
+    context->reassembly.count = len;
+    context->reassembly.slots = slots;
+    return HyphaIpStatusOk;
+}
+
+void HyphaIpReassemblyExpire(HyphaIpContext_t context, uint32_t key) {
+    if (key >= context->reassembly.count) {
+        return;
+    }
+    HyphaIpReassemblySlot_t *slot = &context->reassembly.slots[key];
+    slot->timer = 0U;  // the timer has been given back
+    if (slot->in_use) {
+        HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerIPv4,
+                       "Reassembly of ID=%u from " PRIuIPv4Address " timed out with %u blocks\r\n",
+                       slot->identification, slot->source.a, slot->source.b, slot->source.c, slot->source.d,
+                       slot->blocks);
+        slot->in_use = false;
+        context->statistics.reassembly.timeouts++;
+    }
+}
+
+/// Empties the slot and stops its timer
+static void HyphaIpReassemblyFree(HyphaIpContext_t context, HyphaIpReassemblySlot_t *slot) {
+    HyphaIpTimerCancel(context, &slot->timer);
+    slot->in_use = false;
+}
+
+/// @return True if any block from `first` on has been received
+static bool HyphaIpReassemblyMarkedFrom(HyphaIpReassemblySlot_t const *slot, size_t first) {
+    size_t word = first / HYPHA_IP_REASSEMBLY_WORD_BITS;
+    uint32_t mask = UINT32_MAX << (first % HYPHA_IP_REASSEMBLY_WORD_BITS);
+    for (; word < HYPHA_IP_DIMOF(slot->received); word++) {
+        if ((slot->received[word] & mask) != 0U) {
+            return true;
+        }
+        mask = UINT32_MAX;
+    }
+    return false;
+}
+
+/// Finds the slot of the datagram the fragment belongs to, or starts a new one, evicting the oldest if needed
+/// @return The slot, or nullptr when there was no timer to drop a new datagram with
+static HyphaIpReassemblySlot_t *HyphaIpReassemblyFind(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame,
+                                                      HyphaIpTimestamp_t timestamp) {
+    HyphaIpIPv4Address_t source = HyphaIpPeekIPv4Source(frame);
+    HyphaIpIPv4Address_t destination = HyphaIpPeekIPv4Destination(frame);
+    uint16_t identification = HyphaIpPeekIPv4Identification(frame);
+    uint8_t protocol = HyphaIpPeekIPv4Protocol(frame);
+    HyphaIpReassemblySlot_t *available = nullptr;
+    HyphaIpReassemblySlot_t *oldest = nullptr;
+    for (size_t i = 0U; i < context->reassembly.count; i++) {
+        HyphaIpReassemblySlot_t *slot = &context->reassembly.slots[i];
+        if (!slot->in_use) {
+            available = (available == nullptr) ? slot : available;
+            continue;
+        }
+        // RFC 791, fragments are matched on the addresses, protocol and identification
+        bool same_addresses = HyphaIpIsSameIPv4Address(slot->source, source) &&
+                              HyphaIpIsSameIPv4Address(slot->destination, destination);
+        if (same_addresses && slot->identification == identification && slot->protocol == protocol) {
+            return slot;
+        }
+        if (oldest == nullptr || slot->expiry < oldest->expiry) {
+            oldest = slot;
+        }
+    }
+    if (available == nullptr) {
+        HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerIPv4,
+                       "Reassembly of ID=%u evicted with %u blocks\r\n", oldest->identification, oldest->blocks);
+        context->statistics.reassembly.evictions++;
+        available = oldest;
+    }
+    available->expiry = timestamp + HYPHA_IP_REASSEMBLY_TIMEOUT;
+    uint32_t key = (uint32_t)(available - context->reassembly.slots);
+    HyphaIpStatus_e status =
+        HyphaIpTimerSchedule(context, &available->timer, HyphaIpTimerKindReassembly, key, available->expiry);
+    if (HyphaIpIsFailure(status)) {
+        available->in_use = false;
+        return nullptr;
+    }
+    available->source = source;
+    available->destination = destination;
+    available->identification = identification;
+    available->protocol = protocol;
+    available->in_use = true;
+    available->length = 0U;
+    available->blocks = 0U;
+    memset(available->received, 0, sizeof(available->received));
+    return available;
+}
+
+/// Marks the blocks [first, last) as received a word at a time
+/// @return The number of blocks which had not been received before
+static uint16_t HyphaIpReassemblyMark(HyphaIpReassemblySlot_t *slot, size_t first, size_t last) {
+    uint16_t added = 0U;
+    while (first < last) {
+        size_t word = first / HYPHA_IP_REASSEMBLY_WORD_BITS;
+        size_t bit = first % HYPHA_IP_REASSEMBLY_WORD_BITS;
+        size_t count = HYPHA_IP_REASSEMBLY_WORD_BITS - bit;
+        count = (count < (last - first)) ? count : (last - first);
+        uint32_t mask = (count == HYPHA_IP_REASSEMBLY_WORD_BITS) ? UINT32_MAX : (((1U << count) - 1U) << bit);
+        added += (uint16_t)__builtin_popcount(mask & ~slot->received[word]);
+        slot->received[word] |= mask;
+        first += count;
+    }
+    return added;
+}
+
+HyphaIpStatus_e HyphaIpIPv4Reassemble(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame,
+                                      HyphaIpTimestamp_t timestamp) {
+    context->statistics.reassembly.fragments++;
+    uint16_t fragment = HyphaIpPeekIPv4Fragment(frame);
+    size_t offset = (size_t)(fragment & HYPHA_IP_IPv4_FRAGMENT_MASK) * 8U;
+    size_t length = HyphaIpPeekIPv4Length(frame) - sizeof(HyphaIpIPv4Header_t);
+    bool more = (fragment & HYPHA_IP_IPv4_FLAG_MF) != 0U;
+    // every fragment but the last must hold whole blocks
+    if (length == 0U || (more && (length % 8U) != 0U)) {
+        context->statistics.reassembly.rejected++;
+        return HyphaIpStatusIPv4HeaderRejected;
+    }
+    if ((offset + length) > HYPHA_IP_REASSEMBLY_SIZE) {
+        context->statistics.reassembly.rejected++;
+        return HyphaIpStatusIPv4PacketTooLarge;
+    }
+    HyphaIpReassemblySlot_t *slot = HyphaIpReassemblyFind(context, frame, timestamp);
+    if (slot == nullptr) {
+        context->statistics.reassembly.rejected++;
+        return HyphaIpStatusOutOfMemory;
+    }
+    // nothing may reach past the end of the datagram once the last fragment has said where that is
+    bool past_end = (slot->length != 0U) && ((offset + length) > slot->length);
+    bool moved_end = !more && (slot->length != 0U) && ((offset + length) != slot->length);
+    if (past_end || moved_end) {
+        context->statistics.reassembly.rejected++;
+        return HyphaIpStatusIPv4HeaderRejected;
+    }
+    if (!more) {
+        if (HyphaIpReassemblyMarkedFrom(slot, (offset + length + 7U) / 8U)) {
+            // an earlier fragment reached past this end, the datagram can never be put together
+            context->statistics.reassembly.rejected++;
+            HyphaIpReassemblyFree(context, slot);
+            return HyphaIpStatusIPv4HeaderRejected;
+        }
+        slot->length = (uint16_t)(offset + length);
+    }
+    memcpy(&slot->data[offset], &frame->payload[sizeof(HyphaIpIPv4Header_t)], length);
+    slot->blocks += HyphaIpReassemblyMark(slot, offset / 8U, (offset + length + 7U) / 8U);
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerIPv4,
+                   "Reassembly of ID=%u has %u blocks of %u\r\n", slot->identification, slot->blocks,
+                   (slot->length + 7U) / 8U);
+    if (slot->length == 0U || slot->blocks != ((slot->length + 7U) / 8U)) {
+        return HyphaIpStatusOk;  // there are still holes
+    }
+    context->statistics.reassembly.hits++;
+    HyphaIpSpan_t payload = {.pointer = slot->data, .count = slot->length, .type = HyphaIpSpanTypeUint8_t};
+    // the slot stays taken while the listener looks at the data
+    HyphaIpStatus_e status = HyphaIpIPv4DeliverPayload(context, slot->source, slot->destination, slot->protocol,
+                                                       timestamp, payload, false);
+    HyphaIpReassemblyFree(context, slot);
+    return status;
+}
@@ -0,0 +1,242 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The transmit ring of the Hypha IP stack. Any thread may queue frames on it without taking a lock, the thread which
+/// owns the context drains them to the driver in bursts and keeps the statistics. Nothing else in the stack may be
+/// called from other threads.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+/// The mask of a position to its slot
+#define HYPHA_IP_TRANSMIT_RING_MASK (HYPHA_IP_TRANSMIT_RING_SIZE - 1U)
+
+/// Gives back the frames of the first `count` slots, the ones waiting for a refill have none
+static void HyphaIpRingReleaseSlots(HyphaIpContext_t context, size_t count) {
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    for (size_t i = 0U; i < count; i++) {
+        if (ring->slots[i].frame != nullptr) {
+            (void)HyphaIpDriverRelease(context, ring->slots[i].frame);
+            ring->slots[i].frame = nullptr;
+        }
+    }
+}
+
+/// Gives the drained slots fresh frames and hands them back to the producers, in order. A slot the driver has no
+/// frame for holds back the ones after it until a later drain.
+static void HyphaIpRingRefill(HyphaIpContext_t context) {
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    HyphaIpEthernetFrame_t *frames[HYPHA_IP_BATCH_SIZE];
+    while (ring->refill != ring->dequeue) {
+        size_t wanted = ring->dequeue - ring->refill;
+        wanted = (wanted < HYPHA_IP_DIMOF(frames)) ? wanted : HYPHA_IP_DIMOF(frames);
+        size_t acquired = HyphaIpDriverAcquireBatch(context, wanted, frames);
+        for (size_t i = 0U; i < acquired; i++) {
+            size_t position = ring->refill++;
+            HyphaIpTransmitSlot_t *slot = &ring->slots[position & HYPHA_IP_TRANSMIT_RING_MASK];
+            slot->frame = frames[i];
+            atomic_store_explicit(&slot->sequence, position + HYPHA_IP_TRANSMIT_RING_SIZE, memory_order_release);
+        }
+        if (acquired < wanted) {
+            break;
+        }
+    }
+}
+
+HyphaIpStatus_e HyphaIpStartTransmitRing(HyphaIpContext_t context) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    if (atomic_load_explicit(&ring->started, memory_order_relaxed)) {
+        return HyphaIpStatusBusy;
+    }
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(ring->slots); i++) {
+        HyphaIpEthernetFrame_t *frame = HyphaIpDriverAcquire(context);
+        if (frame == nullptr) {
+            HyphaIpRingReleaseSlots(context, i);
+            return HyphaIpStatusOutOfMemory;
+        }
+        ring->slots[i].frame = frame;
+        atomic_store_explicit(&ring->slots[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring->enqueue, 0U, memory_order_relaxed);
+    atomic_store_explicit(&ring->overflows, 0U, memory_order_relaxed);
+    ring->dequeue = 0U;
+    ring->refill = 0U;
+    // a producer which sees the ring started also sees the slots
+    atomic_store_explicit(&ring->started, true, memory_order_release);
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpStopTransmitRing(HyphaIpContext_t context) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    if (!atomic_load_explicit(&ring->started, memory_order_relaxed)) {
+        return HyphaIpStatusOk;
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    size_t drained = 0U;
+    do {
+        HyphaIpStatus_e result = HyphaIpDrainTransmitRing(context, &drained);
+        status = HyphaIpIsFailure(result) ? result : status;
+    } while (drained > 0U);
+    atomic_store_explicit(&ring->started, false, memory_order_release);
+    HyphaIpRingReleaseSlots(context, HYPHA_IP_DIMOF(ring->slots));
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpReserveTransmit(HyphaIpContext_t context, HyphaIpTransmitReservation_t *reservation) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (reservation == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    if (!atomic_load_explicit(&ring->started, memory_order_acquire)) {
+        return HyphaIpStatusBusy;
+    }
+    size_t position = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+    HyphaIpTransmitSlot_t *slot = nullptr;
+    for (;;) {
+        slot = &ring->slots[position & HYPHA_IP_TRANSMIT_RING_MASK];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t lag = (intptr_t)(sequence - position);
+        if (lag == 0) {
+            // the slot is free at this position, it is ours unless another producer claimed the position first
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue, &position, position + 1U, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // the slot still holds the frame from the lap before, which the owner has not drained
+            atomic_fetch_add_explicit(&ring->overflows, 1U, memory_order_relaxed);
+            return HyphaIpStatusTransmitRingFull;
+        } else {
+            // another producer took this position, try the next one
+            position = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+        }
+    }
+    HyphaIpEthernetFrame_t *frame = slot->frame;
+    frame->info.flags = HyphaIpFrameFlagNone;
+    frame->info.length = 0U;
+    frame->info.interface = 0U;
+    reservation->frame = frame;
+    reservation->position = position;
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpCommitTransmit(HyphaIpContext_t context, HyphaIpTransmitReservation_t const *reservation) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (reservation == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpTransmitSlot_t *slot = &context->transmit_ring.slots[reservation->position & HYPHA_IP_TRANSMIT_RING_MASK];
+    if (slot->frame != reservation->frame) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    // the release hands the bytes of the frame to the owner along with the turn of the slot
+    atomic_store_explicit(&slot->sequence, reservation->position + 1U, memory_order_release);
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpEnqueueTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (frame == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (frame->info.length < sizeof(HyphaIpEthernetHeader_t) || frame->info.length > HYPHA_IP_FRAME_CAPACITY) {
+        return HyphaIpStatusInvalidFrameLength;
+    }
+    HyphaIpTransmitReservation_t reservation;
+    HyphaIpStatus_e status = HyphaIpReserveTransmit(context, &reservation);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    // the header and the payload are one run of bytes
+    memcpy(&reservation.frame->header, &frame->header, frame->info.length);
+    reservation.frame->info.flags = frame->info.flags;
+    reservation.frame->info.length = frame->info.length;
+    reservation.frame->info.interface = frame->info.interface;
+    return HyphaIpCommitTransmit(context, &reservation);
+}
+
+HyphaIpStatus_e HyphaIpEnqueueUdpFlow(HyphaIpContext_t context, HyphaIpUdpFlow_t const *flow, HyphaIpSpan_t datagram) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpStatus_e status = HyphaIpUdpFlowCheck(flow, datagram);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    HyphaIpTransmitReservation_t reservation;
+    status = HyphaIpReserveTransmit(context, &reservation);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    (void)HyphaIpUdpFlowBuild(context, flow, reservation.frame, datagram);
+    return HyphaIpCommitTransmit(context, &reservation);
+}
+
+/// Transmits a committed frame of the ring, the frame stays in its slot
+static HyphaIpStatus_e HyphaIpRingTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame) {
+    if (frame->info.length == 0U) {
+        context->statistics.ring.cancelled++;
+        return HyphaIpStatusOk;
+    }
+    if (frame->info.length < sizeof(HyphaIpEthernetHeader_t) || frame->info.length > frame->info.capacity) {
+        context->statistics.mac.rejected++;
+        return HyphaIpStatusInvalidFrameLength;
+    }
+    if (frame->info.interface >= context->interface_count) {
+        context->statistics.mac.rejected++;
+        return HyphaIpStatusInvalidArgument;
+    }
+    return HyphaIpDriverTransmit(context, frame);
+}
+
+HyphaIpStatus_e HyphaIpDrainTransmitRing(HyphaIpContext_t context, size_t *drained) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (drained == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    *drained = 0U;
+    HyphaIpTransmitRing_t *ring = &context->transmit_ring;
+    if (!atomic_load_explicit(&ring->started, memory_order_relaxed)) {
+        return HyphaIpStatusOk;
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    size_t const first = ring->dequeue;
+    // only the ring transmits in the burst, so what the driver takes of it is what the ring drained
+    size_t const accepted = context->statistics.mac.accepted;
+    HyphaIpDriverBurstBegin(context);
+    for (; *drained < HYPHA_IP_BATCH_SIZE; (*drained)++) {
+        size_t position = first + *drained;
+        HyphaIpTransmitSlot_t *slot = &ring->slots[position & HYPHA_IP_TRANSMIT_RING_MASK];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != (position + 1U)) {
+            break;  // not committed yet, everything after it waits its turn
+        }
+        HyphaIpStatus_e result = HyphaIpRingTransmit(context, slot->frame);
+        HYPHA_IP_REPORT(context, result);
+        status = HyphaIpIsFailure(result) ? result : status;
+        // like any other transmitted frame it goes back to the driver, which may still be sending it from there
+        result = HyphaIpDriverRelease(context, slot->frame);
+        status = HyphaIpIsFailure(result) ? result : status;
+        slot->frame = nullptr;
+    }
+    HyphaIpStatus_e flushed = HyphaIpDriverBurstEnd(context);
+    status = HyphaIpIsFailure(flushed) ? flushed : status;
+    context->statistics.ring.drained += context->statistics.mac.accepted - accepted;
+    ring->dequeue = first + *drained;
+    HyphaIpRingRefill(context);
+    context->statistics.ring.overflows = atomic_load_explicit(&ring->overflows, memory_order_relaxed);
+    return status;
+}
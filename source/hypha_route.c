@@ -0,0 +1,213 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The interfaces and the routing table of the Hypha IP stack. Unicast transmits go by the longest matching prefix and
+/// the owner thread caches the answers by destination.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+/// @return The netmask of a prefix length from 0 to 32
+static inline uint32_t HyphaIpRouteNetmask(uint8_t length) {
+    return (length == 0U) ? 0U : (UINT32_MAX << (32U - length));
+}
+
+/// @return The cache slot of a destination
+static inline size_t HyphaIpRouteSlot(HyphaIpIPv4Address_t destination) {
+    // Fibonacci hashing spreads the mostly sequential hosts of a subnet over the whole cache
+    return (size_t)((HyphaIpIPv4AddressToValue(destination) * 0x9E37'79B1U) >> 16U) & (HYPHA_IP_ROUTE_CACHE_SIZE - 1U);
+}
+
+HyphaIpStatus_e HyphaIpRouteCheckInterface(HyphaIpNetworkInterface_t const *interface) {
+    // check the interface mac
+    if (HyphaIpIsMulticastEthernetAddress(interface->mac)) {
+        return HyphaIpStatusInvalidMacAddress;
+    }
+    // check that we don't have a multicast address
+    if (HyphaIpIsMulticastIPv4Address(interface->address)) {
+        return HyphaIpStatusInvalidIpAddress;
+    }
+    // check that we don't have a localhost address
+    if (HyphaIpIsLocalhostIPv4Address(interface->address)) {
+        return HyphaIpStatusInvalidIpAddress;
+    }
+    // the prefix length is the count of the netmask's bits, which only holds when they are all at the top
+    uint32_t network_mask = HyphaIpIPv4AddressToValue(interface->netmask);
+    if ((~network_mask & (~network_mask + 1U)) != 0U) {
+        return HyphaIpStatusInvalidNetwork;
+    }
+    // an interface without a gateway (0.0.0.0) only reaches its own network
+    if (HyphaIpIsSameIPv4Address(interface->gateway, hypha_ip_default_route)) {
+        return HyphaIpStatusOk;
+    }
+    // the address & mask should be on the same network as the gateway & mask
+    uint32_t our_network = HyphaIpIPv4AddressToValue(interface->address) & network_mask;
+    uint32_t gateway_network = HyphaIpIPv4AddressToValue(interface->gateway) & network_mask;
+    bool same_network = (our_network == gateway_network);
+    if (!same_network) {
+        return HyphaIpStatusInvalidNetwork;
+    }
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpRouteAdd(HyphaIpContext_t context, HyphaIpIPv4Prefix_t prefix, HyphaIpIPv4Address_t gateway,
+                                uint8_t interface) {
+    HyphaIpRoutes_t *routes = &HyphaIpTablesDraft(context, HyphaIpTableRoutes)->routes;
+    uint32_t netmask = HyphaIpRouteNetmask(prefix.length);
+    HyphaIpRoute_t route = {
+        .network = HyphaIpIPv4AddressToValue(prefix.address) & netmask,
+        .netmask = netmask,
+        .gateway = gateway,
+        .length = prefix.length,
+        .interface = interface,
+    };
+    size_t position = 0U;
+    // a route to the same network is replaced, otherwise it goes after every longer (or as long) prefix
+    for (; position < routes->count; position++) {
+        HyphaIpRoute_t const *other = &routes->table[position];
+        if (other->length == route.length && other->network == route.network) {
+            break;
+        }
+        if (other->length < route.length) {
+            break;
+        }
+    }
+    bool replace = (position < routes->count) && (routes->table[position].length == route.length) &&
+                   (routes->table[position].network == route.network);
+    if (!replace) {
+        if (routes->count == HYPHA_IP_DIMOF(routes->table)) {
+            return HyphaIpStatusRouteTableFull;
+        }
+        memmove(&routes->table[position + 1U], &routes->table[position],
+                (routes->count - position) * sizeof(HyphaIpRoute_t));
+        routes->count++;
+    }
+    routes->table[position] = route;
+    routes->generation++;
+    return HyphaIpStatusOk;
+}
+
+/// Finds the next hop of a destination by the longest matching prefix
+static HyphaIpStatus_e HyphaIpRouteSearch(HyphaIpRoutes_t const *routes, HyphaIpIPv4Address_t destination,
+                                          HyphaIpNextHop_t *hop) {
+    uint32_t value = HyphaIpIPv4AddressToValue(destination);
+    for (size_t i = 0U; i < routes->count; i++) {
+        HyphaIpRoute_t const *route = &routes->table[i];
+        if ((value & route->netmask) != route->network) {
+            continue;
+        }
+        // the table is in order of decreasing prefix length, so the first match is the longest
+        bool on_link = HyphaIpIsSameIPv4Address(route->gateway, hypha_ip_default_route);
+        *hop = (HyphaIpNextHop_t){
+            .destination = destination,
+            .next_hop = on_link ? destination : route->gateway,
+            .interface = route->interface,
+            .valid = true,
+        };
+        return HyphaIpStatusOk;
+    }
+    return HyphaIpStatusNoRoute;
+}
+
+HyphaIpStatus_e HyphaIpRouteLookup(HyphaIpContext_t context, HyphaIpIPv4Address_t destination,
+                                   HyphaIpNextHop_t *hop) {
+    HyphaIpRouteCache_t *cache = &context->route_cache;
+    HyphaIpTables_t const *tables = HyphaIpTablesReadBegin(context);
+    if (cache->generation != tables->routes.generation) {
+        // any remembered next hop may now be a different one, the other tables changing does not matter here
+        memset(cache->hops, 0, sizeof(cache->hops));
+        cache->generation = tables->routes.generation;
+    }
+    HyphaIpNextHop_t *cached = &cache->hops[HyphaIpRouteSlot(destination)];
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (cached->valid && HyphaIpIsSameIPv4Address(cached->destination, destination)) {
+        context->statistics.routes.hits++;
+    } else {
+        context->statistics.routes.misses++;
+        status = HyphaIpRouteSearch(&tables->routes, destination, cached);
+    }
+    HyphaIpTablesReadEnd(context);
+    if (HyphaIpIsFailure(status)) {
+        context->statistics.routes.unreachable++;
+        return status;
+    }
+    *hop = *cached;
+    return HyphaIpStatusOk;
+}
+
+/// Adds an interface which has already been checked, with the route to its network
+static HyphaIpStatus_e HyphaIpRouteAppendInterface(HyphaIpContext_t context,
+                                                   HyphaIpNetworkInterface_t const *interface, uint8_t *index) {
+    if (context->interface_count == HYPHA_IP_DIMOF(context->interfaces)) {
+        return HyphaIpStatusInterfaceTableFull;
+    }
+    uint8_t number = (uint8_t)context->interface_count;
+    uint32_t netmask = HyphaIpIPv4AddressToValue(interface->netmask);
+    // each network is reached through one interface, a second one would take over the route of the first
+    for (size_t i = 0U; i < context->interface_count; i++) {
+        HyphaIpNetworkInterface_t const *other = &context->interfaces[i];
+        uint32_t shorter = netmask & HyphaIpIPv4AddressToValue(other->netmask);
+        uint32_t differ = HyphaIpIPv4AddressToValue(interface->address) ^ HyphaIpIPv4AddressToValue(other->address);
+        if ((differ & shorter) == 0U) {
+            return HyphaIpStatusInvalidNetwork;
+        }
+    }
+    HyphaIpIPv4Prefix_t network = {.address = interface->address, .length = (uint8_t)__builtin_popcount(netmask)};
+    HyphaIpStatus_e status = HyphaIpRouteAdd(context, network, hypha_ip_default_route, number);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    context->interfaces[number] = *interface;
+    context->interface_count++;
+    if (index != nullptr) {
+        *index = number;
+    }
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpRouteFirstInterface(HyphaIpContext_t context, HyphaIpNetworkInterface_t const *interface) {
+    HyphaIpTablesLock(context);
+    HyphaIpStatus_e status = HyphaIpRouteAppendInterface(context, interface, nullptr);
+    // with no gateway only the network of the interface is reachable
+    if (HyphaIpIsSuccess(status) && !HyphaIpIsSameIPv4Address(interface->gateway, hypha_ip_default_route)) {
+        HyphaIpIPv4Prefix_t everywhere = {.address = hypha_ip_default_route, .length = 0U};
+        status = HyphaIpRouteAdd(context, everywhere, interface->gateway, 0U);
+    }
+    HyphaIpTablesUnlock(context);
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpAddInterface(HyphaIpContext_t context, HyphaIpNetworkInterface_t const *interface,
+                                    uint8_t *index) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (interface == nullptr || index == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpStatus_e status = HyphaIpRouteCheckInterface(interface);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    HyphaIpTablesLock(context);
+    status = HyphaIpRouteAppendInterface(context, interface, index);
+    HyphaIpTablesUnlock(context);
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpAddRoute(HyphaIpContext_t context, HyphaIpIPv4Prefix_t prefix, HyphaIpIPv4Address_t gateway,
+                                uint8_t interface) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (interface >= context->interface_count || prefix.length > 32U) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    bool on_link = HyphaIpIsSameIPv4Address(gateway, hypha_ip_default_route);
+    if (!on_link && !HyphaIpIsInOurNetwork(context, interface, gateway)) {
+        return HyphaIpStatusInvalidNetwork;
+    }
+    HyphaIpTablesLock(context);
+    HyphaIpStatus_e status = HyphaIpRouteAdd(context, prefix, gateway, interface);
+    HyphaIpTablesUnlock(context);
+    return status;
+}
@@ -122,18 +122,41 @@ HyphaIpSpan_t HyphaIpSpanUdpHeader(HyphaIpEthernetFrame_t *frame) {
 
 HyphaIpSpan_t HyphaIpSpanUdpDatagram(HyphaIpEthernetFrame_t *frame) {
     size_t offset = HyphaIpOffsetOfUDPHeader();
-    size_t length = (sizeof(frame->payload) - offset) / sizeof(uint16_t);
+    size_t capacity = HyphaIpFramePayloadCapacity(frame);
+    size_t length = ((capacity > offset) ? (capacity - offset) : 0U) / sizeof(uint16_t);
     return (HyphaIpSpan_t){
         .pointer = &frame->payload[offset], .count = (uint32_t)length, .type = HyphaIpSpanTypeUint16_t};
 }
 
 HyphaIpSpan_t HyphaIpSpanUdpPayload(HyphaIpEthernetFrame_t *frame) {
     size_t offset = HyphaIpOffsetOfUDPPayload();
-    size_t length = (sizeof(frame->payload) - offset) / sizeof(uint16_t);
+    size_t capacity = HyphaIpFramePayloadCapacity(frame);
+    size_t length = ((capacity > offset) ? (capacity - offset) : 0U) / sizeof(uint16_t);
     return (HyphaIpSpan_t){
         .pointer = &frame->payload[offset], .count = (uint32_t)length, .type = HyphaIpSpanTypeUint16_t};
 }
 
+size_t HyphaIpSpanGather(uint8_t *destination, size_t size, size_t count, HyphaIpSpan_t const spans[count],
+                         HyphaIpSpanCursor_t *cursor) {
+    size_t gathered = 0U;
+    while (gathered < size && cursor->index < count) {
+        HyphaIpSpan_t const *span = &spans[cursor->index];
+        size_t available = HyphaIpSpanSize(*span) - cursor->offset;
+        size_t wanted = size - gathered;
+        size_t chunk = (available < wanted) ? available : wanted;
+        if (chunk > 0U) {
+            memcpy(&destination[gathered], &((uint8_t const *)span->pointer)[cursor->offset], chunk);
+            gathered += chunk;
+        }
+        cursor->offset += chunk;
+        if (cursor->offset == HyphaIpSpanSize(*span)) {
+            cursor->index++;
+            cursor->offset = 0U;
+        }
+    }
+    return gathered;
+}
+
 bool HyphaIpSpanResize(HyphaIpSpan_t *span, uint32_t new_size) {
     if (new_size > span->count) {
         return false;  // Cannot resize to a larger size
@@ -0,0 +1,130 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The versions of the routes, filters and ARP cache of the Hypha IP stack. Any thread may change the tables, the
+/// owner thread reads them on every frame without taking a lock or waiting on a writer.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+void HyphaIpTablesInitialize(HyphaIpContext_t context) {
+    HyphaIpTableVersions_t *tables = &context->tables;
+    atomic_store_explicit(&tables->current, &tables->versions[0], memory_order_relaxed);
+    atomic_store_explicit(&tables->epoch, 0U, memory_order_relaxed);
+    atomic_flag_clear_explicit(&tables->writer, memory_order_relaxed);
+    tables->draft = nullptr;
+    tables->retired = 0U;
+    tables->copied = 0U;
+    tables->stale = HyphaIpTableNone;
+    tables->drafted = HyphaIpTableNone;
+    tables->depth = 0U;
+}
+
+HyphaIpTables_t const *HyphaIpTablesReadBegin(HyphaIpContext_t context) {
+    HyphaIpTableVersions_t *tables = &context->tables;
+    if (tables->depth++ == 0U) {
+        // only the owner stores the epoch, the store has to come before the load of the version in every thread's eyes
+        size_t epoch = atomic_load_explicit(&tables->epoch, memory_order_relaxed);
+        atomic_store_explicit(&tables->epoch, epoch + 1U, memory_order_seq_cst);
+    }
+    return atomic_load_explicit(&tables->current, memory_order_seq_cst);
+}
+
+void HyphaIpTablesReadEnd(HyphaIpContext_t context) {
+    HyphaIpTableVersions_t *tables = &context->tables;
+    if (--tables->depth == 0U) {
+        // the release hands the version back, a writer which sees the even epoch may write over it
+        size_t epoch = atomic_load_explicit(&tables->epoch, memory_order_relaxed);
+        atomic_store_explicit(&tables->epoch, epoch + 1U, memory_order_release);
+    }
+}
+
+void HyphaIpTablesLock(HyphaIpContext_t context) {
+    while (atomic_flag_test_and_set_explicit(&context->tables.writer, memory_order_acquire)) {
+        // the other writer only holds the flag for a copy and a few changes
+    }
+}
+
+bool HyphaIpTablesTryLock(HyphaIpContext_t context) {
+    return !atomic_flag_test_and_set_explicit(&context->tables.writer, memory_order_acquire);
+}
+
+/// Copies the tables in the mask from one version into another
+/// @return The number of bytes copied
+static size_t HyphaIpTablesCopy(HyphaIpTables_t *to, HyphaIpTables_t const *from, uint8_t tables) {
+    size_t copied = 0U;
+    if ((tables & HyphaIpTableRoutes) != 0U) {
+        to->routes = from->routes;
+        copied += sizeof(from->routes);
+    }
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+    if ((tables & HyphaIpTableEthernetFilter) != 0U) {
+        memcpy(to->allowed_ethernet_addresses, from->allowed_ethernet_addresses,
+               sizeof(from->allowed_ethernet_addresses));
+        copied += sizeof(from->allowed_ethernet_addresses);
+    }
+    if ((tables & HyphaIpTableMulticastFilter) != 0U) {
+        to->multicast_filter = from->multicast_filter;
+        copied += sizeof(from->multicast_filter);
+    }
+#endif
+#if (HYPHA_IP_USE_IP_FILTER == 1)
+    if ((tables & HyphaIpTableIPv4Filter) != 0U) {
+        to->allowed_ipv4_addresses = from->allowed_ipv4_addresses;
+        copied += sizeof(from->allowed_ipv4_addresses);
+    }
+#endif
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    if ((tables & HyphaIpTableArpCache) != 0U) {
+        to->arp_cache = from->arp_cache;
+        copied += sizeof(from->arp_cache);
+    }
+#endif
+    return copied;
+}
+
+HyphaIpTables_t *HyphaIpTablesDraft(HyphaIpContext_t context, HyphaIpTable_e tables) {
+    HyphaIpTableVersions_t *versions = &context->tables;
+    // only writers store the current version and the flag orders them
+    HyphaIpTables_t *current = atomic_load_explicit(&versions->current, memory_order_relaxed);
+    if (versions->draft == nullptr) {
+        HyphaIpTables_t *spare = (current == &versions->versions[0]) ? &versions->versions[1] : &versions->versions[0];
+        if ((versions->retired % 2U) == 1U) {
+            while (atomic_load_explicit(&versions->epoch, memory_order_acquire) == versions->retired) {
+                // the owner was reading when the spare was replaced, it may still be looking at it until that read ends
+            }
+            versions->retired = 0U;
+        }
+        spare->generation = current->generation;
+        spare->populated = current->populated;
+        // whatever the last writer changed is brought up to date, as the whole spare is published
+        versions->copied += HyphaIpTablesCopy(spare, current, versions->stale);
+        versions->drafted = versions->stale;
+        versions->stale = HyphaIpTableNone;
+        versions->draft = spare;
+    }
+    uint8_t missing = (uint8_t)(tables & ~versions->drafted);
+    versions->copied += HyphaIpTablesCopy(versions->draft, current, missing);
+    versions->drafted |= missing;
+    versions->stale |= tables;  // the replaced version is behind in these once the draft is published
+    return versions->draft;
+}
+
+HyphaIpTables_t const *HyphaIpTablesPeek(HyphaIpContext_t context, HyphaIpTable_e tables) {
+    HyphaIpTableVersions_t *versions = &context->tables;
+    if (versions->draft != nullptr && (tables & ~versions->drafted) == 0U) {
+        return versions->draft;
+    }
+    return atomic_load_explicit(&versions->current, memory_order_relaxed);
+}
+
+void HyphaIpTablesUnlock(HyphaIpContext_t context) {
+    HyphaIpTableVersions_t *tables = &context->tables;
+    if (tables->draft != nullptr) {
+        tables->draft->generation++;
+        atomic_store_explicit(&tables->current, tables->draft, memory_order_seq_cst);
+        // any read which starts from here on gets the new version, only one which is already running has the old one
+        tables->retired = atomic_load_explicit(&tables->epoch, memory_order_seq_cst);
+        tables->draft = nullptr;
+    }
+    atomic_flag_clear_explicit(&tables->writer, memory_order_release);
+}
@@ -0,0 +1,392 @@
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+/// @file
+/// The Hypha IP timer wheel implementation.
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hypha_ip/hypha_internal.h"
+
+/// The number which ends a list of timers
+#define HYPHA_IP_TIMER_NONE 0U
+
+/// @return The timer of the number
+static inline HyphaIpTimer_t *HyphaIpTimerOf(HyphaIpTimerWheel_t *wheel, uint16_t number) {
+    return &wheel->timers[number - 1U];
+}
+
+/// @return The tick at which a deadline is reached, rounded up so no timer fires early
+static inline HyphaIpTimestamp_t HyphaIpTimerTick(HyphaIpTimestamp_t deadline) {
+    return (deadline + HYPHA_IP_TIMER_RESOLUTION - 1) / HYPHA_IP_TIMER_RESOLUTION;
+}
+
+/// Puts the timer at the front of the list
+static void HyphaIpTimerLink(HyphaIpTimerWheel_t *wheel, uint16_t number, uint16_t list) {
+    HyphaIpTimer_t *timer = HyphaIpTimerOf(wheel, number);
+    timer->list = list;
+    timer->previous = HYPHA_IP_TIMER_NONE;
+    timer->next = wheel->lists[list];
+    if (timer->next != HYPHA_IP_TIMER_NONE) {
+        HyphaIpTimerOf(wheel, timer->next)->previous = number;
+    }
+    wheel->lists[list] = number;
+    if (list < HYPHA_IP_TIMER_LIST_OVERFLOW) {
+        wheel->pending[list / HYPHA_IP_TIMER_SLOTS] |= (1ULL << (list % HYPHA_IP_TIMER_SLOTS));
+    }
+}
+
+/// Takes the timer off its list
+static void HyphaIpTimerUnlink(HyphaIpTimerWheel_t *wheel, uint16_t number) {
+    HyphaIpTimer_t *timer = HyphaIpTimerOf(wheel, number);
+    if (timer->previous == HYPHA_IP_TIMER_NONE) {
+        wheel->lists[timer->list] = timer->next;
+    } else {
+        HyphaIpTimerOf(wheel, timer->previous)->next = timer->next;
+    }
+    if (timer->next != HYPHA_IP_TIMER_NONE) {
+        HyphaIpTimerOf(wheel, timer->next)->previous = timer->previous;
+    }
+    if (timer->list < HYPHA_IP_TIMER_LIST_OVERFLOW && wheel->lists[timer->list] == HYPHA_IP_TIMER_NONE) {
+        wheel->pending[timer->list / HYPHA_IP_TIMER_SLOTS] &= ~(1ULL << (timer->list % HYPHA_IP_TIMER_SLOTS));
+    }
+}
+
+/// Puts the timer on the list its deadline belongs in from now
+static void HyphaIpTimerPlace(HyphaIpTimerWheel_t *wheel, uint16_t number) {
+    HyphaIpTimestamp_t tick = HyphaIpTimerTick(HyphaIpTimerOf(wheel, number)->deadline);
+    if (tick <= wheel->now) {
+        HyphaIpTimerLink(wheel, number, HYPHA_IP_TIMER_LIST_EXPIRED);
+        return;
+    }
+    // the level is the highest digit where the tick differs from now
+    uint64_t differ = (uint64_t)tick ^ (uint64_t)wheel->now;
+    size_t level = (size_t)(63 - __builtin_clzll(differ)) / HYPHA_IP_TIMER_SLOT_BITS;
+    if (level >= HYPHA_IP_TIMER_WHEEL_LEVELS) {
+        HyphaIpTimerLink(wheel, number, HYPHA_IP_TIMER_LIST_OVERFLOW);
+        return;
+    }
+    size_t slot = (size_t)((uint64_t)tick >> (level * HYPHA_IP_TIMER_SLOT_BITS)) % HYPHA_IP_TIMER_SLOTS;
+    HyphaIpTimerLink(wheel, number, (uint16_t)((level * HYPHA_IP_TIMER_SLOTS) + slot));
+}
+
+/// Places every timer of a list again, from the new now
+static void HyphaIpTimerReplace(HyphaIpTimerWheel_t *wheel, uint16_t list) {
+    uint16_t number = wheel->lists[list];
+    wheel->lists[list] = HYPHA_IP_TIMER_NONE;
+    if (list < HYPHA_IP_TIMER_LIST_OVERFLOW) {
+        wheel->pending[list / HYPHA_IP_TIMER_SLOTS] &= ~(1ULL << (list % HYPHA_IP_TIMER_SLOTS));
+    }
+    while (number != HYPHA_IP_TIMER_NONE) {
+        uint16_t next = HyphaIpTimerOf(wheel, number)->next;
+        HyphaIpTimerPlace(wheel, number);
+        number = next;
+    }
+}
+
+/// Moves the wheel to the tick. On each level the slots which have come around since the last tick drop their timers
+/// to the levels below (or onto the expired list). A level whose digit has not changed stops the walk, as none above
+/// it can have changed either.
+static void HyphaIpTimerAdvance(HyphaIpTimerWheel_t *wheel, HyphaIpTimestamp_t tick) {
+    uint64_t then = (uint64_t)wheel->now;
+    wheel->now = tick;
+    for (size_t level = 0U; level < HYPHA_IP_TIMER_WHEEL_LEVELS; level++) {
+        uint64_t from = then >> (level * HYPHA_IP_TIMER_SLOT_BITS);
+        uint64_t to = (uint64_t)tick >> (level * HYPHA_IP_TIMER_SLOT_BITS);
+        if (from == to) {
+            return;
+        }
+        // the slots (from, to] of this level, which is all of them after a whole turn
+        uint64_t passed = UINT64_MAX;
+        if ((to - from) < HYPHA_IP_TIMER_SLOTS) {
+            uint64_t run = (1ULL << (to - from)) - 1U;
+            size_t first = (size_t)((from + 1U) % HYPHA_IP_TIMER_SLOTS);
+            passed = (first == 0U) ? run : ((run << first) | (run >> (HYPHA_IP_TIMER_SLOTS - first)));
+        }
+        uint64_t due = wheel->pending[level] & passed;
+        while (due != 0U) {
+            size_t slot = (size_t)__builtin_ctzll(due);
+            due &= due - 1U;
+            HyphaIpTimerReplace(wheel, (uint16_t)((level * HYPHA_IP_TIMER_SLOTS) + slot));
+        }
+    }
+    // the top level has turned over, some of the far off timers may now be in reach
+    HyphaIpTimerReplace(wheel, HYPHA_IP_TIMER_LIST_OVERFLOW);
+}
+
+/// @return True if the timers of the kind age the entries of the tables, which are found in the index
+static inline bool HyphaIpTimerAges(HyphaIpTimerKind_e kind) {
+    return kind == HyphaIpTimerKindArpEntry || kind == HyphaIpTimerKindEthernetFilter ||
+           kind == HyphaIpTimerKindIPv4Filter;
+}
+
+/// @return The slot of the index where the search for the timer of the kind and key starts
+static inline size_t HyphaIpTimerHome(HyphaIpTimerKind_e kind, uint32_t key) {
+    uint32_t hash = (key ^ ((uint32_t)kind << 24U)) * 0x9E37'79B1U;
+    return (size_t)(((uint64_t)hash * HYPHA_IP_TIMER_INDEX_SIZE) >> 32U);
+}
+
+/// @return The slot of the index after the given one, wrapping around the end
+static inline size_t HyphaIpTimerNextSlot(size_t slot) {
+    return ((slot + 1U) == HYPHA_IP_TIMER_INDEX_SIZE) ? 0U : (slot + 1U);
+}
+
+/// @return The slot of the index which holds the timer of the kind and key, or the empty slot where it would go
+static size_t HyphaIpTimerSlot(HyphaIpTimerWheel_t *wheel, HyphaIpTimerKind_e kind, uint32_t key) {
+    size_t slot = HyphaIpTimerHome(kind, key);
+    while (wheel->aging[slot] != HYPHA_IP_TIMER_NONE) {
+        HyphaIpTimer_t const *timer = HyphaIpTimerOf(wheel, wheel->aging[slot]);
+        if (timer->kind == kind && timer->key == key) {
+            break;
+        }
+        slot = HyphaIpTimerNextSlot(slot);
+    }
+    return slot;
+}
+
+/// Empties a slot of the index, shifting the rest of the run back over the hole like the ARP indexes
+static void HyphaIpTimerUnindex(HyphaIpTimerWheel_t *wheel, size_t slot) {
+    size_t hole = slot;
+    for (size_t next = HyphaIpTimerNextSlot(slot); wheel->aging[next] != HYPHA_IP_TIMER_NONE;
+         next = HyphaIpTimerNextSlot(next)) {
+        HyphaIpTimer_t const *timer = HyphaIpTimerOf(wheel, wheel->aging[next]);
+        size_t home = HyphaIpTimerHome(timer->kind, timer->key);
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            wheel->aging[hole] = wheel->aging[next];
+            hole = next;
+        }
+    }
+    wheel->aging[hole] = HYPHA_IP_TIMER_NONE;
+}
+
+HyphaIpStatus_e HyphaIpTimerSchedule(HyphaIpContext_t context, uint16_t *timer, HyphaIpTimerKind_e kind, uint32_t key,
+                                     HyphaIpTimestamp_t deadline) {
+    HyphaIpTimerWheel_t *wheel = &context->timers;
+    uint16_t number = *timer;
+    if (number != HYPHA_IP_TIMER_NONE) {
+        HyphaIpTimerUnlink(wheel, number);
+    } else if (wheel->unused != HYPHA_IP_TIMER_NONE) {
+        number = wheel->unused;
+        wheel->unused = HyphaIpTimerOf(wheel, number)->next;
+    } else if (wheel->used < HYPHA_IP_TIMER_COUNT) {
+        number = ++wheel->used;
+    } else {
+        return HyphaIpStatusOutOfMemory;
+    }
+    HyphaIpTimer_t *entry = HyphaIpTimerOf(wheel, number);
+    entry->deadline = deadline;
+    entry->key = key;
+    entry->kind = kind;
+    HyphaIpTimerPlace(wheel, number);
+    *timer = number;
+    return HyphaIpStatusOk;
+}
+
+/// Takes the timer off its list (and out of the index) and gives it back
+static void HyphaIpTimerFree(HyphaIpTimerWheel_t *wheel, uint16_t number) {
+    HyphaIpTimer_t *timer = HyphaIpTimerOf(wheel, number);
+    HyphaIpTimerUnlink(wheel, number);
+    if (HyphaIpTimerAges(timer->kind)) {
+        HyphaIpTimerUnindex(wheel, HyphaIpTimerSlot(wheel, timer->kind, timer->key));
+    }
+    timer->list = HYPHA_IP_TIMER_LIST_UNUSED;
+    timer->next = wheel->unused;
+    wheel->unused = number;
+}
+
+void HyphaIpTimerCancel(HyphaIpContext_t context, uint16_t *timer) {
+    if (*timer != HYPHA_IP_TIMER_NONE) {
+        HyphaIpTimerFree(&context->timers, *timer);
+        *timer = HYPHA_IP_TIMER_NONE;
+    }
+}
+
+HyphaIpStatus_e HyphaIpTimerAge(HyphaIpContext_t context, HyphaIpTimerKind_e kind, uint32_t key,
+                                HyphaIpTimestamp_t deadline) {
+    HyphaIpTimerWheel_t *wheel = &context->timers;
+    size_t slot = HyphaIpTimerSlot(wheel, kind, key);
+    uint16_t number = wheel->aging[slot];
+    if (number != HYPHA_IP_TIMER_NONE && deadline <= HyphaIpTimerOf(wheel, number)->deadline) {
+        HyphaIpTimerOf(wheel, number)->seen = true;
+        return HyphaIpStatusOk;  // it already runs at least as long
+    }
+    HyphaIpStatus_e status = HyphaIpTimerSchedule(context, &number, kind, key, deadline);
+    if (HyphaIpIsSuccess(status)) {
+        wheel->aging[slot] = number;
+        HyphaIpTimerOf(wheel, number)->seen = true;
+    }
+    return status;
+}
+
+/// Starts the timers of the entries of a version of the tables, or moves them to later expirations
+static HyphaIpStatus_e HyphaIpTimerAgeTables(HyphaIpContext_t context, HyphaIpTables_t const *tables) {
+    HyphaIpStatus_e result = HyphaIpStatusOk;
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    HyphaIpStatus_e arp = HyphaIpArpCacheAge(context, tables);
+    result = HyphaIpIsFailure(arp) ? arp : result;
+#endif
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+    HyphaIpStatus_e ethernet = HyphaIpEthernetFilterAge(context, tables);
+    result = HyphaIpIsFailure(ethernet) ? ethernet : result;
+#endif
+#if (HYPHA_IP_USE_IP_FILTER == 1)
+    HyphaIpStatus_e ipv4 = HyphaIpIPv4FilterAge(context, tables);
+    result = HyphaIpIsFailure(ipv4) ? ipv4 : result;
+#endif
+    (void)context;  // when nothing ages
+    (void)tables;
+    return result;
+}
+
+/// Brings the timers of the table entries up to date once another thread has populated the tables. Each entry gets
+/// its timer (or a later deadline) and the timers whose entries were merged away are given back.
+static void HyphaIpTimerCatchUp(HyphaIpContext_t context) {
+    HyphaIpTimerWheel_t *wheel = &context->timers;
+    HyphaIpTables_t const *tables = HyphaIpTablesReadBegin(context);
+    if (tables->populated != wheel->populated) {
+        wheel->populated = tables->populated;
+        for (size_t i = 0U; i < wheel->used; i++) {
+            wheel->timers[i].seen = false;
+        }
+        HyphaIpStatus_e status = HyphaIpTimerAgeTables(context, tables);
+        for (uint16_t number = 1U; number <= wheel->used; number++) {
+            HyphaIpTimer_t const *timer = HyphaIpTimerOf(wheel, number);
+            if (timer->list != HYPHA_IP_TIMER_LIST_UNUSED && HyphaIpTimerAges(timer->kind) && !timer->seen) {
+                HyphaIpTimerFree(wheel, number);
+            }
+        }
+        if (HyphaIpIsFailure(status)) {
+            // there is a timer for every entry the tables can hold once those of the removed entries are back
+            (void)HyphaIpTimerAgeTables(context, tables);
+        }
+    }
+    HyphaIpTablesReadEnd(context);
+}
+
+/// Tells the owner its timer has fired. The timer has already been given back.
+static HyphaIpStatus_e HyphaIpTimerFire(HyphaIpContext_t context, HyphaIpTimerKind_e kind, uint32_t key,
+                                        HyphaIpTimestamp_t deadline) {
+    switch (kind) {
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+        case HyphaIpTimerKindArpEntry:
+            HyphaIpArpCacheExpire(context, key, deadline);
+            return HyphaIpStatusOk;
+        case HyphaIpTimerKindArpRequest:
+            HyphaIpArpPendingExpire(context, key);
+            return HyphaIpStatusOk;
+#endif
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+        case HyphaIpTimerKindEthernetFilter:
+            HyphaIpEthernetFilterExpire(context, key, deadline);
+            return HyphaIpStatusOk;
+#endif
+#if (HYPHA_IP_USE_IP_FILTER == 1)
+        case HyphaIpTimerKindIPv4Filter:
+            HyphaIpIPv4FilterExpire(context, key, deadline);
+            return HyphaIpStatusOk;
+#endif
+        case HyphaIpTimerKindIgmpReport:
+            return HyphaIpIgmpReportDue(context, key);
+        case HyphaIpTimerKindReassembly:
+            HyphaIpReassemblyExpire(context, key);
+            return HyphaIpStatusOk;
+        default:
+            (void)deadline;
+            return HyphaIpStatusInvalidArgument;
+    }
+}
+
+/// Moves the wheel to the time and fires the timers which are due. The expired entries of the tables are removed in
+/// one new version, if the writer flag is free, otherwise they wait for a later tick.
+static HyphaIpStatus_e HyphaIpTimerRun(HyphaIpContext_t context, HyphaIpTimestamp_t timestamp) {
+    HyphaIpTimerWheel_t *wheel = &context->timers;
+    HyphaIpTimestamp_t tick = timestamp / HYPHA_IP_TIMER_RESOLUTION;
+    if (tick > wheel->now) {
+        HyphaIpTimerAdvance(wheel, tick);
+    }
+    if (wheel->lists[HYPHA_IP_TIMER_LIST_EXPIRED] == HYPHA_IP_TIMER_NONE) {
+        return HyphaIpStatusOk;  // the usual case, nothing is due
+    }
+    // only the timers which are due now fire, any which are started again while firing wait for the next tick
+    for (uint16_t number = wheel->lists[HYPHA_IP_TIMER_LIST_EXPIRED]; number != HYPHA_IP_TIMER_NONE;
+         number = HyphaIpTimerOf(wheel, number)->next) {
+        HyphaIpTimerOf(wheel, number)->list = HYPHA_IP_TIMER_LIST_FIRING;
+    }
+    wheel->lists[HYPHA_IP_TIMER_LIST_FIRING] = wheel->lists[HYPHA_IP_TIMER_LIST_EXPIRED];
+    wheel->lists[HYPHA_IP_TIMER_LIST_EXPIRED] = HYPHA_IP_TIMER_NONE;
+    context->igmp.budget = HYPHA_IP_IGMP_REPORTS_PER_RUN;
+    HyphaIpStatus_e result = HyphaIpStatusOk;
+    bool writing = false;
+    while (wheel->lists[HYPHA_IP_TIMER_LIST_FIRING] != HYPHA_IP_TIMER_NONE) {
+        uint16_t number = wheel->lists[HYPHA_IP_TIMER_LIST_FIRING];
+        HyphaIpTimer_t const *timer = HyphaIpTimerOf(wheel, number);
+        HyphaIpTimerKind_e kind = timer->kind;
+        uint32_t key = timer->key;
+        HyphaIpTimestamp_t deadline = timer->deadline;
+        HyphaIpTimerFree(wheel, number);
+        if (HyphaIpTimerAges(kind) && !writing && !(writing = HyphaIpTablesTryLock(context))) {
+            // another thread is changing the tables, the entry is just as expired on the next tick
+            (void)HyphaIpTimerAge(context, kind, key, deadline);
+            continue;
+        }
+        HyphaIpStatus_e status = HyphaIpTimerFire(context, kind, key, deadline);
+        if (HyphaIpIsFailure(status)) {
+            result = status;
+        }
+    }
+    if (writing) {
+        HyphaIpTablesUnlock(context);
+    }
+    return result;
+}
+
+HyphaIpStatus_e HyphaIpTick(HyphaIpContext_t context, HyphaIpTimestamp_t timestamp) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    HyphaIpArpPendingResolve(context);
+#endif
+    HyphaIpTimerCatchUp(context);
+    return HyphaIpTimerRun(context, timestamp);
+}
+
+/// @return The earliest deadline on the list
+static HyphaIpTimestamp_t HyphaIpTimerEarliest(HyphaIpTimerWheel_t *wheel, uint16_t list) {
+    HyphaIpTimestamp_t earliest = HYPHA_IP_NO_DEADLINE;
+    for (uint16_t number = wheel->lists[list]; number != HYPHA_IP_TIMER_NONE;
+         number = HyphaIpTimerOf(wheel, number)->next) {
+        HyphaIpTimestamp_t deadline = HyphaIpTimerOf(wheel, number)->deadline;
+        earliest = (deadline < earliest) ? deadline : earliest;
+    }
+    return earliest;
+}
+
+/// @return The earliest deadline of the wheel, or @ref HYPHA_IP_NO_DEADLINE when no timer is running
+static HyphaIpTimestamp_t HyphaIpTimerNext(HyphaIpTimerWheel_t *wheel) {
+    if (wheel->lists[HYPHA_IP_TIMER_LIST_EXPIRED] != HYPHA_IP_TIMER_NONE) {
+        return HyphaIpTimerEarliest(wheel, HYPHA_IP_TIMER_LIST_EXPIRED);
+    }
+    // every timer of a level comes before all of those above it and the slots of a level are all ahead of now in the
+    // same turn, so the earliest timer is in the lowest slot of the lowest level with any
+    for (size_t level = 0U; level < HYPHA_IP_TIMER_WHEEL_LEVELS; level++) {
+        if (wheel->pending[level] != 0U) {
+            size_t slot = (size_t)__builtin_ctzll(wheel->pending[level]);
+            return HyphaIpTimerEarliest(wheel, (uint16_t)((level * HYPHA_IP_TIMER_SLOTS) + slot));
+        }
+    }
+    return HyphaIpTimerEarliest(wheel, HYPHA_IP_TIMER_LIST_OVERFLOW);
+}
+
+HyphaIpStatus_e HyphaIpNextDeadline(HyphaIpContext_t context, HyphaIpTimestamp_t *deadline) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (deadline == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    // the entries another thread has populated since the last tick count too
+    HyphaIpTimerCatchUp(context);
+    HyphaIpTimestamp_t next = HyphaIpTimerNext(&context->timers);
+    // a tick only fires the timers of whole ticks which have passed, so the deadline is where its tick begins
+    *deadline = (next == HYPHA_IP_NO_DEADLINE) ? next : (HyphaIpTimerTick(next) * HYPHA_IP_TIMER_RESOLUTION);
+    return HyphaIpStatusOk;
+}
@@ -5,177 +5,626 @@
 
 #include "hypha_ip/hypha_internal.h"
 
-HyphaIpStatus_e HyphaIpTransmitUdpDatagram(HyphaIpContext_t context, HyphaIpMetaData_t* metadata, HyphaIpSpan_t span) {
+/// @return The slot where the search for the listener of the address and port starts
+static inline size_t HyphaIpUdpListenerHash(HyphaIpIPv4Address_t address, uint16_t port) {
+    uint64_t key = ((uint64_t)HyphaIpIPv4AddressToValue(address) << 16U) | port;
+    uint32_t hash = (uint32_t)((key * 0x9E37'79B9'7F4A'7C15U) >> 32U);
+    return (size_t)(((uint64_t)hash * HYPHA_IP_UDP_LISTENER_INDEX_SIZE) >> 32U);
+}
+
+/// @return The slot after the given one, wrapping around the end of the table
+static inline size_t HyphaIpUdpListenerNext(size_t slot) {
+    return ((slot + 1U) == HYPHA_IP_UDP_LISTENER_INDEX_SIZE) ? 0U : (slot + 1U);
+}
+
+/// @return The slot which holds the address and port, or the empty slot which ended the search
+static size_t HyphaIpUdpListenerSlot(HyphaIpUdpListeners_t const* listeners, HyphaIpIPv4Address_t address,
+                                     uint16_t port) {
+    size_t slot = HyphaIpUdpListenerHash(address, port);
+    while (listeners->slots[slot].listener != nullptr) {
+        HyphaIpUdpListenerEntry_t const* entry = &listeners->slots[slot];
+        if (entry->port == port && HyphaIpIsSameIPv4Address(entry->address, address)) {
+            break;
+        }
+        slot = HyphaIpUdpListenerNext(slot);
+    }
+    return slot;
+}
+
+/// @return The listener of the address and port, then of the port on any address, or nullptr if there is neither
+static HyphaIpUdpListenerEntry_t const* HyphaIpUdpListenerFind(HyphaIpContext_t context,
+                                                               HyphaIpIPv4Address_t address, uint16_t port) {
+    HyphaIpUdpListeners_t const* listeners = &context->udp_listeners;
+    HyphaIpUdpListenerEntry_t const* entry = &listeners->slots[HyphaIpUdpListenerSlot(listeners, address, port)];
+    if (entry->listener == nullptr) {
+        entry = &listeners->slots[HyphaIpUdpListenerSlot(listeners, hypha_ip_default_route, port)];
+    }
+    return (entry->listener != nullptr) ? entry : nullptr;
+}
+
+HyphaIpStatus_e HyphaIpRegisterUdpListener(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port,
+                                           HyphaIpUdpListener_f listener, void* user) {
     if (context == nullptr) {
         return HyphaIpStatusInvalidContext;
     }
-    if (metadata == nullptr) {
+    if (listener == nullptr) {
         return HyphaIpStatusInvalidArgument;
     }
-    if (HyphaIpSpanIsEmpty(span)) {
-        return HyphaIpStatusInvalidSpan;
+    HyphaIpUdpListeners_t* listeners = &context->udp_listeners;
+    HyphaIpUdpListenerEntry_t* entry = &listeners->slots[HyphaIpUdpListenerSlot(listeners, address, port)];
+    if (entry->listener == nullptr) {
+        if (listeners->count >= HYPHA_IP_UDP_LISTENER_TABLE_SIZE) {
+            return HyphaIpStatusUdpListenerTableFull;
+        }
+        listeners->count++;
+    }
+    *entry = (HyphaIpUdpListenerEntry_t){.address = address, .port = port, .listener = listener, .user = user};
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpUnregisterUdpListener(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
     }
-    if (span.type != HyphaIpSpanTypeUint8_t) {
+    HyphaIpUdpListeners_t* listeners = &context->udp_listeners;
+    size_t hole = HyphaIpUdpListenerSlot(listeners, address, port);
+    if (listeners->slots[hole].listener == nullptr) {
         return HyphaIpStatusInvalidArgument;
     }
-    HyphaIpStatus_e status = HyphaIpStatusOk;
+    // shift the rest of the run back over the hole so no search stops early
+    for (size_t next = HyphaIpUdpListenerNext(hole); listeners->slots[next].listener != nullptr;
+         next = HyphaIpUdpListenerNext(next)) {
+        HyphaIpUdpListenerEntry_t const* entry = &listeners->slots[next];
+        size_t home = HyphaIpUdpListenerHash(entry->address, entry->port);
+        // an entry whose home is (cyclically) after the hole would not be found from there, so it stays
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            listeners->slots[hole] = *entry;
+            hole = next;
+        }
+    }
+    listeners->slots[hole] = (HyphaIpUdpListenerEntry_t){.listener = nullptr};
+    listeners->count--;
+    return HyphaIpStatusOk;
+}
+
+/// Writes the UDP checksum into a UDP header which is already in the frame (with a zero checksum)
+/// @param payload_sum The one's complement sum of the whole UDP payload
+static void HyphaIpUdpInsertChecksum(HyphaIpContext_t context, HyphaIpEthernetFrame_t* frame,
+                                     HyphaIpMetaData_t const* metadata, uint16_t payload_sum) {
+    uint8_t* udp = &frame->payload[HyphaIpOffsetOfUDPHeader()];
+    HyphaIpPseudoHeader_t pseudo_header = {
+        .source = HyphaIpIPv4SelectSource(context, metadata->interface, metadata->destination_address,
+                                          metadata->source_address),
+        .destination = metadata->destination_address,
+        .zero = 0,
+        .protocol = HyphaIpProtocol_UDP,
+        .length = 0,
+    };
+    memcpy(&pseudo_header.length, &udp[offsetof(HyphaIpUDPHeader_t, length)], sizeof(uint16_t));  // Network Order
+    memcpy(&pseudo_header.header, udp, sizeof(HyphaIpUDPHeader_t));  // Network Order, checksum is zero
+    // the pseudo header and UDP header only change in the words which differ from the last datagram
+    uint16_t words[HYPHA_IP_CHECKSUM_CACHE_WORDS];
+    static_assert(sizeof(words) == sizeof(pseudo_header), "The pseudo header must fit in the cache");
+    memcpy(words, &pseudo_header, sizeof(words));
+    uint16_t header_sum = (uint16_t)~HyphaIpChecksumCached(&context->tx_checksums.udp, HYPHA_IP_DIMOF(words), words);
+    uint16_t checksum = (uint16_t)~HyphaIpChecksumAdd(header_sum, payload_sum);
+    if (checksum == HyphaIpChecksumDisabled) {
+        checksum = HyphaIpChecksumValid;  // a computed zero is sent as all ones (RFC 768)
+    }
+    memcpy(&udp[offsetof(HyphaIpUDPHeader_t, checksum)], &checksum, sizeof(checksum));
+}
 
+/// Fills in the UDP header (and checksum) in front of a payload which is already in the frame and transmits it.
+/// The frame is always released.
+static HyphaIpStatus_e HyphaIpUdpTransmitFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t* frame,
+                                               HyphaIpMetaData_t* metadata, size_t length) {
     // replace the source address with the one from the interface, users can not create fake source addresses
-    metadata->source_address = context->interface.address;
-
-    // for each part of the udp datagram we'll have to make a new packet
-    size_t offset = 0;
-    size_t const limit = HyphaIpSpanSize(span);
-    do {
-        size_t remaining = limit - offset;
-        size_t chunk = (remaining <= HYPHA_IP_MAX_UDP_PAYLOAD_SIZE) ? remaining : HYPHA_IP_MAX_UDP_PAYLOAD_SIZE;
-        uint8_t* tmp = &((uint8_t*)span.pointer)[offset];
-        HyphaIpSpan_t fragment = {.pointer = tmp, .count = (uint32_t)chunk, .type = HyphaIpSpanTypeUint8_t};
-        HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerUDP,
-                       "Transmitting UDP Datagram Fragment: " PRIuSpan "\r\n", fragment.pointer, fragment.count,
-                       fragment.type);
-        // acquire a frame which we will start to write all the information into
-        HyphaIpEthernetFrame_t* frame = context->external.acquire(context->theirs);
+    HyphaIpIPv4Address_t next_hop;
+    HyphaIpStatus_e selected = HyphaIpIPv4SelectInterface(context, metadata, &next_hop);
+    if (HyphaIpIsFailure(selected)) {
+        context->statistics.udp.rejected++;
+        HYPHA_IP_REPORT(context, selected);
+        (void)HyphaIpDriverRelease(context, frame);
+        return selected;
+    }
+    metadata->source_address = context->interfaces[metadata->interface].address;
+    // frames which are looped back never reach the driver, so they can not be offloaded
+    bool loopback = HyphaIpIsLocalhostIPv4Address(metadata->destination_address) ||
+                    HyphaIpIsOurIPv4Address(context, metadata->destination_address);
+    bool offload = context->capabilities.tx_udp_checksum && !loopback;
+    uint8_t* payload = &frame->payload[HyphaIpOffsetOfUDPPayload()];
+    HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerUDP,
+                   "Transmitting UDP Datagram Fragment: %p:%zu\r\n", (void*)payload, length);
+
+    HyphaIpUDPHeader_t udp_header = {
+        .source_port = metadata->source_port,
+        .destination_port = metadata->destination_port,
+        .length = (uint16_t)(sizeof(HyphaIpUDPHeader_t) + length),
+        .checksum = 0,
+    };
+    // copy the UDP header into the frame
+    HyphaIpCopyUdpHeaderToFrame(frame, &udp_header);
+    if (HYPHA_IP_USE_UDP_CHECKSUM && offload) {
+        // the checksum is left as zero for the driver to fill in
+        frame->info.flags |= HyphaIpFrameFlagUdpChecksumInsert;
+        context->statistics.checksums.udp.tx_offloaded++;
+    } else if (HYPHA_IP_USE_UDP_CHECKSUM) {
+        context->statistics.checksums.udp.tx_software++;
+        uint16_t payload_sum = HyphaIpChecksumBytes(HyphaIpChecksumSelectKernel(), payload, length);
+        HyphaIpUdpInsertChecksum(context, frame, metadata, payload_sum);
+    }
+    // create a span over the header+datagram, the IPv4 length is taken from it
+    HyphaIpSpan_t datagram = {.pointer = &frame->payload[HyphaIpOffsetOfUDPHeader()],
+                              .count = udp_header.length,
+                              .type = HyphaIpSpanTypeUint8_t};
+
+    HyphaIpStatus_e status = HyphaIpIPv4TransmitPacket(context, frame, metadata, HyphaIpProtocol_UDP, datagram);
+    // within a burst the release may flush the frames before this one, and their fate is reported too
+    HyphaIpStatus_e released = HyphaIpDriverRelease(context, frame);
+    status = HyphaIpIsFailure(status) ? status : released;
+    if (HyphaIpIsSuccess(status)) {
+        // if the transmission was successful, we can update the statistics
+        context->statistics.counter.udp.tx.count++;
+        context->statistics.counter.udp.tx.bytes += udp_header.length;  // the length includes the header
+        context->statistics.udp.accepted++;
+    } else {
+        // if the transmission failed, we can update the statistics
+        context->statistics.udp.rejected++;
+    }
+    HYPHA_IP_REPORT(context, status);
+    return status;
+}
+
+/// Transmits a UDP datagram which is larger than a frame as IPv4 fragments. There is a single UDP header, in the
+/// first fragment, and its checksum covers every fragment. So the first fragment is held back and sent last, once the
+/// rest of the payload has been gathered (and summed) straight into the other frames.
+static HyphaIpStatus_e HyphaIpUdpTransmitFragmented(HyphaIpContext_t context, HyphaIpMetaData_t* metadata,
+                                                    size_t limit, size_t count, HyphaIpSpan_t const spans[count]) {
+    // replace the source address with the one from the interface, users can not create fake source addresses
+    HyphaIpIPv4Address_t next_hop;
+    HyphaIpStatus_e selected = HyphaIpIPv4SelectInterface(context, metadata, &next_hop);
+    if (HyphaIpIsFailure(selected)) {
+        context->statistics.udp.rejected++;
+        HYPHA_IP_REPORT(context, selected);
+        return selected;
+    }
+    metadata->source_address = context->interfaces[metadata->interface].address;
+    HyphaIpIPv4Fragment_t fragment = {.identification = context->ipv4_identification++, .offset = 0U, .more = true};
+    HyphaIpChecksumKernel_e const kernel = HyphaIpChecksumSelectKernel();
+    HyphaIpSpanCursor_t cursor = {0U, 0U};
+    HyphaIpEthernetFrame_t* first = HyphaIpDriverAcquire(context);
+    if (first == nullptr) {
+        context->statistics.udp.rejected++;
+        HYPHA_IP_REPORT(context, HyphaIpStatusOutOfMemory);
+        return HyphaIpStatusOutOfMemory;
+    }
+    size_t const first_size = HYPHA_IP_IPv4_FRAGMENT_SIZE - sizeof(HyphaIpUDPHeader_t);
+    uint8_t* first_payload = &first->payload[HyphaIpOffsetOfUDPPayload()];
+    (void)HyphaIpSpanGather(first_payload, first_size, count, spans, &cursor);
+    uint16_t payload_sum = HYPHA_IP_USE_UDP_CHECKSUM ? HyphaIpChecksumBytes(kernel, first_payload, first_size) : 0U;
+
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    size_t const total = sizeof(HyphaIpUDPHeader_t) + limit;
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    // to an unresolved destination the fragments wait for ARP, either all of them or none
+    HyphaIpArpPendingMark_t const mark = HyphaIpArpPendingMark(context);
+#endif
+    HyphaIpDriverBurstBegin(context);
+    for (size_t offset = HYPHA_IP_IPv4_FRAGMENT_SIZE; offset < total; offset += HYPHA_IP_IPv4_FRAGMENT_SIZE) {
+        size_t remaining = total - offset;
+        size_t size = (remaining < HYPHA_IP_IPv4_FRAGMENT_SIZE) ? remaining : HYPHA_IP_IPv4_FRAGMENT_SIZE;
+        HyphaIpEthernetFrame_t* frame = HyphaIpDriverAcquireSized(
+            context, sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpIPv4Header_t) + size);
         if (frame == nullptr) {
-            context->statistics.frames.failures++;
             status = HyphaIpStatusOutOfMemory;
-        } else {
-            context->statistics.frames.acquires++;
-            status = HyphaIpStatusOk;
+            break;
         }
-        HYPHA_IP_REPORT(context, status);
-
+        // every fragment starts on an even offset of the payload, so the sums add without any byte swaps
+        uint8_t* data = &frame->payload[HyphaIpOffsetOfUDPHeader()];
+        (void)HyphaIpSpanGather(data, size, count, spans, &cursor);
+        if (HYPHA_IP_USE_UDP_CHECKSUM) {
+            payload_sum = HyphaIpChecksumAdd(payload_sum, HyphaIpChecksumBytes(kernel, data, size));
+        }
+        fragment.offset = (uint16_t)offset;
+        fragment.more = (offset + size) < total;
+        HyphaIpSpan_t packet = {.pointer = data, .count = (uint32_t)size, .type = HyphaIpSpanTypeUint8_t};
+        status = HyphaIpIPv4TransmitFragment(context, frame, metadata, HyphaIpProtocol_UDP, packet, fragment);
+        HyphaIpStatus_e released = HyphaIpDriverRelease(context, frame);
+        status = HyphaIpIsFailure(status) ? status : released;
+        if (HyphaIpIsFailure(status)) {
+            break;
+        }
+    }
+    if (HyphaIpIsSuccess(status)) {
         HyphaIpUDPHeader_t udp_header = {
             .source_port = metadata->source_port,
             .destination_port = metadata->destination_port,
-            .length = (uint16_t)(sizeof(HyphaIpUDPHeader_t) + HyphaIpSpanSize(fragment)),
+            .length = (uint16_t)total,
             .checksum = 0,
         };
+        HyphaIpCopyUdpHeaderToFrame(first, &udp_header);
         if (HYPHA_IP_USE_UDP_CHECKSUM) {
-            HyphaIpPseudoHeader_t pseudo_header = {
-                .source = metadata->source_address,            // Network Order!
-                .destination = metadata->destination_address,  // Network Order!
-                .protocol = HyphaIpProtocol_UDP,
-                .length = udp_header.length + sizeof(HyphaIpPseudoHeader_t),
-            };
-            memcpy(&pseudo_header.header, &udp_header, sizeof(HyphaIpUDPHeader_t));
-            // TODO flip the pseudo header then do checksum
-            // compute the checksum over the pseudo header and the fragment
-            HyphaIpSpan_t header_span = {&pseudo_header, sizeof(pseudo_header), HyphaIpSpanTypeUint8_t};
-            // compute the checksum over the header and the fragment
-            uint16_t checksum = ~HyphaIpComputeChecksum(header_span, fragment);
-            // TODO write the checksum (Host order) back into the udp_header
-            (void)checksum;  // suppress unused variable warning
+            // the driver only sees one fragment so it can not offload this checksum
+            context->statistics.checksums.udp.tx_software++;
+            HyphaIpUdpInsertChecksum(context, first, metadata, payload_sum);
         }
-        // copy the UDP header into the frame
-        HyphaIpCopyUdpHeaderToFrame(frame, &udp_header);
-        // copy the UDP payload into the frame
-        HyphaIpCopyUdpPayloadToFrame(frame, fragment);
-        // create a span over the whole header+datagram
-        HyphaIpSpan_t datagram = HyphaIpSpanUdpDatagram(frame);
-
-        status = HyphaIpIPv4TransmitPacket(context, frame, metadata, HyphaIpProtocol_UDP, datagram);
-        if (HyphaIpIsSuccess(status)) {
-            // if the transmission was successful, we can update the statistics
-            context->statistics.counter.udp.tx.count++;
-            context->statistics.counter.udp.tx.bytes += udp_header.length;  // the length includes the header
-            context->statistics.udp.accepted++;
-        } else {
-            // if the transmission failed, we can update the statistics
-            context->statistics.udp.rejected++;
+        fragment.offset = 0U;
+        fragment.more = true;
+        HyphaIpSpan_t packet = {.pointer = &first->payload[HyphaIpOffsetOfUDPHeader()],
+                                .count = HYPHA_IP_IPv4_FRAGMENT_SIZE,
+                                .type = HyphaIpSpanTypeUint8_t};
+        status = HyphaIpIPv4TransmitFragment(context, first, metadata, HyphaIpProtocol_UDP, packet, fragment);
+    }
+    HyphaIpStatus_e released = HyphaIpDriverRelease(context, first);
+    status = HyphaIpIsFailure(status) ? status : released;
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    if (HyphaIpIsFailure(status)) {
+        HyphaIpArpPendingRollback(context, mark);
+    }
+#endif
+    // the fragments only reach the driver here, a datagram is only sent if it took every one of them
+    HyphaIpStatus_e flushed = HyphaIpDriverBurstEnd(context);
+    status = HyphaIpIsFailure(status) ? status : flushed;
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.counter.udp.tx.count++;
+        context->statistics.counter.udp.tx.bytes += total;  // the length includes the header
+        context->statistics.udp.accepted++;
+    } else {
+        context->statistics.udp.rejected++;
+    }
+    HYPHA_IP_REPORT(context, status);
+    return status;
+}
+
+HyphaIpStatus_e HyphaIpTransmitUdpDatagram(HyphaIpContext_t context, HyphaIpMetaData_t* metadata, HyphaIpSpan_t span) {
+    return HyphaIpTransmitUdpDatagramV(context, metadata, 1U, &span);
+}
+
+HyphaIpStatus_e HyphaIpTransmitUdpDatagramV(HyphaIpContext_t context, HyphaIpMetaData_t* metadata, size_t count,
+                                            HyphaIpSpan_t const spans[count]) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (metadata == nullptr || (spans == nullptr && count > 0U)) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    size_t limit = 0U;
+    for (size_t i = 0U; i < count; i++) {
+        if (HyphaIpSpanIsEmpty(spans[i])) {
+            continue;  // empty pieces are allowed, they add nothing
         }
-        HYPHA_IP_REPORT(context, status);
-
-        status = context->external.release(context->theirs, frame);
-        if (HyphaIpIsSuccess(status)) {
-            context->statistics.frames.releases++;
-        } else {
-            context->statistics.frames.failures++;
-            // TODO how to recover?
+        if (spans[i].type != HyphaIpSpanTypeUint8_t || spans[i].pointer == nullptr) {
+            return HyphaIpStatusInvalidArgument;
         }
-        HYPHA_IP_REPORT(context, status);
-        frame = nullptr;  // forget the frame, so we don't use it again
+        limit += HyphaIpSpanSize(spans[i]);
+    }
+    if (limit == 0U) {
+        return HyphaIpStatusInvalidSpan;
+    }
+    if (limit > HYPHA_IP_MAX_UDP_DATAGRAM_SIZE) {
+        return HyphaIpStatusUdpDatagramTooLarge;
+    }
+    if (limit > HYPHA_IP_MAX_UDP_PAYLOAD_SIZE) {
+        return HyphaIpUdpTransmitFragmented(context, metadata, limit, count, spans);
+    }
+    // acquire a frame just big enough for the datagram which we will start to write all the information into
+    HyphaIpEthernetFrame_t* frame =
+        HyphaIpDriverAcquireSized(context, sizeof(HyphaIpEthernetHeader_t) + HyphaIpOffsetOfUDPPayload() + limit);
+    if (frame == nullptr) {
+        return HyphaIpStatusOutOfMemory;
+    }
+    // gather the pieces straight into the frame, the checksum is summed from there
+    HyphaIpSpanCursor_t cursor = {0U, 0U};
+    (void)HyphaIpSpanGather(&frame->payload[HyphaIpOffsetOfUDPPayload()], limit, count, spans, &cursor);
+    return HyphaIpUdpTransmitFrame(context, frame, metadata, limit);
+}
 
-        offset += chunk;
-    } while (offset < limit);
+HyphaIpStatus_e HyphaIpReserveUdpPayload(HyphaIpContext_t context, HyphaIpEthernetFrame_t** frame,
+                                         HyphaIpSpan_t* payload) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (frame == nullptr || payload == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    *frame = HyphaIpDriverAcquire(context);
+    if (*frame == nullptr) {
+        *payload = (HyphaIpSpan_t)HYPHA_IP_DEFAULT_SPAN;
+        return HyphaIpStatusOutOfMemory;
+    }
+    // the same region as HyphaIpSpanUdpPayload, counted in bytes so any length can be committed
+    *payload = (HyphaIpSpan_t){.pointer = &(*frame)->payload[HyphaIpOffsetOfUDPPayload()],
+                               .count = HYPHA_IP_MAX_UDP_PAYLOAD_SIZE,
+                               .type = HyphaIpSpanTypeUint8_t};
     return HyphaIpStatusOk;
 }
 
-HyphaIpStatus_e HyphaIpUdpReceiveDatagram(HyphaIpContext_t context, HyphaIpIPv4Header_t* ip_header,
-                                          HyphaIpTimestamp_t timestamp, HyphaIpEthernetFrame_t* frame) {
+HyphaIpStatus_e HyphaIpCommitUdpDatagram(HyphaIpContext_t context, HyphaIpEthernetFrame_t* frame,
+                                         HyphaIpMetaData_t* metadata, size_t length) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (frame == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    HyphaIpStatus_e status = HyphaIpStatusOk;
+    if (metadata == nullptr) {
+        status = HyphaIpStatusInvalidArgument;
+    } else if (length == 0U) {
+        status = HyphaIpStatusInvalidSpan;
+    } else if (length > HYPHA_IP_MAX_UDP_PAYLOAD_SIZE) {
+        status = HyphaIpStatusUdpDatagramTooLarge;
+    }
+    if (HyphaIpIsFailure(status)) {
+        // the reservation is over either way
+        (void)HyphaIpDriverRelease(context, frame);
+        return status;
+    }
+    return HyphaIpUdpTransmitFrame(context, frame, metadata, length);
+}
+
+HyphaIpStatus_e HyphaIpAbort(HyphaIpContext_t context, HyphaIpEthernetFrame_t* frame) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (frame == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    return HyphaIpDriverRelease(context, frame);
+}
+
+HyphaIpStatus_e HyphaIpUdpReceiveDatagram(HyphaIpContext_t context, HyphaIpIPv4Address_t source,
+                                          HyphaIpIPv4Address_t destination, HyphaIpTimestamp_t timestamp,
+                                          HyphaIpSpan_t datagram, bool checksum_verified) {
     context->statistics.counter.udp.rx.count++;
 
-    HyphaIpUDPHeader_t udp_header;
-    HyphaIpCopyUdpHeaderFromFrame(&udp_header, frame);
-    HyphaIpSpan_t payload_span = HyphaIpSpanUdpPayload(frame);
+    // the header is read in place, nothing is copied out of the frame
+    uint8_t const* udp = (uint8_t const*)datagram.pointer;
+    if (datagram.count < sizeof(HyphaIpUDPHeader_t)) {
+        context->statistics.udp.rejected++;
+        return HyphaIpStatusInvalidSpan;
+    }
+    uint16_t source_port = HyphaIpPeek16(&udp[0]);
+    uint16_t destination_port = HyphaIpPeek16(&udp[2]);
+    uint16_t length = HyphaIpPeek16(&udp[4]);
+    uint16_t checksum = HyphaIpPeek16(&udp[6]);
     HYPHA_IP_PRINT(context, HyphaIpPrintLevelDebug, HyphaIpPrintLayerUDP, "UDP Header: %04X->%04X Length: %u\r\n",
-                   udp_header.source_port, udp_header.destination_port, udp_header.length);
-
-    if (udp_header.checksum != 0 && HYPHA_IP_USE_UDP_CHECKSUM) {
-        HyphaIpPseudoHeader_t pseudo_header = {
-            .source = ip_header->source,
-            .destination = ip_header->destination,
-            .zero = 0,
-            .protocol = HyphaIpProtocol_UDP,
-            .length = __builtin_bswap16(udp_header.length + sizeof(HyphaIpPseudoHeader_t))};
-        memcpy(&pseudo_header.header, &frame->payload[HyphaIpOffsetOfUDPHeader()], sizeof(HyphaIpUDPHeader_t));
-        HyphaIpSpan_t header_span = {&pseudo_header, sizeof(pseudo_header), HyphaIpSpanTypeUint8_t};
-        // can't trust the length, yet. compute from IP header minus header
-        payload_span.count =
-            (ip_header->length - sizeof(HyphaIpIPv4Header_t)) / sizeof(uint16_t);  // TODO this needs a unit test
+                   source_port, destination_port, length);
+    // the UDP length can not claim more than the IPv4 length allowed
+    if (length < sizeof(HyphaIpUDPHeader_t) || length > datagram.count) {
+        context->statistics.udp.rejected++;
+        return HyphaIpStatusInvalidSpan;
+    }
+    // nothing is spent on the payload of a datagram nobody is listening for
+    HyphaIpUdpListenerEntry_t const* listener = nullptr;
+    if (context->udp_listeners.count > 0U) {
+        listener = HyphaIpUdpListenerFind(context, destination, destination_port);
+        if (listener == nullptr) {
+            context->statistics.listeners.unregistered++;
+            return HyphaIpStatusUdpPortUnreachable;
+        }
+    }
+
+    if (checksum != 0 && HYPHA_IP_USE_UDP_CHECKSUM && checksum_verified) {
+        // the driver has already checked the datagram, it would have dropped a bad one
+        context->statistics.checksums.udp.rx_offloaded++;
+    } else if (checksum != 0 && HYPHA_IP_USE_UDP_CHECKSUM) {
+        context->statistics.checksums.udp.rx_software++;
+        HyphaIpPseudoHeader_t pseudo_header = {.source = source,
+                                               .destination = destination,
+                                               .zero = 0,
+                                               .protocol = HyphaIpProtocol_UDP,
+                                               .length = __builtin_bswap16(length)};
+        // only the address/protocol/length prefix of the pseudo header, the UDP header is summed in place
+        HyphaIpSpan_t header_span = {&pseudo_header, offsetof(HyphaIpPseudoHeader_t, header), HyphaIpSpanTypeUint8_t};
+        // the datagram may have an odd length
+        HyphaIpSpan_t payload_span = {datagram.pointer, length, HyphaIpSpanTypeUint8_t};
 
         HyphaIpSpanPrint(context, header_span);
         HyphaIpSpanPrint(context, payload_span);
-        // HyphaIpSpan_t empty = {
-        //     .pointer = nullptr,
-        //     .count = 0U,
-        //     .type = HyphaIpSpanTypeUndefined,
-        // };
         uint16_t udp_checksum = HyphaIpComputeChecksum(header_span, payload_span);
         // 0.) Is the UDP checksum valid?
         bool udp_checksum_valid = (udp_checksum == HyphaIpChecksumValid);
         HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerUDP,
                        "Computed Checksum: %04X (should be %04X)\r\n", udp_checksum, HyphaIpChecksumValid);
-        HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerUDP, "Provided Checksum: %04X\r\n",
-                       udp_header.checksum);
+        HYPHA_IP_PRINT(context, HyphaIpPrintLevelInfo, HyphaIpPrintLayerUDP, "Provided Checksum: %04X\r\n", checksum);
         if (!udp_checksum_valid) {
             context->statistics.udp.rejected++;
             return HyphaIpStatusUDPChecksumRejected;
         }
     }
 
-    // TODO Check again previously registered Ports? Denied Ports?
-
     context->statistics.udp.accepted++;
-    context->statistics.counter.udp.rx.bytes += udp_header.length;
+    context->statistics.counter.udp.rx.bytes += length;
 
-    HyphaIpMetaData_t metadata = {.source_address = ip_header->source,
-                                  .destination_address = ip_header->destination,
-                                  .source_port = udp_header.source_port,
-                                  .destination_port = udp_header.destination_port,
+    HyphaIpMetaData_t metadata = {.source_address = source,
+                                  .destination_address = destination,
+                                  .source_port = source_port,
+                                  .destination_port = destination_port,
                                   .timestamp = timestamp};
     // limit to what we're actually processing
-    payload_span.count = udp_header.length - sizeof(HyphaIpUDPHeader_t);
-    payload_span.type = HyphaIpSpanTypeUint8_t;
+    HyphaIpSpan_t payload_span = {.pointer = (void*)&udp[sizeof(HyphaIpUDPHeader_t)],
+                                  .count = (uint32_t)(length - sizeof(HyphaIpUDPHeader_t)),
+                                  .type = HyphaIpSpanTypeUint8_t};
     // call the listener
+    if (listener != nullptr) {
+        context->statistics.listeners.delivered++;
+        return listener->listener(listener->user, &metadata, payload_span);
+    }
     return context->external.receive_udp(context->theirs, &metadata, payload_span);
 }
 
 HyphaIpStatus_e HyphaIpPrepareUdpReceive(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port) {
     (void)port;  // suppress unused parameter warning
     if (HyphaIpIsMulticastIPv4Address(address)) {
-        // multicast address, we need to send a membership report
-        return HyphaIpMembershipReport(context, address);
+        // multicast address, the group is joined (or one more receiver is counted on it)
+        return HyphaIpJoinGroup(context, address);
     }
     return HyphaIpStatusNotSupported;  // only multicast is can make a membership report
 }
 
-HyphaIpStatus_e HyphaIpPrepareUdpTransmit(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port) {
-    (void)context;  // suppress unused parameter warning
-    (void)port;     // suppress unused parameter warning
+HyphaIpStatus_e HyphaIpReleaseUdpReceive(HyphaIpContext_t context, HyphaIpIPv4Address_t address, uint16_t port) {
+    (void)port;  // suppress unused parameter warning
     if (HyphaIpIsMulticastIPv4Address(address)) {
-        // nothing has to be done for multicast transmit
-        return HyphaIpStatusOk;
+        // the group is only left by the last receiver
+        return HyphaIpLeaveGroup(context, address);
     }
-    return HyphaIpStatusNotSupported;  // only multicast is can make a membership report
+    return HyphaIpStatusNotSupported;
+}
+
+HyphaIpStatus_e HyphaIpPrepareUdpTransmit(HyphaIpContext_t context, HyphaIpMetaData_t const* metadata,
+                                          HyphaIpUdpFlow_t* flow) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    if (metadata == nullptr || flow == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (!HyphaIpIsMulticastIPv4Address(metadata->destination_address)) {
+        return HyphaIpStatusNotSupported;  // only multicast has a MAC which never changes
+    }
+    if (metadata->interface >= context->interface_count) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    memset(flow, 0, sizeof(HyphaIpUdpFlow_t));
+    flow->metadata = *metadata;
+    flow->metadata.source_address = context->interfaces[metadata->interface].address;
+    flow->metadata.timestamp = 0U;
+
+    // serialize each header once, the lengths and checksums are left as zero
+    uint8_t* ethernet = &flow->header[0];
+    uint8_t* ip = &ethernet[sizeof(HyphaIpEthernetHeader_t)];
+    uint8_t* udp = &ip[sizeof(HyphaIpIPv4Header_t)];
+    HyphaIpEthernetHeader_t ethernet_header =
+        HyphaIpEthernetMakeHeader(context, metadata->interface, metadata->destination_address, HyphaIpEtherType_IPv4);
+    HyphaIpIPv4Header_t ip_header =
+        HyphaIpIPv4MakeHeader(context, metadata->interface, metadata->destination_address,
+                              flow->metadata.source_address, HyphaIpProtocol_UDP, 0U);
+    ip_header.length = 0U;
+    HyphaIpUDPHeader_t udp_header = {
+        .source_port = metadata->source_port,
+        .destination_port = metadata->destination_port,
+        .length = 0U,
+        .checksum = 0U,
+    };
+    HyphaIpFlipEthernetHeader(ethernet, &ethernet_header);
+    HyphaIpFlipIPv4Header(ip, &ip_header);
+    HyphaIpFlipUdpHeader(udp, &udp_header);
+
+    // the partial sums only lack the lengths (and the payload for UDP)
+    HyphaIpPseudoHeader_t pseudo_header = {
+        .source = ip_header.source,
+        .destination = ip_header.destination,
+        .zero = 0,
+        .protocol = HyphaIpProtocol_UDP,
+        .length = 0U,
+    };
+    flow->ipv4_sum = HyphaIpChecksumBytes(HyphaIpChecksumKernelScalar, ip, sizeof(HyphaIpIPv4Header_t));
+    flow->udp_sum = HyphaIpChecksumAdd(
+        HyphaIpChecksumBytes(HyphaIpChecksumKernelScalar, &pseudo_header, offsetof(HyphaIpPseudoHeader_t, header)),
+        HyphaIpChecksumBytes(HyphaIpChecksumKernelScalar, udp, sizeof(HyphaIpUDPHeader_t)));
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e HyphaIpUdpFlowCheck(HyphaIpUdpFlow_t const* flow, HyphaIpSpan_t datagram) {
+    if (flow == nullptr) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (HyphaIpSpanIsEmpty(datagram)) {
+        return HyphaIpStatusInvalidSpan;
+    }
+    if (datagram.type != HyphaIpSpanTypeUint8_t) {
+        return HyphaIpStatusInvalidArgument;
+    }
+    if (HyphaIpSpanSize(datagram) > HYPHA_IP_MAX_UDP_PAYLOAD_SIZE) {
+        return HyphaIpStatusUdpDatagramTooLarge;
+    }
+    return HyphaIpStatusOk;
+}
+
+size_t HyphaIpUdpFlowBuild(HyphaIpContext_t context, HyphaIpUdpFlow_t const* flow, HyphaIpEthernetFrame_t* frame,
+                           HyphaIpSpan_t datagram) {
+    size_t const size = HyphaIpSpanSize(datagram);
+    // the template is the wire image of the Ethernet header followed by the start of the payload
+    static_assert((offsetof(HyphaIpEthernetFrame_t, payload) - offsetof(HyphaIpEthernetFrame_t, header)) ==
+                      sizeof(HyphaIpEthernetHeader_t),
+                  "The payload must directly follow the header");
+    memcpy(&frame->header, flow->header, sizeof(flow->header));
+    frame->info.interface = flow->metadata.interface;
+    uint8_t* ip = frame->payload;
+    uint8_t* udp = &ip[sizeof(HyphaIpIPv4Header_t)];
+    memcpy(&udp[sizeof(HyphaIpUDPHeader_t)], datagram.pointer, size);
+
+    uint16_t const udp_length = (uint16_t)(sizeof(HyphaIpUDPHeader_t) + size);
+    uint16_t const ip_length = (uint16_t)(sizeof(HyphaIpIPv4Header_t) + udp_length);
+    HyphaIpPoke16(&ip[HyphaIpIPv4OffsetLength], ip_length);
+    HyphaIpPoke16(&ip[HyphaIpUdpOffsetLength], udp_length);
+    if (HYPHA_IP_USE_IP_CHECKSUM && context->capabilities.tx_ipv4_checksum) {
+        frame->info.flags |= HyphaIpFrameFlagIPv4ChecksumInsert;
+    } else if (HYPHA_IP_USE_IP_CHECKSUM) {
+        uint16_t length_word;  // the sums are kept over native loads of the network order bytes
+        memcpy(&length_word, &ip[HyphaIpIPv4OffsetLength], sizeof(length_word));
+        uint16_t checksum = (uint16_t)~HyphaIpChecksumAdd(flow->ipv4_sum, length_word);
+        memcpy(&ip[HyphaIpIPv4OffsetChecksum], &checksum, sizeof(checksum));
+    }
+    if (HYPHA_IP_USE_UDP_CHECKSUM && context->capabilities.tx_udp_checksum) {
+        frame->info.flags |= HyphaIpFrameFlagUdpChecksumInsert;
+    } else if (HYPHA_IP_USE_UDP_CHECKSUM) {
+        uint16_t length_word;  // in both the pseudo header and the UDP header
+        memcpy(&length_word, &ip[HyphaIpUdpOffsetLength], sizeof(length_word));
+        uint16_t sum = HyphaIpChecksumAdd(HyphaIpChecksumAdd(flow->udp_sum, length_word), length_word);
+        sum = HyphaIpChecksumAdd(sum, HyphaIpChecksumBytes(HyphaIpChecksumSelectKernel(), datagram.pointer, size));
+        uint16_t checksum = (uint16_t)~sum;
+        if (checksum == HyphaIpChecksumDisabled) {
+            checksum = HyphaIpChecksumValid;  // a computed zero is sent as all ones (RFC 768)
+        }
+        memcpy(&ip[HyphaIpUdpOffsetChecksum], &checksum, sizeof(checksum));
+    }
+    frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + ip_length);
+    return ip_length;
+}
+
+HyphaIpStatus_e HyphaIpTransmitUdpFlow(HyphaIpContext_t context, HyphaIpUdpFlow_t* flow, HyphaIpSpan_t datagram) {
+    if (context == nullptr) {
+        return HyphaIpStatusInvalidContext;
+    }
+    HyphaIpStatus_e status = HyphaIpUdpFlowCheck(flow, datagram);
+    if (HyphaIpIsFailure(status)) {
+        return status;
+    }
+    size_t const capacity = sizeof(flow->header) + HyphaIpSpanSize(datagram);
+    HyphaIpEthernetFrame_t* frame = HyphaIpDriverAcquireSized(context, capacity);
+    if (frame == nullptr) {
+        return HyphaIpStatusOutOfMemory;
+    }
+    size_t const ip_length = HyphaIpUdpFlowBuild(context, flow, frame, datagram);
+    size_t const udp_length = ip_length - sizeof(HyphaIpIPv4Header_t);
+    // the build decided where each checksum is made, the flags say which way it went
+    if (HYPHA_IP_USE_IP_CHECKSUM && (frame->info.flags & HyphaIpFrameFlagIPv4ChecksumInsert) != 0U) {
+        context->statistics.checksums.ipv4.tx_offloaded++;
+    } else if (HYPHA_IP_USE_IP_CHECKSUM) {
+        context->statistics.checksums.ipv4.tx_software++;
+    }
+    if (HYPHA_IP_USE_UDP_CHECKSUM && (frame->info.flags & HyphaIpFrameFlagUdpChecksumInsert) != 0U) {
+        context->statistics.checksums.udp.tx_offloaded++;
+    } else if (HYPHA_IP_USE_UDP_CHECKSUM) {
+        context->statistics.checksums.udp.tx_software++;
+    }
+
+    status = HyphaIpEthernetSendFrame(context, frame, &flow->metadata, ip_length);
+    HyphaIpStatus_e released = HyphaIpDriverRelease(context, frame);
+    status = HyphaIpIsFailure(status) ? status : released;
+    if (HyphaIpIsSuccess(status)) {
+        context->statistics.counter.ipv4.tx.count++;
+        context->statistics.counter.ipv4.tx.bytes += ip_length;
+        context->statistics.ip.accepted++;
+        context->statistics.counter.udp.tx.count++;
+        context->statistics.counter.udp.tx.bytes += udp_length;  // the length includes the header
+        context->statistics.udp.accepted++;
+    } else {
+        context->statistics.ip.rejected++;
+        context->statistics.udp.rejected++;
+    }
+    return status;
 }
@@ -9,14 +9,46 @@
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
 #include "hypha_ip/hypha_ip.h"
+#include "stdatomic.h"
 
 #ifndef HYPHA_IP_ARP_TABLE_SIZE
 /// The number of ARP entries to keep in the ARP table
 #define HYPHA_IP_ARP_TABLE_SIZE 32
 #endif
 
+#ifndef HYPHA_IP_ARP_INDEX_SIZE
+/// The number of slots in each of the ARP hash indexes. Keeping this at least twice the table keeps the probes short.
+#define HYPHA_IP_ARP_INDEX_SIZE (2U * HYPHA_IP_ARP_TABLE_SIZE)
+#endif
+
+#ifndef HYPHA_IP_ARP_PENDING_DESTINATIONS
+/// The number of unresolved IPv4 destinations which can have transmits waiting for an ARP reply at once
+#define HYPHA_IP_ARP_PENDING_DESTINATIONS 4
+#endif
+
+#ifndef HYPHA_IP_ARP_PENDING_FRAMES
+/// The number of frames which can wait for the ARP reply of any one destination
+#define HYPHA_IP_ARP_PENDING_FRAMES 4
+#endif
+
+#ifndef HYPHA_IP_ARP_PENDING_BYTES
+/// The bytes of frames which can wait for ARP replies all together, the memory bound of the pending queue
+#define HYPHA_IP_ARP_PENDING_BYTES (2U * HYPHA_IP_FRAME_CAPACITY)
+#endif
+
+#ifndef HYPHA_IP_ROUTE_TABLE_SIZE
+/// The number of routes in the routing table, which holds the route to the network of each interface and the default
+/// route too
+#define HYPHA_IP_ROUTE_TABLE_SIZE 8
+#endif
+
+#ifndef HYPHA_IP_ROUTE_CACHE_SIZE
+/// The number of destinations whose next hop is remembered, a power of two
+#define HYPHA_IP_ROUTE_CACHE_SIZE 16
+#endif
+
 #ifndef HYPHA_IP_IPv4_FILTER_TABLE_SIZE
-/// The number of entries to keep in the IP Address filter table
+/// The number of address ranges to keep in the IP Address filter table, a host or network prefix takes at most one
 #define HYPHA_IP_IPv4_FILTER_TABLE_SIZE 32
 #endif
 
@@ -25,6 +57,33 @@
 #define HYPHA_IP_MAC_FILTER_TABLE_SIZE 32
 #endif
 
+#ifndef HYPHA_IP_MULTICAST_FILTER_SIZE
+/// The number of IPv4 multicast groups the Ethernet filter can accept when not allowing any multicast
+#define HYPHA_IP_MULTICAST_FILTER_SIZE 64
+#endif
+
+#ifndef HYPHA_IP_MULTICAST_FILTER_BITS
+/// The number of bits in the multicast filter's bitmap, a power of two. More bits than groups keeps the collisions
+/// (which are then turned away by the exact match) rare.
+#define HYPHA_IP_MULTICAST_FILTER_BITS 1024
+#endif
+
+#ifndef HYPHA_IP_UDP_LISTENER_TABLE_SIZE
+/// The number of (address, port) UDP listeners which can be registered
+#define HYPHA_IP_UDP_LISTENER_TABLE_SIZE 16
+#endif
+
+#ifndef HYPHA_IP_UDP_LISTENER_INDEX_SIZE
+/// The number of slots in the UDP listener hash table, at least twice the listeners keeps the probes short
+#define HYPHA_IP_UDP_LISTENER_INDEX_SIZE (2U * HYPHA_IP_UDP_LISTENER_TABLE_SIZE)
+#endif
+
+#ifndef HYPHA_IP_TRANSMIT_RING_SIZE
+/// The number of frames in the ring which other threads queue their transmits on, a power of two. Each slot holds a
+/// frame from the driver for as long as the ring is started.
+#define HYPHA_IP_TRANSMIT_RING_SIZE 64
+#endif
+
 #ifndef HYPHA_IP_USE_IP_CHECKSUM
 /// Whether to use the IP Checksum in the IPv4 header
 #define HYPHA_IP_USE_IP_CHECKSUM (true)
@@ -72,13 +131,98 @@
 #define HYPHA_IP_EXPIRATION_TIME (HyphaIpTimestamp_t)1'000'000'000'000U
 #endif
 
+#ifndef HYPHA_IP_REASSEMBLY_TIMEOUT
+/// How long a fragmented IPv4 datagram may take to arrive in full, in Timestamp_t units, counted from its first
+/// fragment. If these were milliseconds this would be 30 seconds (RFC 791 suggests 15 to 120).
+#define HYPHA_IP_REASSEMBLY_TIMEOUT (HyphaIpTimestamp_t)30'000U
+#endif
+
+#ifndef HYPHA_IP_ARP_REQUEST_TIMEOUT
+/// How long the frames to an unresolved destination wait for the ARP reply, in Timestamp_t units, before they are
+/// dropped. If these were milliseconds this would be 1 second.
+#define HYPHA_IP_ARP_REQUEST_TIMEOUT (HyphaIpTimestamp_t)1'000U
+#endif
+
+#ifndef HYPHA_IP_TIMER_RESOLUTION
+/// The width of the finest slot of the timer wheel in Timestamp_t units. Timers fire at the first slot boundary at
+/// or after their deadline.
+#define HYPHA_IP_TIMER_RESOLUTION (HyphaIpTimestamp_t)1U
+#endif
+
+#ifndef HYPHA_IP_TIMER_WHEEL_LEVELS
+/// The number of levels of the timer wheel, each one's slots are 64 times wider than the one below. Four levels of
+/// milliseconds reach about 4.6 hours, timers further off than that wait in an overflow list.
+#define HYPHA_IP_TIMER_WHEEL_LEVELS 4U
+#endif
+
+#ifndef HYPHA_IP_IGMP_GROUP_TABLE_SIZE
+/// The number of multicast groups which can be joined at once
+#define HYPHA_IP_IGMP_GROUP_TABLE_SIZE 32
+#endif
+
+#ifndef HYPHA_IP_IGMP_DECISECOND
+/// The number of Timestamp_t units in a tenth of a second, the unit of the IGMP Max Response Time. If these were
+/// milliseconds this would be 100.
+#define HYPHA_IP_IGMP_DECISECOND (HyphaIpTimestamp_t)100U
+#endif
+
+#ifndef HYPHA_IP_IGMP_REPORTS_PER_RUN
+/// The most delayed IGMP reports sent in one run of the stack. A node in many groups spreads its answers to a
+/// General Query over several runs instead of sending them in one burst.
+#define HYPHA_IP_IGMP_REPORTS_PER_RUN 4U
+#endif
+
+#ifndef HYPHA_IP_USE_SIMD_CHECKSUM
+/// Whether to use the SIMD checksum kernels (SSE2/AVX2/NEON) when the target supports them
+#define HYPHA_IP_USE_SIMD_CHECKSUM (1)
+#endif
+
+#ifndef HYPHA_IP_BATCH_SIZE
+/// The maximum number of frames handed to the driver's batch interfaces in a single call
+#define HYPHA_IP_BATCH_SIZE 32
+#endif
+
 static_assert(HYPHA_IP_MTU >= 64U, "The MTU must be greater than 64 bytes");
 static_assert((HYPHA_IP_MTU % sizeof(uint16_t)) == 0, "MTU must be whole number of uint16_t's for Hypha IP stack");
 static_assert(HYPHA_IP_TTL > 0U, "The TTL must be greater than 0");
 static_assert(HYPHA_IP_ARP_TABLE_SIZE > 0U, "The ARP table size must be greater than 0");
+static_assert(HYPHA_IP_ARP_TABLE_SIZE < UINT16_MAX, "The ARP entries are numbered in 16 bits");
+static_assert(HYPHA_IP_ARP_INDEX_SIZE > HYPHA_IP_ARP_TABLE_SIZE, "The ARP index must always have an empty slot");
+static_assert(HYPHA_IP_ARP_PENDING_DESTINATIONS > 0U, "At least one destination must be able to wait for ARP");
+static_assert(HYPHA_IP_ARP_PENDING_FRAMES > 0U, "At least one frame must be able to wait for ARP");
+static_assert(HYPHA_IP_ARP_PENDING_BYTES >= HYPHA_IP_FRAME_CAPACITY, "The ARP pending queue must hold a whole frame");
+static_assert(HYPHA_IP_INTERFACE_COUNT > 0 && HYPHA_IP_INTERFACE_COUNT <= UINT8_MAX,
+              "The interfaces are numbered in 8 bits and there must be at least one");
+static_assert(HYPHA_IP_ROUTE_TABLE_SIZE > HYPHA_IP_INTERFACE_COUNT,
+              "The routing table must hold the route of each interface and the default route");
+static_assert(HYPHA_IP_ROUTE_CACHE_SIZE > 0U && (HYPHA_IP_ROUTE_CACHE_SIZE & (HYPHA_IP_ROUTE_CACHE_SIZE - 1U)) == 0U,
+              "The route cache size must be a power of two");
 static_assert(HYPHA_IP_IPv4_FILTER_TABLE_SIZE > 0U, "The IP filter table size must be greater than 0");
 static_assert(HYPHA_IP_MAC_FILTER_TABLE_SIZE > 0U, "The MAC filter table size must be greater than 0");
+static_assert(HYPHA_IP_MULTICAST_FILTER_SIZE > 0U, "The multicast filter size must be greater than 0");
+static_assert(HYPHA_IP_MULTICAST_FILTER_BITS >= 64U &&
+                  (HYPHA_IP_MULTICAST_FILTER_BITS & (HYPHA_IP_MULTICAST_FILTER_BITS - 1U)) == 0U,
+              "The multicast filter bitmap must be a power of two of at least 64 bits");
+static_assert(HYPHA_IP_UDP_LISTENER_TABLE_SIZE > 0U, "The UDP listener table size must be greater than 0");
+static_assert(HYPHA_IP_UDP_LISTENER_INDEX_SIZE > HYPHA_IP_UDP_LISTENER_TABLE_SIZE,
+              "The UDP listener hash table must always have an empty slot");
+static_assert(HYPHA_IP_IGMP_GROUP_TABLE_SIZE > 0U, "The IGMP group table size must be greater than 0");
+static_assert(HYPHA_IP_IGMP_DECISECOND > 0U, "The IGMP decisecond must be at least one timestamp unit");
+static_assert(HYPHA_IP_IGMP_REPORTS_PER_RUN > 0U, "At least one IGMP report must be sent in each run");
+static_assert(HYPHA_IP_BATCH_SIZE > 0U, "The batch size must be greater than 0");
+static_assert(HYPHA_IP_TRANSMIT_RING_SIZE > 0U &&
+                  (HYPHA_IP_TRANSMIT_RING_SIZE & (HYPHA_IP_TRANSMIT_RING_SIZE - 1U)) == 0U,
+              "The transmit ring size must be a power of two");
+static_assert(HYPHA_IP_CONTEXT_ALIGNMENT > 0 && (HYPHA_IP_CONTEXT_ALIGNMENT & (HYPHA_IP_CONTEXT_ALIGNMENT - 1)) == 0,
+              "The context alignment must be a power of two");
 static_assert(HYPHA_IP_EXPIRATION_TIME > 0U, "The expiration time must be greater than 0");
+static_assert(HYPHA_IP_REASSEMBLY_TIMEOUT > 0U, "The reassembly timeout must be greater than 0");
+static_assert(HYPHA_IP_ARP_REQUEST_TIMEOUT > 0U, "The ARP request timeout must be greater than 0");
+static_assert(HYPHA_IP_TIMER_RESOLUTION > 0U, "The timer resolution must be at least one timestamp unit");
+static_assert(HYPHA_IP_TIMER_WHEEL_LEVELS > 0U && HYPHA_IP_TIMER_WHEEL_LEVELS <= 10U,
+              "The timer wheel must have between 1 and 10 levels of 6 bits each");
+static_assert(HYPHA_IP_REASSEMBLY_SIZE > 0U && HYPHA_IP_REASSEMBLY_SIZE <= (65535U - 20U),
+              "The reassembly size must fit in the payload of an IPv4 packet");
 static_assert(HYPHA_IP_VLAN_ID >= 0U && HYPHA_IP_VLAN_ID <= 4095U, "The VLAN ID must be 0 <= x <= (2^12)-1");
 static_assert(HYPHA_IP_ALLOW_ANY_BROADCAST == 0 || HYPHA_IP_ALLOW_ANY_BROADCAST == 1,
               "HYPHA_IP_ALLOW_ANY_BROADCAST must be 0 or 1 to disable or enable broadcast support");
@@ -92,6 +236,8 @@ static_assert(HYPHA_IP_USE_ARP_CACHE == 0 || HYPHA_IP_USE_ARP_CACHE == 1,
               "HYPHA_IP_USE_ARP_CACHE must be 0 or 1 to disable or enable ARP caching");
 static_assert(HYPHA_IP_USE_VLAN == 0 || HYPHA_IP_USE_VLAN == 1,
               "HYPHA_IP_USE_VLAN must be 0 or 1 to disable or enable VLAN support");
+static_assert(HYPHA_IP_USE_SIMD_CHECKSUM == 0 || HYPHA_IP_USE_SIMD_CHECKSUM == 1,
+              "HYPHA_IP_USE_SIMD_CHECKSUM must be 0 or 1 to disable or enable the SIMD checksum kernels");
 
 /// The Checksum enumeration special values
 typedef enum HyphaIpChecksum : uint16_t {
@@ -116,10 +262,10 @@ typedef struct HyphaIpIPv4Header {
     uint16_t DSCP : 6;                 ///<  Differentiated Services Code Point
     uint16_t length;                   ///<  The length in bytes of the header + the payload
     uint16_t identification;           ///<  Used by fragmentation algorithms to identify fragments
-    uint16_t zero : 1;                 ///<  Reserved. Set to zero.
-    uint16_t DF : 1;                   ///<  Do not Fragment
+    uint16_t fragment_offset : 13;     ///<  The offset of a fragment within the overall packet in 8 byte units
     uint16_t MF : 1;                   ///<  More Fragments
-    uint16_t fragment_offset : 13;     ///<  The offset which a fragment is within the overall packet. Not used here.
+    uint16_t DF : 1;                   ///<  Do not Fragment
+    uint16_t zero : 1;                 ///<  Reserved. Set to zero.
     uint16_t TTL : 8;                  ///<  The time to live. @ref HYPHA_IP_TTL for the default value
     uint16_t protocol : 8;             ///<  @ref HyphaIpProtocol_e
     uint16_t checksum;                 ///<  the 1's compliment checksum.
@@ -134,6 +280,16 @@ static_assert(sizeof(HyphaIpIPv4Header_t) == 20U, "Must be this size, no options
 /// The maximum number of bytes for a IP packet
 #define HYPHA_IP_MAX_IP_PAYLOAD_SIZE (HYPHA_IP_MAX_IP_LENGTH - sizeof(HyphaIpIPv4Header_t))
 
+/// The number of IPv4 payload bytes in each fragment but the last, fragment offsets are in 8 byte units
+#define HYPHA_IP_IPv4_FRAGMENT_SIZE ((HYPHA_IP_MAX_IP_PAYLOAD_SIZE / 8U) * 8U)
+
+/// Where a packet sits within a fragmented datagram, all zero for a packet which is not fragmented
+typedef struct HyphaIpIPv4Fragment {
+    uint16_t identification;  ///< The identification shared by every fragment of the datagram
+    uint16_t offset;          ///< The byte offset of this fragment in the datagram, a multiple of 8
+    bool more;                ///< More fragments follow this one
+} HyphaIpIPv4Fragment_t;
+
 /// The IPv4 Packet
 typedef struct HyphaIpIPv4Packet {
     HyphaIpIPv4Header_t header;                     ///< the IPv4 Header
@@ -153,6 +309,8 @@ typedef struct HyphaIpUDPHeader {
 /// The maximum number of bytes for a UDP datagram payload
 #define HYPHA_IP_MAX_UDP_PAYLOAD_SIZE (HYPHA_IP_MAX_UDP_LENGTH - sizeof(HyphaIpUDPHeader_t))
 static_assert(HYPHA_IP_MAX_UDP_PAYLOAD_SIZE > 0U, "The maximum UDP datagram size must be greater than 0");
+static_assert(((HYPHA_IP_IPv4_FRAGMENT_SIZE - sizeof(HyphaIpUDPHeader_t)) % sizeof(uint16_t)) == 0U,
+              "Every fragment must start on an even offset of the UDP payload so the checksums can be added");
 static_assert((HYPHA_IP_MAX_UDP_PAYLOAD_SIZE % sizeof(uint16_t)) == 0U,
               "The maximum UDP datagram size must be a whole number of uint16_t's for Hypha IP stack");
 
@@ -230,10 +388,56 @@ static_assert(sizeof(HyphaIpArpPacket_t) == 28U, "Must be this size");
 /// The Address Resolution Protocol Entry in the Cache
 typedef struct HyphaIpARPEntry {
     bool valid;                     ///< Is the address valid
-    HyphaIpTimestamp_t expiration;  ///< A time in the future when this expires
+    HyphaIpTimestamp_t expiration;  ///< When the entry was given to expire, the owner's timer may since have moved on
     HyphaIpAddressMatch_t match;    ///< The address match information
 } HyphaIpARPEntry_t;
 
+/// The ARP entries, packed at the front of the table, with open addressing hash indexes to find them by either address.
+/// The index slots hold the entry number plus one, zero is an empty slot.
+typedef struct HyphaIpArpCache {
+    size_t count;                                        ///< The number of entries in use
+    HyphaIpARPEntry_t entries[HYPHA_IP_ARP_TABLE_SIZE];  ///< The entries, [0, count) are in use
+    uint16_t by_ipv4[HYPHA_IP_ARP_INDEX_SIZE];           ///< The index by IPv4 Address, each is unique
+    uint16_t by_mac[HYPHA_IP_ARP_INDEX_SIZE];            ///< The index by Ethernet Address, which may repeat
+} HyphaIpArpCache_t;
+
+/// A frame waiting for the ARP reply of its destination. Its bytes, from the Ethernet header on, are in the storage of
+/// the queue.
+typedef struct HyphaIpArpPendingFrame {
+    HyphaIpIPv4Address_t destination;  ///< The address being resolved
+    uint32_t flags;                    ///< The frame flags, see @ref HyphaIpFrameFlag_e
+    uint8_t interface;                 ///< The interface the frame leaves on
+    size_t offset;                     ///< Where the bytes start in the storage
+    size_t length;                     ///< The number of bytes
+} HyphaIpArpPendingFrame_t;
+
+/// A destination with an outstanding ARP request
+typedef struct HyphaIpArpResolution {
+    HyphaIpIPv4Address_t destination;  ///< The address being resolved
+    uint16_t timer;                    ///< The timer which gives up on the reply, see @ref HyphaIpTimer_t
+    uint8_t interface;                 ///< The interface the request was sent on
+    size_t count;                      ///< The number of frames waiting for it
+} HyphaIpArpResolution_t;
+
+/// The transmits which wait for ARP replies. The frames are copied into the storage in the order they were sent and
+/// kept packed at the front of it, so the storage bounds the memory for any mix of frame sizes.
+typedef struct HyphaIpArpPending {
+    size_t destinations;                                                    ///< The resolutions [0, destinations)
+    size_t frames;                                                          ///< The frames [0, frames) are waiting
+    size_t used;                                                            ///< The bytes [0, used) of the storage
+    HyphaIpArpResolution_t resolutions[HYPHA_IP_ARP_PENDING_DESTINATIONS];  ///< The outstanding requests
+    /// The waiting frames, in the order they were sent
+    HyphaIpArpPendingFrame_t pending[HYPHA_IP_ARP_PENDING_DESTINATIONS * HYPHA_IP_ARP_PENDING_FRAMES];
+    uint8_t storage[HYPHA_IP_ARP_PENDING_BYTES];  ///< The bytes of the waiting frames
+} HyphaIpArpPending_t;
+
+/// Where the ARP pending queue ended, so the frames held after it can be taken back out
+typedef struct HyphaIpArpPendingMark {
+    size_t destinations;  ///< The number of outstanding requests
+    size_t frames;        ///< The number of waiting frames
+    size_t used;          ///< The bytes of the storage in use
+} HyphaIpArpPendingMark_t;
+
 /// A structure control
 typedef struct HyphaIpEthernetFilter {
     bool valid;                     ///<  Is this entry valid?
@@ -241,11 +445,40 @@ typedef struct HyphaIpEthernetFilter {
     HyphaIpEthernetAddress_t mac;   ///<  The Ethernet Address
 } HyphaIpEthernetFilter_t;
 
-/// The IPv4 Address Filter Entry
+/// The IPv4 multicast Ethernet Addresses (01:00:5E + 23 bits) which are accepted. The bitmap answers most addresses
+/// on its own, the sorted groups confirm the ones it lets through.
+typedef struct HyphaIpMulticastFilter {
+    uint64_t bits[HYPHA_IP_MULTICAST_FILTER_BITS / 64U];  ///< One bit per hash, set when any group hashes there
+    size_t count;                                         ///< The number of groups
+    uint32_t groups[HYPHA_IP_MULTICAST_FILTER_SIZE];      ///< The low 23 bits of each group's address, in order
+} HyphaIpMulticastFilter_t;
+
+/// A registered UDP listener
+typedef struct HyphaIpUdpListenerEntry {
+    HyphaIpIPv4Address_t address;   ///< The destination address, or the default route for any
+    uint16_t port;                  ///< The destination port
+    HyphaIpUdpListener_f listener;  ///< The function to call, nullptr when the slot is empty
+    void *user;                     ///< Given to the listener
+} HyphaIpUdpListenerEntry_t;
+
+/// The UDP listeners, an open addressed hash table on the destination address and port
+typedef struct HyphaIpUdpListeners {
+    size_t count;                                                       ///< The number of registered listeners
+    HyphaIpUdpListenerEntry_t slots[HYPHA_IP_UDP_LISTENER_INDEX_SIZE];  ///< The listeners, linearly probed
+} HyphaIpUdpListeners_t;
+
+/// A range of IPv4 addresses, both ends included, as host order values
+typedef struct HyphaIpIPv4Range {
+    uint32_t first;                 ///< The lowest address in the range
+    uint32_t last;                  ///< The highest address in the range
+    HyphaIpTimestamp_t expiration;  ///< When the range is removed, the latest of the ranges merged into it
+} HyphaIpIPv4Range_t;
+
+/// The IPv4 Address Filter. The prefixes are kept as disjoint ranges sorted by address, so hosts and whole networks
+/// are found by the same binary search and neighbouring prefixes collapse into a single range.
 typedef struct HyphaIpIPv4Filter {
-    bool valid;                     ///<  Is this entry valid?
-    HyphaIpTimestamp_t expiration;  ///<  A time in the future when this expires
-    HyphaIpIPv4Address_t ipv4;      ///<  The IPv4 Address
+    size_t count;                                                ///< The number of ranges
+    HyphaIpIPv4Range_t ranges[HYPHA_IP_IPv4_FILTER_TABLE_SIZE];  ///< The ranges in ascending order
 } HyphaIpIPv4Filter_t;
 
 /// THe UDP Header checksum is computed over this structure + the payload
@@ -257,6 +490,9 @@ typedef struct HyphaIpPseudoHeader {
     uint16_t length;                   ///<  The length of the packet in bytes
     HyphaIpUDPHeader_t header;         ///<  The UDP Header
 } HyphaIpPseudoHeader_t;
+static_assert(HYPHA_IP_UDP_FLOW_HEADER_SIZE ==
+                  sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpIPv4Header_t) + sizeof(HyphaIpUDPHeader_t),
+              "The flow template must hold exactly the headers");
 
 /// The IGMP Packet
 typedef struct HyphaIpIgmpPacket {
@@ -275,45 +511,298 @@ typedef enum HyphaIpIgmpType : uint8_t {
     HyphaIpIgmpTypeReport_v3 = 0x22,  ///< Report Group Membership v3
 } HyphaIpIgmpType_e;
 
-/// The Hypha IP Features
+/// The states of a joined group (RFC 2236 section 6), a group which is not in the table is a Non-Member
+typedef enum HyphaIpIgmpState : uint8_t {
+    HyphaIpIgmpStateIdle = 0,  ///< A member with nothing to send
+    HyphaIpIgmpStateDelaying,  ///< A member which will report when its deadline passes, unless another host does
+} HyphaIpIgmpState_e;
+
+/// A joined multicast group
+typedef struct HyphaIpIgmpGroup {
+    HyphaIpIPv4Address_t group;   ///< The group address
+    uint16_t references;          ///< The number of receivers on the group, the group is left when this reaches 0
+    HyphaIpIgmpState_e state;     ///< The membership state
+    uint16_t timer;               ///< The timer of the delayed report, running while the member is delaying
+    bool filtered;                ///< Set when the join let the group's Ethernet Address through the filter
+    HyphaIpTimestamp_t deadline;  ///< When a delaying member reports
+} HyphaIpIgmpGroup_t;
+
+/// The joined multicast groups, kept at the front of the table
+typedef struct HyphaIpIgmpGroups {
+    size_t count;                                                ///< The number of joined groups
+    size_t delaying;                                             ///< The number of groups waiting to report
+    size_t budget;                                               ///< The reports which may still be sent this run
+    uint32_t random;                                             ///< The generator which spreads the reports out
+    bool all_hosts;                                              ///< Set when a join let the all-hosts address through
+    HyphaIpIgmpGroup_t entries[HYPHA_IP_IGMP_GROUP_TABLE_SIZE];  ///< The groups
+} HyphaIpIgmpGroups_t;
+
+/// The number of slots in each level of the timer wheel
+#define HYPHA_IP_TIMER_SLOTS 64U
+
+/// The number of bits of the tick each level of the timer wheel covers
+#define HYPHA_IP_TIMER_SLOT_BITS 6U
+
+/// The list of the timers which are further off than the wheel reaches
+#define HYPHA_IP_TIMER_LIST_OVERFLOW (HYPHA_IP_TIMER_WHEEL_LEVELS * HYPHA_IP_TIMER_SLOTS)
+
+/// The list of the timers which are due and wait for the next tick
+#define HYPHA_IP_TIMER_LIST_EXPIRED (HYPHA_IP_TIMER_LIST_OVERFLOW + 1U)
+
+/// The list of the timers which are firing in this tick
+#define HYPHA_IP_TIMER_LIST_FIRING (HYPHA_IP_TIMER_LIST_OVERFLOW + 2U)
+
+/// The number of timer lists, the slots of every level then the lists above
+#define HYPHA_IP_TIMER_LISTS (HYPHA_IP_TIMER_LIST_OVERFLOW + 3U)
+
+/// The list of an unused timer, which is none of the lists
+#define HYPHA_IP_TIMER_LIST_UNUSED HYPHA_IP_TIMER_LISTS
+
+/// The number of timers, one for everything which ages
+#define HYPHA_IP_TIMER_COUNT                                                                      \
+    (HYPHA_IP_ARP_TABLE_SIZE + HYPHA_IP_MAC_FILTER_TABLE_SIZE + HYPHA_IP_IPv4_FILTER_TABLE_SIZE + \
+     HYPHA_IP_IGMP_GROUP_TABLE_SIZE + HYPHA_IP_ARP_PENDING_DESTINATIONS + HYPHA_IP_REASSEMBLY_SLOTS)
+static_assert(HYPHA_IP_TIMER_COUNT < UINT16_MAX, "The timers are numbered in 16 bits");
+
+/// The number of slots in the hash index of the timers which age the tables, twice the entries which can age
+#define HYPHA_IP_TIMER_INDEX_SIZE \
+    (2U * (HYPHA_IP_ARP_TABLE_SIZE + HYPHA_IP_MAC_FILTER_TABLE_SIZE + HYPHA_IP_IPv4_FILTER_TABLE_SIZE))
+
+/// What a timer ages, which says how its key finds the owner. The entries of the tables are aged by the timer of
+/// their kind and key, the others hold the numbers of their timers.
+typedef enum HyphaIpTimerKind : uint8_t {
+    HyphaIpTimerKindArpEntry = 0,    ///< An ARP cache entry, the key is its IPv4 Address
+    HyphaIpTimerKindEthernetFilter,  ///< An Ethernet filter entry, the key is its index
+    HyphaIpTimerKindIPv4Filter,      ///< An IPv4 filter range, the key is its first address
+    HyphaIpTimerKindIgmpReport,      ///< The delayed report of a joined group, the key is the group address
+    HyphaIpTimerKindArpRequest,      ///< An outstanding ARP request, the key is the unresolved IPv4 Address
+    HyphaIpTimerKindReassembly,      ///< An incomplete datagram, the key is the index of its reassembly slot
+} HyphaIpTimerKind_e;
+
+/// A timer of the wheel. The owners hold the timer's number (the index plus one, zero is no timer) and the lists link
+/// the timers by number, so the owners may be moved around their tables.
+typedef struct HyphaIpTimer {
+    HyphaIpTimestamp_t deadline;  ///< When the timer fires
+    uint32_t key;                 ///< Finds the owner, see @ref HyphaIpTimerKind_e
+    uint16_t list;                ///< The list the timer is on, @ref HYPHA_IP_TIMER_LIST_UNUSED when it is unused
+    uint16_t previous;            ///< The timer before this one on its list
+    uint16_t next;                ///< The timer after this one on its list, or the next unused timer
+    HyphaIpTimerKind_e kind;      ///< What the timer ages
+    bool seen;                    ///< Set when the entry the timer ages was found, while catching up with the tables
+} HyphaIpTimer_t;
+
+/// A hierarchical timer wheel. A timer waits in the level of the highest 6 bit digit where its deadline (in ticks of
+/// @ref HYPHA_IP_TIMER_RESOLUTION) differs from now and drops to a lower level when that digit comes around, so each
+/// timer is moved at most once per level on its way to firing and nothing is ever scanned for expired entries.
+/// Only the owner thread uses the wheel, so the versions of the tables hold expirations and never timers.
+typedef struct HyphaIpTimerWheel {
+    HyphaIpTimestamp_t now;                         ///< The current tick
+    uint64_t pending[HYPHA_IP_TIMER_WHEEL_LEVELS];  ///< The slots of each level which hold any timers
+    uint16_t lists[HYPHA_IP_TIMER_LISTS];           ///< The first timer of each list
+    uint16_t unused;                                ///< The first of the unused timers
+    uint16_t used;                                  ///< The timers [0, used) have been handed out before
+    size_t populated;                               ///< The populates of the tables the aging has caught up with
+    uint16_t aging[HYPHA_IP_TIMER_INDEX_SIZE];      ///< The aging timers by kind and key, linearly probed
+    HyphaIpTimer_t timers[HYPHA_IP_TIMER_COUNT];    ///< The timers
+} HyphaIpTimerWheel_t;
+
+/// The Hypha IP Features. The populates turn the filters on from other threads while the owner reads them on every
+/// frame, so each is atomic.
 typedef struct HyphaIpFeatures {
     /// Enables allowing any localhost through
-    bool allow_any_localhost;
+    atomic_bool allow_any_localhost;
     /// Enables allowing any multicast through
-    bool allow_any_multicast;
+    atomic_bool allow_any_multicast;
     /// Enables allowing any broadcast through
-    bool allow_any_broadcast;
+    atomic_bool allow_any_broadcast;
     /// Enables the MAC software filter. If pre-filtered by hardware, disable filtering here.
-    bool allow_mac_filtering;
+    atomic_bool allow_mac_filtering;
     /// Enables the IP software filter. If pre-filtered by hardware, disable filtering here.
-    bool allow_ip_filtering;
+    atomic_bool allow_ip_filtering;
     /// Enables the ARP cache. If pre-filtered by hardware, disable caching here.
-    bool allow_arp_cache;
+    atomic_bool allow_arp_cache;
 #if (HYPHA_IP_USE_VLAN == 1)
     /// Enables the VLAN filtering. If pre-filtered by hardware, disable filtering here.
-    bool allow_vlan_filtering;
+    atomic_bool allow_vlan_filtering;
 #endif
 } HyphaIpFeatures_t;
 
-/// Our internal context for the Stack
-struct HyphaIpContext {
-    HyphaIpPrintInfo_t debugging;         ///<  The debugging mask for this stack
-    HyphaIpNetworkInterface_t interface;  ///< The Network interface given to the context
-    HyphaIpExternalContext_t theirs;      ///< The external context to give to the external interfaces
-    HyphaIpExternalInterface_t external;  ///< The structure of interface pointers for external functions.
-    HyphaIpFeatures_t features;           ///<  The features of this stack
+/// The frames held back while a burst is open so they can be given to the driver in as few calls as possible
+typedef struct HyphaIpFrameBurst {
+    size_t depth;                                           ///< The nesting depth of open bursts, 0 when closed
+    size_t transmits;                                       ///< The number of frames waiting to be transmitted
+    size_t releases;                                        ///< The number of frames waiting to be released
+    HyphaIpEthernetFrame_t *transmit[HYPHA_IP_BATCH_SIZE];  ///< The frames to transmit, in order
+    HyphaIpEthernetFrame_t *release[HYPHA_IP_BATCH_SIZE];   ///< The frames to release after transmission
+    HyphaIpStatus_e status;                                 ///< The first failure of a flush made for an acquire
+} HyphaIpFrameBurst_t;
+
+/// The number of 16 bit words a checksum cache can track (an IPv4 header, or a UDP pseudo header + UDP header)
+#define HYPHA_IP_CHECKSUM_CACHE_WORDS (sizeof(HyphaIpIPv4Header_t) / sizeof(uint16_t))
+
+/// The last header words sent on a transmit path and their checksum, so that the next checksum only has to account
+/// for the words which changed (RFC 1624)
+typedef struct HyphaIpChecksumCache {
+    bool valid;                                     ///< True once words and checksum have been computed
+    uint16_t checksum;                              ///< The (complimented) checksum over the words
+    uint16_t words[HYPHA_IP_CHECKSUM_CACHE_WORDS];  ///< The network order words the checksum covers
+} HyphaIpChecksumCache_t;
+
+/// A route to a network, through a gateway or straight to the destination when it is on the link
+typedef struct HyphaIpRoute {
+    uint32_t network;              ///< The network, already masked
+    uint32_t netmask;              ///< The netmask of the prefix
+    HyphaIpIPv4Address_t gateway;  ///< The next hop, or @ref hypha_ip_default_route when the network is on the link
+    uint8_t length;                ///< The prefix length
+    uint8_t interface;             ///< The interface the route leaves on
+} HyphaIpRoute_t;
+
+/// The next hop of a destination, as found by @ref HyphaIpRouteLookup
+typedef struct HyphaIpNextHop {
+    HyphaIpIPv4Address_t destination;  ///< The destination which was looked up
+    HyphaIpIPv4Address_t next_hop;     ///< The address to resolve over ARP, the gateway or the destination itself
+    uint8_t interface;                 ///< The interface to transmit on
+    bool valid;                        ///< False when the cache slot is empty
+} HyphaIpNextHop_t;
+
+/// The routing table. The routes are kept in order of decreasing prefix length so the first match is the longest one.
+typedef struct HyphaIpRoutes {
+    size_t generation;                                ///< Counts the changes of the routes
+    size_t count;                                     ///< The routes [0, count) are in use
+    HyphaIpRoute_t table[HYPHA_IP_ROUTE_TABLE_SIZE];  ///< The routes, longest prefix first
+} HyphaIpRoutes_t;
+
+/// The answers of the recent route lookups, direct mapped by destination. Only the owner thread uses it and it is
+/// emptied by the first lookup after the routes change, so a change of route is never answered from it.
+typedef struct HyphaIpRouteCache {
+    size_t generation;                                 ///< The generation of the routes the next hops were found in
+    HyphaIpNextHop_t hops[HYPHA_IP_ROUTE_CACHE_SIZE];  ///< The recent lookups
+} HyphaIpRouteCache_t;
+
+/// The checksum caches of the transmit paths
+typedef struct HyphaIpTransmitChecksums {
+    HyphaIpChecksumCache_t ipv4;  ///< The IPv4 header (the checksum word is zero)
+    HyphaIpChecksumCache_t udp;   ///< The UDP pseudo header + UDP header (the checksum word is zero)
+} HyphaIpTransmitChecksums_t;
+
+/// The caller provided slots which fragmented IPv4 datagrams are put back together in
+typedef struct HyphaIpReassembly {
+    size_t count;                    ///< The number of slots, zero when reassembly is off
+    HyphaIpReassemblySlot_t *slots;  ///< The slots
+} HyphaIpReassembly_t;
+
+/// A slot of the transmit ring. Its sequence says whose turn it is: a producer may reserve it when the sequence is
+/// the position being reserved, the owner may drain it at the position plus one, and refilling it with a fresh frame
+/// moves it a lap ahead.
+typedef struct HyphaIpTransmitSlot {
+    atomic_size_t sequence;         ///< The turn of the slot
+    HyphaIpEthernetFrame_t *frame;  ///< The frame of the slot, nullptr from when it is drained until it is refilled
+} HyphaIpTransmitSlot_t;
+
+/// A bounded ring of frames which many threads transmit on and the owner thread of the context drains (after Dmitry
+/// Vyukov's bounded MPMC queue, with a single consumer). Producers claim positions by a compare and swap and publish
+/// the frames by the sequences of their slots, so no thread ever waits on a lock. The two positions are on their own
+/// cache lines so the producers and the owner do not contend for one.
+typedef struct HyphaIpTransmitRing {
+    _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) atomic_size_t enqueue;  ///< The next position to reserve, shared by producers
+    atomic_size_t overflows;  ///< The reservations refused because the ring was full, counted by the producers
+    _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) size_t dequeue;  ///< The next position to drain, only used by the owner
+    size_t refill;        ///< The next drained position to get a fresh frame, only used by the owner
+    atomic_bool started;  ///< True while the ring is running
+    HyphaIpTransmitSlot_t slots[HYPHA_IP_TRANSMIT_RING_SIZE];  ///< The slots, by position modulo the size
+} HyphaIpTransmitRing_t;
+
+/// The tables of a version, as a mask. A writer drafts only the tables it changes, so learning one ARP entry does not
+/// copy the filters and routes.
+typedef enum HyphaIpTable : uint8_t {
+    HyphaIpTableNone = 0U,             ///< Only the counters at the head of the version
+    HyphaIpTableRoutes = 1U,           ///< The routes of unicast transmits
+    HyphaIpTableEthernetFilter = 2U,   ///< The allowed Ethernet addresses
+    HyphaIpTableMulticastFilter = 4U,  ///< The allowed IPv4 multicast Ethernet addresses
+    HyphaIpTableIPv4Filter = 8U,       ///< The allowed IPv4 source ranges
+    HyphaIpTableArpCache = 16U,        ///< The ARP cache and its indexes
+    HyphaIpTableAll = 31U,             ///< Every table
+} HyphaIpTable_e;
+
+/// One version of the tables which the control plane changes while the data path reads them
+typedef struct HyphaIpTables {
+    size_t generation;  ///< Counts the versions which have been published
+    size_t populated;   ///< Counts the populates, which give the entries expirations the owner's timers catch up with
+    /// The routes of unicast transmits
+    HyphaIpRoutes_t routes;
 #if (HYPHA_IP_USE_MAC_FILTER == 1)
     /// The Allow list of ethernet addresses, only used if allow_mac_filtering==true
     HyphaIpEthernetFilter_t allowed_ethernet_addresses[HYPHA_IP_MAC_FILTER_TABLE_SIZE];
+    /// The IPv4 multicast addresses which are allowed, from joined groups and the filter
+    HyphaIpMulticastFilter_t multicast_filter;
 #endif
 #if (HYPHA_IP_USE_IP_FILTER == 1)
     /// The Allow list of IPv4 addresses, only used if allow_ip_filtering==true
-    HyphaIpIPv4Filter_t allowed_ipv4_addresses[HYPHA_IP_IPv4_FILTER_TABLE_SIZE];
+    HyphaIpIPv4Filter_t allowed_ipv4_addresses;
 #endif
 #if (HYPHA_IP_USE_ARP_CACHE == 1)
     /// The Address Resolution Protocol Cache of Addresses Matches
-    HyphaIpARPEntry_t arp_cache[HYPHA_IP_ARP_TABLE_SIZE];
+    HyphaIpArpCache_t arp_cache;
 #endif
+} HyphaIpTables_t;
+
+/// The two versions of the tables, read-copy-update style. A writer copies the tables it changes from the current
+/// version into the spare one, changes the copies and publishes the spare by swapping the current pointer, so the
+/// owner thread reads whole versions without a lock. The spare is only behind the current version in the tables the
+/// last writer changed, those are brought up to date by the next draft. The owner's epoch is odd while it reads, a
+/// version replaced during an odd epoch is not written again until the epoch moves on. The writers are serialized by
+/// a flag, which the owner never waits on while it reads.
+typedef struct HyphaIpTableVersions {
+    /// The version readers are given, only stored by writers
+    _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) _Atomic(HyphaIpTables_t *) current;
+    HyphaIpTables_t *draft;  ///< The copy being changed by the writer holding the flag, nullptr when none
+    size_t retired;          ///< The epoch the spare version was replaced in, the grace period is over once it changes
+    size_t copied;           ///< The bytes copied into drafts, which is what the writers cost
+    uint8_t stale;           ///< The tables, see @ref HyphaIpTable_e, in which the spare version is behind
+    uint8_t drafted;         ///< The tables the draft has been given to change
+    atomic_flag writer;      ///< Set while a writer holds the tables
+    /// Odd while the owner thread reads a version, only stored by the owner
+    _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) atomic_size_t epoch;
+    size_t depth;                 ///< The nesting depth of the owner's reads
+    HyphaIpTables_t versions[2];  ///< The current version and the spare one
+} HyphaIpTableVersions_t;
+
+/// Our internal context for the Stack
+struct HyphaIpContext {
+    /// The debugging mask for this stack, its alignment rounds the whole context out to @ref HYPHA_IP_CONTEXT_ALIGNMENT
+    _Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) HyphaIpPrintInfo_t debugging;
+    /// The network interfaces of the context, by index
+    HyphaIpNetworkInterface_t interfaces[HYPHA_IP_INTERFACE_COUNT];
+    size_t interface_count;               ///< The interfaces [0, interface_count) are in use
+    HyphaIpExternalContext_t theirs;      ///< The external context to give to the external interfaces
+    HyphaIpExternalInterface_t external;  ///< The structure of interface pointers for external functions.
+    HyphaIpFeatures_t features;           ///<  The features of this stack
+    /// The routes, filters and ARP cache, which other threads may change while the owner reads them
+    HyphaIpTableVersions_t tables;
+    /// The next hops of the recent unicast transmits
+    HyphaIpRouteCache_t route_cache;
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+    /// The transmits waiting for the ARP replies of their destinations
+    HyphaIpArpPending_t arp_pending;
+#endif
+    /// The UDP listeners, by destination address and port
+    HyphaIpUdpListeners_t udp_listeners;
+    /// The joined multicast groups, which only the owner thread joins, leaves and reads
+    HyphaIpIgmpGroups_t igmp;
+    /// The timers which age the tables and send the delayed reports, only used by the owner thread
+    HyphaIpTimerWheel_t timers;
+    /// The outgoing burst of frames for the driver
+    HyphaIpFrameBurst_t burst;
+    /// The header checksums of the last transmitted frames
+    HyphaIpTransmitChecksums_t tx_checksums;
+    /// The checksum offloads the driver reported at initialization
+    HyphaIpCapabilities_t capabilities;
+    /// The identification of the next fragmented IPv4 datagram
+    uint16_t ipv4_identification;
+    /// The reassembly of received IPv4 fragments
+    HyphaIpReassembly_t reassembly;
+    /// The frames which other threads queued for transmission
+    HyphaIpTransmitRing_t transmit_ring;
     /// The statistics and metrics structure
     HyphaIpStatistics_t statistics;
 };
@@ -346,14 +835,14 @@ bool HyphaIpIsMulticastEthernetAddress(HyphaIpEthernetAddress_t mac);
 /// @return True if the IP addresses are the same.
 bool HyphaIpIsSameIPv4Address(HyphaIpIPv4Address_t a, HyphaIpIPv4Address_t b);
 
-/// @return True if the address is our interface address
+/// @return True if the address is the address of any of our interfaces
 bool HyphaIpIsOurIPv4Address(HyphaIpContext_t context, HyphaIpIPv4Address_t address);
 
 /// @return True if the address is a limited local broadcast
 bool HyphaIpIsLimitedBroadcastIPv4Address(HyphaIpIPv4Address_t address);
 
-/// @return True if the address is in the same network as our interface is
-bool HyphaIpIsInOurNetwork(HyphaIpContext_t context, HyphaIpIPv4Address_t ipv4);
+/// @return True if the address is in the network of the interface
+bool HyphaIpIsInOurNetwork(HyphaIpContext_t context, uint8_t interface, HyphaIpIPv4Address_t ipv4);
 
 /// @return True if the address is a private address
 bool HyphaIpIsPrivateIPv4Address(HyphaIpIPv4Address_t address);
@@ -376,12 +865,33 @@ bool HyphaIpIsPermittedIPv4Address(HyphaIpContext_t context, HyphaIpIPv4Address_
 /// @return True if the address is routable off the network, i.e. not private
 bool HyphaIpIsRoutableIPv4Address(HyphaIpIPv4Address_t address);
 
-/// @return True if the MAC address is our interface's.
+/// @return True if the MAC address is one of our interfaces'.
 bool HyphaIpIsOurEthernetAddress(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac);
 
 /// @brief Checks if the given Ethernet address is a permitted address.
 bool HyphaIpIsPermittedEthernetAddress(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac);
 
+/// @return True if the MAC address is an IPv4 multicast one (01:00:5E + 23 bits)
+static inline bool HyphaIpIsIPv4MulticastEthernetAddress(HyphaIpEthernetAddress_t mac) {
+    return mac.oui[0] == 0x01U && mac.oui[1] == 0x00U && mac.oui[2] == 0x5EU && (mac.uid[0] & 0x80U) == 0U;
+}
+
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+/// @brief Lets the IPv4 multicast MAC address through the Ethernet filter of the draft tables, the caller holds the
+/// writer flag
+/// @retval HyphaIpStatusEthernetFilterTableFull There are already @ref HYPHA_IP_MULTICAST_FILTER_SIZE groups
+/// @retval HyphaIpStatusInvalidArgument The address is not an IPv4 multicast one
+HyphaIpStatus_e HyphaIpMulticastFilterAdd(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac);
+
+/// @brief Looks for the IPv4 multicast MAC address in the Ethernet filter, the caller holds the writer flag
+/// @return True if the address is let through
+bool HyphaIpMulticastFilterHas(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac);
+
+/// @brief Stops letting the IPv4 multicast MAC address through the Ethernet filter of the draft tables. Its bit of the
+/// bitmap is cleared unless another group shares it. The caller holds the writer flag.
+void HyphaIpMulticastFilterRemove(HyphaIpContext_t context, HyphaIpEthernetAddress_t mac);
+#endif
+
 /// @return True if the MAC address is a local broadcast.
 bool HyphaIpIsLocalBroadcastEthernetAddress(HyphaIpEthernetAddress_t mac);
 
@@ -413,14 +923,30 @@ HyphaIpSpan_t HyphaIpSpanUdpHeader(HyphaIpEthernetFrame_t *frame);
 
 /// @brief A Span covering the UDP Datagram (header + payload) within the Ethernet Frame
 /// @param frame The Ethernet Frame to get the span from
-/// @return A Span covering the UDP Datagram
+/// @return A Span covering the UDP Datagram up to the capacity of the frame's buffer
 HyphaIpSpan_t HyphaIpSpanUdpDatagram(HyphaIpEthernetFrame_t *frame);
 
 /// @param frame The Ethernet Frame to get the span from
-/// @return A span covering the entire, max UDP Payload (not the header) of the Datagram within the Ethernet Frame
+/// @return A span covering the max UDP Payload (not the header) which the capacity of the frame's buffer allows
 /// @note Users should fill in the data and then call @ref HyphaIpSpanResize to set the size of the payload.
 HyphaIpSpan_t HyphaIpSpanUdpPayload(HyphaIpEthernetFrame_t *frame);
 
+/// A position within a list of spans which is being gathered
+typedef struct HyphaIpSpanCursor {
+    size_t index;   ///< The span being read
+    size_t offset;  ///< The byte offset within that span
+} HyphaIpSpanCursor_t;
+
+/// @brief Gathers the next bytes of a list of spans into a contiguous destination, advancing the cursor.
+/// @param destination The bytes to write
+/// @param size The most bytes to write
+/// @param count The number of spans
+/// @param spans The spans to read
+/// @param cursor The position in the spans, updated to just after the last byte gathered
+/// @return The number of bytes gathered, less than size only when the spans ran out
+size_t HyphaIpSpanGather(uint8_t *destination, size_t size, size_t count, HyphaIpSpan_t const spans[count],
+                         HyphaIpSpanCursor_t *cursor);
+
 /// @brief Copies the Ethernet Header from the frame to the destination.
 /// @param dst The destination Ethernet Header
 /// @param src The source Ethernet Frame
@@ -525,28 +1051,390 @@ typedef struct HyphaIpFlipUnit {
 size_t HyphaIpFlipCopy(size_t num_flip_units, HyphaIpFlipUnit_t const flip_units[num_flip_units], void *destination,
                        void const *source);
 
+/// The flip table for Ethernet headers, kept as the reference layout for @ref HyphaIpFlipEthernetHeader
+extern HyphaIpFlipUnit_t const hypha_ip_flip_ethernet_header[2];
+/// The flip table for IPv4 headers, kept as the reference layout for @ref HyphaIpFlipIPv4Header
+extern HyphaIpFlipUnit_t const hypha_ip_flip_ip_header[5];
+/// The flip table for ICMP headers, kept as the reference layout for @ref HyphaIpFlipIcmpHeader
+extern HyphaIpFlipUnit_t const hypha_ip_flip_icmp_header[1];
+/// The flip table for UDP headers, kept as the reference layout for @ref HyphaIpFlipUdpHeader
+extern HyphaIpFlipUnit_t const hypha_ip_flip_udp_header[1];
+/// The flip table for ARP packets, kept as the reference layout for @ref HyphaIpFlipArpPacket
+extern HyphaIpFlipUnit_t const hypha_ip_flip_arp_packet[5];
+/// The flip table for IGMP packets, kept as the reference layout for @ref HyphaIpFlipIgmpPacket
+extern HyphaIpFlipUnit_t const hypha_ip_flip_igmp_packet[3];
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// SPECIALIZED FLIPS (the flip tables above, unrolled at compile time)
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// @brief Copies a run of bytes which are not flipped (addresses, 8 bit fields)
+#define HYPHA_IP_FLIP_KEEP(destination, source, offset, count) \
+    memmove(&(destination)[offset], &(source)[offset], (count))
+
+/// @brief Flips a single 16 bit field at the byte offset, safe when destination and source are the same
+#define HYPHA_IP_FLIP_16(destination, source, offset)    \
+    do {                                                 \
+        uint8_t const flip_hi = (source)[(offset) + 0U]; \
+        uint8_t const flip_lo = (source)[(offset) + 1U]; \
+        (destination)[(offset) + 0U] = flip_lo;          \
+        (destination)[(offset) + 1U] = flip_hi;          \
+    } while (0)
+
+/// @brief Flips an Ethernet header, equivalent to @ref hypha_ip_flip_ethernet_header
+/// @param destination The destination of the flipped header
+/// @param source The source of the header
+static inline void HyphaIpFlipEthernetHeader(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_KEEP(dst, src, 0U, 2U * sizeof(HyphaIpEthernetAddress_t));
+    HYPHA_IP_FLIP_16(dst, src, 12U);
+#if (HYPHA_IP_USE_VLAN == 1)
+    HYPHA_IP_FLIP_16(dst, src, 14U);
+    HYPHA_IP_FLIP_16(dst, src, 16U);
+#endif
+}
+
+/// @brief Flips an IPv4 header, equivalent to @ref hypha_ip_flip_ip_header
+/// @param destination The destination of the flipped header
+/// @param source The source of the header
+static inline void HyphaIpFlipIPv4Header(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_KEEP(dst, src, 0U, 2U);  // version, IHL, DSCP, ECN
+    HYPHA_IP_FLIP_16(dst, src, 2U);        // length
+    HYPHA_IP_FLIP_16(dst, src, 4U);        // identification
+    HYPHA_IP_FLIP_16(dst, src, 6U);        // flags, fragment offset
+    HYPHA_IP_FLIP_KEEP(dst, src, 8U, 2U);  // TTL, protocol
+    HYPHA_IP_FLIP_16(dst, src, 10U);       // checksum
+    HYPHA_IP_FLIP_KEEP(dst, src, 12U, 2U * sizeof(HyphaIpIPv4Address_t));
+}
+
+/// @brief Flips an ICMP header, equivalent to @ref hypha_ip_flip_icmp_header
+/// @param destination The destination of the flipped header
+/// @param source The source of the header
+static inline void HyphaIpFlipIcmpHeader(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_16(dst, src, 0U);
+    HYPHA_IP_FLIP_16(dst, src, 2U);
+}
+
+/// @brief Flips a UDP header, equivalent to @ref hypha_ip_flip_udp_header
+/// @param destination The destination of the flipped header
+/// @param source The source of the header
+static inline void HyphaIpFlipUdpHeader(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_16(dst, src, 0U);
+    HYPHA_IP_FLIP_16(dst, src, 2U);
+    HYPHA_IP_FLIP_16(dst, src, 4U);
+    HYPHA_IP_FLIP_16(dst, src, 6U);
+}
+
+/// @brief Flips an ARP packet, equivalent to @ref hypha_ip_flip_arp_packet
+/// @param destination The destination of the flipped packet
+/// @param source The source of the packet
+static inline void HyphaIpFlipArpPacket(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_16(dst, src, 0U);
+    HYPHA_IP_FLIP_16(dst, src, 2U);
+    HYPHA_IP_FLIP_16(dst, src, 4U);
+    HYPHA_IP_FLIP_16(dst, src, 6U);
+    HYPHA_IP_FLIP_KEEP(dst, src, 8U, 2U * (sizeof(HyphaIpEthernetAddress_t) + sizeof(HyphaIpIPv4Address_t)));
+}
+
+/// @brief Flips an IGMP packet, equivalent to @ref hypha_ip_flip_igmp_packet
+/// @param destination The destination of the flipped packet
+/// @param source The source of the packet
+static inline void HyphaIpFlipIgmpPacket(void *destination, void const *source) {
+    uint8_t *dst = (uint8_t *)destination;
+    uint8_t const *src = (uint8_t const *)source;
+    HYPHA_IP_FLIP_KEEP(dst, src, 0U, 2U);  // type, max response time
+    HYPHA_IP_FLIP_16(dst, src, 2U);
+    HYPHA_IP_FLIP_KEEP(dst, src, 4U, sizeof(HyphaIpIPv4Address_t));
+}
+
+/// @brief Flips a header out of the frame into a host order structure, selected by the type of the structure
+/// @param header The host order structure (pointer) to write
+/// @param bytes The network order bytes to read
+#define HyphaIpFlipFromFrame(header, bytes)                   \
+    _Generic((header),                                        \
+        HyphaIpEthernetHeader_t *: HyphaIpFlipEthernetHeader, \
+        HyphaIpIPv4Header_t *: HyphaIpFlipIPv4Header,         \
+        HyphaIpICMPHeader_t *: HyphaIpFlipIcmpHeader,         \
+        HyphaIpUDPHeader_t *: HyphaIpFlipUdpHeader,           \
+        HyphaIpArpPacket_t *: HyphaIpFlipArpPacket,           \
+        HyphaIpIgmpPacket_t *: HyphaIpFlipIgmpPacket)((header), (bytes))
+
+/// @brief Flips a host order structure into the frame, selected by the type of the structure
+/// @param bytes The network order bytes to write
+/// @param header The host order structure (pointer) to read
+#define HyphaIpFlipToFrame(bytes, header)                           \
+    _Generic((header),                                              \
+        HyphaIpEthernetHeader_t const *: HyphaIpFlipEthernetHeader, \
+        HyphaIpIPv4Header_t const *: HyphaIpFlipIPv4Header,         \
+        HyphaIpICMPHeader_t const *: HyphaIpFlipIcmpHeader,         \
+        HyphaIpUDPHeader_t const *: HyphaIpFlipUdpHeader,           \
+        HyphaIpArpPacket_t const *: HyphaIpFlipArpPacket,           \
+        HyphaIpIgmpPacket_t const *: HyphaIpFlipIgmpPacket)((bytes), (header))
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// IN-PLACE ACCESSORS (read big-endian fields straight out of a frame, no header copies)
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// The offset of the IPv4 fields within the frame payload (no options are allowed)
+typedef enum HyphaIpIPv4FieldOffset : uint8_t {
+    HyphaIpIPv4OffsetVersion = 0U,          ///< Version and IHL
+    HyphaIpIPv4OffsetLength = 2U,           ///< Total length
+    HyphaIpIPv4OffsetIdentification = 4U,   ///< Identification
+    HyphaIpIPv4OffsetFragment = 6U,         ///< Flags and fragment offset
+    HyphaIpIPv4OffsetTTL = 8U,              ///< Time to live
+    HyphaIpIPv4OffsetProtocol = 9U,         ///< Protocol
+    HyphaIpIPv4OffsetChecksum = 10U,        ///< Header checksum
+    HyphaIpIPv4OffsetSource = 12U,          ///< Source address
+    HyphaIpIPv4OffsetDestination = 16U,     ///< Destination address
+} HyphaIpIPv4FieldOffset_e;
+
+/// The offset of the UDP fields within the frame payload
+typedef enum HyphaIpUdpFieldOffset : uint8_t {
+    HyphaIpUdpOffsetSourcePort = sizeof(HyphaIpIPv4Header_t) + 0U,       ///< Source port
+    HyphaIpUdpOffsetDestinationPort = sizeof(HyphaIpIPv4Header_t) + 2U,  ///< Destination port
+    HyphaIpUdpOffsetLength = sizeof(HyphaIpIPv4Header_t) + 4U,           ///< Length
+    HyphaIpUdpOffsetChecksum = sizeof(HyphaIpIPv4Header_t) + 6U,         ///< Checksum
+} HyphaIpUdpFieldOffset_e;
+
+/// The IPv4 More Fragments flag within the flags and fragment offset field
+#define HYPHA_IP_IPv4_FLAG_MF (0x2000U)
+/// The IPv4 Do not Fragment flag within the flags and fragment offset field
+#define HYPHA_IP_IPv4_FLAG_DF (0x4000U)
+/// The IPv4 fragment offset (in 8 byte units) within the flags and fragment offset field
+#define HYPHA_IP_IPv4_FRAGMENT_MASK (0x1FFFU)
+/// The IPv4 header length (in 32 bit words) of a header carrying only the Router Alert option
+#define HYPHA_IP_IPv4_IHL_ROUTER_ALERT (6U)
+/// The type (copied, option 20) and length of the Router Alert option (RFC 2113)
+#define HYPHA_IP_IPv4_OPTION_ROUTER_ALERT (0x9404U)
+
+/// @return The big-endian 16 bit value at the given bytes
+static inline uint16_t HyphaIpPeek16(uint8_t const *bytes) { return (uint16_t)((bytes[0] << 8U) | bytes[1]); }
+
+/// @brief Writes a 16 bit value to the given bytes in big-endian order
+static inline void HyphaIpPoke16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = (uint8_t)(value >> 8U);
+    bytes[1] = (uint8_t)(value & 0xFFU);
+}
+
+/// @return The number of bytes after the Ethernet header which the frame's buffer can hold
+static inline size_t HyphaIpFramePayloadCapacity(HyphaIpEthernetFrame_t const *frame) {
+    size_t capacity = (frame->info.capacity < HYPHA_IP_FRAME_CAPACITY) ? frame->info.capacity : HYPHA_IP_FRAME_CAPACITY;
+    return (capacity > sizeof(HyphaIpEthernetHeader_t)) ? (capacity - sizeof(HyphaIpEthernetHeader_t)) : 0U;
+}
+
+/// @return The Destination MAC of the frame
+static inline HyphaIpEthernetAddress_t HyphaIpPeekEthernetDestination(HyphaIpEthernetFrame_t const *frame) {
+    return frame->header.destination;
+}
+
+/// @return The Source MAC of the frame
+static inline HyphaIpEthernetAddress_t HyphaIpPeekEthernetSource(HyphaIpEthernetFrame_t const *frame) {
+    return frame->header.source;
+}
+
+/// @return The EtherType of the frame (the inner type when tagged)
+static inline uint16_t HyphaIpPeekEtherType(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16((uint8_t const *)&frame->header.type);
+}
+
+#if (HYPHA_IP_USE_VLAN == 1)
+/// @return The Tag Protocol Identifier of the frame
+static inline uint16_t HyphaIpPeekVlanTpid(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16((uint8_t const *)&frame->header.tpid);
+}
+
+/// @return The VLAN ID of the frame
+static inline uint16_t HyphaIpPeekVlanId(HyphaIpEthernetFrame_t const *frame) {
+    return (uint16_t)(HyphaIpPeek16((uint8_t const *)&frame->header.tpid + sizeof(uint16_t)) & 0x0FFFU);
+}
+#endif
+
+/// @return The IP Version of the packet in the frame
+static inline uint8_t HyphaIpPeekIPv4Version(HyphaIpEthernetFrame_t const *frame) {
+    return (uint8_t)(frame->payload[HyphaIpIPv4OffsetVersion] >> 4U);
+}
+
+/// @return The Internet Header Length (in 32 bit words) of the packet in the frame
+static inline uint8_t HyphaIpPeekIPv4IHL(HyphaIpEthernetFrame_t const *frame) {
+    return (uint8_t)(frame->payload[HyphaIpIPv4OffsetVersion] & 0x0FU);
+}
+
+/// @return The total length (header + payload) of the packet in the frame
+static inline uint16_t HyphaIpPeekIPv4Length(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpIPv4OffsetLength]);
+}
+
+/// @return The identification of the packet in the frame
+static inline uint16_t HyphaIpPeekIPv4Identification(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpIPv4OffsetIdentification]);
+}
+
+/// @return The flags and fragment offset field of the packet in the frame
+static inline uint16_t HyphaIpPeekIPv4Fragment(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpIPv4OffsetFragment]);
+}
+
+/// @return The protocol of the packet in the frame, see @ref HyphaIpProtocol_e
+static inline uint8_t HyphaIpPeekIPv4Protocol(HyphaIpEthernetFrame_t const *frame) {
+    return frame->payload[HyphaIpIPv4OffsetProtocol];
+}
+
+/// @return The source address of the packet in the frame
+static inline HyphaIpIPv4Address_t HyphaIpPeekIPv4Source(HyphaIpEthernetFrame_t const *frame) {
+    uint8_t const *bytes = &frame->payload[HyphaIpIPv4OffsetSource];
+    return (HyphaIpIPv4Address_t){bytes[0], bytes[1], bytes[2], bytes[3]};
+}
+
+/// @return The destination address of the packet in the frame
+static inline HyphaIpIPv4Address_t HyphaIpPeekIPv4Destination(HyphaIpEthernetFrame_t const *frame) {
+    uint8_t const *bytes = &frame->payload[HyphaIpIPv4OffsetDestination];
+    return (HyphaIpIPv4Address_t){bytes[0], bytes[1], bytes[2], bytes[3]};
+}
+
+/// @return The source port of the datagram in the frame
+static inline uint16_t HyphaIpPeekUdpSourcePort(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpUdpOffsetSourcePort]);
+}
+
+/// @return The destination port of the datagram in the frame
+static inline uint16_t HyphaIpPeekUdpDestinationPort(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpUdpOffsetDestinationPort]);
+}
+
+/// @return The length (header + payload) of the datagram in the frame
+static inline uint16_t HyphaIpPeekUdpLength(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpUdpOffsetLength]);
+}
+
+/// @return The checksum of the datagram in the frame
+static inline uint16_t HyphaIpPeekUdpChecksum(HyphaIpEthernetFrame_t const *frame) {
+    return HyphaIpPeek16(&frame->payload[HyphaIpUdpOffsetChecksum]);
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// DRIVER
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// @brief Acquires a single frame from the driver and counts the result.
+/// @param context The Hypha IP context
+/// @return The frame or nullptr if none was available.
+HyphaIpEthernetFrame_t *HyphaIpDriverAcquire(HyphaIpContext_t context);
+
+/// @brief Acquires up to `count` whole frames, with a single call if the driver allows it, and counts the results.
+/// @param context The Hypha IP context
+/// @param count The maximum number of frames to acquire
+/// @param frames The array to fill with the acquired frames
+/// @return The number of frames acquired, they are at the front of the array
+size_t HyphaIpDriverAcquireBatch(HyphaIpContext_t context, size_t count, HyphaIpEthernetFrame_t *frames[count]);
+
+/// @brief Acquires a single frame which can hold at least `capacity` bytes from the header on, from the driver's
+/// sized interface when it has one, and counts the result. When the driver has none while a burst holds frames, the
+/// burst is flushed to give them back and the driver is asked again.
+/// @param context The Hypha IP context
+/// @param capacity The bytes from the header on which the frame must hold, at most @ref HYPHA_IP_FRAME_CAPACITY
+/// @return The frame or nullptr if none was available or it was too small.
+HyphaIpEthernetFrame_t *HyphaIpDriverAcquireSized(HyphaIpContext_t context, size_t capacity);
+
+/// @brief Hands a frame to the driver for transmission and counts it once the driver has taken or refused it. While a
+/// burst is open the frame is held back and given to the driver with the rest of the burst.
+/// @param context The Hypha IP context
+/// @param frame The frame to transmit
+/// @return HyphaIpStatus_e The status of the operation. For a frame held in a burst the status is provisional, it only
+/// tells of the frames flushed to make room, and the frame's own fate is reported by @ref HyphaIpDriverBurstEnd.
+HyphaIpStatus_e HyphaIpDriverTransmit(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame);
+
+/// @brief Releases a frame back to the driver. While a burst is open the release is held back until the burst is
+/// flushed.
+/// @param context The Hypha IP context
+/// @param frame The frame to release
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpDriverRelease(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame);
+
+/// @brief Acquires and receives up to `count` frames, using the batch interfaces when the driver has them.
+/// @param context The Hypha IP context
+/// @param count The maximum number of frames to receive (at most @ref HYPHA_IP_BATCH_SIZE)
+/// @param frames The array to fill with the received frames
+/// @return The number of received frames. Each must be released with @ref HyphaIpDriverReleaseBatch.
+size_t HyphaIpDriverReceiveBatch(HyphaIpContext_t context, size_t count, HyphaIpEthernetFrame_t *frames[count]);
+
+/// @brief Releases `count` frames, using the batch interface when the driver has it.
+/// @param context The Hypha IP context
+/// @param count The number of frames to release
+/// @param frames The frames to release
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpDriverReleaseBatch(HyphaIpContext_t context, size_t count,
+                                          HyphaIpEthernetFrame_t *frames[count]);
+
+/// @brief Opens a burst. Transmits and releases are collected until @ref HyphaIpDriverBurstEnd.
+/// @note Bursts are only opened when the driver supplies a batch transmit or release interface.
+/// @param context The Hypha IP context
+void HyphaIpDriverBurstBegin(HyphaIpContext_t context);
+
+/// @brief Flushes and closes the open burst.
+/// @param context The Hypha IP context
+/// @return HyphaIpStatus_e The status of the flush, a failure if the driver refused any of the held frames.
+HyphaIpStatus_e HyphaIpDriverBurstEnd(HyphaIpContext_t context);
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // ETHERNET
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
+/// @brief Builds the Ethernet header for a frame without looking up a destination
+/// @param context The Hypha IP context
+/// @param interface The interface whose Ethernet Address is the source
+/// @param ether_type The Ethernet Type to use (e.g., IPv4, ARP)
+/// @return The host order Ethernet header, to broadcast unless the destination is filled in
+HyphaIpEthernetHeader_t HyphaIpEthernetBaseHeader(HyphaIpContext_t context, uint8_t interface,
+                                                  HyphaIpEtherType_e ether_type);
+
+/// @brief Builds the Ethernet header for a frame to some IPv4 destination
+/// @param context The Hypha IP context
+/// @param interface The interface whose Ethernet Address is the source
+/// @param destination The IPv4 destination, converted to a multicast MAC or looked up in the ARP cache
+/// @param ether_type The Ethernet Type to use (e.g., IPv4, ARP)
+/// @return The host order Ethernet header
+HyphaIpEthernetHeader_t HyphaIpEthernetMakeHeader(HyphaIpContext_t context, uint8_t interface,
+                                                  HyphaIpIPv4Address_t destination, HyphaIpEtherType_e ether_type);
+
 /// @brief Transmits an Ethernet Frame over the Network Interface
 /// This will pass the frame down the stack if accepted.
 /// @param context The Hypha IP context
-/// @param frame The Ethernet Frame to transmit
+/// @param frame The Ethernet Frame to transmit, on the interface given in its info
 /// @param metadata The metadata for the frame
+/// @param next_hop The IPv4 address whose Ethernet Address is the destination, the gateway or the destination itself
 /// @param ether_type The Ethernet Type to use (e.g., IPv4, ARP)
 /// @param payload_length The length of the payload in the frame (including the Ethernet header)
 /// @return HyphaIpStatus_e The status of the operation.
 HyphaIpStatus_e HyphaIpEthernetTransmitFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
-                                             HyphaIpMetaData_t *metadata, HyphaIpEtherType_e ether_type,
-                                             size_t payload_length);
+                                             HyphaIpMetaData_t *metadata, HyphaIpIPv4Address_t next_hop,
+                                             HyphaIpEtherType_e ether_type, size_t payload_length);
+
+/// @brief Hands a frame whose headers are all filled in to the driver and counts it
+/// @param context The Hypha IP context
+/// @param frame The Ethernet Frame to transmit
+/// @param metadata The metadata for the frame, the timestamp is filled in on success (provisional within a burst)
+/// @param payload_length The length of the payload in the frame (after the Ethernet header)
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpEthernetSendFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                         HyphaIpMetaData_t *metadata, size_t payload_length);
 
 /// @brief Receives an Ethernet Frame from the Network Interface
 /// This will pass the frame up the stack if accepted.
 /// @param context The Hypha IP context
 /// @param frame The Ethernet Frame to receive
+/// @param timestamp The timestamp of the frame (sampled by the caller, possibly once per batch)
 /// @return HyphaIpStatus_e The status of the operation.
-HyphaIpStatus_e HyphaIpEthernetReceiveFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame);
+HyphaIpStatus_e HyphaIpEthernetReceiveFrame(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                            HyphaIpTimestamp_t timestamp);
 
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // IP
@@ -561,6 +1449,64 @@ HyphaIpStatus_e HyphaIpEthernetReceiveFrame(HyphaIpContext_t context, HyphaIpEth
 HyphaIpStatus_e HyphaIpIPv4ReceivePacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
                                          HyphaIpTimestamp_t timestamp);
 
+/// @brief Hands an accepted IPv4 payload to the protocol above
+/// @param context The Hypha IP context
+/// @param source The source address from the IPv4 header
+/// @param destination The destination address from the IPv4 header
+/// @param protocol The IP Protocol of the payload
+/// @param timestamp The timestamp of the packet
+/// @param payload The bytes after the IPv4 header as bounded by the IPv4 length
+/// @param udp_verified True when the driver has already verified the UDP checksum
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpIPv4DeliverPayload(HyphaIpContext_t context, HyphaIpIPv4Address_t source,
+                                          HyphaIpIPv4Address_t destination, uint8_t protocol,
+                                          HyphaIpTimestamp_t timestamp, HyphaIpSpan_t payload, bool udp_verified);
+
+/// @brief Stores an accepted IPv4 fragment in its reassembly slot and delivers the datagram once it is complete.
+/// @param context The Hypha IP context
+/// @param frame The Ethernet Frame containing the fragment
+/// @param timestamp The timestamp of the fragment
+/// @return HyphaIpStatus_e The status of the operation, Ok when the fragment was stored.
+HyphaIpStatus_e HyphaIpIPv4Reassemble(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame,
+                                      HyphaIpTimestamp_t timestamp);
+
+/// @brief Drops the incomplete datagram whose timer has fired
+/// @param context The Hypha IP context
+/// @param key The index of the reassembly slot
+void HyphaIpReassemblyExpire(HyphaIpContext_t context, uint32_t key);
+
+/// @brief Selects the interface a packet leaves on and the address its Ethernet destination is resolved from.
+/// Multicasts and broadcasts keep the interface of the metadata, our own addresses are looped back and any other
+/// unicast goes by its route, whose interface is written back to the metadata.
+/// @param context The Hypha IP context
+/// @param metadata The metadata of the packet
+/// @param[out] next_hop The address to resolve, the gateway of the route or the destination itself
+/// @retval HyphaIpStatusInvalidArgument The interface of a multicast or broadcast is not one of ours
+/// @retval HyphaIpStatusNoRoute No route holds the unicast destination
+HyphaIpStatus_e HyphaIpIPv4SelectInterface(HyphaIpContext_t context, HyphaIpMetaData_t *metadata,
+                                           HyphaIpIPv4Address_t *next_hop);
+
+/// @brief Selects the source address the IPv4 layer will put on a packet to the destination
+/// @param context The Hypha IP context
+/// @param interface The interface the packet leaves on, see @ref HyphaIpIPv4SelectInterface
+/// @param destination The destination of the packet
+/// @param requested The source address the caller asked for
+/// @return The address of the interface or, for localhost destinations, a localhost address
+HyphaIpIPv4Address_t HyphaIpIPv4SelectSource(HyphaIpContext_t context, uint8_t interface,
+                                             HyphaIpIPv4Address_t destination, HyphaIpIPv4Address_t requested);
+
+/// @brief Builds the IPv4 header of an outgoing packet, the checksum is left as zero
+/// @param context The Hypha IP context
+/// @param interface The interface the packet leaves on
+/// @param destination The destination of the packet
+/// @param requested The source address the caller asked for, see @ref HyphaIpIPv4SelectSource
+/// @param protocol The IP Protocol of the payload
+/// @param payload_length The length of the payload after the IPv4 header
+/// @return The host order IPv4 header
+HyphaIpIPv4Header_t HyphaIpIPv4MakeHeader(HyphaIpContext_t context, uint8_t interface,
+                                          HyphaIpIPv4Address_t destination, HyphaIpIPv4Address_t requested,
+                                          HyphaIpProtocol_e protocol, size_t payload_length);
+
 /// @brief Transmits an IPv4 Packet over the Ethernet Frame
 /// @param context The Hypha IP context
 /// @param frame The Ethernet Frame to transmit the packet in
@@ -572,26 +1518,142 @@ HyphaIpStatus_e HyphaIpIPv4TransmitPacket(HyphaIpContext_t context, HyphaIpEther
                                           HyphaIpMetaData_t *metadata, HyphaIpProtocol_e ip_protocol,
                                           HyphaIpSpan_t packet);
 
+/// @brief Transmits one fragment of an IPv4 datagram over the Ethernet Frame
+/// @param context The Hypha IP context
+/// @param frame The Ethernet Frame to transmit the fragment in
+/// @param metadata The metadata for the datagram
+/// @param ip_protocol The IP Protocol of the datagram
+/// @param packet The bytes of this fragment, already in place after the IPv4 header
+/// @param fragment Where the fragment sits in the datagram
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpIPv4TransmitFragment(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
+                                            HyphaIpMetaData_t *metadata, HyphaIpProtocol_e ip_protocol,
+                                            HyphaIpSpan_t packet, HyphaIpIPv4Fragment_t fragment);
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// TABLES
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// @brief Makes the first version of a freshly cleared context's tables the current one
+/// @param context The Hypha IP context
+void HyphaIpTablesInitialize(HyphaIpContext_t context);
+
+/// @brief Starts a read of the current version of the tables, which stays whole until the read ends. Only the owner
+/// thread reads and it must not change the tables (or take the writer flag) until the read ends. Reads may nest.
+/// @param context The Hypha IP context
+/// @return The version to read
+HyphaIpTables_t const *HyphaIpTablesReadBegin(HyphaIpContext_t context);
+
+/// @brief Ends a read from @ref HyphaIpTablesReadBegin, the version must not be used after this
+/// @param context The Hypha IP context
+void HyphaIpTablesReadEnd(HyphaIpContext_t context);
+
+/// @brief Takes the writer flag of the tables, spinning while another writer holds it. The owner thread only spins in
+/// the calls the application makes, never while it reads the tables, a receive or a tick uses
+/// @ref HyphaIpTablesTryLock.
+/// @param context The Hypha IP context
+void HyphaIpTablesLock(HyphaIpContext_t context);
+
+/// @brief Takes the writer flag of the tables only if no other writer holds it
+/// @param context The Hypha IP context
+/// @return True when the flag was taken
+bool HyphaIpTablesTryLock(HyphaIpContext_t context);
+
+/// @brief Gives the version of the tables to change, the holder of the writer flag must use it for every change. Each
+/// table is copied from the current version the first time it is asked for under the flag, once the owner can no
+/// longer be reading the spare one. Only the tables asked for (and the counters at the head) may be used.
+/// @param context The Hypha IP context
+/// @param tables The tables which will be read or changed, see @ref HyphaIpTable_e
+/// @return The version which is published when the flag is given back
+HyphaIpTables_t *HyphaIpTablesDraft(HyphaIpContext_t context, HyphaIpTable_e tables);
+
+/// @brief Gives the holder of the writer flag the tables to look at without copying them, the draft when they have
+/// been drafted already and the current version otherwise
+/// @param context The Hypha IP context
+/// @param tables The tables which will be read, see @ref HyphaIpTable_e
+/// @return The version to read, which must not be changed
+HyphaIpTables_t const *HyphaIpTablesPeek(HyphaIpContext_t context, HyphaIpTable_e tables);
+
+/// @brief Publishes the changed version of the tables, if there is one, and gives back the writer flag
+/// @param context The Hypha IP context
+void HyphaIpTablesUnlock(HyphaIpContext_t context);
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// ROUTES
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// @brief Checks the addresses of a network interface before it is given to a context
+/// @param interface The network interface
+/// @retval HyphaIpStatusInvalidMacAddress The MAC is a multicast one
+/// @retval HyphaIpStatusInvalidIpAddress The address is a multicast or localhost one
+/// @retval HyphaIpStatusInvalidNetwork The netmask is not contiguous or the gateway is neither 0.0.0.0 (none) nor
+/// within the network of the interface
+HyphaIpStatus_e HyphaIpRouteCheckInterface(HyphaIpNetworkInterface_t const *interface);
+
+/// @brief Adds the first interface of a freshly cleared context, with the route to its network and the default route
+/// through its gateway (unless it has none). The tables must have been initialized.
+/// @param context The Hypha IP context
+/// @param interface The network interface, already checked
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpRouteFirstInterface(HyphaIpContext_t context, HyphaIpNetworkInterface_t const *interface);
+
+/// @brief Adds (or replaces) the route to a network in the draft tables, the caller holds the writer flag
+/// @param context The Hypha IP context
+/// @param prefix The network of the route
+/// @param gateway The next hop, or @ref hypha_ip_default_route when the network is on the link
+/// @param interface The interface the route leaves on
+/// @retval HyphaIpStatusRouteTableFull There is no room for another route
+HyphaIpStatus_e HyphaIpRouteAdd(HyphaIpContext_t context, HyphaIpIPv4Prefix_t prefix, HyphaIpIPv4Address_t gateway,
+                                uint8_t interface);
+
+/// @brief Finds the next hop of a unicast destination, from the cache or else by the longest matching prefix
+/// @param context The Hypha IP context
+/// @param destination The destination of the packet
+/// @param[out] hop The interface and the address to resolve over ARP
+/// @retval HyphaIpStatusNoRoute No route holds the destination
+HyphaIpStatus_e HyphaIpRouteLookup(HyphaIpContext_t context, HyphaIpIPv4Address_t destination,
+                                   HyphaIpNextHop_t *hop);
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // UDP (transmit is an external function)
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
-/// @brief Receives a UDP Datagram from the Ethernet Frame
+/// @brief Receives a UDP Datagram which is still in place in the received frame
 /// @param context The Hypha IP context
-/// @param header The IPv4 Header of the Datagram
+/// @param source The source address from the IPv4 header
+/// @param destination The destination address from the IPv4 header
 /// @param timestamp The timestamp of the packet
-/// @param frame The Ethernet Frame containing the UDP Datagram
+/// @param datagram The bytes of the UDP Datagram (header + payload) as bounded by the IPv4 length
+/// @param checksum_verified True when the driver has already verified the UDP checksum
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpUdpReceiveDatagram(HyphaIpContext_t context, HyphaIpIPv4Address_t source,
+                                          HyphaIpIPv4Address_t destination, HyphaIpTimestamp_t timestamp,
+                                          HyphaIpSpan_t datagram, bool checksum_verified);
+
+/// @brief Checks that a datagram can be sent on a prepared flow, in a single frame
+/// @param flow The flow from @ref HyphaIpPrepareUdpTransmit
+/// @param datagram The UDP payload
 /// @return HyphaIpStatus_e The status of the operation.
-HyphaIpStatus_e HyphaIpUdpReceiveDatagram(HyphaIpContext_t context, HyphaIpIPv4Header_t *header,
-                                          HyphaIpTimestamp_t timestamp, HyphaIpEthernetFrame_t *frame);
+HyphaIpStatus_e HyphaIpUdpFlowCheck(HyphaIpUdpFlow_t const *flow, HyphaIpSpan_t datagram);
+
+/// @brief Builds a checked datagram of a flow into a frame, ready for the driver. Only the capabilities of the context
+/// are read, so any thread may build while the owner runs the stack.
+/// @param context The Hypha IP context
+/// @param flow The flow from @ref HyphaIpPrepareUdpTransmit
+/// @param frame The frame to build in, which holds at least the headers and the payload
+/// @param datagram The UDP payload, see @ref HyphaIpUdpFlowCheck
+/// @return The length of the IPv4 packet
+size_t HyphaIpUdpFlowBuild(HyphaIpContext_t context, HyphaIpUdpFlow_t const *flow, HyphaIpEthernetFrame_t *frame,
+                           HyphaIpSpan_t datagram);
 
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // ARP
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
-/// @brief Processes an incoming ARP packet
+/// @brief Processes an incoming ARP packet. Known senders are refreshed and new ones are learned when they ask for our
+/// address. A request for our address is answered by rewriting the frame into the reply and transmitting it again.
 /// @param context The Hypha IP context
-/// @param frame The Ethernet Frame containing the ARP packet
+/// @param frame The Ethernet Frame containing the ARP packet, which may be transmitted back before this returns
 /// @param timestamp The timestamp of the packet
 /// @return HyphaIpStatus_e The status of the operation.
 HyphaIpStatus_e HyphaIpArpProcessPacket(HyphaIpContext_t context, HyphaIpEthernetFrame_t *frame,
@@ -602,24 +1664,178 @@ HyphaIpStatus_e HyphaIpArpProcessPacket(HyphaIpContext_t context, HyphaIpEtherne
 /// @return HyphaIpStatus_e The status of the operation.
 HyphaIpStatus_e HyphaIpArpAnnouncement(HyphaIpContext_t context);
 
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+/// @brief Finds the ARP entry of an IPv4 Address through the hash index
+/// @param cache The ARP cache of a version of the tables
+/// @param ipv4 The IPv4 Address to find
+/// @return The entry or nullptr if there is none
+HyphaIpARPEntry_t const *HyphaIpArpCacheFindByIPv4(HyphaIpArpCache_t const *cache, HyphaIpIPv4Address_t ipv4);
+
+/// @brief Finds an ARP entry of an Ethernet Address through the hash index
+/// @param cache The ARP cache of a version of the tables
+/// @param mac The Ethernet Address to find
+/// @return The first entry found or nullptr if there is none
+HyphaIpARPEntry_t const *HyphaIpArpCacheFindByMac(HyphaIpArpCache_t const *cache, HyphaIpEthernetAddress_t mac);
+
+/// @brief Adds a match to the ARP cache of the draft tables, or updates the Ethernet Address and expiration of the
+/// IPv4 Address's entry. The caller holds the writer flag. The entry is aged by the owner, which either starts its
+/// timer itself or catches up with a count of the populate.
+/// @param context The Hypha IP context
+/// @param match The addresses to add
+/// @param expiration When the entry expires
+/// @retval HyphaIpStatusArpTableFull The IPv4 Address is new and there is no room for it
+HyphaIpStatus_e HyphaIpArpCacheInsert(HyphaIpContext_t context, HyphaIpAddressMatch_t const *match,
+                                      HyphaIpTimestamp_t expiration);
+
+/// @brief Removes the entry of an IPv4 Address from the ARP cache of the draft tables, the last entry is moved into its
+/// place. The caller holds the writer flag.
+/// @param context The Hypha IP context
+/// @param ipv4 The IPv4 Address of the entry, nothing happens when it has none
+void HyphaIpArpCacheRemove(HyphaIpContext_t context, HyphaIpIPv4Address_t ipv4);
+
+/// @brief Holds a frame for an unresolved destination until the ARP reply comes. The first frame for a destination
+/// sends the ARP request, the rest wait on the same one. Like the rest of the queue this is only used by the owner.
+/// @param context The Hypha IP context
+/// @param frame The frame with its headers filled in (except the destination Ethernet Address), its length and its
+/// interface set. It is copied, so the caller still releases it.
+/// @param destination The IPv4 next hop to resolve
+/// @retval HyphaIpStatusArpQueueFull There is no room for the destination or the frame, which is dropped
+HyphaIpStatus_e HyphaIpArpPendingAdd(HyphaIpContext_t context, HyphaIpEthernetFrame_t const *frame,
+                                     HyphaIpIPv4Address_t destination);
+
+/// @brief Notes where the ARP pending queue ends, before the frames of a datagram which must be held all together
+/// @param context The Hypha IP context
+/// @return The mark to give to @ref HyphaIpArpPendingRollback
+HyphaIpArpPendingMark_t HyphaIpArpPendingMark(HyphaIpContext_t context);
+
+/// @brief Drops the frames held since the mark, along with the requests which only they were waiting on, so a
+/// datagram which did not fit does not go out in part once its destination answers.
+/// @param context The Hypha IP context
+/// @param mark Where the queue ended before the datagram
+void HyphaIpArpPendingRollback(HyphaIpContext_t context, HyphaIpArpPendingMark_t mark);
+
+/// @brief Sends the frames which waited for a destination which has just been resolved, in one burst
+/// @param context The Hypha IP context
+/// @param match The addresses of the resolved destination
+void HyphaIpArpPendingFlush(HyphaIpContext_t context, HyphaIpAddressMatch_t const *match);
+
+/// @brief Sends the frames whose destinations the current tables now know, such as ones another thread populated
+/// @param context The Hypha IP context
+void HyphaIpArpPendingResolve(HyphaIpContext_t context);
+
+/// @brief Starts the timers of the ARP entries of a version of the tables, or moves them to later expirations
+/// @param context The Hypha IP context
+/// @param tables The version being read
+/// @retval HyphaIpStatusOutOfMemory There were no unused timers for some entries
+HyphaIpStatus_e HyphaIpArpCacheAge(HyphaIpContext_t context, HyphaIpTables_t const *tables);
+#endif
+
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // IGMP
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
-/// @brief Produces a Join (Membership Report) for a given multicast address
+/// @brief Sends a Membership Report for a given multicast address
 /// @param context The Hypha IP context
-/// @param multicast The multicast address to join
+/// @param multicast The multicast address to report
 /// @return HyphaIpStatus_e The status of the operation.
 HyphaIpStatus_e HyphaIpMembershipReport(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast);
 
-/// @brief Leaves a multicast group.
+/// @brief Adds a reference to a multicast group. The first reference joins the group, lets its frames (and the
+/// General Queries to all hosts) through the Ethernet filter and sends a Membership Report. The group is joined even
+/// when the report is lost, the next query asks for it again. The groups belong to the owner thread.
+/// @param context The Hypha IP context
+/// @param multicast The multicast address to join
+/// @retval HyphaIpStatusIgmpGroupTableFull There are already @ref HYPHA_IP_IGMP_GROUP_TABLE_SIZE groups
+/// @retval HyphaIpStatusInvalidIpAddress The address is not multicast
+HyphaIpStatus_e HyphaIpJoinGroup(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast);
+
+/// @brief Removes a reference to a multicast group. The last reference sends the Leave to all routers and takes the
+/// Ethernet Addresses the join let through out of the Ethernet filter, unless another joined group shares them. The
+/// addresses which were already let through before the join stay.
 /// @param context The Hypha IP context.
 /// @param multicast The multicast address to leave.
-/// @return HyphaIpStatus_e The status of the operation.
+/// @retval HyphaIpStatusInvalidArgument The group was not joined
 HyphaIpStatus_e HyphaIpLeaveGroup(HyphaIpContext_t context, HyphaIpIPv4Address_t multicast);
 
+/// @brief Takes in a received IGMP message. Queries start the delayed reports of the groups they ask about, the
+/// reports of other hosts cancel ours.
+/// @param context The Hypha IP context
+/// @param timestamp The time the message was received
+/// @param message The IGMP message, which may be longer than an IGMPv2 one
+/// @return HyphaIpStatus_e The status of the operation.
+HyphaIpStatus_e HyphaIpIgmpReceivePacket(HyphaIpContext_t context, HyphaIpTimestamp_t timestamp,
+                                         HyphaIpSpan_t message);
+
+/// @brief Sends the delayed report of a group whose timer has fired. Past @ref HYPHA_IP_IGMP_REPORTS_PER_RUN in one
+/// tick the report waits for the next one.
+/// @param context The Hypha IP context
+/// @param key The group address, as a value
+/// @return HyphaIpStatus_e The status of the report
+HyphaIpStatus_e HyphaIpIgmpReportDue(HyphaIpContext_t context, uint32_t key);
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// TIMERS
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+/// @brief Starts a timer, or moves it to a new deadline when it is already running. Like every use of the timer wheel
+/// this is only done by the owner thread.
+/// @param context The Hypha IP context
+/// @param timer The owner's timer number, zero when none is running. It is set to the new timer.
+/// @param kind What the timer ages
+/// @param key Finds the owner when the timer fires
+/// @param deadline When the timer fires, a deadline which has already passed fires on the next tick
+/// @retval HyphaIpStatusOutOfMemory There are no unused timers
+HyphaIpStatus_e HyphaIpTimerSchedule(HyphaIpContext_t context, uint16_t *timer, HyphaIpTimerKind_e kind, uint32_t key,
+                                     HyphaIpTimestamp_t deadline);
+
+/// @brief Stops a timer, if one is running
+/// @param context The Hypha IP context
+/// @param timer The owner's timer number, which is set to zero
+void HyphaIpTimerCancel(HyphaIpContext_t context, uint16_t *timer);
+
+/// @brief Starts the timer which ages an entry of the tables, or moves it when the deadline is later than the one it
+/// runs to. An entry only ever lives longer, so refreshing it needs no new version of the tables.
+/// @param context The Hypha IP context
+/// @param kind What the timer ages, one of the entries of the tables
+/// @param key Finds the entry, see @ref HyphaIpTimerKind_e
+/// @param deadline When the entry expires
+/// @retval HyphaIpStatusOutOfMemory There are no unused timers
+HyphaIpStatus_e HyphaIpTimerAge(HyphaIpContext_t context, HyphaIpTimerKind_e kind, uint32_t key,
+                                HyphaIpTimestamp_t deadline);
+
+#if (HYPHA_IP_USE_ARP_CACHE == 1)
+/// @brief Removes the ARP entry whose timer has fired, with the writer flag held. An entry which was populated again
+/// since has its timer started again instead.
+void HyphaIpArpCacheExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline);
+
+/// @brief Drops the frames waiting for the destination whose ARP request has gone unanswered
+void HyphaIpArpPendingExpire(HyphaIpContext_t context, uint32_t key);
+#endif
+
+#if (HYPHA_IP_USE_MAC_FILTER == 1)
+/// @brief Invalidates the Ethernet filter entry whose timer has fired, with the writer flag held, unless it was
+/// populated again since
+void HyphaIpEthernetFilterExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline);
+
+/// @brief Starts the timers of the Ethernet filter entries of a version of the tables, or moves them to later
+/// expirations
+/// @retval HyphaIpStatusOutOfMemory There were no unused timers for some entries
+HyphaIpStatus_e HyphaIpEthernetFilterAge(HyphaIpContext_t context, HyphaIpTables_t const *tables);
+#endif
+
+#if (HYPHA_IP_USE_IP_FILTER == 1)
+/// @brief Removes the IPv4 filter range whose timer has fired, with the writer flag held, unless it was populated
+/// again since
+void HyphaIpIPv4FilterExpire(HyphaIpContext_t context, uint32_t key, HyphaIpTimestamp_t deadline);
+
+/// @brief Starts the timers of the IPv4 filter ranges of a version of the tables, or moves them to later expirations
+/// @retval HyphaIpStatusOutOfMemory There were no unused timers for some ranges
+HyphaIpStatus_e HyphaIpIPv4FilterAge(HyphaIpContext_t context, HyphaIpTables_t const *tables);
+#endif
+
 /// @brief Computes a 1's compliment checksum over two spans.
-/// Either span can be empty.
+/// Either span can be empty. The spans are measured in bytes (see @ref HyphaIpSpanSize), may start at any alignment
+/// and may have an odd length, in which case the header and payload are summed as if they were one contiguous run.
 /// @param header_span The span over the Header
 /// @param payload_span The span over the Payload
 /// @return uint16_t. When saving into a header, this result must be 1's complimented.
@@ -628,6 +1844,67 @@ HyphaIpStatus_e HyphaIpLeaveGroup(HyphaIpContext_t context, HyphaIpIPv4Address_t
 /// be 100% short-flipped versions.
 uint16_t HyphaIpComputeChecksum(HyphaIpSpan_t header_span, HyphaIpSpan_t payload_span);
 
+/// The checksum kernels
+typedef enum HyphaIpChecksumKernel : uint8_t {
+    HyphaIpChecksumKernelScalar = 0U,  ///< Portable 64 bit accumulator
+    HyphaIpChecksumKernelSSE2 = 1U,    ///< x86-64 SSE2
+    HyphaIpChecksumKernelAVX2 = 2U,    ///< x86-64 AVX2 (detected at runtime)
+    HyphaIpChecksumKernelNEON = 3U,    ///< ARM NEON
+} HyphaIpChecksumKernel_e;
+
+/// @brief Determines if a checksum kernel was compiled in and is supported by the running CPU
+/// @param kernel The kernel to check
+/// @return true if the kernel can be used
+bool HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernel_e kernel);
+
+/// @brief Selects the fastest checksum kernel available on the running CPU
+/// @return The kernel used by @ref HyphaIpComputeChecksum
+HyphaIpChecksumKernel_e HyphaIpChecksumSelectKernel(void);
+
+/// @brief Computes the (not complimented) 1's compliment sum of a run of bytes with a specific kernel.
+/// An odd trailing byte is padded with a zero. The sum is in the same byte order as the data in memory.
+/// @param kernel The kernel to use, must be available
+/// @param bytes The pointer to the bytes, any alignment
+/// @param count The number of bytes
+/// @return The folded 16 bit sum
+uint16_t HyphaIpChecksumBytes(HyphaIpChecksumKernel_e kernel, void const *bytes, size_t count);
+
+/// @brief Adds two 1's compliment sums
+/// @param a The first sum
+/// @param b The second sum
+/// @return The folded 16 bit sum
+static inline uint16_t HyphaIpChecksumAdd(uint16_t a, uint16_t b) {
+    uint32_t sum = (uint32_t)a + (uint32_t)b;
+    return (uint16_t)((sum & 0xFFFFU) + (sum >> 16U));
+}
+
+/// @brief Incrementally updates a checksum when a single 16 bit word it covers changes (RFC 1624, Eqn. 3)
+/// @param checksum The existing (complimented) checksum, as stored in the header
+/// @param old_value The previous value of the word, in the same byte order as the data
+/// @param new_value The new value of the word, in the same byte order as the data
+/// @return The updated (complimented) checksum
+static inline uint16_t HyphaIpChecksumUpdate16(uint16_t checksum, uint16_t old_value, uint16_t new_value) {
+    return (uint16_t)~HyphaIpChecksumAdd(HyphaIpChecksumAdd((uint16_t)~checksum, (uint16_t)~old_value), new_value);
+}
+
+/// @brief Incrementally updates a checksum when a 32 bit field (like an address) it covers changes (RFC 1624)
+/// @param checksum The existing (complimented) checksum, as stored in the header
+/// @param old_value The previous value of the field, in the same byte order as the data
+/// @param new_value The new value of the field, in the same byte order as the data
+/// @return The updated (complimented) checksum
+static inline uint16_t HyphaIpChecksumUpdate32(uint16_t checksum, uint32_t old_value, uint32_t new_value) {
+    checksum = HyphaIpChecksumUpdate16(checksum, (uint16_t)(old_value >> 16U), (uint16_t)(new_value >> 16U));
+    return HyphaIpChecksumUpdate16(checksum, (uint16_t)(old_value & 0xFFFFU), (uint16_t)(new_value & 0xFFFFU));
+}
+
+/// @brief Computes the checksum over a set of header words, only updating the words which differ from the cache.
+/// The first call (or any call on an invalid cache) computes the checksum in full.
+/// @param cache The cache of the previous words and checksum, updated to these words
+/// @param count The number of words, at most @ref HYPHA_IP_CHECKSUM_CACHE_WORDS
+/// @param words The network order words
+/// @return The (complimented) checksum over the words
+uint16_t HyphaIpChecksumCached(HyphaIpChecksumCache_t *cache, size_t count, uint16_t const words[count]);
+
 /// The Hypha IP Report macro
 #define HYPHA_IP_REPORT(_context, _status)                                                      \
     {                                                                                           \
@@ -3,6 +3,9 @@
 /// The Hypha IP Test implementation.
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+#include <pthread.h>
+#include <sched.h>
+
 #include "hypha_ip/hypha_internal.h"
 #include "hypha_ip/hypha_ip.h"
 #include "stdarg.h"
@@ -11,6 +14,9 @@
 
 HyphaIpContext_t context;
 
+/// The storage of the context the tests run on
+_Alignas(HYPHA_IP_CONTEXT_ALIGNMENT) uint8_t context_storage[sizeof(struct HyphaIpContext)];
+
 char const *boolean(bool value) { return value ? "true" : "false"; }
 
 #define ANNOUNCE printf("In %s @ file %s:%u\r\n", __func__, __FILE__, __LINE__)
@@ -29,6 +35,16 @@ uint16_t expected_reversed_ethertype;
 bool expected_receive_udp;
 bool actual_receive_udp;
 HyphaIpEthernetFrame_t *expected_frame;
+HyphaIpEthernetFrame_t transmitted_frame;  ///< A copy of the last frame given to the driver
+
+/// The fragments given to the driver, put back together in the order they were sent
+struct {
+    uint16_t identification;  ///< The identification of the datagram being put together
+    size_t fragments;         ///< The number of fragments seen
+    size_t received;          ///< The number of bytes seen
+    size_t length;            ///< The length of the datagram, known once the last fragment is seen
+    uint8_t bytes[8U + HYPHA_IP_MAX_UDP_DATAGRAM_SIZE];
+} transmitted_fragments;
 
 void report(HyphaIpExternalContext_t mine, HyphaIpStatus_e status, const char *const func, const char *const file,
             unsigned int line) {
@@ -48,6 +64,10 @@ HyphaIpEthernetFrame_t *acquire(HyphaIpExternalContext_t mine) {
     TEST_ASSERT_NOT_NULL(mine);
     HyphaIpEthernetFrame_t *frame = nullptr;
     frame = (HyphaIpEthernetFrame_t *)malloc(sizeof(HyphaIpEthernetFrame_t));
+    if (frame != nullptr) {
+        frame->info.capacity = HYPHA_IP_FRAME_CAPACITY;
+        frame->info.interface = 0U;  // the test driver has a single link
+    }
     return frame;
 }
 
@@ -105,7 +125,8 @@ HyphaIpStatus_e receive(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *f
     TEST_ASSERT_NOT_NULL(mine);
     TEST_ASSERT_NOT_NULL(frame);
     // TODO make a bunch more frames and send them in
-    memcpy(frame, test_frame, sizeof(test_frame));
+    memcpy(&frame->header, test_frame, sizeof(test_frame));
+    frame->info.length = sizeof(test_frame);
     printf("[TEST] Receiving frame %p\r\n", (void *)frame);
     return HyphaIpStatusOk;
 }
@@ -120,7 +141,38 @@ HyphaIpStatus_e transmit(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *
     TEST_ASSERT_EQUAL_MEMORY(&expected_ethernet_source_address, &frame->header.source,
                              sizeof(HyphaIpEthernetAddress_t));
     TEST_ASSERT_EQUAL(expected_reversed_ethertype, frame->header.type);  // reversed
-    // TODO verify that the IP header is right
+    if ((frame->info.flags & HyphaIpFrameFlagIPv4ChecksumInsert) != 0U) {
+        // offloaded, the driver fills in the checksum
+        TEST_ASSERT_EQUAL_HEX16(0U, HyphaIpPeek16(&frame->payload[HyphaIpIPv4OffsetChecksum]));
+    } else if (HYPHA_IP_USE_IP_CHECKSUM && HyphaIpPeekEtherType(frame) == HyphaIpEtherType_IPv4) {
+        // the (incrementally updated) header checksum must verify
+        HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+        TEST_ASSERT_EQUAL_HEX16(HyphaIpChecksumValid, HyphaIpComputeChecksum(HyphaIpSpanIpHeader(frame), empty));
+    }
+    // only the bytes the stack said it wrote are handed on
+    TEST_ASSERT_GREATER_OR_EQUAL(sizeof(HyphaIpEthernetHeader_t), frame->info.length);
+    TEST_ASSERT_LESS_OR_EQUAL(frame->info.capacity, frame->info.length);
+    memset(&transmitted_frame, 0, sizeof(transmitted_frame));
+    memcpy(&transmitted_frame, frame, HYPHA_IP_FRAME_ALLOCATION(frame->info.length));
+    uint16_t fragment = HyphaIpPeekIPv4Fragment(frame);
+    if (HyphaIpPeekEtherType(frame) == HyphaIpEtherType_IPv4 &&
+        (fragment & (HYPHA_IP_IPv4_FLAG_MF | HYPHA_IP_IPv4_FRAGMENT_MASK)) != 0U) {
+        if (transmitted_fragments.fragments == 0U ||
+            HyphaIpPeekIPv4Identification(frame) != transmitted_fragments.identification) {
+            memset(&transmitted_fragments, 0, sizeof(transmitted_fragments));
+            transmitted_fragments.identification = HyphaIpPeekIPv4Identification(frame);
+        }
+        size_t offset = (fragment & HYPHA_IP_IPv4_FRAGMENT_MASK) * 8U;
+        size_t length = HyphaIpPeekIPv4Length(frame) - sizeof(HyphaIpIPv4Header_t);
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(transmitted_fragments.bytes), offset + length);
+        memcpy(&transmitted_fragments.bytes[offset], &frame->payload[sizeof(HyphaIpIPv4Header_t)], length);
+        transmitted_fragments.fragments++;
+        transmitted_fragments.received += length;
+        if ((fragment & HYPHA_IP_IPv4_FLAG_MF) == 0U) {
+            transmitted_fragments.length = offset + length;
+        }
+    }
+    // TODO verify that the rest of the IP header is right
     // TODO verify that the UDP header is right, if it's got UDP, could be IGMP or ICMP
     return HyphaIpStatusOk;
 }
@@ -176,6 +228,82 @@ int printer(HyphaIpExternalContext_t mine, char const *const format, ...) {
     return ret;
 }
 
+/// Counts the calls into the batch interfaces of the driver
+struct {
+    size_t acquires;
+    size_t receives;
+    size_t transmits;
+    size_t releases;
+    size_t transmitted;
+    size_t withheld;  ///< The frames each batch acquire leaves out
+    size_t refused;   ///< The frames at the end of each batch transmit which are not sent
+    size_t failing;   ///< The batch releases still to report a failure
+} batch_calls;
+
+size_t acquire_batch(HyphaIpExternalContext_t mine, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    batch_calls.acquires++;
+    size_t given = (batch_calls.withheld < count) ? (count - batch_calls.withheld) : 0U;
+    for (size_t i = 0; i < given; i++) {
+        frames[i] = acquire(mine);
+    }
+    return given;
+}
+
+size_t receive_batch(HyphaIpExternalContext_t mine, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    batch_calls.receives++;
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, receive(mine, frames[i]));
+    }
+    return count;
+}
+
+size_t transmit_batch(HyphaIpExternalContext_t mine, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    batch_calls.transmits++;
+    size_t sent = (batch_calls.refused < count) ? (count - batch_calls.refused) : 0U;
+    for (size_t i = 0; i < sent; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, transmit(mine, frames[i]));
+    }
+    batch_calls.transmitted += sent;
+    return sent;
+}
+
+HyphaIpStatus_e release_batch(HyphaIpExternalContext_t mine, size_t count, HyphaIpEthernetFrame_t *frames[count]) {
+    batch_calls.releases++;
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, release(mine, frames[i]));
+    }
+    if (batch_calls.failing > 0U) {
+        batch_calls.failing--;
+        return HyphaIpStatusFailure;
+    }
+    return HyphaIpStatusOk;
+}
+
+/// A driver with only a few frames to hand out at once
+struct {
+    size_t size;  ///< The most frames which may be out at once
+    size_t out;   ///< The frames which are out now
+} pool;
+
+HyphaIpEthernetFrame_t *acquire_pooled(HyphaIpExternalContext_t mine) {
+    if (pool.out == pool.size) {
+        return nullptr;
+    }
+    pool.out++;
+    return acquire(mine);
+}
+
+HyphaIpStatus_e release_pooled(HyphaIpExternalContext_t mine, HyphaIpEthernetFrame_t *frame) {
+    pool.out--;
+    return release(mine, frame);
+}
+
+HyphaIpStatus_e release_batch_pooled(HyphaIpExternalContext_t mine, size_t count,
+                                     HyphaIpEthernetFrame_t *frames[count]) {
+    pool.out -= count;
+    return release_batch(mine, count, frames);
+}
+
 HyphaIpExternalInterface_t externals = {.acquire = acquire,
                                         .release = release,
                                         .transmit = transmit,
@@ -200,11 +328,26 @@ bool use_prepopulated_ip_filter = false;
 
 struct HyphaIpExternalContext mine;
 
+/// @return The current version of the tables, which nothing changes behind the back of a test
+static HyphaIpTables_t const *current_tables(HyphaIpContext_t stack) {
+    return atomic_load_explicit(&stack->tables.current, memory_order_acquire);
+}
+
+/// @return The number of timers which the owner is aging table entries with
+static size_t aging_timers(HyphaIpContext_t stack) {
+    size_t count = 0U;
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(stack->timers.aging); i++) {
+        count += (stack->timers.aging[i] != 0U) ? 1U : 0U;  // a timer numbered 0 is none
+    }
+    return count;
+}
+
 void hyphaip_setUp(void) {
     // Set up code for each test
     expected_status = HyphaIpStatusOk;
     if (use_good_setup == true) {
-        HyphaIpStatus_e status = HyphaIpInitialize(&context, &interface, &mine, &externals);
+        HyphaIpStatus_e status =
+            HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine, &externals);
         TEST_ASSERT_EQUAL(HyphaIpStatusOk, status);
         TEST_ASSERT_NOT_NULL(context);
 
@@ -278,7 +421,7 @@ void hyphaip_test_Span(void) {
     TEST_ASSERT_EQUAL_MEMORY(test_data, span.pointer, HYPHA_IP_DIMOF(test_data));
 
     // a Test frame
-    HyphaIpEthernetFrame_t frame = {0};
+    HyphaIpEthernetFrame_t frame = {.info.capacity = HYPHA_IP_FRAME_CAPACITY};
 
     // Span for UDP Header
     HyphaIpSpan_t udp_header = HyphaIpSpanUdpHeader(&frame);
@@ -355,13 +498,119 @@ void hyphaip_test_FlippedChecksum2(void) {
     TEST_ASSERT_EQUAL_HEX16(0xffff, HyphaIpComputeChecksum(empty, flipped_payload));
 }
 
+/// The original scalar checksum (counts are in uint16_t units, aligned, even lengths only) kept as the reference
+static uint16_t legacy_checksum(uint16_t const *header, size_t header_count, uint16_t const *payload,
+                                size_t payload_count) {
+    uint32_t sum = 0U;
+    uint16_t lss = 0U;
+    uint16_t mss = 0U;
+    for (size_t i = 0U; i < header_count; i++) {
+        sum += header[i];
+    }
+    for (size_t i = 0U; i < payload_count; i++) {
+        sum += payload[i];
+    }
+    do {
+        lss = (uint16_t)((sum & 0x0000FFFFU) >> 0u);
+        mss = (uint16_t)((sum & 0xFFFF0000U) >> 16u);
+        sum = (uint32_t)lss + mss;
+    } while (mss > 0);
+    return (uint16_t)(sum & 0x0000FFFFU);
+}
+
+void hyphaip_test_ChecksumKernels(void) {
+    enum { max_bytes = 2048 };
+    static uint16_t storage[(max_bytes + 64) / sizeof(uint16_t)];
+    static uint16_t aligned[(max_bytes + 64) / sizeof(uint16_t)];
+    uint8_t *bytes = (uint8_t *)storage;
+    uint32_t seed = 0x1234'5678U;
+    for (size_t i = 0U; i < sizeof(storage); i++) {
+        seed = (seed * 1'103'515'245U) + 12'345U;
+        bytes[i] = (uint8_t)(seed >> 16U);
+    }
+    HyphaIpChecksumKernel_e const kernels[] = {HyphaIpChecksumKernelScalar, HyphaIpChecksumKernelSSE2,
+                                               HyphaIpChecksumKernelAVX2, HyphaIpChecksumKernelNEON};
+    TEST_ASSERT_TRUE(HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumKernelScalar));
+    TEST_ASSERT_TRUE(HyphaIpChecksumKernelIsAvailable(HyphaIpChecksumSelectKernel()));
+    size_t const lengths[] = {0, 1, 2, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 1471, 1472, 1480, max_bytes};
+    for (size_t k = 0U; k < HYPHA_IP_DIMOF(kernels); k++) {
+        if (!HyphaIpChecksumKernelIsAvailable(kernels[k])) {
+            continue;
+        }
+        for (size_t start = 0U; start < 4U; start++) {  // unaligned starts
+            for (size_t l = 0U; l < HYPHA_IP_DIMOF(lengths); l++) {
+                size_t length = lengths[l];
+                // the reference runs on an aligned, zero padded copy
+                memset(aligned, 0, sizeof(aligned));
+                memcpy(aligned, &bytes[start], length);
+                uint16_t expected = legacy_checksum(nullptr, 0U, aligned, (length + 1U) / sizeof(uint16_t));
+                uint16_t actual = HyphaIpChecksumBytes(kernels[k], &bytes[start], length);
+                TEST_ASSERT_EQUAL_HEX16(expected, actual);
+            }
+        }
+    }
+    // odd header lengths carry into the payload as one contiguous run
+    size_t const splits[] = {0, 1, 7, 12, 13, 20, 21};
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(splits); s++) {
+        size_t length = 1473U;
+        memset(aligned, 0, sizeof(aligned));
+        memcpy(aligned, &bytes[1], length);
+        uint16_t expected = legacy_checksum(nullptr, 0U, aligned, (length + 1U) / sizeof(uint16_t));
+        HyphaIpSpan_t header = {&bytes[1], (uint32_t)splits[s], HyphaIpSpanTypeUint8_t};
+        HyphaIpSpan_t payload = {&bytes[1 + splits[s]], (uint32_t)(length - splits[s]), HyphaIpSpanTypeUint8_t};
+        TEST_ASSERT_EQUAL_HEX16(expected, HyphaIpComputeChecksum(header, payload));
+    }
+    // uint16_t spans still count in words
+    HyphaIpSpan_t header = {&aligned[0], 10U, HyphaIpSpanTypeUint16_t};
+    HyphaIpSpan_t payload = {&aligned[10], 500U, HyphaIpSpanTypeUint16_t};
+    TEST_ASSERT_EQUAL_HEX16(legacy_checksum(&aligned[0], 10U, &aligned[10], 500U),
+                            HyphaIpComputeChecksum(header, payload));
+}
+
+void hyphaip_test_ChecksumUpdate(void) {
+    // an IPv4 header in network order with a zero checksum
+    uint8_t header[20] = {0x45, 0x00, 0x00, 0x46, 0x00, 0x00, 0x00, 0x00, 0x80, 0x11,
+                          0x00, 0x00, 172,  16,   0,    7,    239,  0,    0,    155};
+    uint16_t words[10];
+    HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+    HyphaIpSpan_t span = {header, sizeof(header), HyphaIpSpanTypeUint8_t};
+    uint16_t checksum = (uint16_t)~HyphaIpComputeChecksum(span, empty);
+    // change the length (16 bit) and the destination (32 bit) and update
+    uint16_t old_length, new_length;
+    uint32_t old_destination, new_destination;
+    memcpy(&old_length, &header[2], sizeof(old_length));
+    memcpy(&old_destination, &header[16], sizeof(old_destination));
+    header[2] = 0x05;
+    header[3] = 0xDC;
+    header[19] = 42;
+    memcpy(&new_length, &header[2], sizeof(new_length));
+    memcpy(&new_destination, &header[16], sizeof(new_destination));
+    checksum = HyphaIpChecksumUpdate16(checksum, old_length, new_length);
+    checksum = HyphaIpChecksumUpdate32(checksum, old_destination, new_destination);
+    TEST_ASSERT_EQUAL_HEX16((uint16_t)~HyphaIpComputeChecksum(span, empty), checksum);
+    // the cache computes in full first, then only adjusts for the changed words
+    HyphaIpChecksumCache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    uint32_t seed = 7U;
+    for (size_t i = 0U; i < 100U; i++) {
+        seed = (seed * 1'103'515'245U) + 12'345U;
+        header[4 + (seed % 6U)] = (uint8_t)(seed >> 16U);  // identification, flags, TTL, protocol
+        header[12 + ((seed >> 8U) % 8U)] = (uint8_t)(seed >> 24U);  // addresses
+        memcpy(words, header, sizeof(words));
+        TEST_ASSERT_EQUAL_HEX16((uint16_t)~HyphaIpComputeChecksum(span, empty),
+                                HyphaIpChecksumCached(&cache, HYPHA_IP_DIMOF(words), words));
+    }
+}
+
 void hyphaip_test_BadContext(void) {
-    HyphaIpStatus_e status = HyphaIpInitialize(nullptr, &interface, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(nullptr, context_storage, sizeof(context_storage), &interface, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, status);
 }
 
 void hyphaip_test_BadInterfacePointer(void) {
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, nullptr, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), nullptr, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, status);
 }
 
@@ -372,7 +621,8 @@ void hyphaip_test_BadInterfaceMac(void) {
         .netmask = {255, 255, 255, 0},
         .gateway = {172, 16, 0, 1},
     };
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &bad_interface, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &bad_interface, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidMacAddress, status);
 }
 
@@ -383,7 +633,8 @@ void hyphaip_test_BadInterfaceGateway(void) {
         .netmask = {255, 255, 255, 0},
         .gateway = {172, 17, 0, 1},  // not on the same network
     };
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &bad_interface, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &bad_interface, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidNetwork, status);
 }
 
@@ -394,7 +645,8 @@ void hyphaip_test_BadInterfaceAddress(void) {
         .netmask = {255, 255, 255, 0},
         .gateway = {239, 0, 0, 1},
     };
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &bad_interface, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &bad_interface, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidIpAddress, status);
 }
 
@@ -405,12 +657,14 @@ void hyphaip_test_BadInterfaceAddress2(void) {
         .netmask = {255, 255, 255, 0},
         .gateway = {239, 0, 0, 1},
     };
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &bad_interface, &mine, &externals);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &bad_interface, &mine, &externals);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidIpAddress, status);
 }
 
 void hyphaip_test_BadExternalPointer(void) {
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &interface, &mine, nullptr);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine, nullptr);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, status);
 }
 
@@ -425,7 +679,8 @@ void hyphaip_test_BadExternalFunctions(void) {
                                                .report = nullptr,
                                                .receive_udp = nullptr};
 
-    HyphaIpStatus_e status = HyphaIpInitialize(&context, &interface, &mine, &bad_external);
+    HyphaIpStatus_e status =
+        HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine, &bad_external);
     TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, status);
 }
 
@@ -442,6 +697,50 @@ void hyphaip_test_GoodLifeCycle() {
     hyphaip_expected_test_values();  // set the expected values for the next tests
 }
 
+void hyphaip_test_SeparateContexts(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    size_t size = HyphaIpContextSize();
+    TEST_ASSERT_EQUAL(0U, size % HYPHA_IP_CONTEXT_ALIGNMENT);
+    uint8_t *both = aligned_alloc(HYPHA_IP_CONTEXT_ALIGNMENT, 2U * size);
+    TEST_ASSERT_NOT_NULL(both);
+    HyphaIpContext_t first = nullptr;
+    HyphaIpContext_t second = nullptr;
+    // the storage must hold a whole aligned context
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext,
+                      HyphaIpInitialize(&first, nullptr, size, &interface, &mine, &externals));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext,
+                      HyphaIpInitialize(&first, both, size - 1U, &interface, &mine, &externals));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext,
+                      HyphaIpInitialize(&first, &both[1], size, &interface, &mine, &externals));
+    TEST_ASSERT_NULL(first);
+
+    // side by side, neither sees the other (nor the one the tests run on)
+    HyphaIpNetworkInterface_t other = interface;
+    other.address.d = 8U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpInitialize(&first, both, size, &interface, &mine, &externals));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpInitialize(&second, &both[size], size, &other, &mine, &externals));
+    TEST_ASSERT_EQUAL_PTR(both, first);
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_NOT_EQUAL(first, context);
+    HyphaIpAddressMatch_t matches[] = {
+        {{{0x80, 0x90, 0xA0}, {0x12, 0x34, 0x58}}, {172, 16, 0, 12}},
+    };
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(first, HYPHA_IP_DIMOF(matches), matches));
+    TEST_ASSERT_NOT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(first)->arp_cache, matches[0].ipv4));
+    TEST_ASSERT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(second)->arp_cache, matches[0].ipv4));
+    TEST_ASSERT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(context)->arp_cache, matches[0].ipv4));
+    TEST_ASSERT_EQUAL(1U, HyphaIpGetStatistics(first)->arp.additions);
+    TEST_ASSERT_EQUAL(0U, HyphaIpGetStatistics(second)->arp.additions);
+    TEST_ASSERT_TRUE(HyphaIpIsOurIPv4Address(second, other.address));
+    TEST_ASSERT_FALSE(HyphaIpIsOurIPv4Address(first, other.address));
+
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&first));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&second));
+    TEST_ASSERT_NULL(first);
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpDeinitialize(&second));
+    free(both);
+}
+
 void hyphaip_test_Flip16(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpFlipUnit_t flip_test[] = {{sizeof(uint16_t), 3}};
@@ -490,9 +789,9 @@ void hyphaip_test_Contextless(void) {
     TEST_ASSERT_EQUAL(true, HyphaIpIsReservedIPv4Address(hypha_ip_reserved));
     TEST_ASSERT_EQUAL(0x7F000001U, HyphaIpIPv4AddressToValue(hypha_ip_localhost));
 #if (HYPHA_IP_USE_VLAN == 1)
-    TEST_ASSERT_EQUAL(18U, offsetof(HyphaIpEthernetFrame_t, payload));
+    TEST_ASSERT_EQUAL(18U, offsetof(HyphaIpEthernetFrame_t, payload) - offsetof(HyphaIpEthernetFrame_t, header));
 #else
-    TEST_ASSERT_EQUAL(14U, offsetof(HyphaIpEthernetFrame_t, payload));
+    TEST_ASSERT_EQUAL(14U, offsetof(HyphaIpEthernetFrame_t, payload) - offsetof(HyphaIpEthernetFrame_t, header));
 #endif
     // Test a bunch of addresses for being private
     HyphaIpIPv4Address_t private_addresses[] = {
@@ -535,9 +834,9 @@ void hyphaip_test_CheckOffsets(void) {
     HyphaIpEthernetFrame_t frame;
     size_t frame_length = sizeof(test_frame);
     memset(&frame, 0, sizeof(frame));
-    memcpy(&frame, test_frame, frame_length);
+    memcpy(&frame.header, test_frame, frame_length);
     printf("[TEST] Frame length: %zu\r\n", frame_length);
-    TEST_ASSERT_EQUAL_MEMORY(&frame, &test_frame[0], frame_length);
+    TEST_ASSERT_EQUAL_MEMORY(&frame.header, &test_frame[0], frame_length);
     // Offsets within the Ethernet frame, not the test_frame array
     TEST_ASSERT_EQUAL(0, HyphaIpOffsetOfIPHeader());
     TEST_ASSERT_EQUAL(20, HyphaIpOffsetOfUDPHeader());
@@ -549,6 +848,84 @@ void hyphaip_test_CheckOffsets(void) {
                              remaining);
 }
 
+void hyphaip_test_InPlaceAccessors(void) {
+    HyphaIpEthernetFrame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    memcpy(&frame.header, test_frame, sizeof(test_frame));
+    HyphaIpEthernetAddress_t destination = HyphaIpPeekEthernetDestination(&frame);
+    TEST_ASSERT_EQUAL_MEMORY(&expected_ethernet_destination_address, &destination, sizeof(destination));
+    HyphaIpEthernetAddress_t source = HyphaIpPeekEthernetSource(&frame);
+    TEST_ASSERT_EQUAL_MEMORY(&expected_ethernet_source_address, &source, sizeof(source));
+    TEST_ASSERT_EQUAL_HEX16(HyphaIpEtherType_IPv4, HyphaIpPeekEtherType(&frame));
+#if (HYPHA_IP_USE_VLAN == 1)
+    TEST_ASSERT_EQUAL_HEX16(HyphaIpEtherType_VLAN, HyphaIpPeekVlanTpid(&frame));
+    TEST_ASSERT_EQUAL(1, HyphaIpPeekVlanId(&frame));
+#endif
+    TEST_ASSERT_EQUAL(4, HyphaIpPeekIPv4Version(&frame));
+    TEST_ASSERT_EQUAL(5, HyphaIpPeekIPv4IHL(&frame));
+    TEST_ASSERT_EQUAL(0x46, HyphaIpPeekIPv4Length(&frame));
+    TEST_ASSERT_EQUAL(0, HyphaIpPeekIPv4Fragment(&frame));
+    TEST_ASSERT_EQUAL(HyphaIpProtocol_UDP, HyphaIpPeekIPv4Protocol(&frame));
+    HyphaIpIPv4Address_t ip_source = HyphaIpPeekIPv4Source(&frame);
+    TEST_ASSERT_EQUAL_MEMORY(&expected_metadata.source_address, &ip_source, sizeof(ip_source));
+    HyphaIpIPv4Address_t ip_destination = HyphaIpPeekIPv4Destination(&frame);
+    TEST_ASSERT_EQUAL_MEMORY(&expected_metadata.destination_address, &ip_destination, sizeof(ip_destination));
+    TEST_ASSERT_EQUAL(expected_metadata.source_port, HyphaIpPeekUdpSourcePort(&frame));
+    TEST_ASSERT_EQUAL(expected_metadata.destination_port, HyphaIpPeekUdpDestinationPort(&frame));
+    TEST_ASSERT_EQUAL(0x32, HyphaIpPeekUdpLength(&frame));
+    TEST_ASSERT_EQUAL_HEX16(0xb0ea, HyphaIpPeekUdpChecksum(&frame));
+}
+
+void hyphaip_test_SpecializedFlips(void) {
+    uint8_t source[64];
+    uint8_t expected[64];
+    uint8_t actual[64];
+    for (size_t i = 0U; i < sizeof(source); i++) {
+        source[i] = (uint8_t)(i * 37U + 11U);
+    }
+    typedef void (*flip_f)(void *destination, void const *source);
+    struct {
+        flip_f flip;
+        size_t num_units;
+        HyphaIpFlipUnit_t const *units;
+        size_t size;
+    } const cases[] = {
+        {HyphaIpFlipEthernetHeader, HYPHA_IP_DIMOF(hypha_ip_flip_ethernet_header), hypha_ip_flip_ethernet_header,
+         sizeof(HyphaIpEthernetHeader_t)},
+        {HyphaIpFlipIPv4Header, HYPHA_IP_DIMOF(hypha_ip_flip_ip_header), hypha_ip_flip_ip_header,
+         sizeof(HyphaIpIPv4Header_t)},
+        {HyphaIpFlipIcmpHeader, HYPHA_IP_DIMOF(hypha_ip_flip_icmp_header), hypha_ip_flip_icmp_header,
+         sizeof(HyphaIpICMPHeader_t)},
+        {HyphaIpFlipUdpHeader, HYPHA_IP_DIMOF(hypha_ip_flip_udp_header), hypha_ip_flip_udp_header,
+         sizeof(HyphaIpUDPHeader_t)},
+        {HyphaIpFlipArpPacket, HYPHA_IP_DIMOF(hypha_ip_flip_arp_packet), hypha_ip_flip_arp_packet,
+         sizeof(HyphaIpArpPacket_t)},
+        {HyphaIpFlipIgmpPacket, HYPHA_IP_DIMOF(hypha_ip_flip_igmp_packet), hypha_ip_flip_igmp_packet,
+         sizeof(HyphaIpIgmpPacket_t)},
+    };
+    for (size_t c = 0U; c < HYPHA_IP_DIMOF(cases); c++) {
+        memset(expected, 0, sizeof(expected));
+        memset(actual, 0, sizeof(actual));
+        size_t bytes = HyphaIpFlipCopy(cases[c].num_units, cases[c].units, expected, source);
+        TEST_ASSERT_EQUAL(cases[c].size, bytes);
+        cases[c].flip(actual, source);
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(actual));
+        // flipping in place gives the same result
+        memcpy(actual, source, sizeof(actual));
+        cases[c].flip(actual, actual);
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, cases[c].size);
+    }
+    // the type of the structure selects the flip
+    HyphaIpUDPHeader_t udp_header;
+    HyphaIpFlipFromFrame(&udp_header, &test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET - sizeof(HyphaIpUDPHeader_t)]);
+    TEST_ASSERT_EQUAL(expected_metadata.source_port, udp_header.source_port);
+    TEST_ASSERT_EQUAL(expected_metadata.destination_port, udp_header.destination_port);
+    HyphaIpUDPHeader_t const *const_header = &udp_header;
+    HyphaIpFlipToFrame(actual, const_header);
+    TEST_ASSERT_EQUAL_MEMORY(&test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET - sizeof(HyphaIpUDPHeader_t)], actual,
+                             sizeof(HyphaIpUDPHeader_t));
+}
+
 void hyphaip_test_PopulateArpTable(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpStatus_e status;
@@ -575,6 +952,67 @@ void hyphaip_test_PopulateArpTable(void) {
     use_prepopulated_arp = true;
 }
 
+void hyphaip_test_ArpCacheIndex(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    // start from an empty table
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &externals));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    static HyphaIpAddressMatch_t matches[HYPHA_IP_ARP_TABLE_SIZE];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(matches); i++) {
+        // every other pair of hosts shares an Ethernet Address, like hosts behind a router
+        size_t host = i / 2U;
+        matches[i] = (HyphaIpAddressMatch_t){{{0x02, 0x00, 0x00}, {0x00, (uint8_t)(host >> 8U), (uint8_t)host}},
+                                             {172, 16, (uint8_t)(i >> 8U), (uint8_t)i}};
+    }
+    size_t const half = HYPHA_IP_DIMOF(matches) / 2U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(context, half, matches));
+    size_t const rest = HYPHA_IP_DIMOF(matches) - half;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(context, rest, &matches[half]));
+    HyphaIpAddressMatch_t extra = {{{0x02, 0xFF, 0xFF}, {0xFF, 0xFF, 0xFF}}, {172, 16, 255, 255}};
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpTableFull, HyphaIpPopulateArpTable(context, 1U, &extra));
+    TEST_ASSERT_EQUAL(HYPHA_IP_DIMOF(matches), statistics->arp.additions);
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(matches); i++) {
+        HyphaIpEthernetAddress_t mac = HyphaIpFindEthernetAddress(context, &matches[i].ipv4);
+        TEST_ASSERT_EQUAL_MEMORY(&matches[i].mac, &mac, sizeof(mac));
+        HyphaIpIPv4Address_t ipv4 = HyphaIpFindIPv4Address(context, &matches[i].mac);
+        TEST_ASSERT_TRUE(HyphaIpIsSameEthernetAddress(matches[i].mac, HyphaIpFindEthernetAddress(context, &ipv4)));
+    }
+    HyphaIpEthernetAddress_t unknown = HyphaIpFindEthernetAddress(context, &extra.ipv4);
+    TEST_ASSERT_TRUE(HyphaIpIsSameEthernetAddress(hypha_ip_ethernet_local, unknown));
+
+    // removing every third entry moves others around, each must still be found by both addresses
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(matches); i += 3U) {
+        TEST_ASSERT_NOT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(context)->arp_cache, matches[i].ipv4));
+        HyphaIpTablesLock(context);
+        HyphaIpArpCacheRemove(context, matches[i].ipv4);
+        HyphaIpTablesUnlock(context);
+    }
+    HyphaIpArpCache_t const *cache = &current_tables(context)->arp_cache;
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(matches); i++) {
+        HyphaIpARPEntry_t const *entry = HyphaIpArpCacheFindByIPv4(cache, matches[i].ipv4);
+        if ((i % 3U) == 0U) {
+            TEST_ASSERT_NULL(entry);
+        } else {
+            TEST_ASSERT_NOT_NULL(entry);
+            TEST_ASSERT_TRUE(HyphaIpIsSameEthernetAddress(matches[i].mac, entry->match.mac));
+            TEST_ASSERT_NOT_NULL(HyphaIpArpCacheFindByMac(cache, matches[i].mac));
+        }
+    }
+    TEST_ASSERT_EQUAL((HYPHA_IP_DIMOF(matches) + 2U) / 3U, statistics->arp.removals);
+
+    // a known IPv4 Address is moved to its new Ethernet Address rather than added again
+    HyphaIpAddressMatch_t moved = {extra.mac, matches[1].ipv4};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(context, 1U, &moved));
+    HyphaIpEthernetAddress_t mac = HyphaIpFindEthernetAddress(context, &moved.ipv4);
+    TEST_ASSERT_TRUE(HyphaIpIsSameEthernetAddress(extra.mac, mac));
+    HyphaIpIPv4Address_t ipv4 = HyphaIpFindIPv4Address(context, &extra.mac);
+    TEST_ASSERT_TRUE(HyphaIpIsSameIPv4Address(moved.ipv4, ipv4));
+    TEST_ASSERT_EQUAL(HYPHA_IP_DIMOF(matches), statistics->arp.additions);
+}
+
 void hyphaip_test_PopulateEthernetFilter(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpEthernetAddress_t addresses[] = {
@@ -620,6 +1058,62 @@ void hyphaip_test_PopulateEthernetFilter(void) {
                       HyphaIpIsPermittedEthernetAddress(context, hypha_ip_ethernet_multicast));
 }
 
+void hyphaip_test_MulticastFilter(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    context->features.allow_any_multicast = false;  // only the joined groups get through
+    HyphaIpIPv4Address_t joined = {239, 0, 0, 155};
+    HyphaIpEthernetAddress_t joined_mac;
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&joined_mac, joined));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpReceive(context, joined, 9382));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, joined_mac));
+
+    // fill the rest of the groups through the filter, the joined group also let the General Queries in
+    static HyphaIpEthernetAddress_t groups[HYPHA_IP_MULTICAST_FILTER_SIZE - 2U];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(groups); i++) {
+        HyphaIpIPv4Address_t group = {239, 1, (uint8_t)(i >> 8U), (uint8_t)i};
+        TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&groups[i], group));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateEthernetFilter(context, HYPHA_IP_DIMOF(groups), groups));
+    HyphaIpEthernetAddress_t another = {{0x01, 0x00, 0x5E}, {0x7F, 0xFF, 0xFF}};
+    TEST_ASSERT_EQUAL(HyphaIpStatusEthernetFilterTableFull, HyphaIpPopulateEthernetFilter(context, 1U, &another));
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(groups); i++) {
+        TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, groups[i]));
+    }
+    TEST_ASSERT_EQUAL(1U + HYPHA_IP_DIMOF(groups), statistics->multicast.matches);
+
+    // the groups nobody joined are mostly turned away by the bitmap, the rest by the exact match
+    size_t const probes = 4096U;
+    for (size_t i = 0U; i < probes; i++) {
+        HyphaIpEthernetAddress_t mac = {{0x01, 0x00, 0x5E}, {0x02, (uint8_t)(i >> 8U), (uint8_t)i}};
+        TEST_ASSERT_FALSE(HyphaIpIsPermittedEthernetAddress(context, mac));
+    }
+    TEST_ASSERT_EQUAL(probes, statistics->multicast.rejected + statistics->multicast.collisions);
+    TEST_ASSERT_LESS_THAN(probes / 4U, statistics->multicast.collisions);
+
+    // leaving a group takes it out without disturbing the groups which share its bit
+    HyphaIpMulticastFilter_t before;
+    memcpy(&before, &current_tables(context)->multicast_filter, sizeof(before));
+    HyphaIpEthernetAddress_t const expected = expected_ethernet_destination_address;
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&expected_ethernet_destination_address, hypha_ip_igmpv2));  // the Leave
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpLeaveGroup(context, joined));
+    expected_ethernet_destination_address = expected;
+    TEST_ASSERT_FALSE(HyphaIpIsPermittedEthernetAddress(context, joined_mac));
+    // only the bits of the left group and of the all-hosts group it brought in may be cleared
+    size_t cleared = 0U;
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(before.bits); i++) {
+        uint64_t after = current_tables(context)->multicast_filter.bits[i];
+        TEST_ASSERT_TRUE((after & ~before.bits[i]) == 0U);
+        cleared += (size_t)__builtin_popcountll(before.bits[i] & ~after);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2U, cleared);
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(groups); i++) {
+        TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, groups[i]));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateEthernetFilter(context, 1U, &another));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, another));
+}
+
 void hyphaip_test_PopulateIpFilter(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpIPv4Address_t allowed_addresses[] = {
@@ -683,14 +1177,69 @@ void hyphaip_test_PrepareMulticast(void) {
     status = HyphaIpPrepareUdpReceive(context, address, 9382);
     TEST_ASSERT_EQUAL(HyphaIpStatusOk, status);
 
-    TEST_ASSERT_EQUAL(HyphaIpStatusNotSupported, HyphaIpPrepareUdpTransmit(context, hypha_ip_localhost, 9382));
+    HyphaIpUdpFlow_t flow;
+    HyphaIpMetaData_t metadata = {.destination_address = hypha_ip_localhost, .destination_port = 9382};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpPrepareUdpTransmit(nullptr, &metadata, &flow));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpPrepareUdpTransmit(context, nullptr, &flow));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpPrepareUdpTransmit(context, &metadata, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusNotSupported, HyphaIpPrepareUdpTransmit(context, &metadata, &flow));
 
-    status = HyphaIpPrepareUdpTransmit(context, address, 9382);
+    metadata.destination_address = address;
+    status = HyphaIpPrepareUdpTransmit(context, &metadata, &flow);
     TEST_ASSERT_EQUAL(HyphaIpStatusOk, status);
 
     use_prepare_multicast = true;
 }
 
+void hyphaip_test_PopulateIpPrefixes(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpIPv4Prefix_t prefixes[] = {
+        {{172, 16, 1, 0}, 24},
+        {{172, 16, 2, 0}, 24},    // touches the one before, they become one range
+        {{172, 16, 0, 11}, 32},   // a single host
+        {{172, 16, 1, 77}, 32},   // already inside a network
+        {{172, 16, 8, 255}, 21},  // the host bits are ignored
+    };
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpPopulateIPv4Prefixes(nullptr, 1U, prefixes));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpPopulateIPv4Prefixes(context, 0U, prefixes));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpPopulateIPv4Prefixes(context, 1U, nullptr));
+    HyphaIpIPv4Prefix_t too_long = {{172, 16, 0, 1}, 33};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpPopulateIPv4Prefixes(context, 1U, &too_long));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Prefixes(context, HYPHA_IP_DIMOF(prefixes), prefixes));
+    TEST_ASSERT_EQUAL(3U, current_tables(context)->allowed_ipv4_addresses.count);
+
+    HyphaIpIPv4Address_t allowed[] = {
+        {172, 16, 0, 11}, {172, 16, 1, 0}, {172, 16, 1, 200}, {172, 16, 2, 255}, {172, 16, 8, 0}, {172, 16, 15, 255},
+    };
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(allowed); i++) {
+        TEST_ASSERT_TRUE(HyphaIpIsPermittedIPv4Address(context, allowed[i]));
+    }
+    HyphaIpIPv4Address_t disallowed[] = {
+        {172, 16, 0, 10}, {172, 16, 0, 12}, {172, 16, 0, 255}, {172, 16, 3, 0}, {172, 16, 7, 255}, {172, 16, 16, 0},
+    };
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(disallowed); i++) {
+        TEST_ASSERT_FALSE(HyphaIpIsPermittedIPv4Address(context, disallowed[i]));
+    }
+
+    // the top of the address space does not wrap around
+    HyphaIpIPv4Prefix_t top[] = {{{255, 255, 255, 255}, 32}, {{255, 255, 255, 254}, 32}};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Prefixes(context, HYPHA_IP_DIMOF(top), top));
+    TEST_ASSERT_EQUAL(4U, current_tables(context)->allowed_ipv4_addresses.count);
+
+    // a default route takes in everything
+    HyphaIpIPv4Prefix_t everything = {{0, 0, 0, 0}, 0};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Prefixes(context, 1U, &everything));
+    TEST_ASSERT_EQUAL(1U, current_tables(context)->allowed_ipv4_addresses.count);
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedIPv4Address(context, disallowed[0]));
+
+    static HyphaIpIPv4Prefix_t hosts[HYPHA_IP_IPv4_FILTER_TABLE_SIZE];
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(hosts); i++) {
+        hosts[i] = (HyphaIpIPv4Prefix_t){{10, 0, (uint8_t)(i >> 7U), (uint8_t)(2U * i)}, 32};
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4FilterTableFull,
+                      HyphaIpPopulateIPv4Prefixes(context, HYPHA_IP_DIMOF(hosts), hosts));
+}
+
 void hyphaip_test_PrepareIpFilter(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpIPv4Address_t addresses[] = {
@@ -729,6 +1278,1553 @@ void hyphaip_test_ReceiveOneFrame(void) {
     TEST_ASSERT_EQUAL(HyphaIpStatusOk, status);
 }
 
+void hyphaip_test_ReceiveBatch(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    size_t handled = 0U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpRunBatch(nullptr, 4U, &handled));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpRunBatch(context, 4U, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunBatch(context, 0U, &handled));
+    TEST_ASSERT_EQUAL(0U, handled);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    size_t acquires = statistics->frames.acquires;
+    size_t releases = statistics->frames.releases;
+    HyphaIpStatus_e status = HyphaIpRunBatch(context, 4U, &handled);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, status);
+    TEST_ASSERT_EQUAL(4U, handled);
+    TEST_ASSERT_EQUAL(4U, statistics->udp.accepted);
+    TEST_ASSERT_EQUAL(acquires + 4U, statistics->frames.acquires);
+    TEST_ASSERT_EQUAL(releases + 4U, statistics->frames.releases);
+}
+
+void hyphaip_test_DriverBatches(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    // restart the stack with a driver which supports the batch interfaces
+    HyphaIpExternalInterface_t batched = externals;
+    batched.acquire_batch = acquire_batch;
+    batched.receive_batch = receive_batch;
+    batched.transmit_batch = transmit_batch;
+    batched.release_batch = release_batch;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &batched));
+    memset(&batch_calls, 0, sizeof(batch_calls));
+
+    size_t handled = 0U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunBatch(context, 3U, &handled));
+    TEST_ASSERT_EQUAL(3U, handled);
+    TEST_ASSERT_EQUAL(1U, batch_calls.acquires);
+    TEST_ASSERT_EQUAL(1U, batch_calls.receives);
+    TEST_ASSERT_EQUAL(1U, batch_calls.releases);
+    TEST_ASSERT_EQUAL(3U, HyphaIpGetStatistics(context)->udp.accepted);
+
+    // a datagram which needs several frames goes to the driver in one call
+    static uint8_t large[2U * HYPHA_IP_IPv4_FRAGMENT_SIZE];
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpSpan_t datagram = {.pointer = large, .count = sizeof(large), .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(1U, batch_calls.transmits);
+    TEST_ASSERT_EQUAL(3U, batch_calls.transmitted);
+    TEST_ASSERT_EQUAL(2U, batch_calls.releases);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+
+    // frames are only counted as sent once the driver has taken them
+    size_t accepted = statistics->mac.accepted;
+    size_t rejected = statistics->mac.rejected;
+    size_t sent = statistics->counter.mac.tx.count;
+    batch_calls.refused = 1U;
+    context->external.report = nullptr;  // the refusal is reported more than once on the way up
+    size_t udp_accepted = statistics->udp.accepted;
+    TEST_ASSERT_EQUAL(HyphaIpStatusFailure, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    context->external.report = report;
+    TEST_ASSERT_EQUAL(udp_accepted, statistics->udp.accepted);
+    batch_calls.refused = 0U;
+    TEST_ASSERT_EQUAL(accepted + 2U, statistics->mac.accepted);
+    TEST_ASSERT_EQUAL(rejected + 1U, statistics->mac.rejected);
+    TEST_ASSERT_EQUAL(sent + 2U, statistics->counter.mac.tx.count);
+
+    // every frame the driver could not give counts as a failure
+    size_t failures = statistics->frames.failures;
+    batch_calls.withheld = 2U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunBatch(context, 3U, &handled));
+    batch_calls.withheld = 0U;
+    TEST_ASSERT_EQUAL(1U, handled);
+    TEST_ASSERT_EQUAL(failures + 2U, statistics->frames.failures);
+
+    // a release which fails in an earlier chunk is not hidden by the later ones succeeding
+    batch_calls.failing = 1U;
+    context->external.report = nullptr;
+    TEST_ASSERT_EQUAL(HyphaIpStatusFailure, HyphaIpRunBatch(context, HYPHA_IP_BATCH_SIZE + 1U, &handled));
+    context->external.report = report;
+    TEST_ASSERT_EQUAL(HYPHA_IP_BATCH_SIZE + 1U, handled);
+    TEST_ASSERT_EQUAL(0U, batch_calls.failing);
+
+    // a driver with fewer frames than a burst holds still sends a datagram of many fragments
+    static uint8_t larger[4U * HYPHA_IP_IPv4_FRAGMENT_SIZE];
+    datagram = (HyphaIpSpan_t){.pointer = larger, .count = sizeof(larger), .type = HyphaIpSpanTypeUint8_t};
+    context->external.acquire = acquire_pooled;
+    context->external.release = release_pooled;
+    context->external.release_batch = release_batch_pooled;
+    pool.size = 3U;
+    pool.out = 0U;
+    size_t const transmitted = batch_calls.transmitted;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(transmitted + 5U, batch_calls.transmitted);
+    TEST_ASSERT_EQUAL(0U, pool.out);
+
+    // and one which has none left rejects it like every other failure
+    pool.size = 0U;
+    size_t const udp_rejected = statistics->udp.rejected;
+    expected_status = HyphaIpStatusOutOfMemory;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOutOfMemory, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    expected_status = HyphaIpStatusOk;
+    TEST_ASSERT_EQUAL(udp_rejected + 1U, statistics->udp.rejected);
+    context->external.acquire = acquire;
+    context->external.release = release;
+    context->external.release_batch = release_batch;
+}
+
+/// Counts the datagrams given to a registered listener
+size_t listened;
+
+HyphaIpStatus_e listener(void *user, HyphaIpMetaData_t *meta, HyphaIpSpan_t span) {
+    TEST_ASSERT_EQUAL_PTR(&listened, user);
+    TEST_ASSERT_EQUAL(expected_metadata.destination_port, meta->destination_port);
+    TEST_ASSERT_EQUAL_MEMORY(expected_payload.pointer, span.pointer, expected_payload.count);
+    listened++;
+    return HyphaIpStatusOk;
+}
+
+void hyphaip_test_UdpListeners(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpIPv4Address_t group = {239, 0, 0, 155};
+    listened = 0U;
+    actual_receive_udp = false;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpRegisterUdpListener(nullptr, group, 9382, listener, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpRegisterUdpListener(context, group, 9382, nullptr, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpUnregisterUdpListener(context, group, 9382));
+
+    // the registered listener takes the datagram instead of receive_udp
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRegisterUdpListener(context, group, 9382, listener, &listened));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunOnce(context));
+    TEST_ASSERT_EQUAL(1U, listened);
+    TEST_ASSERT_FALSE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(1U, statistics->listeners.delivered);
+
+    // a datagram for another port is dropped before its checksum is looked at
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpUnregisterUdpListener(context, group, 9382));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRegisterUdpListener(context, group, 9383, listener, &listened));
+    size_t checksums = statistics->checksums.udp.rx_software;
+    size_t accepted = statistics->udp.accepted;
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, receive(&mine, frame));
+    frame->info.flags = HyphaIpFrameFlagNone;
+    TEST_ASSERT_EQUAL(HyphaIpStatusUdpPortUnreachable, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    TEST_ASSERT_EQUAL(1U, statistics->listeners.unregistered);
+    TEST_ASSERT_EQUAL(checksums, statistics->checksums.udp.rx_software);
+    TEST_ASSERT_EQUAL(accepted, statistics->udp.accepted);
+
+    // a listener on any address takes what has no listener of its own
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpRegisterUdpListener(context, hypha_ip_default_route, 9382, listener, &listened));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 2));
+    TEST_ASSERT_EQUAL(2U, listened);
+    free(frame);
+
+    // the table holds as many listeners as configured, and no more
+    for (uint16_t port = 0U; port < (HYPHA_IP_UDP_LISTENER_TABLE_SIZE - 2U); port++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRegisterUdpListener(context, group, port, listener, &listened));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusUdpListenerTableFull,
+                      HyphaIpRegisterUdpListener(context, group, 10000U, listener, &listened));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRegisterUdpListener(context, group, 0U, listener, &listened));
+    // every one is still found after the others are removed from around it
+    for (uint16_t port = 0U; port < (HYPHA_IP_UDP_LISTENER_TABLE_SIZE - 2U); port += 2U) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpUnregisterUdpListener(context, group, port));
+    }
+    for (uint16_t port = 1U; port < (HYPHA_IP_UDP_LISTENER_TABLE_SIZE - 2U); port += 2U) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpUnregisterUdpListener(context, group, port));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpUnregisterUdpListener(context, group, 9383));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpUnregisterUdpListener(context, hypha_ip_default_route, 9382));
+
+    // with no listeners left, everything goes to receive_udp again
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunOnce(context));
+    TEST_ASSERT_TRUE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(2U, listened);
+}
+
+HyphaIpStatus_e offload_capabilities(HyphaIpExternalContext_t theirs, HyphaIpCapabilities_t *capabilities) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_NOT_NULL(capabilities);
+    TEST_ASSERT_FALSE(capabilities->rx_ipv4_checksum);  // starts cleared
+    *capabilities = (HyphaIpCapabilities_t){true, true, true, true};
+    return HyphaIpStatusOk;
+}
+
+HyphaIpStatus_e broken_capabilities(HyphaIpExternalContext_t theirs, HyphaIpCapabilities_t *capabilities) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_NOT_NULL(capabilities);
+    return HyphaIpStatusFailure;
+}
+
+HyphaIpStatus_e receive_offloaded(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    HyphaIpStatus_e status = receive(theirs, frame);
+    // the driver vouches for both checksums, so corrupt them to prove they are not checked again
+    frame->payload[HyphaIpIPv4OffsetChecksum] ^= 0xFFU;
+    frame->payload[HyphaIpUdpOffsetChecksum] ^= 0xFFU;
+    frame->info.flags = HyphaIpFrameFlagIPv4ChecksumVerified | HyphaIpFrameFlagUdpChecksumVerified;
+    return status;
+}
+
+void hyphaip_test_ChecksumOffload(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t offloaded = externals;
+    offloaded.capabilities = broken_capabilities;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusFailure,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &offloaded));
+    TEST_ASSERT_NULL(context);
+    offloaded.capabilities = offload_capabilities;
+    offloaded.receive = receive_offloaded;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &offloaded));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+
+    // the received checksums are taken from the driver
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRunOnce(context));
+    TEST_ASSERT_TRUE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(1U, statistics->checksums.ipv4.rx_offloaded);
+    TEST_ASSERT_EQUAL(0U, statistics->checksums.ipv4.rx_software);
+    TEST_ASSERT_EQUAL(HYPHA_IP_USE_UDP_CHECKSUM ? 1U : 0U, statistics->checksums.udp.rx_offloaded);
+    TEST_ASSERT_EQUAL(0U, statistics->checksums.udp.rx_software);
+
+    // the transmitted checksums are left to the driver
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpSpan_t datagram = {.pointer = (void *)&test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET],
+                              .count = sizeof(test_frame) - HYPHA_IP_UDP_PAYLOAD_OFFSET,
+                              .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(1U, statistics->checksums.ipv4.tx_offloaded);
+    TEST_ASSERT_EQUAL(0U, statistics->checksums.ipv4.tx_software);
+    TEST_ASSERT_EQUAL(HYPHA_IP_USE_UDP_CHECKSUM ? 1U : 0U, statistics->checksums.udp.tx_offloaded);
+    TEST_ASSERT_EQUAL(0U, statistics->checksums.udp.tx_software);
+
+    // looped back frames never see the driver so the stack does the work on both sides
+    expected_metadata.source_address = hypha_ip_localhost;
+    expected_metadata.destination_address = hypha_ip_localhost;
+    metadata.destination_address = hypha_ip_localhost;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(1U, statistics->checksums.ipv4.tx_software);
+    TEST_ASSERT_EQUAL(1U, statistics->checksums.ipv4.rx_software);
+    TEST_ASSERT_EQUAL(HYPHA_IP_USE_UDP_CHECKSUM ? 1U : 0U, statistics->checksums.udp.tx_software);
+    TEST_ASSERT_EQUAL(HYPHA_IP_USE_UDP_CHECKSUM ? 1U : 0U, statistics->checksums.udp.rx_software);
+}
+
+void hyphaip_test_TransmitUdpFlow(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpUdpFlow_t flow;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpTransmit(context, &metadata, &flow));
+    TEST_ASSERT_EQUAL(HyphaIpIPv4AddressToValue(interface.address),
+                      HyphaIpIPv4AddressToValue(flow.metadata.source_address));
+    // odd and even lengths, the flow must produce the same frame as the regular path
+    for (size_t length = 41U; length <= 42U; length++) {
+        HyphaIpSpan_t datagram = {.pointer = (void *)&test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET],
+                                  .count = (uint32_t)length,
+                                  .type = HyphaIpSpanTypeUint8_t};
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+        static HyphaIpEthernetFrame_t regular;
+        memcpy(&regular, &transmitted_frame, sizeof(regular));
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpFlow(context, &flow, datagram));
+        TEST_ASSERT_EQUAL_MEMORY(&regular.header, &transmitted_frame.header, HYPHA_IP_UDP_FLOW_HEADER_SIZE + length);
+        TEST_ASSERT_NOT_EQUAL(0U, flow.metadata.timestamp);
+    }
+    HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+    static uint8_t large[HYPHA_IP_MAX_UDP_PAYLOAD_SIZE + 1U];
+    HyphaIpSpan_t too_large = {.pointer = large, .count = sizeof(large), .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpTransmitUdpFlow(nullptr, &flow, too_large));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpTransmitUdpFlow(context, nullptr, too_large));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidSpan, HyphaIpTransmitUdpFlow(context, &flow, empty));
+    TEST_ASSERT_EQUAL(HyphaIpStatusUdpDatagramTooLarge, HyphaIpTransmitUdpFlow(context, &flow, too_large));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+}
+
+void hyphaip_test_TransmitGathered(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    uint8_t const *payload = &test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET];
+    size_t const length = sizeof(test_frame) - HYPHA_IP_UDP_PAYLOAD_OFFSET;
+    HyphaIpSpan_t whole = {.pointer = (void *)payload, .count = (uint32_t)length, .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, whole));
+    static HyphaIpEthernetFrame_t contiguous;
+    memcpy(&contiguous, &transmitted_frame, sizeof(contiguous));
+
+    // odd sized pieces with an empty one in the middle make the same frame
+    HyphaIpSpan_t const pieces[] = {
+        {.pointer = (void *)&payload[0], .count = 5U, .type = HyphaIpSpanTypeUint8_t},
+        HYPHA_IP_DEFAULT_SPAN,
+        {.pointer = (void *)&payload[5], .count = 24U, .type = HyphaIpSpanTypeUint8_t},
+        {.pointer = (void *)&payload[29], .count = (uint32_t)(length - 29U), .type = HyphaIpSpanTypeUint8_t},
+    };
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagramV(context, &metadata, HYPHA_IP_DIMOF(pieces), pieces));
+    TEST_ASSERT_EQUAL_MEMORY(&contiguous.header, &transmitted_frame.header, HYPHA_IP_UDP_PAYLOAD_OFFSET + length);
+
+    // a piece which straddles two fragments is split between them, the first fragment is sent last
+    static uint8_t first[1000U];
+    static uint8_t second[1000U];
+    memset(first, 0xA5, sizeof(first));
+    memset(second, 0x5A, sizeof(second));
+    HyphaIpSpan_t const large[] = {
+        {.pointer = first, .count = sizeof(first), .type = HyphaIpSpanTypeUint8_t},
+        {.pointer = second, .count = sizeof(second), .type = HyphaIpSpanTypeUint8_t},
+    };
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagramV(context, &metadata, HYPHA_IP_DIMOF(large), large));
+    size_t const head = HYPHA_IP_IPv4_FRAGMENT_SIZE - sizeof(HyphaIpUDPHeader_t) - sizeof(first);
+    TEST_ASSERT_EQUAL(sizeof(HyphaIpUDPHeader_t) + sizeof(first) + sizeof(second),
+                      HyphaIpPeek16(&transmitted_frame.payload[HyphaIpUdpOffsetLength]));
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xA5, &transmitted_frame.payload[HyphaIpOffsetOfUDPPayload()], sizeof(first));
+    TEST_ASSERT_EACH_EQUAL_UINT8(0x5A, &transmitted_frame.payload[HyphaIpOffsetOfUDPPayload() + sizeof(first)], head);
+
+    HyphaIpSpan_t const bad[] = {{.pointer = first, .count = 2U, .type = HyphaIpSpanTypeUint16_t}};
+    HyphaIpSpan_t const empty[] = {HYPHA_IP_DEFAULT_SPAN};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpTransmitUdpDatagramV(nullptr, &metadata, 1U, pieces));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpTransmitUdpDatagramV(context, nullptr, 1U, pieces));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpTransmitUdpDatagramV(context, &metadata, 1U, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpTransmitUdpDatagramV(context, &metadata, 1U, bad));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidSpan, HyphaIpTransmitUdpDatagramV(context, &metadata, 1U, empty));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidSpan, HyphaIpTransmitUdpDatagramV(context, &metadata, 0U, nullptr));
+}
+
+void hyphaip_test_TransmitFragmented(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    static uint8_t large[HYPHA_IP_MAX_UDP_DATAGRAM_SIZE + 1U];
+    for (size_t i = 0U; i < sizeof(large); i++) {
+        large[i] = (uint8_t)(i * 7U);
+    }
+    size_t const sizes[] = {4000U, HYPHA_IP_MAX_UDP_DATAGRAM_SIZE};
+    uint16_t identification = 0U;
+    for (size_t s = 0U; s < HYPHA_IP_DIMOF(sizes); s++) {
+        HyphaIpSpan_t datagram = {.pointer = large, .count = (uint32_t)sizes[s], .type = HyphaIpSpanTypeUint8_t};
+        memset(&transmitted_fragments, 0, sizeof(transmitted_fragments));
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+        // one UDP header for the whole datagram, each fragment under the same (new) identification
+        size_t const total = sizeof(HyphaIpUDPHeader_t) + sizes[s];
+        TEST_ASSERT_EQUAL((total + HYPHA_IP_IPv4_FRAGMENT_SIZE - 1U) / HYPHA_IP_IPv4_FRAGMENT_SIZE,
+                          transmitted_fragments.fragments);
+        TEST_ASSERT_EQUAL(total, transmitted_fragments.length);
+        TEST_ASSERT_EQUAL(total, transmitted_fragments.received);
+        if (s > 0U) {
+            TEST_ASSERT_EQUAL((uint16_t)(identification + 1U), transmitted_fragments.identification);
+        }
+        identification = transmitted_fragments.identification;
+        uint8_t const *udp = transmitted_fragments.bytes;
+        TEST_ASSERT_EQUAL(metadata.source_port, HyphaIpPeek16(&udp[0]));
+        TEST_ASSERT_EQUAL(metadata.destination_port, HyphaIpPeek16(&udp[2]));
+        TEST_ASSERT_EQUAL(total, HyphaIpPeek16(&udp[4]));
+        TEST_ASSERT_EQUAL_MEMORY(large, &udp[sizeof(HyphaIpUDPHeader_t)], sizes[s]);
+        if (HYPHA_IP_USE_UDP_CHECKSUM) {
+            HyphaIpPseudoHeader_t pseudo_header = {.source = interface.address,
+                                                   .destination = metadata.destination_address,
+                                                   .zero = 0,
+                                                   .protocol = HyphaIpProtocol_UDP,
+                                                   .length = __builtin_bswap16((uint16_t)total)};
+            HyphaIpSpan_t header = {&pseudo_header, offsetof(HyphaIpPseudoHeader_t, header), HyphaIpSpanTypeUint8_t};
+            HyphaIpSpan_t whole = {(void *)udp, (uint32_t)total, HyphaIpSpanTypeUint8_t};
+            TEST_ASSERT_EQUAL_HEX16(HyphaIpChecksumValid, HyphaIpComputeChecksum(header, whole));
+        }
+    }
+    HyphaIpSpan_t too_large = {.pointer = large, .count = sizeof(large), .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusUdpDatagramTooLarge, HyphaIpTransmitUdpDatagram(context, &metadata, too_large));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+}
+
+void hyphaip_test_TransmitReserved(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    uint8_t const *expected = &test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET];
+    size_t const length = sizeof(test_frame) - HYPHA_IP_UDP_PAYLOAD_OFFSET;
+    HyphaIpSpan_t whole = {.pointer = (void *)expected, .count = (uint32_t)length, .type = HyphaIpSpanTypeUint8_t};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, whole));
+    static HyphaIpEthernetFrame_t copied;
+    memcpy(&copied, &transmitted_frame, sizeof(copied));
+
+    // the payload is written where HyphaIpSpanUdpPayload points and gives the same frame as a copy
+    HyphaIpEthernetFrame_t *frame = nullptr;
+    HyphaIpSpan_t payload = HYPHA_IP_DEFAULT_SPAN;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReserveUdpPayload(context, &frame, &payload));
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_EQUAL_PTR(HyphaIpSpanUdpPayload(frame).pointer, payload.pointer);
+    TEST_ASSERT_EQUAL(HYPHA_IP_MAX_UDP_PAYLOAD_SIZE, HyphaIpSpanSize(payload));
+    memcpy(payload.pointer, expected, length);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpCommitUdpDatagram(context, frame, &metadata, length));
+    TEST_ASSERT_EQUAL_MEMORY(&copied.header, &transmitted_frame.header, HYPHA_IP_UDP_PAYLOAD_OFFSET + length);
+
+    // an aborted or rejected reservation is given back
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReserveUdpPayload(context, &frame, &payload));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAbort(context, frame));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReserveUdpPayload(context, &frame, &payload));
+    TEST_ASSERT_EQUAL(HyphaIpStatusUdpDatagramTooLarge,
+                      HyphaIpCommitUdpDatagram(context, frame, &metadata, HYPHA_IP_MAX_UDP_PAYLOAD_SIZE + 1U));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpReserveUdpPayload(nullptr, &frame, &payload));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpReserveUdpPayload(context, nullptr, &payload));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpReserveUdpPayload(context, &frame, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpCommitUdpDatagram(nullptr, frame, &metadata, length));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpCommitUdpDatagram(context, nullptr, &metadata, length));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpAbort(nullptr, frame));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpAbort(context, nullptr));
+}
+
+/// The frames given to the driver, kept so they can be received again in any order
+struct {
+    size_t count;                       ///< The number of frames kept
+    HyphaIpEthernetFrame_t frames[9U];  ///< The frames in the order they were transmitted
+} captured_frames;
+
+HyphaIpStatus_e transmit_captured(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    TEST_ASSERT_LESS_THAN(HYPHA_IP_DIMOF(captured_frames.frames), captured_frames.count);
+    memcpy(&captured_frames.frames[captured_frames.count++], frame, HYPHA_IP_FRAME_ALLOCATION(frame->info.length));
+    return transmit(theirs, frame);
+}
+
+HyphaIpStatus_e receive_reassembled(HyphaIpExternalContext_t theirs, HyphaIpMetaData_t *meta, HyphaIpSpan_t span) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_NOT_NULL(meta);
+    TEST_ASSERT_EQUAL(expected_metadata.source_port, meta->source_port);
+    TEST_ASSERT_EQUAL(expected_metadata.destination_port, meta->destination_port);
+    TEST_ASSERT_EQUAL(expected_payload.count, span.count);
+    TEST_ASSERT_EQUAL_MEMORY(expected_payload.pointer, span.pointer, HyphaIpSpanSize(span));
+    actual_receive_udp = true;
+    return HyphaIpStatusOk;
+}
+
+void hyphaip_test_ReceiveReassembled(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t capturing = externals;
+    capturing.transmit = transmit_captured;
+    capturing.receive_udp = receive_reassembled;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &capturing));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    static uint8_t large[4000U];
+    for (size_t i = 0U; i < sizeof(large); i++) {
+        large[i] = (uint8_t)(i * 13U);
+    }
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpSpan_t datagram = {.pointer = large, .count = sizeof(large), .type = HyphaIpSpanTypeUint8_t};
+    HyphaIpSpan_t const previous_payload = expected_payload;
+    expected_payload = datagram;
+    actual_receive_udp = false;
+    // three datagrams A, B and C of three fragments each, sent as middle, last then first
+    captured_frames.count = 0U;
+    for (size_t i = 0U; i < 3U; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    }
+    TEST_ASSERT_EQUAL(9U, captured_frames.count);
+    HyphaIpEthernetFrame_t *frames = captured_frames.frames;
+
+    // without slots the fragments are rejected
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4HeaderRejected, HyphaIpIPv4ReceivePacket(context, &frames[0], 1));
+    static HyphaIpReassemblySlot_t slots[HYPHA_IP_REASSEMBLY_SLOTS + 1U];
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpProvideReassemblySlots(nullptr, 2U, slots));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpProvideReassemblySlots(context, 2U, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument,
+                      HyphaIpProvideReassemblySlots(context, HYPHA_IP_DIMOF(slots), slots));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpProvideReassemblySlots(context, 2U, slots));
+
+    // A arrives out of order and is delivered once the last hole is filled
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[0], 1));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[2], 1));
+    TEST_ASSERT_FALSE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[1], 1));
+    TEST_ASSERT_TRUE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(1U, statistics->reassembly.hits);
+
+    // B, C and A again do not fit in two slots, so the oldest (B) is evicted
+    actual_receive_udp = false;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[3], 10));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[6], 20));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[0], 30));
+    TEST_ASSERT_EQUAL(1U, statistics->reassembly.evictions);
+
+    // C and A run out of time on the timer wheel, B starts over and completes
+    HyphaIpTimestamp_t later = 30 + HYPHA_IP_REASSEMBLY_TIMEOUT;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, later - 1));
+    TEST_ASSERT_EQUAL(1U, statistics->reassembly.timeouts);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, later));
+    TEST_ASSERT_EQUAL(2U, statistics->reassembly.timeouts);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[4], later));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[5], later));
+    TEST_ASSERT_FALSE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4ReceivePacket(context, &frames[3], later));
+    TEST_ASSERT_TRUE(actual_receive_udp);
+    TEST_ASSERT_EQUAL(2U, statistics->reassembly.hits);
+    TEST_ASSERT_EQUAL(9U, statistics->reassembly.fragments);
+    TEST_ASSERT_EQUAL(0U, statistics->reassembly.rejected);
+
+    // a fragment which reached past the end before the last one said where that is gives the slot up
+    size_t last = 0U;
+    while ((HyphaIpPeekIPv4Fragment(&frames[last]) & HYPHA_IP_IPv4_FLAG_MF) != 0U) {
+        last++;
+    }
+    uint16_t const end = HyphaIpPeekIPv4Fragment(&frames[last]) & HYPHA_IP_IPv4_FRAGMENT_MASK;
+    static HyphaIpEthernetFrame_t beyond;
+    beyond = frames[(last + 1U) % 3U];
+    TEST_ASSERT_NOT_EQUAL(0U, HyphaIpPeekIPv4Fragment(&beyond) & HYPHA_IP_IPv4_FLAG_MF);
+    HyphaIpPoke16(&beyond.payload[HyphaIpIPv4OffsetFragment], (uint16_t)(HYPHA_IP_IPv4_FLAG_MF | end));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpIPv4Reassemble(context, &beyond, later));
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4HeaderRejected, HyphaIpIPv4Reassemble(context, &frames[last], later));
+    TEST_ASSERT_EQUAL(1U, statistics->reassembly.rejected);
+    TEST_ASSERT_FALSE(slots[0].in_use);
+    TEST_ASSERT_FALSE(slots[1].in_use);
+    TEST_ASSERT_EQUAL(0U, slots[0].timer);
+    TEST_ASSERT_EQUAL(0U, slots[1].timer);
+    expected_payload = previous_payload;
+}
+
+/// The sizes the stack asked the driver for
+struct {
+    size_t count;              ///< The number of sized acquires
+    size_t requested;          ///< The capacity asked for by the last one
+    size_t shortfall;          ///< How much smaller than asked the frames are made
+    HyphaIpStatus_e reported;  ///< The last failure reported by the stack
+} sized_frames;
+
+void report_sized(HyphaIpExternalContext_t theirs, HyphaIpStatus_e status, const char *const func,
+                  const char *const file, unsigned int line) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    (void)func;
+    (void)file;
+    (void)line;
+    if (status != HyphaIpStatusOk) {
+        sized_frames.reported = status;
+    }
+}
+
+HyphaIpEthernetFrame_t *acquire_sized(HyphaIpExternalContext_t theirs, size_t capacity) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_LESS_OR_EQUAL(HYPHA_IP_FRAME_CAPACITY, capacity);
+    sized_frames.count++;
+    sized_frames.requested = capacity;
+    // the whole frame is allocated so it can be written through its type, the stack only has the capacity to go by
+    HyphaIpEthernetFrame_t *frame = (HyphaIpEthernetFrame_t *)malloc(sizeof(HyphaIpEthernetFrame_t));
+    if (frame != nullptr) {
+        frame->info.capacity = (uint16_t)(capacity - sized_frames.shortfall);
+    }
+    return frame;
+}
+
+void hyphaip_test_SizedFrames(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t sized = externals;
+    sized.acquire_sized = acquire_sized;
+    sized.report = report_sized;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    memset(&sized_frames, 0, sizeof(sized_frames));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine, &sized));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpMetaData_t metadata = {.source_address = hypha_ip_localhost,  // ignored
+                                  .source_port = 1025,
+                                  .destination_address = {239, 0, 0, 155},
+                                  .destination_port = 9382,
+                                  .timestamp = 0};
+    uint8_t small[8U] = {1, 2, 3, 4, 5, 6, 7, 8};
+    HyphaIpSpan_t datagram = {.pointer = small, .count = sizeof(small), .type = HyphaIpSpanTypeUint8_t};
+
+    // a small datagram only asks for a small frame and says how much of it was written
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    size_t const expected_length = HYPHA_IP_UDP_PAYLOAD_OFFSET + sizeof(small);
+    TEST_ASSERT_EQUAL(1U, sized_frames.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, sized_frames.reported);
+    TEST_ASSERT_EQUAL(expected_length, sized_frames.requested);
+    TEST_ASSERT_EQUAL(expected_length, transmitted_frame.info.length);
+    TEST_ASSERT_EQUAL_MEMORY(small, &transmitted_frame.payload[HyphaIpOffsetOfUDPPayload()], sizeof(small));
+
+    // a frame smaller than asked for is given back rather than written past its end
+    size_t failures = statistics->frames.failures;
+    size_t releases = statistics->frames.releases;
+    sized_frames.shortfall = 1U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOutOfMemory, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidFrameLength, sized_frames.reported);
+    TEST_ASSERT_EQUAL(failures + 1U, statistics->frames.failures);
+    TEST_ASSERT_EQUAL(releases + 1U, statistics->frames.releases);
+    sized_frames.shortfall = 0U;
+
+    // received frames are only parsed as far as the driver said it received
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    memcpy(&frame->header, test_frame, sizeof(test_frame));
+    frame->info.flags = HyphaIpFrameFlagNone;
+    frame->info.length = sizeof(HyphaIpEthernetHeader_t) - 1U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidFrameLength, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    frame->info.length = (uint16_t)(HYPHA_IP_FRAME_CAPACITY + 1U);
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidFrameLength, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    frame->info.length = sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpIPv4Header_t) - 1U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidFrameLength, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    frame->info.length = sizeof(test_frame) - 1U;  // the IPv4 length now runs past the end
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4HeaderRejected, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    free(frame);
+}
+
+/// What the stack has sent over IGMP
+struct {
+    size_t count;                      ///< The number of IGMP messages
+    uint8_t type;                      ///< The type of the last one
+    HyphaIpIPv4Address_t group;        ///< The group of the last one
+    HyphaIpIPv4Address_t destination;  ///< Where the last one was sent
+} igmp_sent;
+
+HyphaIpStatus_e transmit_igmp(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_EQUAL(HyphaIpProtocol_IGMP, HyphaIpPeekIPv4Protocol(frame));
+    // every message goes to the Ethernet Address of its multicast destination
+    HyphaIpEthernetAddress_t mac;
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&mac, HyphaIpPeekIPv4Destination(frame)));
+    TEST_ASSERT_EQUAL_MEMORY(&mac, &frame->header.destination, sizeof(mac));
+    uint8_t const *igmp = &frame->payload[sizeof(HyphaIpIPv4Header_t)];
+    igmp_sent.count++;
+    igmp_sent.type = igmp[0];
+    memcpy(&igmp_sent.group, &igmp[4], sizeof(igmp_sent.group));
+    igmp_sent.destination = HyphaIpPeekIPv4Destination(frame);
+    return HyphaIpStatusOk;
+}
+
+/// Fills in a frame with an IGMP message from a querier or another host, with the Router Alert option
+void make_igmp_frame(HyphaIpEthernetFrame_t *frame, HyphaIpIPv4Address_t destination, uint8_t type, uint8_t code,
+                     HyphaIpIPv4Address_t group) {
+    memcpy(&frame->header, test_frame, sizeof(HyphaIpEthernetHeader_t));
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&frame->header.destination, destination));
+    uint8_t *ip = frame->payload;
+    uint8_t const header[] = {0x46, 0x00, 0x00, 32, 0x00, 0x00, 0x00, 0x00, 1, HyphaIpProtocol_IGMP, 0x00, 0x00,
+                              172, 16, 0, 1, destination.a, destination.b, destination.c, destination.d,
+                              0x94, 0x04, 0x00, 0x00};
+    memcpy(ip, header, sizeof(header));
+    uint8_t *igmp = &ip[sizeof(header)];
+    uint8_t const message[] = {type, code, 0x00, 0x00, group.a, group.b, group.c, group.d};
+    memcpy(igmp, message, sizeof(message));
+    HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+    HyphaIpSpan_t ip_span = {.pointer = ip, .count = sizeof(header), .type = HyphaIpSpanTypeUint8_t};
+    uint16_t checksum = (uint16_t)~HyphaIpComputeChecksum(ip_span, empty);
+    memcpy(&ip[10], &checksum, sizeof(checksum));
+    HyphaIpSpan_t igmp_span = {.pointer = igmp, .count = sizeof(message), .type = HyphaIpSpanTypeUint8_t};
+    checksum = (uint16_t)~HyphaIpComputeChecksum(igmp_span, empty);
+    memcpy(&igmp[2], &checksum, sizeof(checksum));
+    frame->info.flags = HyphaIpFrameFlagNone;
+    frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + sizeof(header) + sizeof(message));
+}
+
+void hyphaip_test_IgmpMembership(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t igmp_externals = externals;
+    igmp_externals.transmit = transmit_igmp;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &igmp_externals));
+    memset(&igmp_sent, 0, sizeof(igmp_sent));
+    context->features.allow_ip_filtering = false;  // the querier is not one of the allowed sources
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpIPv4Address_t group = {239, 0, 0, 155};
+    HyphaIpIPv4Address_t other = {239, 0, 0, 156};
+
+    // only the first receiver joins and only the last one leaves
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpReceive(context, group, 9382));
+    TEST_ASSERT_EQUAL(1U, igmp_sent.count);
+    TEST_ASSERT_EQUAL(HyphaIpIgmpTypeReport_v2, igmp_sent.type);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpReceive(context, group, 9383));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReleaseUdpReceive(context, group, 9383));
+    TEST_ASSERT_EQUAL(1U, igmp_sent.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpReceive(context, other, 9382));
+    TEST_ASSERT_EQUAL(2U, igmp_sent.count);
+
+    // a General Query is answered for every group, each at a random time within the Max Response Time
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    HyphaIpTimestamp_t now = 1000;
+    HyphaIpTimestamp_t const response_time = 10 * HYPHA_IP_IGMP_DECISECOND;
+    make_igmp_frame(frame, hypha_ip_igmpv1, HyphaIpIgmpTypeQuery, 10U, hypha_ip_default_route);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, now));
+    TEST_ASSERT_EQUAL(1U, statistics->membership.queries);
+    TEST_ASSERT_EQUAL(2U, context->igmp.delaying);
+    for (size_t i = 0U; i < context->igmp.count; i++) {
+        TEST_ASSERT_TRUE(context->igmp.entries[i].deadline >= now);
+        TEST_ASSERT_TRUE(context->igmp.entries[i].deadline < (now + response_time));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, now + response_time));
+    TEST_ASSERT_EQUAL(4U, igmp_sent.count);
+    TEST_ASSERT_EQUAL(2U, statistics->membership.reports);
+
+    // a query about someone else's group is not ours to answer
+    HyphaIpIPv4Address_t stranger = {239, 0, 0, 200};
+    make_igmp_frame(frame, stranger, HyphaIpIgmpTypeQuery, 10U, stranger);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, now));
+    TEST_ASSERT_EQUAL(0U, context->igmp.delaying);
+
+    // another host's report for the group means ours is not needed
+    make_igmp_frame(frame, group, HyphaIpIgmpTypeQuery, 10U, group);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, now));
+    TEST_ASSERT_EQUAL(2U, statistics->membership.queries);
+    TEST_ASSERT_EQUAL(1U, context->igmp.delaying);
+    make_igmp_frame(frame, group, HyphaIpIgmpTypeReport_v2, 0U, group);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, now + 1));
+    TEST_ASSERT_EQUAL(1U, statistics->membership.suppressed);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, now + response_time));
+    TEST_ASSERT_EQUAL(4U, igmp_sent.count);
+
+    // a damaged message is dropped
+    make_igmp_frame(frame, hypha_ip_igmpv1, HyphaIpIgmpTypeQuery, 10U, hypha_ip_default_route);
+    frame->payload[sizeof(HyphaIpIPv4Header_t) + 4U + 1U] ^= 0xFFU;
+    TEST_ASSERT_EQUAL(HyphaIpStatusIgmpChecksumRejected, HyphaIpEthernetReceiveFrame(context, frame, now));
+    TEST_ASSERT_EQUAL(0U, context->igmp.delaying);
+
+    // with many groups the answers to a query are spread over several runs
+    for (size_t i = 2U; i < HYPHA_IP_IGMP_GROUP_TABLE_SIZE; i++) {
+        HyphaIpIPv4Address_t many = {239, 1, 0, (uint8_t)i};
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpReceive(context, many, 9382));
+    }
+    HyphaIpIPv4Address_t one_too_many = {239, 2, 0, 0};
+    TEST_ASSERT_EQUAL(HyphaIpStatusIgmpGroupTableFull, HyphaIpPrepareUdpReceive(context, one_too_many, 9382));
+    make_igmp_frame(frame, hypha_ip_igmpv1, HyphaIpIgmpTypeQuery, 0U, hypha_ip_default_route);  // IGMPv1, 10 seconds
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, now));
+    TEST_ASSERT_EQUAL(HYPHA_IP_IGMP_GROUP_TABLE_SIZE, context->igmp.delaying);
+    size_t runs = 0U;
+    size_t sent = igmp_sent.count;
+    while (context->igmp.delaying > 0U) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, now + (100 * HYPHA_IP_IGMP_DECISECOND)));
+        TEST_ASSERT_LESS_OR_EQUAL(HYPHA_IP_IGMP_REPORTS_PER_RUN, igmp_sent.count - sent);
+        sent = igmp_sent.count;
+        runs++;
+    }
+    size_t const expected_runs =
+        (HYPHA_IP_IGMP_GROUP_TABLE_SIZE + HYPHA_IP_IGMP_REPORTS_PER_RUN - 1U) / HYPHA_IP_IGMP_REPORTS_PER_RUN;
+    TEST_ASSERT_EQUAL(expected_runs, runs);
+    free(frame);
+
+    // leaving sends a Leave for the group to all routers, a group which was never joined can not be left
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReleaseUdpReceive(context, group, 9382));
+    TEST_ASSERT_EQUAL(HyphaIpIgmpTypeLeave, igmp_sent.type);
+    TEST_ASSERT_EQUAL_MEMORY(&group, &igmp_sent.group, sizeof(group));
+    TEST_ASSERT_EQUAL_MEMORY(&hypha_ip_igmpv2, &igmp_sent.destination, sizeof(hypha_ip_igmpv2));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpReleaseUdpReceive(context, group, 9382));
+    TEST_ASSERT_EQUAL(HYPHA_IP_IGMP_GROUP_TABLE_SIZE - 1U, context->igmp.count);
+}
+
+HyphaIpStatus_e transmit_refused(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    TEST_ASSERT_NOT_NULL(frame);
+    return HyphaIpStatusFailure;
+}
+
+void hyphaip_test_IgmpFilter(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t igmp_externals = externals;
+    igmp_externals.transmit = transmit_igmp;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &igmp_externals));
+    memset(&igmp_sent, 0, sizeof(igmp_sent));
+    context->features.allow_any_multicast = false;
+    context->features.allow_ip_filtering = false;  // the querier is not one of the allowed sources
+    bool filtering = HyphaIpGetCompiledEthernetFiltering();
+    // 224.1.1.1 and 239.1.1.1 are sent to the same Ethernet Address
+    HyphaIpIPv4Address_t group = {224, 1, 1, 1};
+    HyphaIpIPv4Address_t alias = {239, 1, 1, 1};
+    HyphaIpEthernetAddress_t mac;
+    HyphaIpEthernetAddress_t all_hosts;
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&mac, group));
+    TEST_ASSERT_TRUE(HyphaIpConvertMulticast(&all_hosts, hypha_ip_igmpv1));
+    TEST_ASSERT_EQUAL(!filtering, HyphaIpIsPermittedEthernetAddress(context, all_hosts));
+
+    // the General Queries get through while any group is joined
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpJoinGroup(context, group));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpJoinGroup(context, alias));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, mac));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, all_hosts));
+    context->features.allow_any_multicast = true;  // the IPv4 destination check does not look at the groups
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    make_igmp_frame(frame, hypha_ip_igmpv1, HyphaIpIgmpTypeQuery, 10U, hypha_ip_default_route);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 1000));
+    TEST_ASSERT_EQUAL(2U, context->igmp.delaying);
+
+    // only the Router Alert option is let in with IGMP
+    make_igmp_frame(frame, hypha_ip_igmpv1, HyphaIpIgmpTypeQuery, 10U, hypha_ip_default_route);
+    frame->payload[sizeof(HyphaIpIPv4Header_t)] = 0x83U;  // Loose Source Route
+    HyphaIpSpan_t empty = HYPHA_IP_DEFAULT_SPAN;
+    HyphaIpSpan_t ip_span = {.pointer = frame->payload, .count = 24U, .type = HyphaIpSpanTypeUint8_t};
+    memset(&frame->payload[10], 0, sizeof(uint16_t));
+    uint16_t checksum = (uint16_t)~HyphaIpComputeChecksum(ip_span, empty);
+    memcpy(&frame->payload[10], &checksum, sizeof(checksum));
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4HeaderRejected, HyphaIpEthernetReceiveFrame(context, frame, 1000));
+    free(frame);
+    context->features.allow_any_multicast = false;
+
+    // leaving the group which let the Ethernet Address through keeps it for the other one still sent to it
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpLeaveGroup(context, group));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, mac));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, all_hosts));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpLeaveGroup(context, alias));
+    TEST_ASSERT_EQUAL(!filtering, HyphaIpIsPermittedEthernetAddress(context, mac));
+    TEST_ASSERT_EQUAL(!filtering, HyphaIpIsPermittedEthernetAddress(context, all_hosts));
+
+    // the addresses the application let through itself stay after the groups are left
+    HyphaIpEthernetAddress_t populated[] = {all_hosts, mac};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateEthernetFilter(context, HYPHA_IP_DIMOF(populated), populated));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpJoinGroup(context, group));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpLeaveGroup(context, group));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, mac));
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, all_hosts));
+    TEST_ASSERT_EQUAL(0U, context->igmp.count);
+
+    // a lost report still joins the group, the next query asks for it again
+    context->external.transmit = transmit_refused;
+    context->external.report = nullptr;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpJoinGroup(context, group));
+    context->external.report = report;
+    TEST_ASSERT_EQUAL(1U, context->igmp.count);
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedEthernetAddress(context, mac));
+}
+
+void hyphaip_test_TimerWheel(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &externals));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpTimestamp_t deadline = 0;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpNextDeadline(nullptr, &deadline));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpNextDeadline(context, nullptr));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpTick(nullptr, 0));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+    TEST_ASSERT_EQUAL(HYPHA_IP_NO_DEADLINE, deadline);
+
+    // entries in every level of the wheel and beyond it
+    HyphaIpTimestamp_t now = mine.timestamp;
+    HyphaIpTimestamp_t const lifetimes[] = {50, 5'000, 300'000, 20'000'000, HYPHA_IP_EXPIRATION_TIME};
+    HyphaIpTablesLock(context);
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(lifetimes); i++) {
+        HyphaIpAddressMatch_t match = {{{0x02, 0x00, 0x00}, {0x00, 0x00, (uint8_t)i}}, {172, 16, 1, (uint8_t)i}};
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpArpCacheInsert(context, &match, now + lifetimes[i]));
+    }
+    // as another thread's populate would, the owner starts the timers
+    HyphaIpTablesDraft(context, HyphaIpTableNone)->populated++;
+    HyphaIpTablesUnlock(context);
+    // nothing fires early, each fires once its deadline has passed and the next deadline is when its tick begins
+    for (size_t i = 0U; i < HYPHA_IP_DIMOF(lifetimes); i++) {
+        HyphaIpTimestamp_t const resolution = HYPHA_IP_TIMER_RESOLUTION;
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+        TEST_ASSERT_EQUAL((now + lifetimes[i] + resolution - 1) / resolution * resolution, deadline);
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, deadline - 1));
+        TEST_ASSERT_EQUAL(HYPHA_IP_DIMOF(lifetimes) - i, current_tables(context)->arp_cache.count);
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, deadline));
+        TEST_ASSERT_EQUAL(HYPHA_IP_DIMOF(lifetimes) - i - 1U, current_tables(context)->arp_cache.count);
+        TEST_ASSERT_EQUAL(i + 1U, statistics->expirations.arp);
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+    TEST_ASSERT_EQUAL(HYPHA_IP_NO_DEADLINE, deadline);
+
+    // refreshing an entry moves its timer without publishing another version of the tables
+    now = deadline = now + HYPHA_IP_EXPIRATION_TIME;
+    HyphaIpAddressMatch_t match = {{{0x02, 0x00, 0x00}, {0x00, 0x00, 0x01}}, {172, 16, 1, 1}};
+    uint32_t key = HyphaIpIPv4AddressToValue(match.ipv4);
+    HyphaIpTablesLock(context);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpArpCacheInsert(context, &match, now + 100));
+    HyphaIpTablesUnlock(context);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry, key, now + 100));
+    HyphaIpTables_t const *before = current_tables(context);
+    size_t generation = before->generation;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry, key, now + 200));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTimerAge(context, HyphaIpTimerKindArpEntry, key, now + 150));
+    TEST_ASSERT_EQUAL(before, current_tables(context));
+    TEST_ASSERT_EQUAL(generation, current_tables(context)->generation);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, now + 150));
+    TEST_ASSERT_EQUAL(1U, current_tables(context)->arp_cache.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, now + 200));
+    TEST_ASSERT_EQUAL(0U, current_tables(context)->arp_cache.count);
+
+    // the filters age the same way, merged ranges last as long as the longest lived part
+    HyphaIpEthernetAddress_t macs[] = {{{0x02, 0x00, 0x00}, {0x00, 0x00, 0x07}}};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateEthernetFilter(context, HYPHA_IP_DIMOF(macs), macs));
+    HyphaIpIPv4Address_t hosts[] = {{172, 16, 0, 11}, {172, 16, 0, 12}};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Filter(context, HYPHA_IP_DIMOF(hosts), hosts));
+    TEST_ASSERT_EQUAL(1U, current_tables(context)->allowed_ipv4_addresses.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, mine.timestamp + HYPHA_IP_EXPIRATION_TIME));
+    TEST_ASSERT_EQUAL(0U, current_tables(context)->allowed_ipv4_addresses.count);
+    TEST_ASSERT_FALSE(current_tables(context)->allowed_ethernet_addresses[0].valid);
+    TEST_ASSERT_EQUAL(1U, statistics->expirations.ipv4);
+    TEST_ASSERT_EQUAL(1U, statistics->expirations.ethernet);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+    TEST_ASSERT_EQUAL(HYPHA_IP_NO_DEADLINE, deadline);
+    // once the last range is gone the sources are no longer filtered, rather than all turned away
+    TEST_ASSERT_FALSE(context->features.allow_ip_filtering);
+    TEST_ASSERT_TRUE(HyphaIpIsPermittedIPv4Address(context, hosts[0]));
+
+    // a range merged away by a later populate gives its timer back once the owner catches up
+    HyphaIpIPv4Address_t apart[] = {{172, 16, 0, 21}, {172, 16, 0, 23}};
+    HyphaIpIPv4Address_t between = {172, 16, 0, 22};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Filter(context, HYPHA_IP_DIMOF(apart), apart));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+    TEST_ASSERT_EQUAL(2U, aging_timers(context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Filter(context, 1U, &between));
+    TEST_ASSERT_EQUAL(1U, current_tables(context)->allowed_ipv4_addresses.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpNextDeadline(context, &deadline));
+    TEST_ASSERT_EQUAL(1U, aging_timers(context));
+}
+
+/// What the stack has sent over ARP
+struct {
+    size_t count;                         ///< The number of ARP packets
+    HyphaIpEthernetFrame_t const *frame;  ///< The frame of the last one
+    HyphaIpEthernetHeader_t header;       ///< The Ethernet header of the last one
+    HyphaIpArpPacket_t packet;            ///< The last one
+    HyphaIpStatus_e reported;             ///< The last failure which was reported
+    uint32_t flags;                       ///< The frame flags of the last one
+} arp_sent;
+
+void report_arp(HyphaIpExternalContext_t theirs, HyphaIpStatus_e status, const char *const func, const char *const file,
+                unsigned int line) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    (void)func;
+    (void)file;
+    (void)line;
+    if (status != HyphaIpStatusOk) {
+        arp_sent.reported = status;
+    }
+}
+
+HyphaIpStatus_e transmit_arp(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    arp_sent.count++;
+    arp_sent.frame = frame;
+    arp_sent.flags = frame->info.flags;
+    HyphaIpCopyEthernetHeaderFromFrame(&arp_sent.header, frame);
+    HyphaIpCopyArpPacketFromFrame(&arp_sent.packet, frame);
+    return HyphaIpStatusOk;
+}
+
+/// Fills in a frame with an ARP packet from another host
+void make_arp_frame(HyphaIpContext_t stack, HyphaIpEthernetFrame_t *frame, HyphaIpEthernetAddress_t destination,
+                    HyphaIpArpPacket_t const *packet) {
+    HyphaIpEthernetHeader_t header = HyphaIpEthernetBaseHeader(stack, 0U, HyphaIpEtherType_ARP);
+    header.destination = destination;
+    header.source = packet->sender_hardware;
+    HyphaIpCopyEthernetHeaderToFrame(frame, &header);
+    HyphaIpCopyArpPacketToFrame(frame, packet);
+    frame->info.flags = HyphaIpFrameFlagNone;
+    frame->info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + sizeof(HyphaIpArpPacket_t));
+}
+
+void hyphaip_test_ArpReplies(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t arp_externals = externals;
+    arp_externals.transmit = transmit_arp;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &arp_externals));
+    memset(&arp_sent, 0, sizeof(arp_sent));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpEthernetAddress_t peer_mac = {{0x02, 0x00, 0x00}, {0x00, 0x00, 0x50}};
+    HyphaIpIPv4Address_t peer = {172, 16, 0, 50};
+    HyphaIpArpPacket_t request = {
+        .hardware_type = HyphaIpArpHardwareTypeEthernet,
+        .protocol_type = HyphaIpArpProtocolTypeIPv4,
+        .hardware_length = sizeof(HyphaIpEthernetAddress_t),
+        .protocol_length = sizeof(HyphaIpIPv4Address_t),
+        .operation = HyphaIpArpOperationRequest,
+        .sender_hardware = peer_mac,
+        .sender_protocol = peer,
+        .target_hardware = hypha_ip_ethernet_local,
+        .target_protocol = interface.address,
+    };
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    size_t const acquires = statistics->frames.acquires;
+
+    // a broadcast request for our address is answered from the same frame and teaches us the sender, the flags the
+    // driver received it with are not sent back
+    make_arp_frame(context, frame, hypha_ip_ethernet_broadcast, &request);
+    frame->info.flags = HyphaIpFrameFlagIPv4ChecksumVerified;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    TEST_ASSERT_EQUAL_PTR(frame, arp_sent.frame);
+    TEST_ASSERT_EQUAL(HyphaIpFrameFlagNone, arp_sent.flags);
+    TEST_ASSERT_EQUAL(acquires, statistics->frames.acquires);
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &arp_sent.header.destination, sizeof(peer_mac));
+    TEST_ASSERT_EQUAL_MEMORY(&interface.mac, &arp_sent.header.source, sizeof(interface.mac));
+    TEST_ASSERT_EQUAL(HyphaIpEtherType_ARP, arp_sent.header.type);
+    TEST_ASSERT_EQUAL(HyphaIpArpOperationReply, arp_sent.packet.operation);
+    TEST_ASSERT_EQUAL_MEMORY(&interface.mac, &arp_sent.packet.sender_hardware, sizeof(interface.mac));
+    TEST_ASSERT_EQUAL_MEMORY(&interface.address, &arp_sent.packet.sender_protocol, sizeof(interface.address));
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &arp_sent.packet.target_hardware, sizeof(peer_mac));
+    TEST_ASSERT_EQUAL_MEMORY(&peer, &arp_sent.packet.target_protocol, sizeof(peer));
+    HyphaIpEthernetAddress_t found = HyphaIpFindEthernetAddress(context, &peer);
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &found, sizeof(found));
+    TEST_ASSERT_EQUAL(1U, statistics->arp.requests);
+    TEST_ASSERT_EQUAL(1U, statistics->arp.replies);
+
+    // a request for another host is not answered and a stranger is not learned from it
+    HyphaIpArpPacket_t other = request;
+    other.sender_hardware.uid[2] = 0x51U;
+    other.sender_protocol.d = 51U;
+    other.target_protocol.d = 52U;
+    make_arp_frame(context, frame, hypha_ip_ethernet_broadcast, &other);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 2));
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    TEST_ASSERT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(context)->arp_cache, other.sender_protocol));
+
+    // but a host we know is refreshed from anything it sends, here a new card
+    other.sender_hardware.uid[2] = 0x60U;
+    other.sender_protocol = peer;
+    make_arp_frame(context, frame, hypha_ip_ethernet_broadcast, &other);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 3));
+    found = HyphaIpFindEthernetAddress(context, &peer);
+    TEST_ASSERT_EQUAL_MEMORY(&other.sender_hardware, &found, sizeof(found));
+
+    // a reply sent to us is learned and not answered
+    HyphaIpArpPacket_t reply = request;
+    reply.operation = HyphaIpArpOperationReply;
+    reply.sender_hardware.uid[2] = 0x70U;
+    reply.sender_protocol.d = 70U;
+    reply.target_hardware = interface.mac;
+    make_arp_frame(context, frame, interface.mac, &reply);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, 4));
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    TEST_ASSERT_NOT_NULL(HyphaIpArpCacheFindByIPv4(&current_tables(context)->arp_cache, reply.sender_protocol));
+    TEST_ASSERT_EQUAL(3U, statistics->arp.learned);
+
+    // only Ethernet and IPv4 addresses are understood
+    HyphaIpArpPacket_t odd = request;
+    odd.protocol_length = 16U;
+    make_arp_frame(context, frame, hypha_ip_ethernet_broadcast, &odd);
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpPacketRejected, HyphaIpEthernetReceiveFrame(context, frame, 5));
+    TEST_ASSERT_EQUAL(1U, statistics->arp.rejected);
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    free(frame);
+
+    // the announcement is a broadcast request for our own address
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpArpAnnouncement(context));
+    TEST_ASSERT_EQUAL(2U, arp_sent.count);
+    TEST_ASSERT_EQUAL_MEMORY(&hypha_ip_ethernet_broadcast, &arp_sent.header.destination, sizeof(found));
+    TEST_ASSERT_EQUAL(HyphaIpArpOperationRequest, arp_sent.packet.operation);
+    TEST_ASSERT_EQUAL_MEMORY(&interface.address, &arp_sent.packet.target_protocol, sizeof(interface.address));
+}
+
+void hyphaip_test_ArpPending(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t arp_externals = externals;
+    arp_externals.transmit = transmit_arp;
+    arp_externals.report = report_arp;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &arp_externals));
+    memset(&arp_sent, 0, sizeof(arp_sent));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpEthernetAddress_t peer_mac = {{0x02, 0x00, 0x00}, {0x00, 0x00, 0x60}};
+    HyphaIpIPv4Address_t peer = {172, 16, 0, 60};
+    uint8_t payload[16] = {0x1, 0x2, 0x3, 0x4};
+    HyphaIpSpan_t datagram = {.pointer = payload, .count = sizeof(payload), .type = HyphaIpSpanTypeUint8_t};
+    HyphaIpMetaData_t metadata = {.source_address = hypha_ip_localhost,  // ignored
+                                  .source_port = 1025,
+                                  .destination_address = peer,
+                                  .destination_port = 9382,
+                                  .timestamp = 0};
+
+    // both transmits wait on the one request
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    TEST_ASSERT_EQUAL_MEMORY(&hypha_ip_ethernet_broadcast, &arp_sent.header.destination, sizeof(peer_mac));
+    TEST_ASSERT_EQUAL(HyphaIpEtherType_ARP, arp_sent.header.type);
+    TEST_ASSERT_EQUAL(HyphaIpArpOperationRequest, arp_sent.packet.operation);
+    TEST_ASSERT_EQUAL_MEMORY(&peer, &arp_sent.packet.target_protocol, sizeof(peer));
+    TEST_ASSERT_EQUAL(1U, statistics->arp.resolves);
+    TEST_ASSERT_EQUAL(2U, statistics->arp.queued);
+
+    // the reply sends them both, to the address it gave
+    HyphaIpArpPacket_t reply = {
+        .hardware_type = HyphaIpArpHardwareTypeEthernet,
+        .protocol_type = HyphaIpArpProtocolTypeIPv4,
+        .hardware_length = sizeof(HyphaIpEthernetAddress_t),
+        .protocol_length = sizeof(HyphaIpIPv4Address_t),
+        .operation = HyphaIpArpOperationReply,
+        .sender_hardware = peer_mac,
+        .sender_protocol = peer,
+        .target_hardware = interface.mac,
+        .target_protocol = interface.address,
+    };
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    make_arp_frame(context, frame, interface.mac, &reply);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, mine.timestamp));
+    free(frame);
+    TEST_ASSERT_EQUAL(3U, arp_sent.count);
+    TEST_ASSERT_EQUAL(2U, statistics->arp.flushed);
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &arp_sent.header.destination, sizeof(peer_mac));
+    TEST_ASSERT_EQUAL(HyphaIpEtherType_IPv4, arp_sent.header.type);
+
+    // now that it is known, nothing waits
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(4U, arp_sent.count);
+    TEST_ASSERT_EQUAL(2U, statistics->arp.queued);
+
+    // hearing from it again with the same address only moves its timer, the tables are not copied
+    HyphaIpTables_t const *before = current_tables(context);
+    size_t const generation = before->generation;
+    frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    make_arp_frame(context, frame, interface.mac, &reply);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, mine.timestamp));
+    free(frame);
+    TEST_ASSERT_EQUAL(before, current_tables(context));
+    TEST_ASSERT_EQUAL(generation, current_tables(context)->generation);
+
+    // learning another address copies the ARP cache the last learn left behind in the spare version, nothing else
+    HyphaIpAddressMatch_t other = {.ipv4 = peer, .mac = peer_mac};
+    other.ipv4.d = 70U;
+    other.mac.uid[2] = 0x70U;
+    size_t const copied = context->tables.copied;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(context, 1U, &other));
+    TEST_ASSERT_EQUAL(sizeof(HyphaIpArpCache_t), context->tables.copied - copied);
+    TEST_ASSERT_LESS_THAN(sizeof(HyphaIpTables_t), context->tables.copied - copied);
+
+    // a destination which never answers holds a few frames, then drops them when the request times out
+    metadata.destination_address.d = 61U;
+    for (size_t i = 0U; i < HYPHA_IP_ARP_PENDING_FRAMES; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, arp_sent.reported);
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpQueueFull, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpQueueFull, arp_sent.reported);
+    TEST_ASSERT_EQUAL(1U, statistics->arp.overflows);
+    TEST_ASSERT_EQUAL(2U, statistics->arp.resolves);
+    TEST_ASSERT_EQUAL(5U, arp_sent.count);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, mine.timestamp + HYPHA_IP_ARP_REQUEST_TIMEOUT));
+    TEST_ASSERT_EQUAL(HYPHA_IP_ARP_PENDING_FRAMES, statistics->arp.timeouts);
+    TEST_ASSERT_EQUAL(5U, arp_sent.count);
+
+    // which leaves room to ask again
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(3U, statistics->arp.resolves);
+    TEST_ASSERT_EQUAL(6U, arp_sent.count);
+
+    // hosts beyond the gateway wait on the address of the gateway instead
+    metadata.destination_address = (HyphaIpIPv4Address_t){10, 0, 0, 1};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(4U, statistics->arp.resolves);
+    TEST_ASSERT_EQUAL_MEMORY(&interface.gateway, &arp_sent.packet.target_protocol, sizeof(interface.gateway));
+
+    // a datagram whose fragments do not all fit does not wait in part, nor does its request
+    static uint8_t large[3U * HYPHA_IP_MAX_UDP_PAYLOAD_SIZE];
+    HyphaIpSpan_t fragmented = {.pointer = large, .count = sizeof(large), .type = HyphaIpSpanTypeUint8_t};
+    HyphaIpArpPending_t const *pending = &context->arp_pending;
+    size_t const frames = pending->frames;
+    size_t const used = pending->used;
+    size_t const overflows = statistics->arp.overflows;
+    metadata.destination_address = (HyphaIpIPv4Address_t){172, 16, 0, 62};
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpQueueFull, HyphaIpTransmitUdpDatagram(context, &metadata, fragmented));
+    TEST_ASSERT_EQUAL(frames, pending->frames);
+    TEST_ASSERT_EQUAL(used, pending->used);
+    TEST_ASSERT_EQUAL(2U, pending->destinations);
+    TEST_ASSERT_GREATER_THAN(overflows + 1U, statistics->arp.overflows);
+
+    // the reply sends the waiting frames even when the cache has no room to learn it
+    for (uint8_t i = 0U; current_tables(context)->arp_cache.count < HYPHA_IP_ARP_TABLE_SIZE; i++) {
+        HyphaIpAddressMatch_t filler = {{{0x02, 0x00, 0x01}, {0x00, 0x00, i}}, {172, 16, 1, i}};
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateArpTable(context, 1U, &filler));
+    }
+    reply.sender_protocol = metadata.destination_address;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    size_t const flushed = statistics->arp.flushed;
+    frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    make_arp_frame(context, frame, interface.mac, &reply);
+    TEST_ASSERT_EQUAL(HyphaIpStatusArpTableFull, HyphaIpEthernetReceiveFrame(context, frame, mine.timestamp));
+    free(frame);
+    TEST_ASSERT_EQUAL(flushed + 1U, statistics->arp.flushed);
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &arp_sent.header.destination, sizeof(peer_mac));
+
+    // nor when another thread is writing the tables, neither the transmit nor the reply waits on it
+    metadata.destination_address = (HyphaIpIPv4Address_t){172, 16, 0, 63};
+    reply.sender_protocol = metadata.destination_address;
+    HyphaIpTablesLock(context);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    make_arp_frame(context, frame, interface.mac, &reply);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEthernetReceiveFrame(context, frame, mine.timestamp));
+    free(frame);
+    HyphaIpTablesUnlock(context);
+    TEST_ASSERT_EQUAL(flushed + 2U, statistics->arp.flushed);
+    TEST_ASSERT_EQUAL_MEMORY(&peer_mac, &arp_sent.header.destination, sizeof(peer_mac));
+}
+
+void hyphaip_test_Routing(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t arp_externals = externals;
+    arp_externals.transmit = transmit_arp;
+    arp_externals.report = report_arp;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &arp_externals));
+    memset(&arp_sent, 0, sizeof(arp_sent));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpNetworkInterface_t second = {
+        .mac = {{0x02, 0x00, 0x00}, {0x00, 0x01, 0x07}},
+        .address = {192, 168, 1, 7},
+        .netmask = {255, 255, 255, 0},
+        .gateway = {192, 168, 1, 1},
+    };
+    uint8_t index = 0U;
+
+    // the second interface is checked like the first
+    HyphaIpNetworkInterface_t bad = second;
+    bad.mac = hypha_ip_ethernet_broadcast;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpAddInterface(nullptr, &second, &index));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpAddInterface(context, nullptr, &index));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidMacAddress, HyphaIpAddInterface(context, &bad, &index));
+    bad = second;
+    bad.netmask = (HyphaIpIPv4Address_t){255, 0, 255, 0};  // the prefix length would be a guess
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidNetwork, HyphaIpAddInterface(context, &bad, &index));
+
+    // a network is only reached through one interface
+    bad = second;
+    bad.address = (HyphaIpIPv4Address_t){172, 16, 0, 7};
+    bad.gateway = interface.gateway;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidNetwork, HyphaIpAddInterface(context, &bad, &index));
+    bad.netmask = (HyphaIpIPv4Address_t){255, 255, 0, 0};  // nor through one which holds it
+    bad.gateway = (HyphaIpIPv4Address_t){172, 16, 1, 1};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidNetwork, HyphaIpAddInterface(context, &bad, &index));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAddInterface(context, &second, &index));
+    TEST_ASSERT_EQUAL(1U, index);
+    TEST_ASSERT_EQUAL(HyphaIpStatusInterfaceTableFull, HyphaIpAddInterface(context, &second, &index));
+
+    // a gateway has to be on the link of its interface
+    HyphaIpIPv4Prefix_t wide = {.address = {10, 0, 0, 0}, .length = 8U};
+    HyphaIpIPv4Prefix_t narrow = {.address = {10, 1, 0, 0}, .length = 16U};
+    HyphaIpIPv4Address_t far_gateway = {192, 168, 1, 1};
+    HyphaIpIPv4Address_t near_gateway = {172, 16, 0, 2};
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpAddRoute(context, wide, far_gateway, 2U));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidNetwork, HyphaIpAddRoute(context, wide, far_gateway, 0U));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAddRoute(context, wide, far_gateway, 1U));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAddRoute(context, narrow, near_gateway, 0U));
+
+    uint8_t payload[16] = {0x1, 0x2, 0x3, 0x4};
+    HyphaIpSpan_t datagram = {.pointer = payload, .count = sizeof(payload), .type = HyphaIpSpanTypeUint8_t};
+    HyphaIpMetaData_t metadata = {.source_port = 1025, .destination_address = {10, 2, 3, 4}, .destination_port = 9382};
+
+    // the /8 sends it out of the second interface, which asks for its gateway from its own addresses
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(1U, metadata.interface);
+    TEST_ASSERT_EQUAL_MEMORY(&second.address, &metadata.source_address, sizeof(second.address));
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+    TEST_ASSERT_EQUAL_MEMORY(&far_gateway, &arp_sent.packet.target_protocol, sizeof(far_gateway));
+    TEST_ASSERT_EQUAL_MEMORY(&second.mac, &arp_sent.header.source, sizeof(second.mac));
+    TEST_ASSERT_EQUAL_MEMORY(&second.address, &arp_sent.packet.sender_protocol, sizeof(second.address));
+    TEST_ASSERT_EQUAL(1U, statistics->interfaces[1].frames.tx.count);
+    TEST_ASSERT_EQUAL(0U, statistics->interfaces[0].frames.tx.count);
+
+    // the same destination is answered by the cache
+    size_t hits = statistics->routes.hits;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_GREATER_THAN(hits, statistics->routes.hits);
+    TEST_ASSERT_EQUAL(1U, arp_sent.count);
+
+    // the longer /16 wins over the /8
+    metadata.destination_address = (HyphaIpIPv4Address_t){10, 1, 2, 3};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(0U, metadata.interface);
+    TEST_ASSERT_EQUAL_MEMORY(&near_gateway, &arp_sent.packet.target_protocol, sizeof(near_gateway));
+    TEST_ASSERT_EQUAL_MEMORY(&interface.mac, &arp_sent.header.source, sizeof(interface.mac));
+
+    // everything else goes through the gateway of the first interface
+    metadata.destination_address = (HyphaIpIPv4Address_t){8, 8, 8, 8};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL(0U, metadata.interface);
+    TEST_ASSERT_EQUAL_MEMORY(&interface.gateway, &arp_sent.packet.target_protocol, sizeof(interface.gateway));
+    TEST_ASSERT_EQUAL(2U, statistics->interfaces[0].frames.tx.count);
+    TEST_ASSERT_EQUAL(0U, statistics->routes.unreachable);
+
+    // a multicast leaves on the interface it is given, which has to be one of ours
+    metadata.destination_address = (HyphaIpIPv4Address_t){239, 0, 0, 155};
+    metadata.interface = 2U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    metadata.interface = 1U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpDatagram(context, &metadata, datagram));
+    TEST_ASSERT_EQUAL_MEMORY(&second.mac, &arp_sent.header.source, sizeof(second.mac));
+    TEST_ASSERT_EQUAL(2U, statistics->interfaces[1].frames.tx.count);
+
+    // a source which does not route back out of the interface it came in on is turned away
+    HyphaIpEthernetFrame_t *frame = acquire(&mine);
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, receive(&mine, frame));
+    frame->info.interface = 1U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusIPv4SourceRejected, HyphaIpEthernetReceiveFrame(context, frame, 1));
+    TEST_ASSERT_EQUAL(1U, statistics->interfaces[1].rejected);
+    TEST_ASSERT_EQUAL(1U, statistics->interfaces[1].frames.rx.count);
+    frame->info.interface = 2U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpEthernetReceiveFrame(context, frame, 2));
+    free(frame);
+
+    // a first interface without a gateway only reaches its own network
+    HyphaIpNetworkInterface_t isolated = interface;
+    isolated.gateway = hypha_ip_default_route;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &isolated, &mine,
+                                        &arp_externals));
+    TEST_ASSERT_EQUAL(1U, current_tables(context)->routes.count);
+    HyphaIpNextHop_t hop;
+    TEST_ASSERT_EQUAL(HyphaIpStatusNoRoute, HyphaIpRouteLookup(context, (HyphaIpIPv4Address_t){8, 8, 8, 8}, &hop));
+    HyphaIpIPv4Address_t neighbour = {172, 16, 0, 99};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, neighbour, &hop));
+    TEST_ASSERT_EQUAL_MEMORY(&neighbour, &hop.next_hop, sizeof(neighbour));
+}
+
+void hyphaip_test_TransmitRing(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpMetaData_t metadata = {
+        .source_port = 1025, .destination_address = {239, 0, 0, 155}, .destination_port = 9382};
+    HyphaIpUdpFlow_t flow;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpTransmit(context, &metadata, &flow));
+    HyphaIpSpan_t datagram = {.pointer = (void *)&test_frame[HYPHA_IP_UDP_PAYLOAD_OFFSET],
+                              .count = (uint32_t)(sizeof(test_frame) - HYPHA_IP_UDP_PAYLOAD_OFFSET),
+                              .type = HyphaIpSpanTypeUint8_t};
+    HyphaIpTransmitReservation_t first;
+    HyphaIpTransmitReservation_t second;
+    size_t drained = 0U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusBusy, HyphaIpReserveTransmit(context, &first));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+    TEST_ASSERT_EQUAL(0U, drained);
+
+    // restart the stack with a driver which supports the batch interfaces
+    HyphaIpExternalInterface_t batched = externals;
+    batched.transmit_batch = transmit_batch;
+    batched.release_batch = release_batch;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &batched));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPrepareUdpTransmit(context, &metadata, &flow));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpStartTransmitRing(context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusBusy, HyphaIpStartTransmitRing(context));
+
+    // a queued datagram is the same frame the flow transmits directly
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTransmitUdpFlow(context, &flow, datagram));
+    static HyphaIpEthernetFrame_t direct;
+    memcpy(&direct, &transmitted_frame, sizeof(direct));
+    for (size_t i = 0U; i < 3U; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEnqueueUdpFlow(context, &flow, datagram));
+    }
+    memset(&batch_calls, 0, sizeof(batch_calls));
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    size_t const releases = statistics->frames.releases;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+    TEST_ASSERT_EQUAL(3U, drained);
+    TEST_ASSERT_EQUAL(1U, batch_calls.transmits);
+    TEST_ASSERT_EQUAL(3U, batch_calls.transmitted);
+    TEST_ASSERT_EQUAL_MEMORY(&direct.header, &transmitted_frame.header, direct.info.length);
+    // the sent frames went back to the driver with the burst and the slots were given fresh ones
+    TEST_ASSERT_EQUAL(1U, batch_calls.releases);
+    TEST_ASSERT_EQUAL(releases + 3U, statistics->frames.releases);
+    TEST_ASSERT_EQUAL(statistics->frames.releases + HYPHA_IP_TRANSMIT_RING_SIZE, statistics->frames.acquires);
+
+    // a full ring refuses more until the owner drains, a batch at a time
+    for (size_t i = 0U; i < HYPHA_IP_TRANSMIT_RING_SIZE; i++) {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpEnqueueTransmit(context, &direct));
+    }
+    TEST_ASSERT_EQUAL(HyphaIpStatusTransmitRingFull, HyphaIpEnqueueTransmit(context, &direct));
+    size_t total = 0U;
+    do {
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+        TEST_ASSERT_LESS_OR_EQUAL(HYPHA_IP_BATCH_SIZE, drained);
+        total += drained;
+    } while (drained > 0U);
+    TEST_ASSERT_EQUAL(HYPHA_IP_TRANSMIT_RING_SIZE, total);
+    TEST_ASSERT_EQUAL(1U, HyphaIpGetStatistics(context)->ring.overflows);
+
+    // the owner waits at the first frame still being built, a frame with no length is skipped
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReserveTransmit(context, &first));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpReserveTransmit(context, &second));
+    (void)HyphaIpUdpFlowBuild(context, &flow, second.frame, datagram);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpCommitTransmit(context, &second));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+    TEST_ASSERT_EQUAL(0U, drained);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpCommitTransmit(context, &first));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+    TEST_ASSERT_EQUAL(2U, drained);
+    TEST_ASSERT_EQUAL(1U, HyphaIpGetStatistics(context)->ring.cancelled);
+    TEST_ASSERT_EQUAL(3U + HYPHA_IP_TRANSMIT_RING_SIZE + 1U, HyphaIpGetStatistics(context)->ring.drained);
+
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidArgument, HyphaIpCommitTransmit(context, nullptr));
+    direct.info.length = 0U;
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidFrameLength, HyphaIpEnqueueTransmit(context, &direct));
+    TEST_ASSERT_EQUAL(HyphaIpStatusInvalidContext, HyphaIpEnqueueUdpFlow(nullptr, &flow, datagram));
+
+    // stopping gives every frame of the ring back
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpStopTransmitRing(context));
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+    TEST_ASSERT_EQUAL(HyphaIpStatusBusy, HyphaIpReserveTransmit(context, &first));
+}
+
+/// The frames each producer of the transmit ring test queues
+#define RING_PRODUCED 2000U
+
+/// What the owner has drained of each producer
+struct {
+    uint32_t next[2];  ///< The sequence number each producer's next frame must have
+    size_t count;      ///< The frames transmitted
+    size_t misorders;  ///< The frames which were lost, repeated or out of order
+} ring_received;
+
+HyphaIpStatus_e transmit_produced(HyphaIpExternalContext_t theirs, HyphaIpEthernetFrame_t *frame) {
+    TEST_ASSERT_NOT_NULL(theirs);
+    uint8_t producer = frame->payload[0];
+    uint32_t sequence;
+    memcpy(&sequence, &frame->payload[1], sizeof(sequence));
+    if (producer >= HYPHA_IP_DIMOF(ring_received.next) || sequence != ring_received.next[producer]) {
+        ring_received.misorders++;
+    } else {
+        ring_received.next[producer]++;
+    }
+    ring_received.count++;
+    return HyphaIpStatusOk;
+}
+
+/// Queues numbered frames on the ring from another thread, trying again while it is full
+void *produce(void *argument) {
+    uint8_t producer = *(uint8_t const *)argument;
+    static _Thread_local HyphaIpEthernetFrame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.info.length = (uint16_t)(sizeof(HyphaIpEthernetHeader_t) + 1U + sizeof(uint32_t));
+    frame.payload[0] = producer;
+    for (uint32_t sequence = 0U; sequence < RING_PRODUCED; sequence++) {
+        memcpy(&frame.payload[1], &sequence, sizeof(sequence));
+        while (HyphaIpEnqueueTransmit(context, &frame) == HyphaIpStatusTransmitRingFull) {
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+void hyphaip_test_TransmitRingProducers(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpExternalInterface_t producing = externals;
+    producing.transmit = transmit_produced;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDeinitialize(&context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk,
+                      HyphaIpInitialize(&context, context_storage, sizeof(context_storage), &interface, &mine,
+                                        &producing));
+    memset(&ring_received, 0, sizeof(ring_received));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpStartTransmitRing(context));
+
+    // two threads claim positions against each other while this one, the owner, drains
+    uint8_t producers[] = {0U, 1U};
+    pthread_t threads[HYPHA_IP_DIMOF(producers)];
+    for (size_t p = 0U; p < HYPHA_IP_DIMOF(producers); p++) {
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[p], nullptr, produce, &producers[p]));
+    }
+    size_t const expected = HYPHA_IP_DIMOF(producers) * RING_PRODUCED;
+    while (ring_received.count < expected) {
+        size_t drained = 0U;
+        TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpDrainTransmitRing(context, &drained));
+    }
+    for (size_t p = 0U; p < HYPHA_IP_DIMOF(producers); p++) {
+        TEST_ASSERT_EQUAL(0, pthread_join(threads[p], nullptr));
+    }
+
+    // each frame came out once, in the order its producer queued it
+    TEST_ASSERT_EQUAL(0U, ring_received.misorders);
+    TEST_ASSERT_EQUAL(RING_PRODUCED, ring_received.next[0]);
+    TEST_ASSERT_EQUAL(RING_PRODUCED, ring_received.next[1]);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    TEST_ASSERT_EQUAL(expected, statistics->ring.drained);
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpStopTransmitRing(context));
+    TEST_ASSERT_EQUAL(statistics->frames.acquires, statistics->frames.releases);
+}
+
+void hyphaip_test_TableVersions(void) {
+    TEST_ASSERT_TRUE(use_good_setup);
+    HyphaIpStatistics_t const *statistics = HyphaIpGetStatistics(context);
+    HyphaIpIPv4Address_t destination = {10, 1, 2, 3};
+    HyphaIpNextHop_t hop;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, destination, &hop));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, destination, &hop));
+    size_t misses = statistics->routes.misses;
+
+    // a read which is running keeps the version it started with while a change is published next to it
+    HyphaIpTables_t const *reading = HyphaIpTablesReadBegin(context);
+    size_t generation = reading->generation;
+    size_t count = reading->routes.count;
+    HyphaIpIPv4Prefix_t network = {.address = {10, 0, 0, 0}, .length = 8U};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAddRoute(context, network, hypha_ip_default_route, 0U));
+    TEST_ASSERT_NOT_EQUAL(reading, current_tables(context));
+    TEST_ASSERT_EQUAL(count, reading->routes.count);
+    TEST_ASSERT_EQUAL(count + 1U, current_tables(context)->routes.count);
+    TEST_ASSERT_EQUAL(generation + 1U, current_tables(context)->generation);
+    HyphaIpTablesReadEnd(context);
+
+    // the next lookup sees the new version and does not trust what was cached from the old one
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, destination, &hop));
+    TEST_ASSERT_EQUAL(misses + 1U, statistics->routes.misses);
+    TEST_ASSERT_EQUAL_MEMORY(&destination, &hop.next_hop, sizeof(destination));
+
+    // once the read has ended the old version may be written over by the next change
+    network = (HyphaIpIPv4Prefix_t){.address = {10, 1, 0, 0}, .length = 16U};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpAddRoute(context, network, hypha_ip_default_route, 0U));
+    TEST_ASSERT_EQUAL(reading, current_tables(context));
+    TEST_ASSERT_EQUAL(count + 2U, current_tables(context)->routes.count);
+
+    // a writer which changes nothing publishes nothing
+    HyphaIpTables_t const *before = current_tables(context);
+    HyphaIpTablesLock(context);
+    HyphaIpTablesUnlock(context);
+    TEST_ASSERT_EQUAL(before, current_tables(context));
+    TEST_ASSERT_EQUAL(generation + 2U, current_tables(context)->generation);
+
+    // the owner does not wait on a writer, its timers run on a later tick
+    HyphaIpTablesLock(context);
+    TEST_ASSERT_FALSE(HyphaIpTablesTryLock(context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpTick(context, 1U));
+    HyphaIpTablesUnlock(context);
+    TEST_ASSERT_TRUE(HyphaIpTablesTryLock(context));
+    HyphaIpTablesUnlock(context);
+
+    // a version which did not change the routes leaves the route cache alone
+    HyphaIpIPv4Address_t host = {172, 16, 0, 99};
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, destination, &hop));
+    size_t const hits = statistics->routes.hits;
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpPopulateIPv4Filter(context, 1U, &host));
+    TEST_ASSERT_NOT_EQUAL(before, current_tables(context));
+    TEST_ASSERT_EQUAL(HyphaIpStatusOk, HyphaIpRouteLookup(context, destination, &hop));
+    TEST_ASSERT_EQUAL(hits + 1U, statistics->routes.hits);
+}
+
 void hyphaip_test_TransmitOneFrame(void) {
     TEST_ASSERT_TRUE(use_good_setup);
     HyphaIpMetaData_t metadata = {.source_address = hypha_ip_localhost,  // ignored
@@ -18,6 +18,8 @@ extern void hyphaip_test_NormalChecksum(void);
 extern void hyphaip_test_FlippedChecksum(void);
 extern void hyphaip_test_NormalChecksum2(void);
 extern void hyphaip_test_FlippedChecksum2(void);
+extern void hyphaip_test_ChecksumKernels(void);
+extern void hyphaip_test_ChecksumUpdate(void);
 extern void hyphaip_test_BadContext(void);
 extern void hyphaip_test_BadInterfacePointer(void);
 extern void hyphaip_test_BadInterfaceGateway(void);
@@ -28,18 +30,43 @@ extern void hyphaip_test_BadExternalPointer(void);
 extern void hyphaip_test_BadExternalFunctions(void);
 extern void hyphaip_test_BadDeinitialize(void);
 extern void hyphaip_test_GoodLifeCycle(void);
+extern void hyphaip_test_SeparateContexts(void);
 extern void hyphaip_test_Contextless(void);
 extern void hyphaip_test_Flip16(void);
 extern void hyphaip_test_Flip32(void);
 extern void hyphaip_test_Flip64(void);
 extern void hyphaip_test_PopulateArpTable(void);
+extern void hyphaip_test_ArpCacheIndex(void);
 extern void hyphaip_test_PopulateEthernetFilter(void);
+extern void hyphaip_test_MulticastFilter(void);
 extern void hyphaip_test_PopulateIpFilter(void);
+extern void hyphaip_test_PopulateIpPrefixes(void);
 extern void hyphaip_test_ConvertMulticast(void);
 extern void hyphaip_test_PrepareMulticast(void);
 extern void hyphaip_test_BadRunOnce(void);
 extern void hyphaip_test_CheckOffsets(void);
+extern void hyphaip_test_InPlaceAccessors(void);
+extern void hyphaip_test_SpecializedFlips(void);
 extern void hyphaip_test_ReceiveOneFrame(void);
+extern void hyphaip_test_ReceiveBatch(void);
+extern void hyphaip_test_DriverBatches(void);
+extern void hyphaip_test_UdpListeners(void);
+extern void hyphaip_test_ChecksumOffload(void);
+extern void hyphaip_test_TransmitUdpFlow(void);
+extern void hyphaip_test_TransmitGathered(void);
+extern void hyphaip_test_TransmitReserved(void);
+extern void hyphaip_test_TransmitFragmented(void);
+extern void hyphaip_test_ReceiveReassembled(void);
+extern void hyphaip_test_SizedFrames(void);
+extern void hyphaip_test_IgmpMembership(void);
+extern void hyphaip_test_IgmpFilter(void);
+extern void hyphaip_test_TimerWheel(void);
+extern void hyphaip_test_ArpReplies(void);
+extern void hyphaip_test_ArpPending(void);
+extern void hyphaip_test_Routing(void);
+extern void hyphaip_test_TransmitRing(void);
+extern void hyphaip_test_TransmitRingProducers(void);
+extern void hyphaip_test_TableVersions(void);
 extern void hyphaip_test_TransmitOneFrame(void);
 extern void hyphaip_test_TransmitReceiveLocalhost(void);
 extern void hyphaip_test_ReceiveOneLargeFrame(void);
@@ -53,6 +80,8 @@ int main(void) {
     RUN_TEST(hyphaip_test_NormalChecksum2);
     RUN_TEST(hyphaip_test_FlippedChecksum);
     RUN_TEST(hyphaip_test_FlippedChecksum2);
+    RUN_TEST(hyphaip_test_ChecksumKernels);
+    RUN_TEST(hyphaip_test_ChecksumUpdate);
     RUN_TEST(hyphaip_test_BadContext);
     RUN_TEST(hyphaip_test_BadInterfacePointer);
     RUN_TEST(hyphaip_test_BadInterfaceGateway);
@@ -63,6 +92,7 @@ int main(void) {
     RUN_TEST(hyphaip_test_BadExternalFunctions);
     RUN_TEST(hyphaip_test_BadDeinitialize);  // <-- this has to be called before doing "good" cycles
     RUN_TEST(hyphaip_test_GoodLifeCycle);
+    RUN_TEST(hyphaip_test_SeparateContexts);
     RUN_TEST(hyphaip_test_Flip16);
     RUN_TEST(hyphaip_test_Flip32);
     RUN_TEST(hyphaip_test_Flip64);
@@ -70,11 +100,35 @@ int main(void) {
     RUN_TEST(hyphaip_test_Contextless);
     RUN_TEST(hyphaip_test_BadRunOnce);
     RUN_TEST(hyphaip_test_CheckOffsets);
+    RUN_TEST(hyphaip_test_InPlaceAccessors);
+    RUN_TEST(hyphaip_test_SpecializedFlips);
     RUN_TEST(hyphaip_test_PopulateArpTable);
+    RUN_TEST(hyphaip_test_ArpCacheIndex);
     RUN_TEST(hyphaip_test_PopulateEthernetFilter);
+    RUN_TEST(hyphaip_test_MulticastFilter);
     RUN_TEST(hyphaip_test_PrepareMulticast);
     RUN_TEST(hyphaip_test_PopulateIpFilter);
+    RUN_TEST(hyphaip_test_PopulateIpPrefixes);
     RUN_TEST(hyphaip_test_ReceiveOneFrame);
+    RUN_TEST(hyphaip_test_ReceiveBatch);
+    RUN_TEST(hyphaip_test_DriverBatches);
+    RUN_TEST(hyphaip_test_UdpListeners);
+    RUN_TEST(hyphaip_test_ChecksumOffload);
+    RUN_TEST(hyphaip_test_TransmitUdpFlow);
+    RUN_TEST(hyphaip_test_TransmitGathered);
+    RUN_TEST(hyphaip_test_TransmitReserved);
+    RUN_TEST(hyphaip_test_TransmitFragmented);
+    RUN_TEST(hyphaip_test_ReceiveReassembled);
+    RUN_TEST(hyphaip_test_SizedFrames);
+    RUN_TEST(hyphaip_test_IgmpMembership);
+    RUN_TEST(hyphaip_test_IgmpFilter);
+    RUN_TEST(hyphaip_test_TimerWheel);
+    RUN_TEST(hyphaip_test_ArpReplies);
+    RUN_TEST(hyphaip_test_ArpPending);
+    RUN_TEST(hyphaip_test_Routing);
+    RUN_TEST(hyphaip_test_TransmitRing);
+    RUN_TEST(hyphaip_test_TransmitRingProducers);
+    RUN_TEST(hyphaip_test_TableVersions);
     RUN_TEST(hyphaip_test_TransmitOneFrame);
     RUN_TEST(hyphaip_test_TransmitReceiveLocalhost);
     // RUN_TEST(hyphaip_test_ReceiveOneLargeFrame);